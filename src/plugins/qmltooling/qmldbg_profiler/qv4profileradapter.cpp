@@ -43,7 +43,7 @@
 QT_BEGIN_NAMESPACE
 
 QV4ProfilerAdapter::QV4ProfilerAdapter(QQmlProfilerService *service, QV4::ExecutionEngine *engine) :
-    m_functionCallPos(0), m_memoryPos(0)
+    m_functionCallPos(0), m_memoryPos(0), m_gcPos(0)
 {
     setService(service);
     engine->setProfiler(new QV4::Profiling::Profiler(engine));
@@ -71,17 +71,41 @@ QV4ProfilerAdapter::QV4ProfilerAdapter(QQmlProfilerService *service, QV4::Execut
 qint64 QV4ProfilerAdapter::appendMemoryEvents(qint64 until, QList<QByteArray> &messages,
                                               QQmlDebugPacket &d)
 {
-    // Make it const, so that we cannot accidentally detach it.
+    // Make them const, so that we cannot accidentally detach them.
     const QVector<QV4::Profiling::MemoryAllocationProperties> &memoryData = m_memoryData;
+    const QVector<QV4::Profiling::GarbageCollectionProperties> &gcData = m_gcData;
 
-    while (memoryData.length() > m_memoryPos && memoryData[m_memoryPos].timestamp <= until) {
-        const QV4::Profiling::MemoryAllocationProperties &props = memoryData[m_memoryPos];
-        d << props.timestamp << int(MemoryAllocation) << int(props.type) << props.size;
-        ++m_memoryPos;
+    while (true) {
+        const qint64 memoryNext = memoryData.length() == m_memoryPos
+                ? -1 : memoryData[m_memoryPos].timestamp;
+        const qint64 gcNext = gcData.length() == m_gcPos ? -1 : gcData[m_gcPos].timestamp;
+
+        // The allocations of a collection are reported before the collection itself.
+        if (memoryNext != -1 && (gcNext == -1 || memoryNext <= gcNext)) {
+            if (memoryNext > until)
+                return memoryNext;
+            const QV4::Profiling::MemoryAllocationProperties &props = memoryData[m_memoryPos];
+            d << props.timestamp << int(MemoryAllocation) << int(props.type) << props.size;
+            ++m_memoryPos;
+        } else if (gcNext != -1) {
+            if (gcNext > until)
+                return gcNext;
+            const QV4::Profiling::GarbageCollectionProperties &props = gcData[m_gcPos];
+            d << props.timestamp << int(GarbageCollection) << int(props.type)
+              << props.freedClasses << props.markTime << props.sweepTime << props.freedBytes
+              << props.usedBytes << static_cast<qint64>(props.hugeItems)
+              << static_cast<qint64>(props.chunkOccupancy.length());
+            for (qint64 chunks : props.chunkOccupancy)
+                d << chunks;
+            for (qint64 freed : props.freedBytesPerClass)
+                d << freed;
+            ++m_gcPos;
+        } else {
+            return -1;
+        }
         messages.append(d.squeezedData());
         d.clear();
     }
-    return memoryData.length() == m_memoryPos ? -1 : memoryData[m_memoryPos].timestamp;
 }
 
 qint64 QV4ProfilerAdapter::finalizeMessages(qint64 until, QList<QByteArray> &messages,
@@ -98,6 +122,8 @@ qint64 QV4ProfilerAdapter::finalizeMessages(qint64 until, QList<QByteArray> &mes
     if (memoryNext == -1) {
         m_memoryData.clear();
         m_memoryPos = 0;
+        m_gcData.clear();
+        m_gcPos = 0;
         return callNext;
     }
 
@@ -166,7 +192,8 @@ qint64 QV4ProfilerAdapter::sendMessages(qint64 until, QList<QByteArray> &message
 void QV4ProfilerAdapter::receiveData(
         const QV4::Profiling::FunctionLocationHash &locations,
         const QVector<QV4::Profiling::FunctionCallProperties> &functionCallData,
-        const QVector<QV4::Profiling::MemoryAllocationProperties> &memoryData)
+        const QVector<QV4::Profiling::MemoryAllocationProperties> &memoryData,
+        const QVector<QV4::Profiling::GarbageCollectionProperties> &gcData)
 {
     // In rare cases it could be that another flush or stop event is processed while data from
     // the previous one is still pending. In that case we just append the data.
@@ -185,6 +212,11 @@ void QV4ProfilerAdapter::receiveData(
     else
         m_memoryData.append(memoryData);
 
+    if (m_gcData.isEmpty())
+        m_gcData = gcData;
+    else
+        m_gcData.append(gcData);
+
     service->dataReady(this);
 }
 
@@ -184,7 +184,100 @@ void BytecodeGenerator::finalize(Compiler::Context *context)
     context->lineNumberMapping = lineNumbers;
 }
 
+static Instr::Type compareAndJumpFalse(Instr::Type compare)
+{
+    switch (compare) {
+    case Instr::Type::CmpEq: return Instr::Type::CmpEqJumpFalse;
+    case Instr::Type::CmpNe: return Instr::Type::CmpNeJumpFalse;
+    case Instr::Type::CmpGt: return Instr::Type::CmpGtJumpFalse;
+    case Instr::Type::CmpGe: return Instr::Type::CmpGeJumpFalse;
+    case Instr::Type::CmpLt: return Instr::Type::CmpLtJumpFalse;
+    case Instr::Type::CmpLe: return Instr::Type::CmpLeJumpFalse;
+    case Instr::Type::CmpStrictEqual: return Instr::Type::CmpStrictEqualJumpFalse;
+    case Instr::Type::CmpStrictNotEqual: return Instr::Type::CmpStrictNotEqualJumpFalse;
+    default: return Instr::Type::JumpFalse;
+    }
+}
+
+static Instr::Type loadRegAndBinop(Instr::Type binop)
+{
+    switch (binop) {
+    case Instr::Type::Add: return Instr::Type::LoadRegAdd;
+    case Instr::Type::Sub: return Instr::Type::LoadRegSub;
+    case Instr::Type::Mul: return Instr::Type::LoadRegMul;
+    default: return binop;
+    }
+}
+
+/*
+    Replaces the last instruction with a superinstruction if it forms a frequent pair with the
+    one being added, saving the interpreter a dispatch. Returns the index of the combined
+    instruction, or -1 if the new instruction has to be added on its own.
+ */
+int BytecodeGenerator::fuseWithLastInstruction(Instr::Type type, const Instr &i)
+{
+    // keep a one to one mapping of statements to instructions for the debugger
+    if (debugMode || instructions.isEmpty())
+        return -1;
+    // something jumps to the new instruction
+    if (lastLabelledInstruction == instructions.size())
+        return -1;
+    const I &last = instructions.constLast();
+    if (last.line != currentLine)
+        return -1;
+    Q_ASSERT(last.offsetForJump == -1 || last.linkedLabel == -1);
+
+    const auto lastArgument = [&last](int n) {
+        return qFromLittleEndian<qint32>(last.packed + 1 + n * sizeof(int));
+    };
+
+    Instr fused;
+    Instr::Type fusedType = type;
+    int offsetOfOffset = -1;
+    switch (type) {
+    case Instr::Type::JumpFalse:
+        fusedType = compareAndJumpFalse(last.type);
+        // all of them are laid out like Instruction::CmpEqJumpFalse
+        fused.argumentsAsInts[0] = lastArgument(0);
+        fused.argumentsAsInts[1] = i.argumentsAsInts[0];
+        offsetOfOffset = offsetof(Instruction::CmpEqJumpFalse, offset);
+        break;
+    case Instr::Type::Add:
+    case Instr::Type::Sub:
+    case Instr::Type::Mul:
+        if (last.type == Instr::Type::LoadReg) {
+            fusedType = loadRegAndBinop(type);
+            fused.argumentsAsInts[0] = lastArgument(0);
+            fused.argumentsAsInts[1] = i.argumentsAsInts[0];
+        }
+        break;
+    case Instr::Type::StoreReg:
+        if (last.type == Instr::Type::Increment) {
+            fusedType = Instr::Type::IncrementStoreReg;
+            fused.argumentsAsInts[0] = i.argumentsAsInts[0];
+        } else if (last.type == Instr::Type::GetLookup) {
+            fusedType = Instr::Type::GetLookupStoreReg;
+            fused.argumentsAsInts[0] = lastArgument(0);
+            fused.argumentsAsInts[1] = lastArgument(1);
+            fused.argumentsAsInts[2] = i.argumentsAsInts[0];
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (fusedType == type)
+        return -1;
+
+    instructions.removeLast();
+    return addInstructionHelper(fusedType, fused, offsetOfOffset);
+}
+
 int BytecodeGenerator::addInstructionHelper(Instr::Type type, const Instr &i, int offsetOfOffset) {
+    const int fused = fuseWithLastInstruction(type, i);
+    if (fused != -1)
+        return fused;
+
 #if QT_CONFIG(qml_debug)
     if (debugMode && type != Instr::Type::Debug) {
 QT_WARNING_PUSH
@@ -78,6 +78,8 @@ public:
             : generator(generator),
               index(generator->labels.size()) {
             generator->labels.append(mode == LinkNow ? generator->instructions.size() : -1);
+            if (mode == LinkNow)
+                generator->lastLabelledInstruction = generator->instructions.size();
         }
         static Label returnLabel() {
             Label l;
@@ -92,6 +94,7 @@ public:
             Q_ASSERT(index >= 0);
             Q_ASSERT(generator->labels[index] == -1);
             generator->labels[index] = generator->instructions.size();
+            generator->lastLabelledInstruction = generator->instructions.size();
         }
 
         BytecodeGenerator *generator = nullptr;
@@ -258,6 +261,7 @@ private:
     friend struct ExceptionHandler;
 
     int addInstructionHelper(Moth::Instr::Type type, const Instr &i, int offsetOfOffset = -1);
+    int fuseWithLastInstruction(Moth::Instr::Type type, const Instr &i);
 
     struct I {
         Moth::Instr::Type type;
@@ -275,6 +279,7 @@ private:
 
     QVector<I> instructions;
     QVector<int> labels;
+    int lastLabelledInstruction = -1;
     ExceptionHandler *currentExceptionHandler;
     int regCount = 0;
 public:
@@ -47,6 +47,7 @@
 #include <QtCore/QBitArray>
 #include <QtCore/QLinkedList>
 #include <QtCore/QStack>
+#include <QtCore/QScopedValueRollback>
 #include <private/qqmljsast_p.h>
 #include <private/qv4string_p.h>
 #include <private/qv4value_p.h>
@@ -1261,6 +1262,20 @@ bool Codegen::visit(CallExpression *ast)
     Reference base = expression(ast->base);
     if (hasError)
         return false;
+
+    if (FunctionExpression *callee = inlineableCallee(ast, base))
+        inlineCall(ast, base, callee);
+    else
+        handleCall(base, ast->arguments);
+    if (hasError)
+        return false;
+
+    _expr.setResult(Reference::fromAccumulator(this));
+    return false;
+}
+
+void Codegen::handleCall(Reference &base, ArgumentList *arguments)
+{
     switch (base.type) {
     case Reference::Member:
     case Reference::Subscript:
@@ -1275,9 +1290,9 @@ bool Codegen::visit(CallExpression *ast)
         break;
     }
 
-    auto calldata = pushArgs(ast->arguments);
+    auto calldata = pushArgs(arguments);
     if (hasError)
-        return false;
+        return;
 
     //### Do we really need all these call instructions? can's we load the callee in a temp?
     if (base.type == Reference::QmlScopeObject) {
@@ -1344,9 +1359,6 @@ bool Codegen::visit(CallExpression *ast)
         call.argv = calldata.argv;
         bytecodeGenerator->addInstruction(call);
     }
-
-    _expr.setResult(Reference::fromAccumulator(this));
-    return false;
 }
 
 Codegen::Arguments Codegen::pushArgs(ArgumentList *args)
@@ -1378,6 +1390,213 @@ Codegen::Arguments Codegen::pushArgs(ArgumentList *args)
     return { argc, calldata };
 }
 
+class Codegen::InlineCandidateScanner: protected QQmlJS::AST::Visitor
+{
+    // upper bound for the size of an inlined return expression, in AST nodes
+    enum { MaxNodes = 24 };
+
+    int nodes = 0;
+    bool rejected = false;
+
+public:
+    bool accepts(AST::ExpressionNode *e)
+    {
+        e->accept(this);
+        return !rejected;
+    }
+
+    bool preVisit(Node *) override
+    {
+        if (++nodes > MaxNodes)
+            rejected = true;
+        return !rejected;
+    }
+
+    bool visit(ThisExpression *) override { return reject(); }
+    bool visit(FunctionExpression *) override { return reject(); }
+    bool visit(DeleteExpression *) override { return reject(); }
+    bool visit(PostIncrementExpression *) override { return reject(); }
+    bool visit(PostDecrementExpression *) override { return reject(); }
+    bool visit(PreIncrementExpression *) override { return reject(); }
+    bool visit(PreDecrementExpression *) override { return reject(); }
+
+    bool visit(BinaryExpression *e) override
+    {
+        switch (e->op) {
+        case QSOperator::Assign:
+        case QSOperator::InplaceAnd:
+        case QSOperator::InplaceSub:
+        case QSOperator::InplaceDiv:
+        case QSOperator::InplaceAdd:
+        case QSOperator::InplaceLeftShift:
+        case QSOperator::InplaceMod:
+        case QSOperator::InplaceMul:
+        case QSOperator::InplaceOr:
+        case QSOperator::InplaceRightShift:
+        case QSOperator::InplaceURightShift:
+        case QSOperator::InplaceXor:
+            return reject();
+
+        default:
+            return true;
+        }
+    }
+
+private:
+    bool reject()
+    {
+        rejected = true;
+        return false;
+    }
+};
+
+static ReturnStatement *singleReturnStatement(FunctionExpression *function)
+{
+    if (!function->body || !function->body->elements || function->body->elements->next)
+        return nullptr;
+    StatementSourceElement *element = AST::cast<StatementSourceElement *>(function->body->elements->element);
+    return element ? AST::cast<ReturnStatement *>(element->statement) : nullptr;
+}
+
+// A call to a function declared in this compilation unit can be expanded in place when the callee
+// consists of a single small return expression that neither writes to anything nor depends on
+// the function's own activation (this, arguments, eval, nested closures). As the name may be
+// reassigned at any time, the inlined code is guarded by a check that the called value still is
+// a closure of that declaration, and the regular call is performed otherwise.
+FunctionExpression *Codegen::inlineableCallee(CallExpression *ast, const Reference &base)
+{
+    if (_inlinedFormals || _module->debugMode)
+        return nullptr;
+
+    IdentifierExpression *id = AST::cast<IdentifierExpression *>(ast->base);
+    if (!id)
+        return nullptr;
+    if (base.type != Reference::StackSlot && base.type != Reference::ScopedLocal
+            && !(base.type == Reference::Name && base.global))
+        return nullptr;
+
+    const QString name = id->name.toString();
+    QVarLengthArray<Context *, 8> enclosing;
+    Context *declaring = _context;
+    Context::Member member;
+    for (; declaring; declaring = declaring->parent) {
+        member = declaring->findMember(name);
+        if (member.type != Context::UndefinedMember || declaring->findArgument(name) != -1)
+            break;
+        if (declaring->hasWith || (declaring->hasDirectEval && !declaring->isStrict) || declaring->forceLookupByName())
+            return nullptr;
+        enclosing.append(declaring);
+    }
+    if (!declaring || member.type != Context::FunctionDefinition || !member.function)
+        return nullptr;
+
+    // The guard only compares the declaration, so the binding must never hold a closure of it
+    // that was created by another activation, with a different scope. Global code is always
+    // marked as using eval, so eval only rules out inlining functions declared in a function.
+    const bool declaredInFunction = declaring->parent != nullptr;
+    for (Context *c : qAsConst(_module->contextMap)) {
+        if (!(c->hasDirectEval && declaredInFunction) && !c->assignedVariables.contains(name))
+            continue;
+        for (Context *outer = c; outer; outer = outer->parent) {
+            if (outer == declaring)
+                return nullptr;
+        }
+    }
+
+    FunctionExpression *function = member.function;
+    Context *callee = _module->contextMap.value(function);
+    if (!callee || callee == _context)
+        return nullptr;
+    if (callee->usesThis || callee->hasDirectEval || callee->hasNestedFunctions || callee->hasTry || callee->hasWith
+            || callee->usesArgumentsObject == Context::ArgumentsObjectUsed)
+        return nullptr;
+    for (const Context::Member &m : qAsConst(callee->members)) {
+        if (m.type != Context::ThisFunctionName)
+            return nullptr;
+    }
+
+    ReturnStatement *ret = singleReturnStatement(function);
+    if (!ret || !ret->expression)
+        return nullptr;
+    InlineCandidateScanner scanner;
+    if (!scanner.accepts(ret->expression))
+        return nullptr;
+
+    // Free variables of the callee have to resolve to the same bindings from the call site.
+    for (const QString &var : qAsConst(callee->usedVariables)) {
+        if (callee->findArgument(var) != -1)
+            continue;
+        if (callee->members.contains(var) || var == QLatin1String("arguments") || var == QLatin1String("eval"))
+            return nullptr;
+        for (Context *c : qAsConst(enclosing)) {
+            if (c->members.contains(var) || c->findArgument(var) != -1)
+                return nullptr;
+        }
+    }
+
+    if (callee->functionIndex < 0) {
+        // The guard needs the index of the callee in the unit. It is declared in a scope whose
+        // functions are being generated, but has not been reached yet, so generate it now.
+        QScopedValueRollback<Context *> contextRollback(_context);
+        defineFunction(function->name.toString(), function, function->formals, function->body->elements);
+        if (hasError)
+            return nullptr;
+    }
+
+    return function;
+}
+
+void Codegen::inlineCall(CallExpression *ast, const Reference &base, FunctionExpression *function)
+{
+    const Context *callee = _module->contextMap.value(function);
+    BytecodeGenerator::Label call = bytecodeGenerator->newLabel();
+
+    base.loadInAccumulator();
+    Instruction::TestClosure test;
+    test.value = callee->functionIndex;
+    bytecodeGenerator->addInstruction(test);
+    bytecodeGenerator->jumpFalse().link(call);
+
+    QHash<QString, int> formals;
+    ArgumentList *arg = ast->arguments;
+    for (FormalParameterList *formal = function->formals; formal; formal = formal->next) {
+        const int reg = bytecodeGenerator->newRegister();
+        formals.insert(formal->name.toString(), reg);
+        RegisterScope scope(this);
+        Reference value = arg ? expression(arg->expression) : Reference::fromConst(this, Encode::undefined());
+        if (hasError)
+            return;
+        (void) value.storeOnStack(reg);
+        if (arg)
+            arg = arg->next;
+    }
+    for (; arg; arg = arg->next) {
+        RegisterScope scope(this);
+        Reference value = expression(arg->expression);
+        if (hasError)
+            return;
+        if (value.loadTriggersSideEffect())
+            value.loadInAccumulator();
+    }
+
+    // Exceptions thrown by the inlined body report the line of the callee's return statement.
+    ReturnStatement *ret = singleReturnStatement(function);
+    bytecodeGenerator->setLocation(ret->firstSourceLocation());
+    _inlinedFormals = &formals;
+    Reference result = expression(ret->expression);
+    _inlinedFormals = nullptr;
+    if (hasError)
+        return;
+    result.loadInAccumulator();
+    bytecodeGenerator->setLocation(ast->firstSourceLocation());
+    BytecodeGenerator::Jump done = bytecodeGenerator->jump();
+
+    call.link();
+    Reference callBase = base;
+    handleCall(callBase, ast->arguments);
+    done.link();
+}
+
 bool Codegen::visit(ConditionalExpression *ast)
 {
     if (hasError)
@@ -1505,6 +1724,12 @@ bool Codegen::visit(FunctionExpression *ast)
 
 Codegen::Reference Codegen::referenceForName(const QString &name, bool isLhs)
 {
+    if (_inlinedFormals) {
+        const auto formal = _inlinedFormals->constFind(name);
+        if (formal != _inlinedFormals->constEnd())
+            return Reference::fromStackSlot(this, *formal, true /*isLocal*/);
+    }
+
     int scope = 0;
     Context *c = _context;
 
@@ -104,6 +104,7 @@ public:
                              CompilationMode mode = GlobalCode);
 
 public:
+    class InlineCandidateScanner;
     class VolatileMemoryLocationScanner;
     class VolatileMemoryLocations {
         friend VolatileMemoryLocationScanner;
@@ -633,6 +634,10 @@ public:
     Reference jumpBinop(QSOperator::Op oper, Reference &left, Reference &right);
     struct Arguments { int argc; int argv; };
     Arguments pushArgs(AST::ArgumentList *args);
+    void handleCall(Reference &base, AST::ArgumentList *arguments);
+
+    AST::FunctionExpression *inlineableCallee(AST::CallExpression *ast, const Reference &base);
+    void inlineCall(AST::CallExpression *ast, const Reference &base, AST::FunctionExpression *function);
 
     void setUseFastLookups(bool b) { useFastLookups = b; }
 
@@ -660,6 +665,8 @@ protected:
     bool _strictMode;
     bool useFastLookups = true;
     bool requiresReturnValue = false;
+    // formal parameter name -> register, while the body of an inlined call is generated
+    const QHash<QString, int> *_inlinedFormals = nullptr;
 
     bool _fileNameIsUrl;
     bool hasError;
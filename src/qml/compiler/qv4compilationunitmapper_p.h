@@ -71,10 +71,12 @@ public:
     CompiledData::Unit *open(const QString &cacheFilePath, const QDateTime &sourceTimeStamp, QString *errorString);
     void close();
 
+    // The whole mapped file, which may extend past the unit data.
+    const char *mappedData() const { return static_cast<const char *>(dataPtr); }
+    size_t mappedSize() const { return dataPtr ? length : 0; }
+
 private:
-#if defined(Q_OS_UNIX)
     size_t length;
-#endif
     void *dataPtr;
 };
 
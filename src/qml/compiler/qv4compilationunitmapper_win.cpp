@@ -97,6 +97,13 @@ CompiledData::Unit *CompilationUnitMapper::open(const QString &cacheFileName, co
 
     // Data structure and qt version matched, so now we can access the rest of the file safely.
 
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize)) {
+        *errorString = qt_error_string(GetLastError());
+        return nullptr;
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+
     HANDLE fileMappingHandle = CreateFileMapping(handle, 0, mappingFlags, 0, 0, 0);
     if (!fileMappingHandle) {
         *errorString = qt_error_string(GetLastError());
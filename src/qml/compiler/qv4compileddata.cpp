@@ -50,6 +50,8 @@
 #include <private/qqmltypeloader_p.h>
 #include <private/qqmlengine_p.h>
 #include <private/qv4vme_moth_p.h>
+#include <private/qv4jit_p.h>
+#include <private/qv4assembler_p.h>
 #include "qv4compilationunitmapper_p.h"
 #include <QQmlPropertyMap>
 #include <QDateTime>
@@ -202,8 +204,10 @@ QV4::Function *CompilationUnit::linkToEngine(ExecutionEngine *engine)
 
 void CompilationUnit::unlink()
 {
-    if (engine)
+    if (engine) {
+        handOverJitCodeForDiskCache();
         nextCompilationUnit.remove();
+    }
 
     if (isRegisteredWithEngine) {
         Q_ASSERT(data && propertyCaches.count() > 0 && propertyCaches.at(/*root object*/0));
@@ -228,6 +232,12 @@ void CompilationUnit::unlink()
     qmlEngine = nullptr;
     free(runtimeStrings);
     runtimeStrings = nullptr;
+    if (runtimeLookups) {
+        for (uint i = 0; i < data->lookupTableSize; ++i) {
+            runtimeLookups[i].releasePropertyCache();
+            runtimeLookups[i].releasePolymorphicCache();
+        }
+    }
     delete [] runtimeLookups;
     runtimeLookups = nullptr;
     delete [] runtimeRegularExpressions;
@@ -359,6 +369,7 @@ bool CompilationUnit::loadFromDisk(const QUrl &url, const QDateTime &sourceTimeS
     dataPtrChange.commit();
     free(const_cast<Unit*>(oldDataPtr));
     backingFile.reset(cacheFile.take());
+    diskCacheFilePath = cacheFilePath(url);
     return true;
 }
 
@@ -369,10 +380,50 @@ void CompilationUnit::linkBackendToEngine(ExecutionEngine *engine)
         const QV4::CompiledData::Function *compiledFunction = data->functionAt(i);
         runtimeFunctions[i] = new QV4::Function(engine, this, compiledFunction, &Moth::VME::exec);
     }
+
+    loadJitCodeFromDiskCache(engine);
 }
 
 #endif // V4_BOOTSTRAP
 
+#if QT_CONFIG(temporaryfile)
+static QByteArray cacheFileContents(const Unit *data)
+{
+    QByteArray modifiedUnit;
+    modifiedUnit.resize(data->unitSize);
+    memcpy(modifiedUnit.data(), data, data->unitSize);
+    const char *dataPtr = modifiedUnit.data();
+    Unit *unitPtr;
+    memcpy(&unitPtr, &dataPtr, sizeof(unitPtr));
+    unitPtr->flags |= Unit::StaticData;
+    return modifiedUnit;
+}
+
+static bool writeCacheFile(const QString &outputFileName, const QByteArray &contents, QString *errorString)
+{
+    // Foo.qml -> Foo.qmlc
+    QSaveFile cacheFile(outputFileName);
+    if (!cacheFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorString = cacheFile.errorString();
+        return false;
+    }
+
+    qint64 headerWritten = cacheFile.write(contents);
+    if (headerWritten != contents.size()) {
+        *errorString = cacheFile.errorString();
+        return false;
+    }
+
+    if (!cacheFile.commit()) {
+        *errorString = cacheFile.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+#endif // QT_CONFIG(temporaryfile)
+
 #if defined(V4_BOOTSTRAP)
 bool CompilationUnit::saveToDisk(const QString &outputFileName, QString *errorString)
 #else
@@ -395,39 +446,147 @@ bool CompilationUnit::saveToDisk(const QUrl &unitUrl, QString *errorString)
 #endif
 
 #if QT_CONFIG(temporaryfile)
-    // Foo.qml -> Foo.qmlc
-    QSaveFile cacheFile(outputFileName);
-    if (!cacheFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        *errorString = cacheFile.errorString();
+    if (!writeCacheFile(outputFileName, cacheFileContents(data), errorString))
         return false;
+#if !defined(V4_BOOTSTRAP)
+    diskCacheFilePath = outputFileName;
+#endif
+    return true;
+#else
+    Q_UNUSED(outputFileName)
+    *errorString = QStringLiteral("features.temporaryfile is disabled.");
+    return false;
+#endif // QT_CONFIG(temporaryfile)
+}
+
+#ifndef V4_BOOTSTRAP
+void CompilationUnit::addJitCodeForDiskCache(int functionIndex, const QByteArray &record, quint64 fingerprint)
+{
+    if (fingerprint != jitCodeFingerprint) {
+        // Code loaded earlier was generated under different conditions.
+        jitCodeForDiskCache.clear();
+        jitCodeFingerprint = fingerprint;
     }
+    jitCodeForDiskCache.insert(functionIndex, record);
+    jitCodeForDiskCacheChanged = true;
+}
 
-    QByteArray modifiedUnit;
-    modifiedUnit.resize(data->unitSize);
-    memcpy(modifiedUnit.data(), data, data->unitSize);
-    const char *dataPtr = modifiedUnit.data();
-    Unit *unitPtr;
-    memcpy(&unitPtr, &dataPtr, sizeof(unitPtr));
-    unitPtr->flags |= Unit::StaticData;
+// Gives the cache file contents to the engine for writing, if new code was generated since the
+// last time.
+void CompilationUnit::handOverJitCodeForDiskCache()
+{
+    if (!jitCodeForDiskCacheChanged)
+        return;
+    const QByteArray contents = cacheFileContentsWithJitCode();
+    if (!contents.isEmpty())
+        engine->jitCodeCacheFiles.insert(diskCacheFilePath, contents);
+    jitCodeForDiskCacheChanged = false;
+}
 
-    qint64 headerWritten = cacheFile.write(modifiedUnit);
-    if (headerWritten != modifiedUnit.size()) {
-        *errorString = cacheFile.errorString();
-        return false;
+static QByteArray jitCodeContentHash(const Unit *unit, const char *records, int size)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(reinterpret_cast<const char *>(unit), unit->unitSize);
+    hash.addData(records, size);
+    return hash.result();
+}
+
+void CompilationUnit::loadJitCodeFromDiskCache(ExecutionEngine *engine)
+{
+#ifdef V4_ENABLE_JIT
+    if (!backingFile || reinterpret_cast<const char *>(data) != backingFile->mappedData()
+            || !engine->canJIT() || !engine->jitUsesDiskCache() || engine->debugger()) {
+        return;
+    }
+
+    const qint64 sectionOffset = JitCodeSection::offsetAfter(data);
+    const qint64 available = qint64(backingFile->mappedSize()) - sectionOffset;
+    if (available < qint64(sizeof(JitCodeSection)))
+        return;
+
+    const char *sectionStart = reinterpret_cast<const char *>(data) + sectionOffset;
+    const JitCodeSection *section = reinterpret_cast<const JitCodeSection *>(sectionStart);
+    const quint64 fingerprint = JIT::BaselineJIT::diskCacheFingerprint(engine);
+    if (strncmp(section->magic, jit_magic_str, sizeof(section->magic))
+            || section->version != quint32(QV4_DATA_STRUCTURE_VERSION)
+            || section->sectionSize < sizeof(JitCodeSection) || section->sectionSize > available
+            || section->fingerprint != fingerprint) {
+        return;
+    }
+
+    const char *sectionEnd = sectionStart + section->sectionSize;
+    const char *recordsStart = reinterpret_cast<const char *>(section->firstFunction());
+    const QByteArray contentHash = jitCodeContentHash(data, recordsStart, int(sectionEnd - recordsStart));
+    if (memcmp(section->contentHash, contentHash.constData(), sizeof(section->contentHash)))
+        return;
+    jitCodeFingerprint = fingerprint;
+
+    const JitCodeFunction *record = section->firstFunction();
+    for (uint i = 0; i < section->nFunctions; ++i) {
+        const char *recordStart = reinterpret_cast<const char *>(record);
+        const qint64 remaining = sectionEnd - recordStart;
+        if (remaining < qint64(sizeof(JitCodeFunction))
+                || qint64(record->nRelocations) * qint64(sizeof(JitCodeRelocation)) + record->codeSize
+                   > remaining - qint64(sizeof(JitCodeFunction))
+                || record->size() > remaining) {
+            break;
+        }
+        if (record->functionIndex < data->functionTableSize) {
+            QV4::Function *function = runtimeFunctions[record->functionIndex];
+            if (!function->jittedCode && JIT::Assembler::installRelocatableCode(function, record))
+                jitCodeForDiskCache.insert(record->functionIndex, QByteArray(recordStart, record->size()));
+        }
+        record = reinterpret_cast<const JitCodeFunction *>(recordStart + record->size());
     }
+#else
+    Q_UNUSED(engine);
+#endif
+}
 
-    if (!cacheFile.commit()) {
-        *errorString = cacheFile.errorString();
-        return false;
+QByteArray CompilationUnit::cacheFileContentsWithJitCode() const
+{
+#if QT_CONFIG(temporaryfile)
+    if (jitCodeForDiskCacheChanged && !diskCacheFilePath.isEmpty() && data) {
+        QByteArray section(sizeof(JitCodeSection), 0);
+        for (const QByteArray &record : qAsConst(jitCodeForDiskCache))
+            section.append(record);
+
+        JitCodeSection *header = reinterpret_cast<JitCodeSection *>(section.data());
+        memcpy(header->magic, jit_magic_str, sizeof(header->magic));
+        header->version = QV4_DATA_STRUCTURE_VERSION;
+        header->nFunctions = jitCodeForDiskCache.count();
+        header->fingerprint = jitCodeFingerprint;
+        header->sectionSize = section.size();
+
+        // The unit is written with the StaticData flag set, which is part of the hash.
+        QByteArray contents = cacheFileContents(data);
+        const QByteArray contentHash = jitCodeContentHash(
+                    reinterpret_cast<const Unit *>(contents.constData()),
+                    section.constData() + sizeof(JitCodeSection), section.size() - sizeof(JitCodeSection));
+        Q_ASSERT(contentHash.size() == sizeof(header->contentHash));
+        memcpy(header->contentHash, contentHash.constData(), sizeof(header->contentHash));
+        contents.append(QByteArray(JitCodeSection::offsetAfter(data) - data->unitSize, 0));
+        contents.append(section);
+        return contents;
     }
+#endif
+    return QByteArray();
+}
 
-    return true;
+void CompilationUnit::writeJitCodeCacheFiles(const QHash<QString, QByteArray> &files)
+{
+#if QT_CONFIG(temporaryfile)
+    // Failing to write merely means that the code is generated again next time. That includes
+    // files that are still mapped by a unit outliving the engine, which can't be replaced on
+    // Windows.
+    QString errorString;
+    for (auto it = files.cbegin(), end = files.cend(); it != end; ++it)
+        writeCacheFile(it.key(), it.value(), &errorString);
 #else
-    Q_UNUSED(outputFileName)
-    *errorString = QStringLiteral("features.temporaryfile is disabled.");
-    return false;
-#endif // QT_CONFIG(temporaryfile)
+    Q_UNUSED(files);
+#endif
 }
+#endif // V4_BOOTSTRAP
 
 Unit *CompilationUnit::createUnitData(QmlIR::Document *irDocument)
 {
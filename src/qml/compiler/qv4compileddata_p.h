@@ -54,6 +54,7 @@
 #include <QVector>
 #include <QStringList>
 #include <QHash>
+#include <QMap>
 #include <QUrl>
 
 #include <private/qv4value_p.h>
@@ -72,7 +73,7 @@
 QT_BEGIN_NAMESPACE
 
 // Bump this whenever the compiler data structures change in an incompatible way.
-#define QV4_DATA_STRUCTURE_VERSION 0x19
+#define QV4_DATA_STRUCTURE_VERSION 0x1d
 
 class QIODevice;
 class QQmlPropertyCache;
@@ -797,6 +798,59 @@ struct Unit
 
 static_assert(sizeof(Unit) == 192, "Unit structure needs to have the expected size to be binary compatible on disk when generated by host compiler and loaded by target");
 
+// Optional section following the unit data (at unitSize aligned to 16 bytes) in cache files
+// written at run-time. It holds the baseline JIT code of the unit's functions, so that a later run
+// of the same build on the same kind of CPU can install the code instead of compiling it again.
+// Unlike the unit data it is not portable, which the fingerprint guards against. The content hash
+// ties the code to the unit data in front of it.
+struct JitCodeRelocation
+{
+    enum Type : unsigned int {
+        RuntimeFunction = 0, // value is the address of a runtime function relative to Runtime::method_closure
+        CodeAddress = 1 // value is relative to the start of the code
+    };
+    quint32_le type;
+    quint32_le offset; // of the patchable pointer, relative to the start of the code
+    qint64_le value;
+};
+static_assert(sizeof(JitCodeRelocation) == 16, "JitCodeRelocation structure needs to have the expected size to be binary compatible on disk");
+
+struct JitCodeFunction
+{
+    quint32_le functionIndex;
+    quint32_le codeSize;
+    quint32_le nRelocations;
+    quint32_le padding;
+    // followed by the relocations and then the code
+
+    static int calculateSize(int nRelocations, int codeSize) {
+        return (sizeof(JitCodeFunction) + nRelocations * sizeof(JitCodeRelocation) + codeSize + 7) & ~0x7;
+    }
+    int size() const { return calculateSize(nRelocations, codeSize); }
+
+    const JitCodeRelocation *relocationTable() const { return reinterpret_cast<const JitCodeRelocation *>(this + 1); }
+    const char *code() const { return reinterpret_cast<const char *>(relocationTable() + nRelocations); }
+};
+static_assert(sizeof(JitCodeFunction) == 16, "JitCodeFunction structure needs to have the expected size to be binary compatible on disk");
+
+static const char jit_magic_str[] = "qv4jcode";
+
+struct JitCodeSection
+{
+    char magic[8];
+    quint32_le version;
+    quint32_le nFunctions;
+    quint64_le fingerprint; // of the build, the CPU and the engine settings that affect the generated code
+    quint32_le sectionSize; // including this header
+    quint32_le padding;
+    char contentHash[32]; // SHA-256 of the unit data and the function records
+    // followed by nFunctions JitCodeFunction records
+
+    static quint32 offsetAfter(const Unit *unit) { return (unit->unitSize + 15) & ~15u; }
+    const JitCodeFunction *firstFunction() const { return reinterpret_cast<const JitCodeFunction *>(this + 1); }
+};
+static_assert(sizeof(JitCodeSection) == 64, "JitCodeSection structure needs to have the expected size to be binary compatible on disk");
+
 struct TypeReference
 {
     TypeReference(const Location &loc)
@@ -981,6 +1035,16 @@ public:
 
     QScopedPointer<CompilationUnitMapper> backingFile;
 
+    // Baseline JIT code of the functions, as serialized JitCodeFunction records keyed by function
+    // index. Only collected for units that have a cache file. When new code got generated, the
+    // file contents are handed to the engine on unlink() or when the engine flushes its JIT code
+    // cache, and written by the engine.
+    QString diskCacheFilePath;
+    QMap<int, QByteArray> jitCodeForDiskCache;
+    quint64 jitCodeFingerprint = 0;
+    bool jitCodeForDiskCacheChanged = false;
+    void addJitCodeForDiskCache(int functionIndex, const QByteArray &record, quint64 fingerprint);
+
     // --- interface for QQmlPropertyCacheCreator
     typedef Object CompiledObject;
     int objectCount() const { return data->nObjects; }
@@ -1005,6 +1069,8 @@ public:
 
     QV4::Function *linkToEngine(QV4::ExecutionEngine *engine);
     void unlink();
+    void handOverJitCodeForDiskCache();
+    static void writeJitCodeCacheFiles(const QHash<QString, QByteArray> &files);
 
     void markObjects(MarkStack *markStack);
 
@@ -1012,6 +1078,10 @@ public:
 
 protected:
     void linkBackendToEngine(QV4::ExecutionEngine *engine);
+
+private:
+    void loadJitCodeFromDiskCache(QV4::ExecutionEngine *engine);
+    QByteArray cacheFileContentsWithJitCode() const;
 #endif // V4_BOOTSTRAP
 
 private:
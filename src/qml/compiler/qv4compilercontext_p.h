@@ -128,6 +128,7 @@ struct Context {
 
     MemberMap members;
     QSet<QString> usedVariables;
+    QSet<QString> assignedVariables; // names written to by assignments in this context
     QQmlJS::AST::FormalParameterList *formals = nullptr;
     QStringList arguments;
     QStringList locals;
@@ -257,6 +258,13 @@ struct Context {
         usedVariables.insert(name);
     }
 
+    void addAssignedVariable(QQmlJS::AST::ExpressionNode *target) {
+        while (QQmlJS::AST::NestedExpression *nested = QQmlJS::AST::cast<QQmlJS::AST::NestedExpression *>(target))
+            target = nested->expression;
+        if (QQmlJS::AST::IdentifierExpression *id = QQmlJS::AST::cast<QQmlJS::AST::IdentifierExpression *>(target))
+            assignedVariables.insert(id->name.toString());
+    }
+
     bool addLocalVar(const QString &name, MemberType type, QQmlJS::AST::VariableDeclaration::VariableScope scope, QQmlJS::AST::FunctionExpression *function = nullptr)
     {
         if (name.isEmpty())
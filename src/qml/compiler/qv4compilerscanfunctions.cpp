@@ -215,6 +215,8 @@ bool ScanFunctions::visit(VariableDeclaration *ast)
         return false;
     }
     QString name = ast->name.toString();
+    if (ast->expression)
+        _context->assignedVariables.insert(name);
     if (!_context->addLocalVar(ast->name.toString(), ast->expression ? Context::VariableDefinition : Context::VariableDeclaration, ast->scope)) {
         _cg->throwSyntaxError(ast->identifierToken, QStringLiteral("Identifier %1 has already been declared").arg(name));
         return false;
@@ -231,6 +233,53 @@ bool ScanFunctions::visit(IdentifierExpression *ast)
     return true;
 }
 
+bool ScanFunctions::visit(BinaryExpression *ast)
+{
+    switch (ast->op) {
+    case QSOperator::Assign:
+    case QSOperator::InplaceAnd:
+    case QSOperator::InplaceSub:
+    case QSOperator::InplaceDiv:
+    case QSOperator::InplaceAdd:
+    case QSOperator::InplaceLeftShift:
+    case QSOperator::InplaceMod:
+    case QSOperator::InplaceMul:
+    case QSOperator::InplaceOr:
+    case QSOperator::InplaceRightShift:
+    case QSOperator::InplaceURightShift:
+    case QSOperator::InplaceXor:
+        _context->addAssignedVariable(ast->left);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+bool ScanFunctions::visit(PreIncrementExpression *ast)
+{
+    _context->addAssignedVariable(ast->expression);
+    return true;
+}
+
+bool ScanFunctions::visit(PreDecrementExpression *ast)
+{
+    _context->addAssignedVariable(ast->expression);
+    return true;
+}
+
+bool ScanFunctions::visit(PostIncrementExpression *ast)
+{
+    _context->addAssignedVariable(ast->base);
+    return true;
+}
+
+bool ScanFunctions::visit(PostDecrementExpression *ast)
+{
+    _context->addAssignedVariable(ast->base);
+    return true;
+}
+
 bool ScanFunctions::visit(ExpressionStatement *ast)
 {
     if (FunctionExpression* expr = AST::cast<AST::FunctionExpression*>(ast->expression)) {
@@ -360,6 +409,7 @@ bool ScanFunctions::visit(LocalForStatement *ast) {
 }
 
 bool ScanFunctions::visit(ForEachStatement *ast) {
+    _context->addAssignedVariable(ast->initialiser);
     Node::accept(ast->initialiser, this);
     Node::accept(ast->expression, this);
 
@@ -108,6 +108,11 @@ protected:
     bool visit(AST::ArrayLiteral *ast) override;
     bool visit(AST::VariableDeclaration *ast) override;
     bool visit(AST::IdentifierExpression *ast) override;
+    bool visit(AST::BinaryExpression *ast) override;
+    bool visit(AST::PreIncrementExpression *ast) override;
+    bool visit(AST::PreDecrementExpression *ast) override;
+    bool visit(AST::PostIncrementExpression *ast) override;
+    bool visit(AST::PostDecrementExpression *ast) override;
     bool visit(AST::ExpressionStatement *ast) override;
     bool visit(AST::FunctionExpression *ast) override;
 
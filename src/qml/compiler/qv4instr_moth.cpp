@@ -621,6 +621,10 @@ void dumpBytecode(const char *code, int len, int nLocals, int nFormals, int /*st
             d << dumpRegister(lhs, nFormals) << ", acc";
         MOTH_END_INSTR(CmpInstanceOf)
 
+        MOTH_BEGIN_INSTR(TestClosure)
+            d << "acc, " << value;
+        MOTH_END_INSTR(TestClosure)
+
         MOTH_BEGIN_INSTR(Ret)
         MOTH_END_INSTR(Ret)
 
@@ -634,6 +638,58 @@ void dumpBytecode(const char *code, int len, int nLocals, int nFormals, int /*st
         MOTH_BEGIN_INSTR(LoadQmlImportedScripts)
             d << dumpRegister(result, nFormals);
         MOTH_END_INSTR(LoadQmlImportedScripts)
+
+        MOTH_BEGIN_INSTR(CmpEqJumpFalse)
+            d << dumpRegister(lhs, nFormals) << "  " << ABSOLUTE_OFFSET();
+        MOTH_END_INSTR(CmpEqJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpNeJumpFalse)
+            d << dumpRegister(lhs, nFormals) << "  " << ABSOLUTE_OFFSET();
+        MOTH_END_INSTR(CmpNeJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpGtJumpFalse)
+            d << dumpRegister(lhs, nFormals) << "  " << ABSOLUTE_OFFSET();
+        MOTH_END_INSTR(CmpGtJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpGeJumpFalse)
+            d << dumpRegister(lhs, nFormals) << "  " << ABSOLUTE_OFFSET();
+        MOTH_END_INSTR(CmpGeJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpLtJumpFalse)
+            d << dumpRegister(lhs, nFormals) << "  " << ABSOLUTE_OFFSET();
+        MOTH_END_INSTR(CmpLtJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpLeJumpFalse)
+            d << dumpRegister(lhs, nFormals) << "  " << ABSOLUTE_OFFSET();
+        MOTH_END_INSTR(CmpLeJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpStrictEqualJumpFalse)
+            d << dumpRegister(lhs, nFormals) << "  " << ABSOLUTE_OFFSET();
+        MOTH_END_INSTR(CmpStrictEqualJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpStrictNotEqualJumpFalse)
+            d << dumpRegister(lhs, nFormals) << "  " << ABSOLUTE_OFFSET();
+        MOTH_END_INSTR(CmpStrictNotEqualJumpFalse)
+
+        MOTH_BEGIN_INSTR(LoadRegAdd)
+            d << dumpRegister(lhs, nFormals) << ", " << dumpRegister(reg, nFormals);
+        MOTH_END_INSTR(LoadRegAdd)
+
+        MOTH_BEGIN_INSTR(LoadRegSub)
+            d << dumpRegister(lhs, nFormals) << ", " << dumpRegister(reg, nFormals);
+        MOTH_END_INSTR(LoadRegSub)
+
+        MOTH_BEGIN_INSTR(LoadRegMul)
+            d << dumpRegister(lhs, nFormals) << ", " << dumpRegister(reg, nFormals);
+        MOTH_END_INSTR(LoadRegMul)
+
+        MOTH_BEGIN_INSTR(IncrementStoreReg)
+            d << dumpRegister(reg, nFormals);
+        MOTH_END_INSTR(IncrementStoreReg)
+
+        MOTH_BEGIN_INSTR(GetLookupStoreReg)
+            d << dumpRegister(base, nFormals) << "(" << index << ") -> " << dumpRegister(reg, nFormals);
+        MOTH_END_INSTR(GetLookupStoreReg)
     }
 }
 
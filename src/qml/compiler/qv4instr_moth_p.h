@@ -147,6 +147,7 @@ QT_BEGIN_NAMESPACE
 #define INSTR_CmpStrictNotEqual(op) INSTRUCTION(op, CmpStrictNotEqual, 1, lhs)
 #define INSTR_CmpIn(op) INSTRUCTION(op, CmpIn, 1, lhs)
 #define INSTR_CmpInstanceOf(op) INSTRUCTION(op, CmpInstanceOf, 1, lhs)
+#define INSTR_TestClosure(op) INSTRUCTION(op, TestClosure, 1, value)
 #define INSTR_JumpStrictEqualStackSlotInt(op) INSTRUCTION(op, JumpStrictEqualStackSlotInt, 3, lhs, rhs, offset)
 #define INSTR_JumpStrictNotEqualStackSlotInt(op) INSTRUCTION(op, JumpStrictNotEqualStackSlotInt, 3, lhs, rhs, offset)
 #define INSTR_UNot(op) INSTRUCTION(op, UNot, 0)
@@ -175,6 +176,21 @@ QT_BEGIN_NAMESPACE
 #define INSTR_LoadQmlContext(op) INSTRUCTION(op, LoadQmlContext, 1, result)
 #define INSTR_LoadQmlImportedScripts(op) INSTRUCTION(op, LoadQmlImportedScripts, 1, result)
 
+/* superinstructions, emitted by the bytecode generator for frequent pairs of the above */
+#define INSTR_CmpEqJumpFalse(op) INSTRUCTION(op, CmpEqJumpFalse, 2, lhs, offset)
+#define INSTR_CmpNeJumpFalse(op) INSTRUCTION(op, CmpNeJumpFalse, 2, lhs, offset)
+#define INSTR_CmpGtJumpFalse(op) INSTRUCTION(op, CmpGtJumpFalse, 2, lhs, offset)
+#define INSTR_CmpGeJumpFalse(op) INSTRUCTION(op, CmpGeJumpFalse, 2, lhs, offset)
+#define INSTR_CmpLtJumpFalse(op) INSTRUCTION(op, CmpLtJumpFalse, 2, lhs, offset)
+#define INSTR_CmpLeJumpFalse(op) INSTRUCTION(op, CmpLeJumpFalse, 2, lhs, offset)
+#define INSTR_CmpStrictEqualJumpFalse(op) INSTRUCTION(op, CmpStrictEqualJumpFalse, 2, lhs, offset)
+#define INSTR_CmpStrictNotEqualJumpFalse(op) INSTRUCTION(op, CmpStrictNotEqualJumpFalse, 2, lhs, offset)
+#define INSTR_LoadRegAdd(op) INSTRUCTION(op, LoadRegAdd, 2, reg, lhs)
+#define INSTR_LoadRegSub(op) INSTRUCTION(op, LoadRegSub, 2, reg, lhs)
+#define INSTR_LoadRegMul(op) INSTRUCTION(op, LoadRegMul, 2, reg, lhs)
+#define INSTR_IncrementStoreReg(op) INSTRUCTION(op, IncrementStoreReg, 1, reg)
+#define INSTR_GetLookupStoreReg(op) INSTRUCTION(op, GetLookupStoreReg, 3, index, base, reg)
+
 
 #define FOR_EACH_MOTH_INSTR(F) \
     F(Ret) \
@@ -263,6 +279,7 @@ QT_BEGIN_NAMESPACE
     F(CmpStrictNotEqual) \
     F(CmpIn) \
     F(CmpInstanceOf) \
+    F(TestClosure) \
     F(JumpStrictEqualStackSlotInt) \
     F(JumpStrictNotEqualStackSlotInt) \
     F(UNot) \
@@ -289,8 +306,21 @@ QT_BEGIN_NAMESPACE
     F(Mod) \
     F(Sub) \
     F(LoadQmlContext) \
-    F(LoadQmlImportedScripts)
-#define MOTH_NUM_INSTRUCTIONS() (static_cast<int>(Moth::Instr::Type::LoadQmlImportedScripts) + 1)
+    F(LoadQmlImportedScripts) \
+    F(CmpEqJumpFalse) \
+    F(CmpNeJumpFalse) \
+    F(CmpGtJumpFalse) \
+    F(CmpGeJumpFalse) \
+    F(CmpLtJumpFalse) \
+    F(CmpLeJumpFalse) \
+    F(CmpStrictEqualJumpFalse) \
+    F(CmpStrictNotEqualJumpFalse) \
+    F(LoadRegAdd) \
+    F(LoadRegSub) \
+    F(LoadRegMul) \
+    F(IncrementStoreReg) \
+    F(GetLookupStoreReg)
+#define MOTH_NUM_INSTRUCTIONS() (static_cast<int>(Moth::Instr::Type::GetLookupStoreReg) + 1)
 
 #if defined(Q_CC_GNU) && !defined(Q_CC_INTEL)
 // icc before version 1200 doesn't support computed goto, and at least up to version 18.0.0 the
@@ -71,7 +71,11 @@ struct QQmlProfilerDefinitions {
         MemoryAllocation,
         DebugMessage,
 
-        MaximumMessage
+        MaximumMessage,
+
+        // Added later. Kept out of the range above, so that MaximumMessage keeps its value and
+        // older clients skip it as an unknown message.
+        GarbageCollection = MaximumMessage + 1
     };
 
     enum EventType {
@@ -43,6 +43,7 @@
 #include "qv4engine_p.h"
 #include "qv4assembler_p.h"
 #include <private/qv4function_p.h>
+#include <private/qv4object_p.h>
 #include <private/qv4runtime_p.h>
 
 #include <wtf/Vector.h>
@@ -51,6 +52,8 @@
 #include <assembler/LinkBuffer.h>
 #include <WTFStubs.h>
 
+#include <algorithm>
+
 #undef ENABLE_ALL_ASSEMBLERS_FOR_REFACTORING_PURPOSES
 
 #ifdef V4_ENABLE_JIT
@@ -92,6 +95,10 @@ struct PlatformAssembler_X86_64_SysV : JSC::MacroAssembler<JSC::MacroAssemblerX8
     static const RegisterID StackPointerRegister  = RegisterID::esp;
     static const RegisterID FramePointerRegister  = RegisterID::ebp;
     static const FPRegisterID FPScratchRegister   = FPRegisterID::xmm1;
+    static const FPRegisterID FPScratchRegister2  = FPRegisterID::xmm2;
+    static const RegisterID CachedValueRegister0  = RegisterID::ebx;
+    static const RegisterID CachedValueRegister1  = RegisterID::r15;
+    static const int CachedValueRegisterCount = 2;
 
     static const RegisterID Arg0Reg = RegisterID::edi;
     static const RegisterID Arg1Reg = RegisterID::esi;
@@ -116,12 +123,16 @@ struct PlatformAssembler_X86_64_SysV : JSC::MacroAssembler<JSC::MacroAssemblerX8
         push(JSStackFrameRegister);
         push(CppStackFrameRegister);
         push(EngineRegister);
+        push(CachedValueRegister0);
+        push(CachedValueRegister1);
         move(Arg0Reg, CppStackFrameRegister);
         move(Arg1Reg, EngineRegister);
     }
 
     void generatePlatformFunctionExit()
     {
+        pop(CachedValueRegister1);
+        pop(CachedValueRegister0);
         pop(EngineRegister);
         pop(CppStackFrameRegister);
         pop(JSStackFrameRegister);
@@ -130,10 +141,15 @@ struct PlatformAssembler_X86_64_SysV : JSC::MacroAssembler<JSC::MacroAssemblerX8
         ret();
     }
 
-    void callAbsolute(const void *funcPtr)
+    // The bytes repatchPointer() rewrites relative to a DataLabelPtr: the immediate in front of it
+    static const int PatchedPointerBegin = -PointerSize;
+    static const int PatchedPointerEnd = 0;
+
+    DataLabelPtr callAbsolute(const void *funcPtr)
     {
-        move(TrustedImmPtr(funcPtr), ScratchRegister);
+        DataLabelPtr target = moveWithPatch(TrustedImmPtr(funcPtr), ScratchRegister);
         call(ScratchRegister);
+        return target;
     }
 
     void pushAligned(RegisterID reg)
@@ -170,6 +186,10 @@ struct PlatformAssembler_Win64 : JSC::MacroAssembler<JSC::MacroAssemblerX86_64>
     static const RegisterID StackPointerRegister  = RegisterID::esp;
     static const RegisterID FramePointerRegister  = RegisterID::ebp;
     static const FPRegisterID FPScratchRegister   = FPRegisterID::xmm1;
+    static const FPRegisterID FPScratchRegister2  = FPRegisterID::xmm2;
+    static const RegisterID CachedValueRegister0  = RegisterID::ebx;
+    static const RegisterID CachedValueRegister1  = RegisterID::r15;
+    static const int CachedValueRegisterCount = 2;
 
     static const RegisterID Arg0Reg = RegisterID::ecx;
     static const RegisterID Arg1Reg = RegisterID::edx;
@@ -194,12 +214,16 @@ struct PlatformAssembler_Win64 : JSC::MacroAssembler<JSC::MacroAssemblerX86_64>
         push(JSStackFrameRegister);
         push(CppStackFrameRegister);
         push(EngineRegister);
+        push(CachedValueRegister0);
+        push(CachedValueRegister1);
         move(Arg0Reg, CppStackFrameRegister);
         move(Arg1Reg, EngineRegister);
     }
 
     void generatePlatformFunctionExit()
     {
+        pop(CachedValueRegister1);
+        pop(CachedValueRegister0);
         pop(EngineRegister);
         pop(CppStackFrameRegister);
         pop(JSStackFrameRegister);
@@ -208,12 +232,17 @@ struct PlatformAssembler_Win64 : JSC::MacroAssembler<JSC::MacroAssemblerX86_64>
         ret();
     }
 
-    void callAbsolute(const void *funcPtr)
+    // The bytes repatchPointer() rewrites relative to a DataLabelPtr: the immediate in front of it
+    static const int PatchedPointerBegin = -PointerSize;
+    static const int PatchedPointerEnd = 0;
+
+    DataLabelPtr callAbsolute(const void *funcPtr)
     {
-        move(TrustedImmPtr(funcPtr), ScratchRegister);
+        DataLabelPtr target = moveWithPatch(TrustedImmPtr(funcPtr), ScratchRegister);
         subPtr(TrustedImm32(4 * PointerSize), StackPointerRegister);
         call(ScratchRegister);
         addPtr(TrustedImm32(4 * PointerSize), StackPointerRegister);
+        return target;
     }
 
     void pushAligned(RegisterID reg)
@@ -251,6 +280,9 @@ struct PlatformAssembler_X86_All : JSC::MacroAssembler<JSC::MacroAssemblerX86>
     static const RegisterID StackPointerRegister  = RegisterID::esp;
     static const RegisterID FramePointerRegister  = RegisterID::ebp;
     static const FPRegisterID FPScratchRegister   = FPRegisterID::xmm1;
+    static const RegisterID CachedValueRegister0  = NoRegister;
+    static const RegisterID CachedValueRegister1  = NoRegister;
+    static const int CachedValueRegisterCount = 0;
 
     static const RegisterID Arg0Reg = NoRegister;
     static const RegisterID Arg1Reg = NoRegister;
@@ -293,10 +325,15 @@ struct PlatformAssembler_X86_All : JSC::MacroAssembler<JSC::MacroAssemblerX86>
         ret();
     }
 
-    void callAbsolute(const void *funcPtr)
+    // The bytes repatchPointer() rewrites relative to a DataLabelPtr: the immediate in front of it
+    static const int PatchedPointerBegin = -PointerSize;
+    static const int PatchedPointerEnd = 0;
+
+    DataLabelPtr callAbsolute(const void *funcPtr)
     {
-        move(TrustedImmPtr(funcPtr), ScratchRegister);
+        DataLabelPtr target = moveWithPatch(TrustedImmPtr(funcPtr), ScratchRegister);
         call(ScratchRegister);
+        return target;
     }
 
     void pushAligned(RegisterID reg)
@@ -334,6 +371,10 @@ struct PlatformAssembler_ARM64 : JSC::MacroAssembler<JSC::MacroAssemblerARM64>
     static const RegisterID StackPointerRegister  = JSC::ARM64Registers::sp;
     static const RegisterID FramePointerRegister  = JSC::ARM64Registers::fp;
     static const FPRegisterID FPScratchRegister   = JSC::ARM64Registers::q1;
+    static const FPRegisterID FPScratchRegister2  = JSC::ARM64Registers::q2;
+    static const RegisterID CachedValueRegister0  = JSC::ARM64Registers::x22;
+    static const RegisterID CachedValueRegister1  = JSC::ARM64Registers::x23;
+    static const int CachedValueRegisterCount = 2;
 
     static const RegisterID Arg0Reg = JSC::ARM64Registers::x0;
     static const RegisterID Arg1Reg = JSC::ARM64Registers::x1;
@@ -372,6 +413,7 @@ struct PlatformAssembler_ARM64 : JSC::MacroAssembler<JSC::MacroAssemblerARM64>
         move(TrustedImmPtr(nullptr), AccumulatorRegister); // exceptionHandler
         pushPair(JSStackFrameRegister, AccumulatorRegister);
         pushPair(EngineRegister, CppStackFrameRegister);
+        pushPair(CachedValueRegister0, CachedValueRegister1);
         move(Arg0Reg, CppStackFrameRegister);
         move(Arg1Reg, EngineRegister);
     }
@@ -379,16 +421,22 @@ struct PlatformAssembler_ARM64 : JSC::MacroAssembler<JSC::MacroAssemblerARM64>
     void generatePlatformFunctionExit()
     {
         move(AccumulatorRegister, ReturnValueRegister);
+        popPair(CachedValueRegister0, CachedValueRegister1);
         popPair(EngineRegister, CppStackFrameRegister);
         popPair(JSStackFrameRegister, AccumulatorRegister);
         popPair(JSC::ARM64Registers::fp, JSC::ARM64Registers::lr);
         ret();
     }
 
-    void callAbsolute(const void *funcPtr)
+    // The bytes repatchPointer() rewrites relative to a DataLabelPtr: the movz/movk/movk after it
+    static const int PatchedPointerBegin = 0;
+    static const int PatchedPointerEnd = 3 * 4;
+
+    DataLabelPtr callAbsolute(const void *funcPtr)
     {
-        move(TrustedImmPtr(funcPtr), ScratchRegister);
+        DataLabelPtr target = moveWithPatch(TrustedImmPtr(funcPtr), ScratchRegister);
         call(ScratchRegister);
+        return target;
     }
 
     void pushAligned(RegisterID reg)
@@ -429,6 +477,9 @@ struct PlatformAssembler_ARM32 : JSC::MacroAssembler<JSC::MacroAssemblerARMv7>
 #endif
     static const RegisterID StackPointerRegister     = JSC::ARMRegisters::r13;
     static const FPRegisterID FPScratchRegister      = JSC::ARMRegisters::d1;
+    static const RegisterID CachedValueRegister0     = NoRegister;
+    static const RegisterID CachedValueRegister1     = NoRegister;
+    static const int CachedValueRegisterCount = 0;
 
     static const RegisterID Arg0Reg = JSC::ARMRegisters::r0;
     static const RegisterID Arg1Reg = JSC::ARMRegisters::r1;
@@ -479,10 +530,15 @@ struct PlatformAssembler_ARM32 : JSC::MacroAssembler<JSC::MacroAssemblerARMv7>
         ret();
     }
 
-    void callAbsolute(const void *funcPtr)
+    // The bytes repatchPointer() rewrites relative to a DataLabelPtr: the movw/movt in front of it
+    static const int PatchedPointerBegin = -2 * 4;
+    static const int PatchedPointerEnd = 0;
+
+    DataLabelPtr callAbsolute(const void *funcPtr)
     {
-        move(TrustedImmPtr(funcPtr), dataTempRegister);
+        DataLabelPtr target = moveWithPatch(TrustedImmPtr(funcPtr), dataTempRegister);
         call(dataTempRegister);
+        return target;
     }
 
     void pushAligned(RegisterID reg)
@@ -509,11 +565,23 @@ struct PlatformAssemblerCommon : PlatformAssemblerBase
     std::vector<JumpTarget> patches;
     struct ExceptionHanlderTarget { JSC::MacroAssemblerBase::DataLabelPtr label; int offset; };
     std::vector<ExceptionHanlderTarget> ehTargets;
+    struct RuntimeCallTarget { JSC::MacroAssemblerBase::DataLabelPtr label; const void *funcPtr; };
+    std::vector<RuntimeCallTarget> runtimeCallTargets;
+    // The absolute addresses in the linked code, in a form that is independent of where the code
+    // and the library are loaded. See Assembler::relocatableCode().
+    std::vector<CompiledData::JitCodeRelocation> relocations;
     QHash<int, JSC::MacroAssemblerBase::Label> labelsByOffset;
     QHash<const void *, const char *> functions;
     std::vector<Jump> catchyJumps;
     Label functionExit;
 
+    // JS stack frame slots whose current value is also held in one of the CachedValueRegisters.
+    // Stores always go to the frame as well, so the cache never needs to be written back and can
+    // simply be forgotten at labels and calls.
+    bool cacheFrameSlots = false;
+    int cachedSlots[2] = { -1, -1 };
+    int nextCachedSlot = 0;
+
     Address exceptionHandlerAddress() const
     {
         return Address(FramePointerRegister, -1 * PointerSize);
@@ -546,7 +614,74 @@ struct PlatformAssemblerCommon : PlatformAssemblerBase
     void callRuntime(const char *functionName, const void *funcPtr)
     {
         functions.insert(funcPtr, functionName);
-        callAbsolute(funcPtr);
+        runtimeCallTargets.push_back({ callAbsolute(funcPtr), funcPtr });
+        // The callee may write to the JS stack frame.
+        invalidateCachedSlots();
+    }
+
+    RegisterID cachedValueRegister(int i) const
+    {
+        Q_ASSERT(i >= 0 && i < CachedValueRegisterCount);
+        return i == 0 ? CachedValueRegister0 : CachedValueRegister1;
+    }
+
+    static int frameSlot(Address addr)
+    {
+        if (addr.base != JSStackFrameRegister || addr.offset % int(sizeof(Value)))
+            return -1;
+        return addr.offset / int(sizeof(Value));
+    }
+
+    RegisterID cachedRegisterForSlot(Address addr) const
+    {
+        const int slot = frameSlot(addr);
+        if (slot < 0)
+            return NoRegister;
+        for (int i = 0; i < CachedValueRegisterCount; ++i) {
+            if (cachedSlots[i] == slot)
+                return cachedValueRegister(i);
+        }
+        return NoRegister;
+    }
+
+    void invalidateCachedSlots()
+    {
+        for (int i = 0; i < CachedValueRegisterCount; ++i)
+            cachedSlots[i] = -1;
+    }
+
+    void invalidateCachedSlot(Address addr)
+    {
+        if (addr.base != JSStackFrameRegister)
+            return;
+        // Unaligned or partial writes (tag or value only) drop the slots they overlap.
+        const int first = addr.offset / int(sizeof(Value));
+        const int last = (addr.offset + int(sizeof(Value)) - 1) / int(sizeof(Value));
+        for (int i = 0; i < CachedValueRegisterCount; ++i) {
+            if (cachedSlots[i] >= first && cachedSlots[i] <= last)
+                cachedSlots[i] = -1;
+        }
+    }
+
+    // Remembers that src holds the value of the frame slot at addr. Returns false if there is
+    // nothing to cache into.
+    bool cacheSlot(Address addr, RegisterID src)
+    {
+        const int slot = frameSlot(addr);
+        if (!cacheFrameSlots || slot < 0 || CachedValueRegisterCount == 0)
+            return false;
+        invalidateCachedSlot(addr);
+        int i = 0;
+        while (i < CachedValueRegisterCount && cachedSlots[i] != -1)
+            ++i;
+        if (i == CachedValueRegisterCount) {
+            i = nextCachedSlot;
+            if (++nextCachedSlot == CachedValueRegisterCount)
+                nextCachedSlot = 0;
+        }
+        cachedSlots[i] = slot;
+        move(src, cachedValueRegister(i));
+        return true;
     }
 
     Address loadFunctionPtr(RegisterID target)
@@ -657,12 +792,42 @@ struct PlatformAssembler64 : PlatformAssemblerCommon
             load64(loadConstAddress(constIndex, ScratchRegister), ScratchRegister);
         }
         store64(ScratchRegister, dest);
+        invalidateCachedSlot(dest);
     }
 
     void copyReg(Address src, Address dst)
     {
-        load64(src, ScratchRegister);
+        loadFrameValue(src, ScratchRegister);
         store64(ScratchRegister, dst);
+        invalidateCachedSlot(dst);
+    }
+
+    // Loads a value that may live in the JS stack frame, using a cached copy if there is one.
+    void loadFrameValue(Address addr, RegisterID dest)
+    {
+        RegisterID cached = cachedRegisterForSlot(addr);
+        if (cached != NoRegister)
+            move(cached, dest);
+        else
+            load64(addr, dest);
+    }
+
+    void loadFrameSlot(Address addr)
+    {
+        RegisterID cached = cachedRegisterForSlot(addr);
+        if (cached != NoRegister) {
+            move(cached, AccumulatorRegister);
+        } else {
+            load64(addr, AccumulatorRegister);
+            cacheSlot(addr, AccumulatorRegister);
+        }
+    }
+
+    void storeFrameSlot(Address addr)
+    {
+        store64(AccumulatorRegister, addr);
+        if (!cacheSlot(addr, AccumulatorRegister))
+            invalidateCachedSlot(addr);
     }
 
     void loadPointerFromValue(Address addr, RegisterID dest = AccumulatorRegister)
@@ -678,6 +843,7 @@ struct PlatformAssembler64 : PlatformAssemblerCommon
     void storeAccumulator(Address addr)
     {
         store64(AccumulatorRegister, addr);
+        invalidateCachedSlot(addr);
     }
 
     void loadString(int stringId)
@@ -693,6 +859,7 @@ struct PlatformAssembler64 : PlatformAssemblerCommon
     void storeHeapObject(RegisterID source, Address addr)
     {
         store64(source, addr);
+        invalidateCachedSlot(addr);
     }
 
     void generateCatchTrampoline()
@@ -733,7 +900,7 @@ struct PlatformAssembler64 : PlatformAssemblerCommon
 
     void toInt32LhsAcc(Address lhs, RegisterID lhsTarget)
     {
-        load64(lhs, lhsTarget);
+        loadFrameValue(lhs, lhsTarget);
         urshift64(lhsTarget, TrustedImm32(Value::QuickType_Shift), ScratchRegister2);
         auto lhsIsInt = branch32(Equal, TrustedImm32(Value::QT_Int), ScratchRegister2);
 
@@ -770,7 +937,7 @@ struct PlatformAssembler64 : PlatformAssemblerCommon
 
     void regToInt32(Address srcReg, RegisterID targetReg)
     {
-        load64(srcReg, targetReg);
+        loadFrameValue(srcReg, targetReg);
         urshift64(targetReg, TrustedImm32(Value::QuickType_Shift), ScratchRegister2);
         auto isInt = branch32(Equal, TrustedImm32(Value::QT_Int), ScratchRegister2);
 
@@ -849,11 +1016,14 @@ struct PlatformAssembler64 : PlatformAssemblerCommon
         addPtr(TrustedImm32(2 * PointerSize), StackPointerRegister);
     }
 
-    Jump binopBothIntPath(Address lhsAddr, std::function<Jump(void)> fastPath)
+    Jump binopBothIntPath(Address lhsAddr, std::function<Jump(void)> fastPath, bool accIsInt = false)
     {
-        urshift64(AccumulatorRegister, TrustedImm32(32), ScratchRegister);
-        Jump accNotInt = branch32(NotEqual, TrustedImm32(int(IntegerTag)), ScratchRegister);
-        load64(lhsAddr, ScratchRegister);
+        Jump accNotInt;
+        if (!accIsInt) {
+            urshift64(AccumulatorRegister, TrustedImm32(32), ScratchRegister);
+            accNotInt = branch32(NotEqual, TrustedImm32(int(IntegerTag)), ScratchRegister);
+        }
+        loadFrameValue(lhsAddr, ScratchRegister);
         urshift64(ScratchRegister, TrustedImm32(32), ScratchRegister2);
         Jump lhsNotInt = branch32(NotEqual, TrustedImm32(int(IntegerTag)), ScratchRegister2);
 
@@ -864,12 +1034,114 @@ struct PlatformAssembler64 : PlatformAssemblerCommon
         // all other cases
         if (failure.isSet())
             failure.link(this);
-        accNotInt.link(this);
+        if (accNotInt.isSet())
+            accNotInt.link(this);
         lhsNotInt.link(this);
 
         return done;
     }
 
+    // Loads an integer or double value into a floating point register, jumps to notNumber otherwise.
+    void unboxNumber(RegisterID src, FPRegisterID dest, JumpList &notNumber)
+    {
+        urshift64(src, TrustedImm32(32), ScratchRegister2);
+        Jump notInt = branch32(NotEqual, TrustedImm32(int(IntegerTag)), ScratchRegister2);
+        convertInt32ToDouble(src, dest);
+        Jump done = jump();
+
+        notInt.link(this);
+        urshift64(src, TrustedImm32(Value::IsDouble_Shift), ScratchRegister2);
+        notNumber.append(branch32(Equal, TrustedImm32(0), ScratchRegister2));
+        move(TrustedImm64(Value::NaNEncodeMask), ScratchRegister2);
+        xor64(ScratchRegister2, src);
+        move64ToDouble(src, dest);
+
+        done.link(this);
+    }
+
+    // Executes fastPath with lhs in FPScratchRegister and the accumulator in FPScratchRegister2 if
+    // both are numbers. fastPath leaves its result in FPScratchRegister.
+    JumpList binopBothNumberPath(Address lhsAddr, std::function<void(FPRegisterID, FPRegisterID)> fastPath)
+    {
+        JumpList notNumber;
+        loadFrameValue(lhsAddr, ScratchRegister);
+        unboxNumber(ScratchRegister, FPScratchRegister, notNumber);
+        move(AccumulatorRegister, ScratchRegister);
+        unboxNumber(ScratchRegister, FPScratchRegister2, notNumber);
+
+        // both numbers
+        fastPath(FPScratchRegister, FPScratchRegister2);
+        Jump isNaN = branchDouble(DoubleNotEqualOrUnordered, FPScratchRegister, FPScratchRegister);
+        encodeDoubleIntoAccumulator(FPScratchRegister);
+        Jump done = jump();
+
+        // all NaNs are boxed as the canonical one, see Value::setDouble()
+        isNaN.link(this);
+        loadValue(Encode(qt_qnan()));
+        Jump doneNaN = jump();
+
+        // all other cases
+        notNumber.link(this);
+
+        JumpList result;
+        result.append(done);
+        result.append(doneNaN);
+        return result;
+    }
+
+    // Sets the accumulator to the result of comparing lhs with the accumulator as doubles if both
+    // are numbers.
+    JumpList cmpBothNumberPath(Address lhsAddr, DoubleCondition cond)
+    {
+        JumpList notNumber;
+        load64(lhsAddr, ScratchRegister);
+        unboxNumber(ScratchRegister, FPScratchRegister, notNumber);
+        move(AccumulatorRegister, ScratchRegister);
+        unboxNumber(ScratchRegister, FPScratchRegister2, notNumber);
+
+        // both numbers, NaN compares false
+        JumpList result;
+        Jump isTrue = branchDouble(cond, FPScratchRegister, FPScratchRegister2);
+        loadValue(Encode(false));
+        result.append(jump());
+        isTrue.link(this);
+        loadValue(Encode(true));
+        result.append(jump());
+
+        // all other cases
+        notNumber.link(this);
+        return result;
+    }
+
+    JumpList isNotManaged()
+    {
+        JumpList notManaged;
+        notManaged.append(branch64(Equal, AccumulatorRegister, TrustedImm64(0)));
+        urshift64(AccumulatorRegister, TrustedImm32(Value::IsManagedOrUndefined_Shift), ScratchRegister);
+        notManaged.append(branch32(NotEqual, TrustedImm32(0), ScratchRegister));
+        return notManaged;
+    }
+
+    Jump internalClassIsNot(const InternalClass *ic)
+    {
+        return branchPtr(NotEqual, Address(AccumulatorRegister, 0), TrustedImmPtr(ic));
+    }
+
+    void loadOwnProperty(int offset, bool inlineProperty)
+    {
+        if (inlineProperty) {
+            load64(Address(AccumulatorRegister, offset * int(sizeof(Value))), AccumulatorRegister);
+        } else {
+            Heap::Object o;
+            Q_UNUSED(o)
+            Heap::MemberData md;
+            Q_UNUSED(md)
+            loadPtr(Address(AccumulatorRegister, o.memberData.offset), ScratchRegister);
+            load64(Address(ScratchRegister, md.values.offset + offsetof(ValueArray<0>, values)
+                           + offset * int(sizeof(Value))), AccumulatorRegister);
+        }
+    }
+
     Jump unopIntPath(std::function<Jump(void)> fastPath)
     {
         urshift64(AccumulatorRegister, TrustedImm32(Value::IsIntegerConvertible_Shift), ScratchRegister);
@@ -960,6 +1232,17 @@ struct PlatformAssembler32 : PlatformAssemblerCommon
         store32(AccumulatorRegisterTag, addr);
     }
 
+    void loadFrameSlot(Address addr)
+    {
+        // No registers to spare for caching stack slots on 32 bit.
+        loadAccumulator(addr);
+    }
+
+    void storeFrameSlot(Address addr)
+    {
+        storeAccumulator(addr);
+    }
+
     void loadString(int stringId)
     {
         load32(loadStringAddress(stringId), AccumulatorRegisterValue);
@@ -1225,9 +1508,11 @@ struct PlatformAssembler32 : PlatformAssemblerCommon
         popValue();
     }
 
-    Jump binopBothIntPath(Address lhsAddr, std::function<Jump(void)> fastPath)
+    Jump binopBothIntPath(Address lhsAddr, std::function<Jump(void)> fastPath, bool accIsInt = false)
     {
-        Jump accNotInt = branch32(NotEqual, TrustedImm32(int(IntegerTag)), AccumulatorRegisterTag);
+        Jump accNotInt;
+        if (!accIsInt)
+            accNotInt = branch32(NotEqual, TrustedImm32(int(IntegerTag)), AccumulatorRegisterTag);
         Address lhsAddrTag = lhsAddr; lhsAddrTag.offset += Value::tagOffset();
         load32(lhsAddrTag, ScratchRegister);
         Jump lhsNotInt = branch32(NotEqual, TrustedImm32(int(IntegerTag)), ScratchRegister);
@@ -1241,12 +1526,59 @@ struct PlatformAssembler32 : PlatformAssemblerCommon
         // all other cases
         if (failure.isSet())
             failure.link(this);
-        accNotInt.link(this);
+        if (accNotInt.isSet())
+            accNotInt.link(this);
         lhsNotInt.link(this);
 
         return done;
     }
 
+    JumpList binopBothNumberPath(Address lhsAddr, std::function<void(FPRegisterID, FPRegisterID)> fastPath)
+    {
+        // Not worth it with only one FP scratch register; the runtime call handles doubles.
+        Q_UNUSED(lhsAddr);
+        Q_UNUSED(fastPath);
+        return JumpList();
+    }
+
+    JumpList cmpBothNumberPath(Address lhsAddr, DoubleCondition cond)
+    {
+        Q_UNUSED(lhsAddr);
+        Q_UNUSED(cond);
+        return JumpList();
+    }
+
+    JumpList isNotManaged()
+    {
+        JumpList notManaged;
+        notManaged.append(branch32(NotEqual, TrustedImm32(Value::Managed_Type_Internal), AccumulatorRegisterTag));
+        notManaged.append(branch32(Equal, TrustedImm32(0), AccumulatorRegisterValue));
+        return notManaged;
+    }
+
+    Jump internalClassIsNot(const InternalClass *ic)
+    {
+        return branchPtr(NotEqual, Address(AccumulatorRegisterValue, 0), TrustedImmPtr(ic));
+    }
+
+    void loadOwnProperty(int offset, bool inlineProperty)
+    {
+        Address addr(AccumulatorRegisterValue, offset * int(sizeof(Value)));
+        if (!inlineProperty) {
+            Heap::Object o;
+            Q_UNUSED(o)
+            Heap::MemberData md;
+            Q_UNUSED(md)
+            loadPtr(Address(AccumulatorRegisterValue, o.memberData.offset), ScratchRegister);
+            addr = Address(ScratchRegister, md.values.offset + offsetof(ValueArray<0>, values)
+                           + offset * int(sizeof(Value)));
+        }
+        Address tagAddr = addr; tagAddr.offset += Value::tagOffset();
+        Address valueAddr = addr; valueAddr.offset += Value::valueOffset();
+        load32(tagAddr, AccumulatorRegisterTag);
+        load32(valueAddr, AccumulatorRegisterValue);
+    }
+
     Jump unopIntPath(std::function<Jump(void)> fastPath)
     {
         Jump accNotInt = branch32(NotEqual, TrustedImm32(int(IntegerTag)), AccumulatorRegisterTag);
@@ -1295,10 +1627,11 @@ static Address regAddr(int reg)
     return Address(PlatformAssembler::JSStackFrameRegister, reg * int(sizeof(QV4::Value)));
 }
 
-Assembler::Assembler(const Value *constantTable)
+Assembler::Assembler(const Value *constantTable, bool cacheFrameSlots)
     : d(new PlatformAssembler)
 {
     pasm()->constantTable = constantTable;
+    pasm()->cacheFrameSlots = cacheFrameSlots;
 }
 
 Assembler::~Assembler()
@@ -1306,9 +1639,28 @@ Assembler::~Assembler()
     delete pasm();
 }
 
-void Assembler::generatePrologue()
+void Assembler::generatePrologue(const std::vector<int> &loopHeaders)
 {
     pasm()->generateFunctionEntry();
+    if (loopHeaders.empty())
+        return;
+
+    // A function that is already running in the interpreter continues at the loop header in
+    // CppStackFrame::instructionPointer, with the accumulator saved in the frame. On regular
+    // entry the instruction pointer is 0 and the accumulator undefined.
+    pasm()->loadAccumulator(Address(PlatformAssembler::JSStackFrameRegister,
+                                    offsetof(CallData, accumulator)));
+    pasm()->load32(Address(PlatformAssembler::CppStackFrameRegister,
+                           offsetof(QV4::CppStackFrame, instructionPointer)),
+                   PlatformAssembler::ScratchRegister);
+    for (int offset : loopHeaders) {
+        if (offset == 0) // that's where the code starts anyway
+            continue;
+        pasm()->patches.push_back({ pasm()->branch32(PlatformAssembler::Equal,
+                                                     PlatformAssembler::ScratchRegister,
+                                                     TrustedImm32(offset)),
+                                    offset });
+    }
 }
 
 void Assembler::generateEpilogue()
@@ -1390,9 +1742,25 @@ void Assembler::link(Function *function)
     JSC::JSGlobalData dummy(function->internalClass->engine->executableAllocator);
     JSC::LinkBuffer<PlatformAssembler::MacroAssembler> linkBuffer(dummy, pasm(), nullptr);
 
+    const quintptr codeStart = reinterpret_cast<quintptr>(linkBuffer.debugAddress());
+    const auto relocation = [&](quint32 type, JSC::MacroAssemblerBase::DataLabelPtr label, qint64 value) {
+        CompiledData::JitCodeRelocation r;
+        r.type = type;
+        r.offset = quint32(reinterpret_cast<quintptr>(linkBuffer.locationOf(label).dataLocation()) - codeStart);
+        r.value = value;
+        pasm()->relocations.push_back(r);
+    };
+
     for (const auto &ehTarget : pasm()->ehTargets) {
         auto targetLabel = pasm()->labelsByOffset.value(ehTarget.offset);
-        linkBuffer.patch(ehTarget.label, linkBuffer.locationOf(targetLabel));
+        auto target = linkBuffer.locationOf(targetLabel);
+        linkBuffer.patch(ehTarget.label, target);
+        relocation(CompiledData::JitCodeRelocation::CodeAddress, ehTarget.label,
+                   qint64(reinterpret_cast<quintptr>(target.executableAddress()) - codeStart));
+    }
+    for (const auto &callTarget : pasm()->runtimeCallTargets) {
+        relocation(CompiledData::JitCodeRelocation::RuntimeFunction, callTarget.label,
+                   qint64(reinterpret_cast<quintptr>(callTarget.funcPtr) - runtimeAnchor()));
     }
 
     JSC::MacroAssemblerCodeRef codeRef;
@@ -1412,6 +1780,10 @@ void Assembler::link(Function *function)
         codeRef = linkBuffer.finalizeCodeWithoutDisassembly();
     }
 
+    if (function->codeRef) {
+        Q_ASSERT(!function->baselineCodeRef);
+        function->baselineCodeRef = function->codeRef;
+    }
     function->codeRef = new JSC::MacroAssemblerCodeRef(codeRef);
     function->jittedCode = reinterpret_cast<Function::JittedCode>(function->codeRef->code().executableAddress());
 
@@ -1444,8 +1816,82 @@ void Assembler::link(Function *function)
 #endif
 }
 
+QByteArray Assembler::relocatableCode(Function *function, int functionIndex,
+                                      const std::vector<const void *> &callTargets) const
+{
+    Q_ASSERT(function->codeRef);
+    for (const auto &callTarget : pasm()->runtimeCallTargets) {
+        // Only the addresses of the given functions are covered by the fingerprint of the cache.
+        if (std::find(callTargets.begin(), callTargets.end(), callTarget.funcPtr) == callTargets.end()) {
+            Q_ASSERT_X(false, "Assembler::relocatableCode", pasm()->functions.value(callTarget.funcPtr));
+            return QByteArray();
+        }
+    }
+
+    const quint32 codeSize = quint32(function->codeRef->size());
+    const int nRelocations = int(pasm()->relocations.size());
+
+    QByteArray record(CompiledData::JitCodeFunction::calculateSize(nRelocations, codeSize), 0);
+    CompiledData::JitCodeFunction *header = reinterpret_cast<CompiledData::JitCodeFunction *>(record.data());
+    header->functionIndex = functionIndex;
+    header->codeSize = codeSize;
+    header->nRelocations = nRelocations;
+    char *relocations = reinterpret_cast<char *>(header + 1);
+    memcpy(relocations, pasm()->relocations.data(), nRelocations * sizeof(CompiledData::JitCodeRelocation));
+    memcpy(relocations + nRelocations * sizeof(CompiledData::JitCodeRelocation),
+           function->codeRef->code().dataLocation(), codeSize);
+    return record;
+}
+
+bool Assembler::installRelocatableCode(Function *function, const CompiledData::JitCodeFunction *record)
+{
+    const quint32 codeSize = record->codeSize;
+    const CompiledData::JitCodeRelocation *relocations = record->relocationTable();
+    for (uint i = 0; i < record->nRelocations; ++i) {
+        const CompiledData::JitCodeRelocation &r = relocations[i];
+        const qint64 begin = qint64(r.offset) + PlatformAssembler::PatchedPointerBegin;
+        const qint64 end = qint64(r.offset) + PlatformAssembler::PatchedPointerEnd;
+        if (begin < 0 || end > qint64(codeSize))
+            return false;
+        if (r.type == CompiledData::JitCodeRelocation::CodeAddress) {
+            if (qint64(r.value) < 0 || qint64(r.value) >= qint64(codeSize))
+                return false;
+        } else if (r.type != CompiledData::JitCodeRelocation::RuntimeFunction) {
+            return false;
+        }
+    }
+
+    JSC::JSGlobalData dummy(function->internalClass->engine->executableAllocator);
+    RefPtr<JSC::ExecutableMemoryHandle> memory = dummy.executableAllocator.allocate(
+                dummy, codeSize, nullptr, JSC::JITCompilationMustSucceed);
+    char *code = static_cast<char *>(memory->start());
+
+    JSC::ExecutableAllocator::makeWritable(code, codeSize);
+    memcpy(code, record->code(), codeSize);
+    for (uint i = 0; i < record->nRelocations; ++i) {
+        const CompiledData::JitCodeRelocation &r = relocations[i];
+        void *value = r.type == CompiledData::JitCodeRelocation::RuntimeFunction
+                ? reinterpret_cast<void *>(runtimeAnchor() + quintptr(qint64(r.value)))
+                : code + qint64(r.value);
+        PlatformAssembler::AssemblerType_T::repatchPointer(code + r.offset, value);
+    }
+    JSC::ExecutableAllocator::makeExecutable(code, codeSize);
+    PlatformAssembler::cacheFlush(code, codeSize);
+
+    function->codeRef = new JSC::MacroAssemblerCodeRef(memory.release());
+    function->jittedCode = reinterpret_cast<Function::JittedCode>(function->codeRef->code().executableAddress());
+    return true;
+}
+
+quintptr Assembler::runtimeAnchor()
+{
+    return reinterpret_cast<quintptr>(&Runtime::method_closure);
+}
+
 void Assembler::addLabel(int offset)
 {
+    // Other jumps may arrive here with different values in the cache registers.
+    pasm()->invalidateCachedSlots();
     pasm()->labelsByOffset[offset] = pasm()->label();
 }
 
@@ -1466,12 +1912,12 @@ void Assembler::copyConst(int constIndex, int destReg)
 
 void Assembler::loadReg(int reg)
 {
-    pasm()->loadAccumulator(regAddr(reg));
+    pasm()->loadFrameSlot(regAddr(reg));
 }
 
 void Assembler::storeReg(int reg)
 {
-    pasm()->storeAccumulator(regAddr(reg));
+    pasm()->storeFrameSlot(regAddr(reg));
 }
 
 void Assembler::loadLocal(int index, int level)
@@ -1826,6 +2272,169 @@ void Assembler::sub(int lhs)
     done.link(pasm());
 }
 
+// Without type feedback both inline paths are generated. Otherwise only the ones for the operand
+// types the interpreter has seen; the runtime call still handles everything else.
+static bool wantsIntPath(quint8 feedback)
+{
+    return feedback == Function::NoTypeFeedback || (feedback & Function::SawInt);
+}
+
+static bool wantsDoublePath(quint8 feedback)
+{
+    return feedback == Function::NoTypeFeedback || (feedback & Function::SawDouble);
+}
+
+void Assembler::addNumber(int lhs, bool accIsInt, quint8 feedback)
+{
+    PlatformAssembler::Jump done;
+    if (accIsInt || wantsIntPath(feedback)) {
+        done = pasm()->binopBothIntPath(regAddr(lhs), [this](){
+            auto overflowed = pasm()->branchAdd32(PlatformAssembler::Overflow,
+                                                  PlatformAssembler::AccumulatorRegisterValue,
+                                                  PlatformAssembler::ScratchRegister);
+            pasm()->setAccumulatorTag(IntegerTag,
+                                      PlatformAssembler::ScratchRegister);
+            return overflowed;
+        }, accIsInt);
+    }
+    PlatformAssembler::JumpList doneDouble;
+    if (wantsDoublePath(feedback)) {
+        doneDouble = pasm()->binopBothNumberPath(regAddr(lhs), [this](FPRegisterID l, FPRegisterID r){
+            pasm()->addDouble(r, l);
+        });
+    }
+
+    // slow path:
+    saveAccumulatorInFrame();
+    prepareCallWithArgCount(3);
+    passAccumulatorAsArg(2);
+    passRegAsArg(lhs, 1);
+    passEngineAsArg(0);
+    IN_JIT_GENERATE_RUNTIME_CALL(Runtime::method_add, ResultInAccumulator);
+    checkException();
+
+    // done.
+    if (done.isSet())
+        done.link(pasm());
+    doneDouble.link(pasm());
+}
+
+void Assembler::subNumber(int lhs, bool accIsInt, quint8 feedback)
+{
+    PlatformAssembler::Jump done;
+    if (accIsInt || wantsIntPath(feedback)) {
+        done = pasm()->binopBothIntPath(regAddr(lhs), [this](){
+            auto overflowed = pasm()->branchSub32(PlatformAssembler::Overflow,
+                                                  PlatformAssembler::AccumulatorRegisterValue,
+                                                  PlatformAssembler::ScratchRegister);
+            pasm()->setAccumulatorTag(IntegerTag,
+                                      PlatformAssembler::ScratchRegister);
+            return overflowed;
+        }, accIsInt);
+    }
+    PlatformAssembler::JumpList doneDouble;
+    if (wantsDoublePath(feedback)) {
+        doneDouble = pasm()->binopBothNumberPath(regAddr(lhs), [this](FPRegisterID l, FPRegisterID r){
+            pasm()->subDouble(r, l);
+        });
+    }
+
+    // slow path:
+    saveAccumulatorInFrame();
+    prepareCallWithArgCount(2);
+    passAccumulatorAsArg(1);
+    passRegAsArg(lhs, 0);
+    IN_JIT_GENERATE_RUNTIME_CALL(Runtime::method_sub, ResultInAccumulator);
+    checkException();
+
+    // done.
+    if (done.isSet())
+        done.link(pasm());
+    doneDouble.link(pasm());
+}
+
+void Assembler::mulNumber(int lhs, bool accIsInt, quint8 feedback)
+{
+    PlatformAssembler::Jump done;
+    if (accIsInt || wantsIntPath(feedback)) {
+        done = pasm()->binopBothIntPath(regAddr(lhs), [this](){
+            auto overflowed = pasm()->branchMul32(PlatformAssembler::Overflow,
+                                                  PlatformAssembler::AccumulatorRegisterValue,
+                                                  PlatformAssembler::ScratchRegister);
+            pasm()->setAccumulatorTag(IntegerTag,
+                                      PlatformAssembler::ScratchRegister);
+            return overflowed;
+        }, accIsInt);
+    }
+    PlatformAssembler::JumpList doneDouble;
+    if (wantsDoublePath(feedback)) {
+        doneDouble = pasm()->binopBothNumberPath(regAddr(lhs), [this](FPRegisterID l, FPRegisterID r){
+            pasm()->mulDouble(r, l);
+        });
+    }
+
+    // slow path:
+    saveAccumulatorInFrame();
+    prepareCallWithArgCount(2);
+    passAccumulatorAsArg(1);
+    passRegAsArg(lhs, 0);
+    IN_JIT_GENERATE_RUNTIME_CALL(Runtime::method_mul, ResultInAccumulator);
+    checkException();
+
+    // done.
+    if (done.isSet())
+        done.link(pasm());
+    doneDouble.link(pasm());
+}
+
+void Assembler::divNumber(int lhs)
+{
+    auto doneDouble = pasm()->binopBothNumberPath(regAddr(lhs), [this](FPRegisterID l, FPRegisterID r){
+        pasm()->divDouble(r, l);
+    });
+
+    // slow path:
+    saveAccumulatorInFrame();
+    prepareCallWithArgCount(2);
+    passAccumulatorAsArg(1);
+    passRegAsArg(lhs, 0);
+    IN_JIT_GENERATE_RUNTIME_CALL(Runtime::method_div, ResultInAccumulator);
+    checkException();
+
+    // done.
+    doneDouble.link(pasm());
+}
+
+void Assembler::getLookupForInternalClasses(int index, const Lookup::PolymorphicCache::Entry *entries,
+                                            int nEntries, const char *helperName, const void *helper)
+{
+    auto miss = pasm()->isNotManaged();
+    PlatformAssembler::JumpList done;
+    for (int i = 0; i < nEntries; ++i) {
+        const Lookup::PolymorphicCache::Entry &e = entries[i];
+        Q_ASSERT(e.type == Lookup::PolymorphicCache::InlineProperty
+                 || e.type == Lookup::PolymorphicCache::MemberDataProperty);
+        auto next = pasm()->internalClassIsNot(e.ic);
+        pasm()->loadOwnProperty(e.offset, e.type == Lookup::PolymorphicCache::InlineProperty);
+        done.append(pasm()->jump());
+        next.link(pasm());
+    }
+
+    // slow path:
+    miss.link(pasm());
+    saveAccumulatorInFrame();
+    prepareCallWithArgCount(4);
+    passAccumulatorAsArg(3);
+    passInt32AsArg(index, 2);
+    passFunctionAsArg(1);
+    passEngineAsArg(0);
+    callRuntime(helperName, helper, ResultInAccumulator);
+    checkException();
+
+    // done.
+    done.link(pasm());
+}
+
 void Assembler::cmpeqNull()
 {
     pasm()->isNullOrUndefined();
@@ -1946,6 +2555,66 @@ void Assembler::cmple(int lhs)
         "Runtime::method_compareLessEqual", lhs);
 }
 
+void Assembler::cmpNumber(int cond, int doubleCond, CmpFunc function, const char *functionName,
+                          int lhs, quint8 feedback)
+{
+    auto c = static_cast<PlatformAssembler::RelationalCondition>(cond);
+    PlatformAssembler::Jump done;
+    if (wantsIntPath(feedback)) {
+        done = pasm()->binopBothIntPath(regAddr(lhs), [this, c](){
+            pasm()->compare32(c, PlatformAssembler::ScratchRegister,
+                              PlatformAssembler::AccumulatorRegisterValue,
+                              PlatformAssembler::AccumulatorRegisterValue);
+            pasm()->setAccumulatorTag(QV4::Value::ValueTypeInternal::Boolean);
+            return PlatformAssembler::Jump();
+        });
+    }
+    PlatformAssembler::JumpList doneDouble;
+    if (wantsDoublePath(feedback)) {
+        doneDouble = pasm()->cmpBothNumberPath(
+                    regAddr(lhs), static_cast<PlatformAssembler::DoubleCondition>(doubleCond));
+    }
+
+    // slow path:
+    saveAccumulatorInFrame();
+    prepareCallWithArgCount(2);
+    passAccumulatorAsArg(1);
+    passRegAsArg(lhs, 0);
+
+    callRuntime(functionName, reinterpret_cast<void*>(function), ResultInAccumulator);
+    checkException();
+    pasm()->setAccumulatorTag(QV4::Value::ValueTypeInternal::Boolean);
+
+    // done.
+    if (done.isSet())
+        done.link(pasm());
+    doneDouble.link(pasm());
+}
+
+void Assembler::cmpgtNumber(int lhs, quint8 feedback)
+{
+    cmpNumber(PlatformAssembler::GreaterThan, PlatformAssembler::DoubleGreaterThan,
+              &Runtime::method_compareGreaterThan, "Runtime::method_compareGreaterThan", lhs, feedback);
+}
+
+void Assembler::cmpgeNumber(int lhs, quint8 feedback)
+{
+    cmpNumber(PlatformAssembler::GreaterThanOrEqual, PlatformAssembler::DoubleGreaterThanOrEqual,
+              &Runtime::method_compareGreaterEqual, "Runtime::method_compareGreaterEqual", lhs, feedback);
+}
+
+void Assembler::cmpltNumber(int lhs, quint8 feedback)
+{
+    cmpNumber(PlatformAssembler::LessThan, PlatformAssembler::DoubleLessThan,
+              &Runtime::method_compareLessThan, "Runtime::method_compareLessThan", lhs, feedback);
+}
+
+void Assembler::cmpleNumber(int lhs, quint8 feedback)
+{
+    cmpNumber(PlatformAssembler::LessThanOrEqual, PlatformAssembler::DoubleLessThanOrEqual,
+              &Runtime::method_compareLessEqual, "Runtime::method_compareLessEqual", lhs, feedback);
+}
+
 void Assembler::cmpStrictEqual(int lhs)
 {
     cmp(PlatformAssembler::Equal, &RuntimeHelpers::strictEqual,
@@ -2222,6 +2891,19 @@ void Assembler::ret()
     pasm()->generateFunctionExit();
 }
 
+void Assembler::addHelperCallTargets(std::vector<const void *> *targets)
+{
+    const void *helpers[] = {
+        reinterpret_cast<const void *>(&toNumberHelper),
+        reinterpret_cast<const void *>(&toInt32Helper),
+        reinterpret_cast<const void *>(&incHelper),
+        reinterpret_cast<const void *>(&decHelper),
+        reinterpret_cast<const void *>(&Value::toBooleanImpl),
+        reinterpret_cast<const void *>(&RuntimeHelpers::strictEqual),
+    };
+    targets->insert(targets->end(), std::begin(helpers), std::end(helpers));
+}
+
 } // JIT namespace
 } // QV4 namepsace
 
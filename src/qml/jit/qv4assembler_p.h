@@ -53,8 +53,11 @@
 
 #include <private/qv4global_p.h>
 #include <private/qv4function_p.h>
+#include <private/qv4lookup_p.h>
 #include <QHash>
 
+#include <vector>
+
 QT_BEGIN_NAMESPACE
 
 namespace QV4 {
@@ -70,6 +73,10 @@ namespace JIT {
 #define JIT_GENERATE_RUNTIME_CALL(function, destination) \
     as->IN_JIT_GENERATE_RUNTIME_CALL(function, destination)
 
+// Baseline code from the disk cache is only installed by a build with the same version. When
+// making changes to the generated code or to the functions it calls, bump this.
+#define QV4_JIT_CODE_VERSION 0x1
+
 class Assembler {
 public:
     enum CallResultDestination {
@@ -77,15 +84,22 @@ public:
         ResultInAccumulator,
     };
 
-    Assembler(const Value* constantTable);
+    Assembler(const Value* constantTable, bool cacheFrameSlots = false);
     ~Assembler();
 
     // codegen infrastructure
-    void generatePrologue();
+    void generatePrologue(const std::vector<int> &loopHeaders);
     void generateEpilogue();
     void link(Function *function);
     void addLabel(int offset);
 
+    // disk cache support
+    QByteArray relocatableCode(Function *function, int functionIndex,
+                               const std::vector<const void *> &callTargets) const;
+    static bool installRelocatableCode(Function *function, const CompiledData::JitCodeFunction *record);
+    static quintptr runtimeAnchor();
+    static void addHelperCallTargets(std::vector<const void *> *targets);
+
     // loads/stores/moves
     void loadConst(int constIndex);
     void copyConst(int constIndex, int destReg);
@@ -122,6 +136,21 @@ public:
     void mod(int lhs);
     void sub(int lhs);
 
+    // numeric ops with inline double paths, used by the optimizing tier. feedback holds the
+    // Function::TypeFeedback flags recorded for the instruction.
+    void addNumber(int lhs, bool accIsInt, quint8 feedback = Function::NoTypeFeedback);
+    void subNumber(int lhs, bool accIsInt, quint8 feedback = Function::NoTypeFeedback);
+    void mulNumber(int lhs, bool accIsInt, quint8 feedback = Function::NoTypeFeedback);
+    void divNumber(int lhs);
+    void cmpgtNumber(int lhs, quint8 feedback);
+    void cmpgeNumber(int lhs, quint8 feedback);
+    void cmpltNumber(int lhs, quint8 feedback);
+    void cmpleNumber(int lhs, quint8 feedback);
+
+    // inline caches
+    void getLookupForInternalClasses(int index, const Lookup::PolymorphicCache::Entry *entries,
+                                     int nEntries, const char *helperName, const void *helper);
+
     // comparissons
     void cmpeqNull();
     void cmpneNull();
@@ -180,6 +209,8 @@ protected:
 private:
     typedef unsigned(*CmpFunc)(const Value&,const Value&);
     void cmp(int cond, CmpFunc function, const char *functionName, int lhs);
+    void cmpNumber(int cond, int doubleCond, CmpFunc function, const char *functionName, int lhs,
+                   quint8 feedback);
     void passAccumulatorAsArg_internal(int arg, bool push);
 };
 
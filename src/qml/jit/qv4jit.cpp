@@ -40,6 +40,12 @@
 #include "qv4jit_p.h"
 #include "qv4assembler_p.h"
 #include <private/qv4lookup_p.h>
+#include <private/qv4mm_p.h>
+#include <private/qv4runtime_p.h>
+#include <private/qsimd_p.h>
+
+#include <QCryptographicHash>
+#include <QSysInfo>
 
 #ifdef V4_ENABLE_JIT
 
@@ -48,6 +54,8 @@ using namespace QV4;
 using namespace QV4::JIT;
 using namespace QV4::Moth;
 
+static const std::vector<const void *> &diskCacheCallTargets();
+
 ByteCodeHandler::~ByteCodeHandler()
 {
 }
@@ -86,7 +94,9 @@ void ByteCodeHandler::decode(const char *code, uint len)
 
 BaselineJIT::BaselineJIT(Function *function)
     : function(function)
-    , as(new Assembler(function->compilationUnit->constants))
+    , as(new Assembler(function->compilationUnit->constants,
+                       function->internalClass->engine->jitCachesStackSlots()))
+    , needsWriteBarrier(engineNeedsWriteBarrier(function->internalClass->engine))
 {}
 
 BaselineJIT::~BaselineJIT()
@@ -97,14 +107,59 @@ void BaselineJIT::generate()
 //    qDebug()<<"jitting" << function->name()->toQString();
     collectLabelsInBytecode();
 
-    as->generatePrologue();
+    as->generatePrologue(loopHeaders);
     decode(reinterpret_cast<const char *>(function->codeData), function->compiledFunction->codeSize);
     as->generateEpilogue();
 
+    // Only the code of the first tier goes to the disk cache, optimized code embeds pointers
+    // to heap objects.
+    const bool isFirstTier = !function->codeRef;
     as->link(function);
+
+    ExecutionEngine *engine = function->internalClass->engine;
+    CompiledData::CompilationUnit *unit = function->compilationUnit;
+    if (isFirstTier && !unit->diskCacheFilePath.isEmpty() && engine->jitUsesDiskCache()) {
+        const int functionIndex = unit->runtimeFunctions.indexOf(function);
+        const QByteArray code = as->relocatableCode(function, functionIndex, diskCacheCallTargets());
+        if (!code.isEmpty())
+            unit->addJitCodeForDiskCache(functionIndex, code, diskCacheFingerprint(engine));
+    }
 //    qDebug()<<"done";
 }
 
+bool BaselineJIT::engineNeedsWriteBarrier(ExecutionEngine *engine)
+{
+    return engine->memoryManager->incrementalGC || engine->memoryManager->generationalGC;
+}
+
+quint64 BaselineJIT::diskCacheFingerprint(ExecutionEngine *engine)
+{
+    static const quint64 buildFingerprint = []() {
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        const quint32 codeVersion = QV4_JIT_CODE_VERSION;
+        hash.addData(reinterpret_cast<const char *>(&codeVersion), sizeof(codeVersion));
+        hash.addData(QSysInfo::buildAbi().toLatin1());
+        const quint64 cpuFeatures = qCpuFeatures();
+        hash.addData(reinterpret_cast<const char *>(&cpuFeatures), sizeof(cpuFeatures));
+        // Calls are stored relative to Assembler::runtimeAnchor(), which only holds for the very
+        // same build of the library.
+        for (const void *target : diskCacheCallTargets()) {
+            const qint64 offset = qint64(reinterpret_cast<quintptr>(target) - Assembler::runtimeAnchor());
+            hash.addData(reinterpret_cast<const char *>(&offset), sizeof(offset));
+        }
+        quint64 result;
+        memcpy(&result, hash.result().constData(), sizeof(result));
+        return result;
+    }();
+
+    quint64 settings = 0;
+    if (engineNeedsWriteBarrier(engine))
+        settings |= 0x1;
+    if (engine->jitCachesStackSlots())
+        settings |= 0x2;
+    return (buildFingerprint & ~quint64(0x3)) | settings;
+}
+
 #define STORE_IP() as->storeInstructionPointer(instructionOffset())
 #define STORE_ACC() as->saveAccumulatorInFrame()
 
@@ -177,10 +232,41 @@ void BaselineJIT::generate_LoadLocal(int index)
     as->loadLocal(index);
 }
 
+static ReturnedValue storeLocalWithBarrierHelper(ExecutionEngine *engine, const Value &context,
+                                                  int index, int level, const Value &value)
+{
+    Heap::ExecutionContext *scope = static_cast<const ExecutionContext &>(context).d();
+    while (level > 0) {
+        --level;
+        scope = scope->outer;
+    }
+    Heap::CallContext *cc = static_cast<Heap::CallContext *>(scope);
+    WriteBarrier::write(engine, cc, cc->locals.values[index].data_ptr(), value.asReturnedValue());
+    return value.asReturnedValue();
+}
+
+void BaselineJIT::storeLocalWithBarrier(int index, int level)
+{
+    // the inline store bypasses the write barrier needed by incremental and generational
+    // collection, so go through a helper instead. It hands the value back to keep it in
+    // the accumulator.
+    STORE_ACC();
+    as->prepareCallWithArgCount(5);
+    as->passAccumulatorAsArg(4);
+    as->passInt32AsArg(level, 3);
+    as->passInt32AsArg(index, 2);
+    as->passRegAsArg(CallData::Context, 1);
+    as->passEngineAsArg(0);
+    JIT_GENERATE_RUNTIME_CALL(storeLocalWithBarrierHelper, Assembler::ResultInAccumulator);
+}
+
 void BaselineJIT::generate_StoreLocal(int index)
 {
     as->checkException();
-    as->storeLocal(index);
+    if (needsWriteBarrier)
+        storeLocalWithBarrier(index, 0);
+    else
+        as->storeLocal(index);
 }
 
 void BaselineJIT::generate_LoadScopedLocal(int scope, int index)
@@ -191,7 +277,10 @@ void BaselineJIT::generate_LoadScopedLocal(int scope, int index)
 void BaselineJIT::generate_StoreScopedLocal(int scope, int index)
 {
     as->checkException();
-    as->storeLocal(index, scope);
+    if (needsWriteBarrier)
+        storeLocalWithBarrier(index, scope);
+    else
+        as->storeLocal(index, scope);
 }
 
 void BaselineJIT::generate_LoadRuntimeString(int stringId)
@@ -852,6 +941,16 @@ void BaselineJIT::generate_CmpInstanceOf(int lhs)
     as->checkException();
 }
 
+void BaselineJIT::generate_TestClosure(int value)
+{
+    STORE_ACC();
+    as->prepareCallWithArgCount(3);
+    as->passInt32AsArg(value, 2);
+    as->passAccumulatorAsArg(1);
+    as->passEngineAsArg(0);
+    JIT_GENERATE_RUNTIME_CALL(Runtime::method_isClosureOf, Assembler::ResultInAccumulator);
+}
+
 void BaselineJIT::generate_JumpStrictEqualStackSlotInt(int lhs, int rhs, int offset)
 {
     as->jumpStrictEqualStackSlotInt(lhs, rhs, instructionOffset() + offset);
@@ -917,6 +1016,86 @@ void BaselineJIT::generate_LoadQmlImportedScripts(int result)
     as->storeReg(result);
 }
 
+// The superinstructions only save dispatches in the interpreter, so generate the same code as
+// for their parts.
+void BaselineJIT::generate_CmpEqJumpFalse(int lhs, int offset)
+{
+    generate_CmpEq(lhs);
+    generate_JumpFalse(offset);
+}
+
+void BaselineJIT::generate_CmpNeJumpFalse(int lhs, int offset)
+{
+    generate_CmpNe(lhs);
+    generate_JumpFalse(offset);
+}
+
+void BaselineJIT::generate_CmpGtJumpFalse(int lhs, int offset)
+{
+    generate_CmpGt(lhs);
+    generate_JumpFalse(offset);
+}
+
+void BaselineJIT::generate_CmpGeJumpFalse(int lhs, int offset)
+{
+    generate_CmpGe(lhs);
+    generate_JumpFalse(offset);
+}
+
+void BaselineJIT::generate_CmpLtJumpFalse(int lhs, int offset)
+{
+    generate_CmpLt(lhs);
+    generate_JumpFalse(offset);
+}
+
+void BaselineJIT::generate_CmpLeJumpFalse(int lhs, int offset)
+{
+    generate_CmpLe(lhs);
+    generate_JumpFalse(offset);
+}
+
+void BaselineJIT::generate_CmpStrictEqualJumpFalse(int lhs, int offset)
+{
+    generate_CmpStrictEqual(lhs);
+    generate_JumpFalse(offset);
+}
+
+void BaselineJIT::generate_CmpStrictNotEqualJumpFalse(int lhs, int offset)
+{
+    generate_CmpStrictNotEqual(lhs);
+    generate_JumpFalse(offset);
+}
+
+void BaselineJIT::generate_LoadRegAdd(int reg, int lhs)
+{
+    generate_LoadReg(reg);
+    generate_Add(lhs);
+}
+
+void BaselineJIT::generate_LoadRegSub(int reg, int lhs)
+{
+    generate_LoadReg(reg);
+    generate_Sub(lhs);
+}
+
+void BaselineJIT::generate_LoadRegMul(int reg, int lhs)
+{
+    generate_LoadReg(reg);
+    generate_Mul(lhs);
+}
+
+void BaselineJIT::generate_IncrementStoreReg(int reg)
+{
+    generate_Increment();
+    generate_StoreReg(reg);
+}
+
+void BaselineJIT::generate_GetLookupStoreReg(int index, int base, int reg)
+{
+    generate_GetLookup(index, base);
+    generate_StoreReg(reg);
+}
+
 void BaselineJIT::startInstruction(Instr::Type /*instr*/)
 {
     if (hasLabel())
@@ -968,6 +1147,11 @@ void BaselineJIT::collectLabelsInBytecode()
         Q_ASSERT(offset >= 0 && offset < static_cast<int>(function->compiledFunction->codeSize));
         labels.push_back(offset);
     };
+    // The targets of backward jumps, the interpreter enters JIT code at these. See VME::exec().
+    const auto addLoopHeader = [&](int offset) {
+        if (std::find(loopHeaders.cbegin(), loopHeaders.cend(), offset) == loopHeaders.cend())
+            loopHeaders.push_back(offset);
+    };
 
     const char *code = reinterpret_cast<const char *>(function->codeData);
     const char *start = code;
@@ -1180,14 +1364,20 @@ void BaselineJIT::collectLabelsInBytecode()
 
         MOTH_BEGIN_INSTR(Jump)
             addLabel(code - start + offset);
+            if (offset < 0)
+                addLoopHeader(code - start + offset);
         MOTH_END_INSTR(Jump)
 
         MOTH_BEGIN_INSTR(JumpTrue)
             addLabel(code - start + offset);
+            if (offset < 0)
+                addLoopHeader(code - start + offset);
         MOTH_END_INSTR(JumpTrue)
 
         MOTH_BEGIN_INSTR(JumpFalse)
             addLabel(code - start + offset);
+            if (offset < 0)
+                addLoopHeader(code - start + offset);
         MOTH_END_INSTR(JumpFalse)
 
         MOTH_BEGIN_INSTR(CmpEqNull)
@@ -1232,6 +1422,9 @@ void BaselineJIT::collectLabelsInBytecode()
         MOTH_BEGIN_INSTR(CmpInstanceOf)
         MOTH_END_INSTR(CmpInstanceOf)
 
+        MOTH_BEGIN_INSTR(TestClosure)
+        MOTH_END_INSTR(TestClosure)
+
         MOTH_BEGIN_INSTR(JumpStrictEqualStackSlotInt)
             addLabel(code - start + offset);
         MOTH_END_INSTR(JumpStrictEqualStackSlotInt)
@@ -1320,9 +1513,225 @@ void BaselineJIT::collectLabelsInBytecode()
 
         MOTH_BEGIN_INSTR(LoadQmlImportedScripts)
         MOTH_END_INSTR(LoadQmlImportedScripts)
+
+        MOTH_BEGIN_INSTR(CmpEqJumpFalse)
+            addLabel(code - start + offset);
+        MOTH_END_INSTR(CmpEqJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpNeJumpFalse)
+            addLabel(code - start + offset);
+        MOTH_END_INSTR(CmpNeJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpGtJumpFalse)
+            addLabel(code - start + offset);
+        MOTH_END_INSTR(CmpGtJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpGeJumpFalse)
+            addLabel(code - start + offset);
+        MOTH_END_INSTR(CmpGeJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpLtJumpFalse)
+            addLabel(code - start + offset);
+        MOTH_END_INSTR(CmpLtJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpLeJumpFalse)
+            addLabel(code - start + offset);
+        MOTH_END_INSTR(CmpLeJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpStrictEqualJumpFalse)
+            addLabel(code - start + offset);
+        MOTH_END_INSTR(CmpStrictEqualJumpFalse)
+
+        MOTH_BEGIN_INSTR(CmpStrictNotEqualJumpFalse)
+            addLabel(code - start + offset);
+        MOTH_END_INSTR(CmpStrictNotEqualJumpFalse)
+
+        MOTH_BEGIN_INSTR(LoadRegAdd)
+        MOTH_END_INSTR(LoadRegAdd)
+
+        MOTH_BEGIN_INSTR(LoadRegSub)
+        MOTH_END_INSTR(LoadRegSub)
+
+        MOTH_BEGIN_INSTR(LoadRegMul)
+        MOTH_END_INSTR(LoadRegMul)
+
+        MOTH_BEGIN_INSTR(IncrementStoreReg)
+        MOTH_END_INSTR(IncrementStoreReg)
+
+        MOTH_BEGIN_INSTR(GetLookupStoreReg)
+        MOTH_END_INSTR(GetLookupStoreReg)
     }
 }
 #undef MOTH_BEGIN_INSTR
 #undef MOTH_END_INSTR
 
+OptimizingJIT::OptimizingJIT(Function *function)
+    : BaselineJIT(function)
+{}
+
+OptimizingJIT::~OptimizingJIT()
+{}
+
+void OptimizingJIT::generate_LoadZero()
+{
+    BaselineJIT::generate_LoadZero();
+    accIsIntAfterInstruction = true;
+}
+
+void OptimizingJIT::generate_LoadInt(int value)
+{
+    BaselineJIT::generate_LoadInt(value);
+    accIsIntAfterInstruction = true;
+}
+
+void OptimizingJIT::generate_LoadReg(int reg)
+{
+    // also reached from the superinstructions, in the middle of an instruction
+    accIsInt = false;
+    BaselineJIT::generate_LoadReg(reg);
+}
+
+// Collects the internal classes a getter lookup has specialized on, if all of them resolve to
+// own data properties, and returns their number.
+static int collectOwnPropertyEntries(const QV4::Lookup *l, QV4::Lookup::PolymorphicCache::Entry *entries)
+{
+    using Cache = QV4::Lookup::PolymorphicCache;
+    const auto entry = [](InternalClass *ic, int offset, Cache::EntryType type) {
+        Cache::Entry e;
+        memset(&e, 0, sizeof(e));
+        e.ic = ic;
+        e.offset = offset;
+        e.type = type;
+        return e;
+    };
+
+    if (l->getter == QV4::Lookup::getter0Inline) {
+        entries[0] = entry(l->objectLookup.ic, l->objectLookup.offset, Cache::InlineProperty);
+        return 1;
+    }
+    if (l->getter == QV4::Lookup::getter0MemberData) {
+        entries[0] = entry(l->objectLookup.ic, l->objectLookup.offset, Cache::MemberDataProperty);
+        return 1;
+    }
+    if (l->getter == QV4::Lookup::getter0Inlinegetter0Inline
+            || l->getter == QV4::Lookup::getter0Inlinegetter0MemberData
+            || l->getter == QV4::Lookup::getter0MemberDatagetter0MemberData) {
+        entries[0] = entry(l->objectLookupTwoClasses.ic, l->objectLookupTwoClasses.offset,
+                           l->getter == QV4::Lookup::getter0MemberDatagetter0MemberData
+                           ? Cache::MemberDataProperty : Cache::InlineProperty);
+        entries[1] = entry(l->objectLookupTwoClasses.ic2, l->objectLookupTwoClasses.offset2,
+                           l->getter == QV4::Lookup::getter0Inlinegetter0Inline
+                           ? Cache::InlineProperty : Cache::MemberDataProperty);
+        return 2;
+    }
+    if (l->getter == QV4::Lookup::getterPolymorphic) {
+        // not worth inlining a cache that keeps missing
+        const Cache *cache = l->polymorphicLookup.cache;
+        if (cache->misses > cache->hits)
+            return 0;
+        for (uint i = 0; i < cache->nEntries; ++i) {
+            if (cache->entries[i].type != Cache::InlineProperty
+                    && cache->entries[i].type != Cache::MemberDataProperty) {
+                return 0;
+            }
+            entries[i] = cache->entries[i];
+        }
+        return int(cache->nEntries);
+    }
+    return 0;
+}
+
+bool OptimizingJIT::generateInlineCachedLookup(int index, int base)
+{
+    // Internal classes live as long as the engine, and a class always maps a property to the
+    // same slot, so the checks stay valid even if the lookup itself changes state later.
+    const QV4::Lookup *l = function->compilationUnit->runtimeLookups + index;
+    QV4::Lookup::PolymorphicCache::Entry entries[QV4::Lookup::PolymorphicCache::Size];
+    const int nEntries = collectOwnPropertyEntries(l, entries);
+    if (!nEntries)
+        return false;
+
+    STORE_IP();
+    // the result replaces the accumulator anyway
+    if (base != -1)
+        as->loadReg(base);
+    as->getLookupForInternalClasses(index, entries, nEntries, "getLookupHelper",
+                                    reinterpret_cast<const void *>(&getLookupHelper));
+    return true;
+}
+
+void OptimizingJIT::generate_GetLookup(int index, int base)
+{
+    if (!generateInlineCachedLookup(index, base))
+        BaselineJIT::generate_GetLookup(index, base);
+}
+
+void OptimizingJIT::generate_GetLookupA(int index)
+{
+    if (!generateInlineCachedLookup(index, -1))
+        BaselineJIT::generate_GetLookupA(index);
+}
+
+// Also used for the fused LoadReg* and Cmp*JumpFalse instructions, which the interpreter records
+// under their own offset.
+quint8 OptimizingJIT::typeFeedback() const
+{
+    if (!function->typeFeedback)
+        return Function::NoTypeFeedback;
+    return function->typeFeedback[instructionOffset() - 1];
+}
+
+void OptimizingJIT::generate_Add(int lhs) { as->addNumber(lhs, accIsInt, typeFeedback()); }
+void OptimizingJIT::generate_Mul(int lhs) { as->mulNumber(lhs, accIsInt, typeFeedback()); }
+void OptimizingJIT::generate_Div(int lhs) { as->divNumber(lhs); }
+void OptimizingJIT::generate_Sub(int lhs) { as->subNumber(lhs, accIsInt, typeFeedback()); }
+void OptimizingJIT::generate_CmpGt(int lhs) { as->cmpgtNumber(lhs, typeFeedback()); }
+void OptimizingJIT::generate_CmpGe(int lhs) { as->cmpgeNumber(lhs, typeFeedback()); }
+void OptimizingJIT::generate_CmpLt(int lhs) { as->cmpltNumber(lhs, typeFeedback()); }
+void OptimizingJIT::generate_CmpLe(int lhs) { as->cmpleNumber(lhs, typeFeedback()); }
+
+void OptimizingJIT::startInstruction(Instr::Type instr)
+{
+    accIsInt = accIsIntAfterInstruction && !hasLabel();
+    accIsIntAfterInstruction = false;
+    BaselineJIT::startInstruction(instr);
+}
+
+void OptimizingJIT::endInstruction(Instr::Type instr)
+{
+    // storing the accumulator leaves it alone
+    if (instr == Instr::Type::StoreReg)
+        accIsIntAfterInstruction = accIsInt;
+    BaselineJIT::endInstruction(instr);
+}
+
+// All functions that baseline code calls. Code calling anything else is not written to the disk
+// cache, as it would not be covered by BaselineJIT::diskCacheFingerprint().
+static const std::vector<const void *> &diskCacheCallTargets()
+{
+    static const std::vector<const void *> targets = []() {
+        const Runtime runtime;
+        std::vector<const void *> targets(std::begin(runtime.runtimeMethods),
+                                          std::end(runtime.runtimeMethods));
+        const void *helpers[] = {
+            reinterpret_cast<const void *>(&storeLocalWithBarrierHelper),
+            reinterpret_cast<const void *>(&loadGlobalLookupHelper),
+            reinterpret_cast<const void *>(&storeElementHelper),
+            reinterpret_cast<const void *>(&getLookupHelper),
+            reinterpret_cast<const void *>(&storePropertyHelper),
+            reinterpret_cast<const void *>(&setLookupHelper),
+            reinterpret_cast<const void *>(&ExecutionContext::newCallContext),
+            reinterpret_cast<const void *>(&pushWithContextHelper),
+            reinterpret_cast<const void *>(&deleteMemberHelper),
+            reinterpret_cast<const void *>(&deleteSubscriptHelper),
+            reinterpret_cast<const void *>(&deleteNameHelper),
+            reinterpret_cast<const void *>(&convertThisToObjectHelper),
+        };
+        targets.insert(targets.end(), std::begin(helpers), std::end(helpers));
+        Assembler::addHelperCallTargets(&targets);
+        return targets;
+    }();
+    return targets;
+}
+
 #endif // V4_ENABLE_JIT
@@ -111,7 +111,7 @@ private:
 };
 
 #ifdef V4_ENABLE_JIT
-class BaselineJIT final: public ByteCodeHandler
+class BaselineJIT: public ByteCodeHandler
 {
 public:
     BaselineJIT(QV4::Function *);
@@ -119,6 +119,10 @@ public:
 
     void generate();
 
+    // Identifies everything besides the bytecode that the generated code depends on, so that
+    // code from the disk cache is only installed where it would have been generated the same way.
+    static quint64 diskCacheFingerprint(ExecutionEngine *engine);
+
     void generate_Ret() override;
     void generate_Debug() override;
     void generate_LoadConst(int index) override;
@@ -211,6 +215,7 @@ public:
     void generate_CmpStrictNotEqual(int lhs) override;
     void generate_CmpIn(int lhs) override;
     void generate_CmpInstanceOf(int lhs) override;
+    void generate_TestClosure(int value) override;
     void generate_JumpStrictEqualStackSlotInt(int lhs, int rhs,
                                               int offset) override;
     void generate_JumpStrictNotEqualStackSlotInt(int lhs, int rhs,
@@ -240,6 +245,19 @@ public:
     void generate_Sub(int lhs) override;
     void generate_LoadQmlContext(int result) override;
     void generate_LoadQmlImportedScripts(int result) override;
+    void generate_CmpEqJumpFalse(int lhs, int offset) override;
+    void generate_CmpNeJumpFalse(int lhs, int offset) override;
+    void generate_CmpGtJumpFalse(int lhs, int offset) override;
+    void generate_CmpGeJumpFalse(int lhs, int offset) override;
+    void generate_CmpLtJumpFalse(int lhs, int offset) override;
+    void generate_CmpLeJumpFalse(int lhs, int offset) override;
+    void generate_CmpStrictEqualJumpFalse(int lhs, int offset) override;
+    void generate_CmpStrictNotEqualJumpFalse(int lhs, int offset) override;
+    void generate_LoadRegAdd(int reg, int lhs) override;
+    void generate_LoadRegSub(int reg, int lhs) override;
+    void generate_LoadRegMul(int reg, int lhs) override;
+    void generate_IncrementStoreReg(int reg) override;
+    void generate_GetLookupStoreReg(int index, int base, int reg) override;
 
     void startInstruction(Moth::Instr::Type instr) override;
     void endInstruction(Moth::Instr::Type instr) override;
@@ -250,11 +268,54 @@ protected:
 
 private:
     void collectLabelsInBytecode();
+    void storeLocalWithBarrier(int index, int level);
+    static bool engineNeedsWriteBarrier(ExecutionEngine *engine);
 
-private:
+protected:
     QV4::Function *function;
     QScopedPointer<Assembler> as;
+
+private:
     std::vector<int> labels;
+    std::vector<int> loopHeaders;
+    bool needsWriteBarrier;
+};
+
+// Second tier for functions that keep getting called after being baseline compiled. It uses the
+// state of the lookups at the time of compilation to inline own property reads, and
+// emits inline double arithmetic next to the integer fast paths of the baseline tier. Where the
+// interpreter recorded type feedback, only the paths for the operand types seen are emitted.
+class OptimizingJIT final: public BaselineJIT
+{
+public:
+    OptimizingJIT(QV4::Function *);
+    ~OptimizingJIT() override;
+
+    void generate_LoadZero() override;
+    void generate_LoadInt(int value) override;
+    void generate_LoadReg(int reg) override;
+    void generate_GetLookup(int index, int base) override;
+    void generate_GetLookupA(int index) override;
+    void generate_Add(int lhs) override;
+    void generate_Mul(int lhs) override;
+    void generate_Div(int lhs) override;
+    void generate_Sub(int lhs) override;
+    void generate_CmpGt(int lhs) override;
+    void generate_CmpGe(int lhs) override;
+    void generate_CmpLt(int lhs) override;
+    void generate_CmpLe(int lhs) override;
+
+    void startInstruction(Moth::Instr::Type instr) override;
+    void endInstruction(Moth::Instr::Type instr) override;
+
+private:
+    bool generateInlineCachedLookup(int index, int base);
+    quint8 typeFeedback() const;
+
+    // Whether the accumulator is known to hold an integer, so that arithmetic can skip its tag
+    // check. Only tracked within a basic block.
+    bool accIsInt = false;
+    bool accIsIntAfterInstruction = false;
 };
 #endif // V4_ENABLE_JIT
 
@@ -358,6 +358,152 @@ void QJSEngine::collectGarbage()
     m_v4Engine->memoryManager->runGC();
 }
 
+/*!
+    \since 5.12
+
+    Tells the garbage collector that the application expects to be idle for the
+    next \a msecs milliseconds, for example because a frame has been rendered well
+    ahead of the next one.
+
+    If a collection would have to run soon anyway, given the amount of memory allocated
+    since the last one and the current allocation rate, it is run now, provided that it
+    is expected to fit into the given time. This moves pauses out of the periods where
+    the application is busy, like animations.
+
+    Returns \c true if any garbage collection work was done.
+
+    \sa collectGarbage(), setGarbageCollectionHeapGrowth()
+*/
+bool QJSEngine::collectGarbageInIdleTime(int msecs)
+{
+    return m_v4Engine->memoryManager->collectInIdleTime(msecs);
+}
+
+/*!
+    \since 5.12
+
+    Sets how much the JavaScript heap may grow before the garbage collector runs again to
+    \a percent of the memory that survived the last collection. Larger values mean fewer
+    collections at the price of a higher memory usage. If most of the heap survives
+    collections, like while an application creates its objects on startup, the heap is
+    allowed to grow twice as much.
+
+    The default is 200 percent. It can also be set with the \c QV4_MM_HEAP_GROWTH
+    environment variable. Passing a value of 0 or less restores the default.
+
+    \sa garbageCollectionHeapGrowth(), collectGarbageInIdleTime()
+*/
+void QJSEngine::setGarbageCollectionHeapGrowth(int percent)
+{
+    m_v4Engine->memoryManager->setHeapGrowth(percent);
+}
+
+/*!
+    \since 5.12
+
+    Returns how much the JavaScript heap may grow before the garbage collector runs again,
+    in percent of the memory that survived the last collection.
+
+    \sa setGarbageCollectionHeapGrowth()
+*/
+int QJSEngine::garbageCollectionHeapGrowth() const
+{
+    return m_v4Engine->memoryManager->heapGrowthPercentage();
+}
+
+static QVariantMap garbageCollectionRecordToMap(const QV4::GCRecord &record)
+{
+    static const char *types[] = { "full", "minor", "incremental" };
+
+    QVariantMap map;
+    map.insert(QStringLiteral("type"), QLatin1String(types[record.type]));
+    map.insert(QStringLiteral("markTime"), record.markTime);
+    map.insert(QStringLiteral("sweepTime"), record.sweepTime);
+    map.insert(QStringLiteral("markedItems"), qulonglong(record.markedItems));
+    map.insert(QStringLiteral("usedBefore"), qulonglong(record.usedBefore));
+    map.insert(QStringLiteral("usedAfter"), qulonglong(record.usedAfter));
+    map.insert(QStringLiteral("largeItemsBefore"), qulonglong(record.largeItemsBefore));
+    map.insert(QStringLiteral("largeItemsAfter"), qulonglong(record.largeItemsAfter));
+    map.insert(QStringLiteral("hugeItemsBefore"), record.hugeItemsBefore);
+    map.insert(QStringLiteral("hugeItemsAfter"), record.hugeItemsAfter);
+
+    QVariantList occupancy;
+    for (uint chunks : record.chunkOccupancy)
+        occupancy.append(chunks);
+    map.insert(QStringLiteral("chunkOccupancy"), occupancy);
+
+    QVariantMap freed;
+    for (const QV4::GCRecord::FreedClass &freedClass : record.freedBytesPerClass)
+        freed.insert(QLatin1String(freedClass.first), qulonglong(freedClass.second));
+    map.insert(QStringLiteral("freedBytesPerClass"), freed);
+    return map;
+}
+
+/*!
+    \since 5.12
+
+    Enables or disables recording of garbage collections, depending on \a enabled. While
+    recording, the engine emits garbageCollected() after every collection.
+
+    Recording looks at every dead object before it is freed, and keeps the heap from being
+    swept on another thread, so collections get somewhat slower. It is disabled by default.
+
+    \sa isGarbageCollectionRecordingEnabled(), garbageCollected()
+*/
+void QJSEngine::setGarbageCollectionRecordingEnabled(bool enabled)
+{
+    if (!enabled) {
+        m_v4Engine->memoryManager->setGCRecordCallback(QV4::GCRecordCallback());
+        return;
+    }
+
+    m_v4Engine->memoryManager->setGCRecordCallback([this](const QV4::GCRecord &record) {
+        // The collection may have interrupted any JavaScript code, report it once that is done.
+        const QVariantMap map = garbageCollectionRecordToMap(record);
+        QMetaObject::invokeMethod(this, [this, map]() {
+            emit garbageCollected(map);
+        }, Qt::QueuedConnection);
+    });
+}
+
+/*!
+    \since 5.12
+
+    Returns whether garbage collections are recorded.
+
+    \sa setGarbageCollectionRecordingEnabled()
+*/
+bool QJSEngine::isGarbageCollectionRecordingEnabled() const
+{
+    return bool(m_v4Engine->memoryManager->gcRecordCallback);
+}
+
+/*!
+    \fn void QJSEngine::garbageCollected(const QVariantMap &record)
+    \since 5.12
+
+    This signal is emitted after a garbage collection, if recording is enabled. It is
+    delivered through the event loop, once the code that was interrupted by the collection
+    is done.
+
+    The \a record contains:
+    \list
+    \li \c type: \c "full", \c "minor" or \c "incremental"
+    \li \c markTime and \c sweepTime: the time spent, in nanoseconds
+    \li \c markedItems: the number of objects found alive
+    \li \c usedBefore and \c usedAfter: the bytes used by small items before and after
+    \li \c largeItemsBefore and \c largeItemsAfter: the same for items too large for the
+        regular memory chunks
+    \li \c hugeItemsBefore and \c hugeItemsAfter: the number of these large items
+    \li \c chunkOccupancy: a list counting the memory chunks by how full they are after the
+        collection, in steps of a tenth
+    \li \c freedBytesPerClass: a map from the class names of dead objects to the bytes freed
+        for them
+    \endlist
+
+    \sa setGarbageCollectionRecordingEnabled()
+*/
+
 #if QT_DEPRECATED_SINCE(5, 6)
 
 /*!
@@ -94,6 +94,13 @@ public:
     }
 
     void collectGarbage();
+    bool collectGarbageInIdleTime(int msecs);
+
+    void setGarbageCollectionHeapGrowth(int percent);
+    int garbageCollectionHeapGrowth() const;
+
+    void setGarbageCollectionRecordingEnabled(bool enabled);
+    bool isGarbageCollectionRecordingEnabled() const;
 
 #if QT_DEPRECATED_SINCE(5, 6)
     QT_DEPRECATED void installTranslatorFunctions(const QJSValue &object = QJSValue());
@@ -111,6 +118,9 @@ public:
 
     QV4::ExecutionEngine *handle() const { return m_v4Engine; }
 
+Q_SIGNALS:
+    void garbageCollected(const QVariantMap &record);
+
 private:
     QJSValue create(int type, const void *ptr);
 
@@ -45,6 +45,10 @@
 #include "qv4string_p.h"
 #include "qv4jscall_p.h"
 
+#include <algorithm>
+#include <functional>
+#include <vector>
+
 using namespace QV4;
 
 QT_WARNING_SUPPRESS_GCC_TAUTOLOGICAL_COMPARE_ON
@@ -172,6 +176,7 @@ void ArrayData::realloc(Object *o, Type newType, uint requested, bool enforceAtt
     o->setArrayData(newData);
 
     if (d) {
+        newData->d()->elementKind = d->d()->elementKind;
         if (enforceAttributes) {
             if (d->attrs())
                 memcpy(newData->attrs(), d->attrs(), sizeof(PropertyAttributes)*toCopy);
@@ -658,92 +663,327 @@ void ArrayData::insert(Object *o, uint index, const Value *v, bool isAccessor)
 class ArrayElementLessThan
 {
 public:
-    inline ArrayElementLessThan(ExecutionEngine *engine, const Value &comparefn)
-        : m_engine(engine), m_comparefn(comparefn) {}
+    // callSlots holds the this object, the two arguments and the result of calls to comparefn,
+    // so that they don't need to be set up again for every comparison.
+    inline ArrayElementLessThan(ExecutionEngine *engine, const Value &comparefn, Value *callSlots)
+        : m_engine(engine), m_comparefn(comparefn.as<FunctionObject>()), m_callSlots(callSlots) {}
 
     bool operator()(Value v1, Value v2) const;
 
 private:
     ExecutionEngine *m_engine;
-    const Value &m_comparefn;
+    const FunctionObject *m_comparefn;
+    Value *m_callSlots;
 };
 
 
 bool ArrayElementLessThan::operator()(Value v1, Value v2) const
 {
-    Scope scope(m_engine);
-
     if (v1.isUndefined() || v1.isEmpty())
         return false;
     if (v2.isUndefined() || v2.isEmpty())
         return true;
-    ScopedFunctionObject o(scope, m_comparefn);
-    if (o) {
-        Scope scope(o->engine());
-        ScopedValue result(scope);
-        JSCallData jsCallData(scope, 2);
-        jsCallData->args[0] = v1;
-        jsCallData->args[1] = v2;
-        result = o->call(jsCallData);
-
-        return result->toNumber() < 0;
+    // Once a comparison threw, all remaining elements compare equal, which ends the sort quickly.
+    if (m_engine->hasException)
+        return false;
+    if (m_comparefn) {
+        m_callSlots[1] = v1;
+        m_callSlots[2] = v2;
+        m_callSlots[3] = m_comparefn->call(m_callSlots, m_callSlots + 1, 2);
+        return m_callSlots[3].toNumber() < 0;
     }
+    Scope scope(m_engine);
     ScopedString p1s(scope, v1.toString(scope.engine));
     ScopedString p2s(scope, v2.toString(scope.engine));
     return p1s->toQString() < p2s->toQString();
 }
 
-template <typename RandomAccessIterator, typename T, typename LessThan>
-void sortHelper(RandomAccessIterator start, RandomAccessIterator end, const T &t, LessThan lessThan)
+// Compares the decimal representations of two integers, which is what the default comparison
+// does after converting them to strings.
+static bool integerStringLessThan(Value v1, Value v2)
 {
-top:
-    int span = int(end - start);
-    if (span < 2)
-        return;
+    static const quint64 powersOf10[] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+        1000000000ull
+    };
+
+    const int i1 = v1.int_32();
+    const int i2 = v2.int_32();
+    if (i1 == i2)
+        return false;
+    if ((i1 < 0) != (i2 < 0))
+        return i1 < 0; // '-' sorts before the digits
+    quint64 d1 = i1 < 0 ? quint64(-qint64(i1)) : quint64(i1);
+    quint64 d2 = i2 < 0 ? quint64(-qint64(i2)) : quint64(i2);
+    int digits1 = 1;
+    for (quint64 d = d1; d >= 10; d /= 10)
+        ++digits1;
+    int digits2 = 1;
+    for (quint64 d = d2; d >= 10; d /= 10)
+        ++digits2;
+
+    // Align the numbers at their first digit, then a proper prefix sorts first.
+    if (digits1 < digits2) {
+        d1 *= powersOf10[digits2 - digits1];
+        if (d1 == d2)
+            return true;
+    } else if (digits2 < digits1) {
+        d2 *= powersOf10[digits1 - digits2];
+        if (d1 == d2)
+            return false;
+    }
+    return d1 < d2;
+}
 
-    --end;
-    RandomAccessIterator low = start, high = end - 1;
-    RandomAccessIterator pivot = start + span / 2;
+struct StringSortEntry
+{
+    QString key;
+    Value value;
 
-    if (lessThan(*end, *start))
-        qSwap(*end, *start);
-    if (span == 2)
-        return;
+    bool operator<(const StringSortEntry &other) const { return key < other.key; }
+};
 
-    if (lessThan(*pivot, *start))
-        qSwap(*pivot, *start);
-    if (lessThan(*end, *pivot))
-        qSwap(*end, *pivot);
-    if (span == 3)
-        return;
+// Stores for sorts during which the garbage collector can't run: nothing allocates on the JS
+// heap and no JS code gets called.
+template <typename T>
+struct DirectSortStore
+{
+    T *data;
+    T *tmp;
 
-    qSwap(*pivot, *end);
+    void setData(uint i, const T &v) const { data[i] = v; }
+    void setTmp(uint i, const T &v) const { tmp[i] = v; }
+};
 
-    while (low < high) {
-        while (low < high && lessThan(*low, *end))
-            ++low;
+// The comparison function can allocate and collect garbage in between the stores, so the
+// values written into the array need to go through the write barrier. The merge buffer is
+// on the JS stack, which is a root. Buffers too large for the stack live in a MemberData and
+// get the barrier as well.
+struct BarrierSortStore
+{
+    ExecutionEngine *engine;
+    Heap::ArrayData *data;
+    Heap::MemberData *buffer;
+    Value *tmp;
+
+    void setData(uint i, const Value &v) const { data->values.set(engine, i, v); }
+    void setTmp(uint i, const Value &v) const
+    {
+        if (buffer)
+            buffer->values.set(engine, i, v);
+        else
+            tmp[i] = v;
+    }
+};
 
-        while (high > low && lessThan(*end, *high))
-            --high;
+// A stable merge sort following TimSort: ascending and strictly descending runs already in the
+// data are used as they are, short ones are extended with a binary insertion sort, and a stack
+// of pending runs keeps the merges balanced. The galloping mode is left out, but merges skip
+// the elements at either end that are already in their place. tmp needs room for half of the
+// elements that are sorted. All writes go through store.
+template <typename T, typename LessThan, typename Store>
+class TimSort
+{
+public:
+    TimSort(T *tmp, const LessThan &lessThan, const Store &store)
+        : tmp(tmp), lessThan(lessThan), store(store) {}
+
+    void sort(T *data, uint length)
+    {
+        if (length < 2)
+            return;
+        a = data;
+
+        const uint minRun = minRunLength(length);
+        uint lo = 0;
+        while (lo < length) {
+            uint runLength = countRunAndMakeAscending(lo, length);
+            if (runLength < minRun) {
+                const uint forcedLength = qMin(minRun, length - lo);
+                binaryInsertionSort(lo, lo + forcedLength, lo + runLength);
+                runLength = forcedLength;
+            }
+            runs.push_back({ lo, runLength });
+            mergeCollapse();
+            lo += runLength;
+        }
+
+        while (runs.size() > 1) {
+            size_t n = runs.size() - 2;
+            if (n > 0 && runs[n - 1].length < runs[n + 1].length)
+                --n;
+            mergeAt(n);
+        }
+    }
+
+private:
+    struct Run {
+        uint start;
+        uint length;
+    };
+
+    static uint minRunLength(uint n)
+    {
+        uint r = 0;
+        while (n >= 64) {
+            r |= n & 1;
+            n >>= 1;
+        }
+        return n + r;
+    }
 
-        if (low < high) {
-            qSwap(*low, *high);
-            ++low;
-            --high;
+    uint countRunAndMakeAscending(uint lo, uint hi)
+    {
+        uint runHi = lo + 1;
+        if (runHi == hi)
+            return 1;
+        if (lessThan(a[runHi++], a[lo])) {
+            while (runHi < hi && lessThan(a[runHi], a[runHi - 1]))
+                ++runHi;
+            for (uint i = lo, j = runHi - 1; i < j; ++i, --j) {
+                const T t = a[i];
+                store.setData(i, a[j]);
+                store.setData(j, t);
+            }
         } else {
-            break;
+            while (runHi < hi && !lessThan(a[runHi], a[runHi - 1]))
+                ++runHi;
+        }
+        return runHi - lo;
+    }
+
+    // [lo, start) is sorted already
+    void binaryInsertionSort(uint lo, uint hi, uint start)
+    {
+        for (uint i = start; i < hi; ++i) {
+            // pivot stays in a[i] for as long as comparisons run
+            const T pivot = a[i];
+            uint left = lo;
+            uint right = i;
+            while (left < right) {
+                const uint mid = left + (right - left) / 2;
+                if (lessThan(pivot, a[mid]))
+                    right = mid;
+                else
+                    left = mid + 1;
+            }
+            for (uint j = i; j > left; --j)
+                store.setData(j, a[j - 1]);
+            store.setData(left, pivot);
+        }
+    }
+
+    void mergeCollapse()
+    {
+        while (runs.size() > 1) {
+            size_t n = runs.size() - 2;
+            if ((n > 0 && runs[n - 1].length <= runs[n].length + runs[n + 1].length)
+                    || (n > 1 && runs[n - 2].length <= runs[n - 1].length + runs[n].length)) {
+                if (runs[n - 1].length < runs[n + 1].length)
+                    --n;
+            } else if (runs[n].length > runs[n + 1].length) {
+                break;
+            }
+            mergeAt(n);
         }
     }
 
-    if (lessThan(*low, *end))
-        ++low;
+    void mergeAt(size_t i)
+    {
+        uint baseA = runs[i].start;
+        uint lengthA = runs[i].length;
+        const uint baseB = runs[i + 1].start;
+        uint lengthB = runs[i + 1].length;
+        runs[i].length += lengthB;
+        runs.erase(runs.begin() + i + 1);
+
+        // Elements of A not greater than the first one of B stay where they are ...
+        uint left = baseA;
+        uint right = baseA + lengthA;
+        while (left < right) {
+            const uint mid = left + (right - left) / 2;
+            if (lessThan(a[baseB], a[mid]))
+                right = mid;
+            else
+                left = mid + 1;
+        }
+        lengthA -= left - baseA;
+        baseA = left;
+        if (lengthA == 0)
+            return;
+
+        // ... and so do the elements of B not less than the last one of A.
+        left = baseB;
+        right = baseB + lengthB;
+        while (left < right) {
+            const uint mid = left + (right - left) / 2;
+            if (lessThan(a[mid], a[baseA + lengthA - 1]))
+                left = mid + 1;
+            else
+                right = mid;
+        }
+        lengthB = left - baseB;
+        if (lengthB == 0)
+            return;
+
+        if (lengthA <= lengthB)
+            mergeLow(baseA, lengthA, baseB, lengthB);
+        else
+            mergeHigh(baseA, lengthA, baseB, lengthB);
+    }
 
-    qSwap(*end, *low);
-    sortHelper(start, low, t, lessThan);
+    void mergeLow(uint baseA, uint lengthA, uint baseB, uint lengthB)
+    {
+        for (uint k = 0; k < lengthA; ++k)
+            store.setTmp(k, a[baseA + k]);
+        uint dest = baseA;
+        uint i = 0;
+        uint j = baseB;
+        const uint endB = baseB + lengthB;
+        while (i < lengthA && j < endB) {
+            if (lessThan(a[j], tmp[i]))
+                store.setData(dest++, a[j++]);
+            else
+                store.setData(dest++, tmp[i++]);
+        }
+        while (i < lengthA)
+            store.setData(dest++, tmp[i++]);
+    }
+
+    void mergeHigh(uint baseA, uint lengthA, uint baseB, uint lengthB)
+    {
+        for (uint k = 0; k < lengthB; ++k)
+            store.setTmp(k, a[baseB + k]);
+        int dest = int(baseB + lengthB) - 1;
+        int i = int(baseA + lengthA) - 1;
+        int j = int(lengthB) - 1;
+        while (i >= int(baseA) && j >= 0) {
+            if (lessThan(tmp[j], a[i]))
+                store.setData(dest--, a[i--]);
+            else
+                store.setData(dest--, tmp[j--]);
+        }
+        while (j >= 0)
+            store.setData(dest--, tmp[j--]);
+    }
+
+    T *a = nullptr;
+    T *tmp;
+    const LessThan &lessThan;
+    Store store;
+    std::vector<Run> runs;
+};
 
-    start = low + 1;
-    ++end;
-    goto top;
+template <typename T, typename LessThan, typename Store>
+static void timSort(T *data, uint length, T *tmp, const LessThan &lessThan, const Store &store)
+{
+    TimSort<T, LessThan, Store>(tmp, lessThan, store).sort(data, length);
+}
+
+template <typename T, typename LessThan>
+static void timSort(T *data, uint length, T *tmp, const LessThan &lessThan)
+{
+    timSort(data, length, tmp, lessThan, DirectSortStore<T>{ data, tmp });
 }
 
 
@@ -837,10 +1077,68 @@ void ArrayData::sort(ExecutionEngine *engine, Object *thisObject, const Value &c
     }
 
 
-    ArrayElementLessThan lessThan(engine, static_cast<const FunctionObject &>(comparefn));
+    // keeps the data alive and sorted in place, even if the comparison function replaces it
+    arrayData = thisObject->arrayData();
+    Heap::ArrayData *d = arrayData->d();
+    Value *begin = d->values.values;
+
+    // undefined sorts after everything else without being passed to the comparison function
+    uint n = 0;
+    for (uint i = 0; i < len; ++i) {
+        if (!begin[i].isUndefined())
+            d->values.set(engine, n++, begin[i]);
+    }
+    for (uint i = n; i < len; ++i)
+        d->values.set(engine, i, Primitive::undefinedValue());
+    if (n < 2)
+        return;
+
+    if (comparefn.isUndefined()) {
+        bool allIntegers = true;
+        bool allPrimitives = true;
+        if (thisObject->d()->arrayData->elementKind != Heap::ArrayData::IntegerElements) {
+            for (uint i = 0; i < n && allPrimitives; ++i) {
+                allIntegers = allIntegers && begin[i].isInteger();
+                allPrimitives = !begin[i].isObject();
+            }
+        }
+
+        if (allIntegers) {
+            std::vector<Value> tmp(n / 2);
+            timSort(begin, n, tmp.data(), &integerStringLessThan);
+            return;
+        }
+
+        if (allPrimitives) {
+            // Converting primitives to strings neither runs JS code nor allocates on the JS
+            // heap, so the values can't be collected while they are only held here.
+            std::vector<StringSortEntry> entries;
+            entries.reserve(n);
+            for (uint i = 0; i < n; ++i)
+                entries.push_back({ begin[i].toQString(), begin[i] });
+            std::vector<StringSortEntry> tmp(n / 2);
+            timSort(entries.data(), n, tmp.data(), std::less<StringSortEntry>());
+            for (uint i = 0; i < n; ++i)
+                d->values.set(engine, i, entries[i].value);
+            return;
+        }
+    }
+
+    ArrayElementLessThan lessThan(engine, comparefn, scope.alloc(4));
 
-    Value *begin = thisObject->arrayData()->values.values;
-    sortHelper(begin, begin + len, *begin, lessThan);
+    // The comparison may run JS code, so elements that are only held in the merge buffer need
+    // to be visible to the garbage collector. The buffer goes on the JS stack, unless that would
+    // leave too little of it to the comparison function.
+    BarrierSortStore store = { engine, d, nullptr, nullptr };
+    Scoped<MemberData> buffer(scope);
+    if (engine->jsStackTop + n / 2 + 1024 < engine->jsStackLimit) {
+        store.tmp = scope.alloc(int(n / 2));
+    } else {
+        buffer = MemberData::allocate(engine, n / 2);
+        store.buffer = buffer->d();
+        store.tmp = store.buffer->values.values;
+    }
+    timSort(begin, n, store.tmp, lessThan, store);
 
 #ifdef CHECK_SPARSE_ARRAYS
     thisObject->initSparseArray();
@@ -92,7 +92,7 @@ namespace Heap {
 
 #define ArrayDataMembers(class, Member) \
     Member(class, NoMark, ushort, type) \
-    Member(class, NoMark, ushort, unused) \
+    Member(class, NoMark, ushort, elementKind) \
     Member(class, NoMark, uint, offset) \
     Member(class, NoMark, PropertyAttributes *, attrs) \
     Member(class, NoMark, SparseArray *, sparse) \
@@ -103,11 +103,17 @@ DECLARE_HEAP_OBJECT(ArrayData, Base) {
 
     enum Type { Simple = 0, Complex = 1, Sparse = 2, Custom = 3 };
 
+    // What has been stored in values so far, holes excluded. Only ever widens, so
+    // a numeric kind guarantees that no element needs a type check beyond the number tag.
+    // New array data is zero filled and thus starts out as IntegerElements.
+    enum ElementKind { IntegerElements = 0, NumberElements = 1, GenericElements = 2 };
+
     struct Index {
         Heap::ArrayData *arrayData;
         uint index;
 
         void set(EngineBase *e, Value newVal) {
+            arrayData->updateElementKind(newVal);
             arrayData->values.set(e, index, newVal);
         }
         const Value *operator->() const { return &arrayData->values[index]; }
@@ -136,9 +142,20 @@ DECLARE_HEAP_OBJECT(ArrayData, Base) {
     }
 
     void setArrayData(EngineBase *e, uint index, Value newVal) {
+        updateElementKind(newVal);
         values.set(e, index, newVal);
     }
 
+    void updateElementKind(Value v) {
+        if (v.isInteger() || v.isEmpty())
+            return;
+        if (!v.isDouble())
+            elementKind = GenericElements;
+        else if (elementKind == IntegerElements)
+            elementKind = NumberElements;
+    }
+    bool hasOnlyNumbers() const { return elementKind != GenericElements; }
+
     uint mappedIndex(uint index) const;
 };
 Q_STATIC_ASSERT(std::is_trivial< ArrayData >::value);
@@ -147,6 +164,7 @@ struct SimpleArrayData : public ArrayData {
     uint mappedIndex(uint index) const { index += offset; if (index >= values.alloc) index -= values.alloc; return index; }
     const Value &data(uint index) const { return values[mappedIndex(index)]; }
     void setData(EngineBase *e, uint index, Value newVal) {
+        updateElementKind(newVal);
         values.set(e, mappedIndex(index), newVal);
     }
 
@@ -314,9 +332,9 @@ void ArrayData::setProperty(QV4::EngineBase *e, uint index, const Property *p)
 {
     uint mapped = mappedIndex(index);
     Q_ASSERT(mapped != UINT_MAX);
-    values.set(e, mapped, p->value);
+    setArrayData(e, mapped, p->value);
     if (attributes(index).isAccessor())
-        values.set(e, mapped + 1 /*QV4::Object::SetterOffset*/, p->set);
+        setArrayData(e, mapped + 1 /*QV4::Object::SetterOffset*/, p->set);
 }
 
 inline PropertyAttributes ArrayData::attributes(uint i) const
@@ -50,6 +50,58 @@ using namespace QV4;
 
 DEFINE_OBJECT_VTABLE(ArrayCtor);
 
+// Reads an element of a plain array straight from its storage. Holes, attributes and
+// anything that isn't an array go through the full property lookup.
+static inline ReturnedValue getArrayElement(const Object *o, uint index, bool *exists)
+{
+    Heap::ArrayData *ad = o->d()->arrayData;
+    if (ad && ad->type == Heap::ArrayData::Simple && o->isArrayObject()) {
+        const Heap::SimpleArrayData *sa = static_cast<const Heap::SimpleArrayData *>(ad);
+        if (index < sa->values.size) {
+            const Value &v = sa->data(index);
+            if (!v.isEmpty()) {
+                *exists = true;
+                return v.asReturnedValue();
+            }
+        }
+    }
+    return o->getIndexed(index, exists);
+}
+
+// Strict equality against a number for array data that only ever held numbers. Holes can't
+// match, and if the data only ever held integers, neither can anything that isn't one.
+struct NumberMatcher
+{
+    NumberMatcher(const Heap::ArrayData *d, double number)
+        : number(number)
+        , integersOnly(d->elementKind == Heap::ArrayData::IntegerElements)
+    {
+        Q_ASSERT(d->hasOnlyNumbers());
+        if (integersOnly && number >= INT_MIN && number <= INT_MAX && int(number) == number)
+            integer = Primitive::fromInt32(int(number)).asReturnedValue();
+    }
+
+    bool canMatch() const { return !integersOnly || integer != Primitive::emptyValue().asReturnedValue(); }
+
+    bool operator()(const Value &v) const
+    {
+        if (integersOnly)
+            return v.asReturnedValue() == integer;
+        return v.isNumber() && v.asDouble() == number;
+    }
+
+    double number;
+    bool integersOnly;
+    ReturnedValue integer = Primitive::emptyValue().asReturnedValue();
+};
+
+static inline bool hasOnlyNumbers(Object *o)
+{
+    Heap::ArrayData *ad = o->d()->arrayData;
+    return ad && ad->type == Heap::ArrayData::Simple && ad->hasOnlyNumbers()
+            && o->isArrayObject() && !o->protoHasArray();
+}
+
 void Heap::ArrayCtor::init(QV4::ExecutionContext *scope)
 {
     Heap::FunctionObject::init(scope, QStringLiteral("Array"));
@@ -96,6 +148,7 @@ void ArrayPrototype::init(ExecutionEngine *engine, Object *ctor)
     defineDefaultProperty(engine->id_toString(), method_toString, 0);
     defineDefaultProperty(QStringLiteral("toLocaleString"), method_toLocaleString, 0);
     defineDefaultProperty(QStringLiteral("concat"), method_concat, 1);
+    defineDefaultProperty(QStringLiteral("fill"), method_fill, 1);
     defineDefaultProperty(QStringLiteral("find"), method_find, 1);
     defineDefaultProperty(QStringLiteral("findIndex"), method_findIndex, 1);
     defineDefaultProperty(QStringLiteral("join"), method_join, 1);
@@ -183,6 +236,61 @@ ReturnedValue ArrayPrototype::method_concat(const FunctionObject *b, const Value
     return result.asReturnedValue();
 }
 
+ReturnedValue ArrayPrototype::method_fill(const FunctionObject *b, const Value *thisObject, const Value *argv, int argc)
+{
+    Scope scope(b);
+    ScopedObject instance(scope, thisObject->toObject(scope.engine));
+    if (!instance)
+        RETURN_UNDEFINED();
+
+    uint len = instance->getLength();
+    ScopedValue value(scope, argc ? argv[0] : Primitive::undefinedValue());
+
+    double s = argc > 1 ? argv[1].toInteger() : 0;
+    CHECK_EXCEPTION();
+    uint start;
+    if (s < 0)
+        start = (uint)qMax(len + s, 0.);
+    else if (s > len)
+        start = len;
+    else
+        start = (uint) s;
+    uint end = len;
+    if (argc > 2 && !argv[2].isUndefined()) {
+        double e = argv[2].toInteger();
+        CHECK_EXCEPTION();
+        if (e < 0)
+            end = (uint)qMax(len + e, 0.);
+        else if (e > len)
+            end = len;
+        else
+            end = (uint) e;
+    }
+    if (start >= end)
+        return instance->asReturnedValue();
+
+    // Filling a dense array doesn't leave holes, so it can be written in place, unless some of
+    // its elements are read-only or accessors.
+    if (instance->isArrayObject() && instance->isExtensible() && !instance->protoHasArray()
+            && instance->arrayType() == Heap::ArrayData::Simple
+            && (!instance->arrayData() || !instance->arrayData()->attrs)
+            && start <= (instance->arrayData() ? instance->arrayData()->values.size : 0)) {
+        instance->arrayReserve(end);
+        Heap::SimpleArrayData *sa = instance->d()->arrayData.cast<Heap::SimpleArrayData>();
+        Q_ASSERT(sa->type == Heap::ArrayData::Simple);
+        for (uint i = start; i < end; ++i)
+            sa->setData(scope.engine, i, value);
+        sa->values.size = qMax(sa->values.size, end);
+        return instance->asReturnedValue();
+    }
+
+    for (uint i = start; i < end; ++i) {
+        if (!instance->putIndexed(i, value))
+            return scope.engine->throwTypeError();
+    }
+    return instance->asReturnedValue();
+}
+
 ReturnedValue ArrayPrototype::method_find(const FunctionObject *b, const Value *thisObject, const Value *argv, int argc)
 {
     Scope scope(b);
@@ -273,19 +381,19 @@ ReturnedValue ArrayPrototype::method_join(const FunctionObject *b, const Value *
     if (!r2)
         return Encode(scope.engine->newString());
 
-    QString R;
+    StringBuilder R;
 
     // ### FIXME
     if (ArrayObject *a = instance->as<ArrayObject>()) {
         ScopedValue e(scope);
         for (uint i = 0; i < a->getLength(); ++i) {
             if (i)
-                R += r4;
+                R.append(r4);
 
             e = a->getIndexed(i);
             CHECK_EXCEPTION();
             if (!e->isNullOrUndefined())
-                R += e->toQString();
+                R.append(*e);
         }
     } else {
         //
@@ -294,22 +402,22 @@ ReturnedValue ArrayPrototype::method_join(const FunctionObject *b, const Value *
         ScopedString name(scope, scope.engine->newString(QStringLiteral("0")));
         ScopedValue r6(scope, instance->get(name));
         if (!r6->isNullOrUndefined())
-            R = r6->toQString();
+            R.append(*r6);
 
         ScopedValue r12(scope);
         for (quint32 k = 1; k < r2; ++k) {
-            R += r4;
+            R.append(r4);
 
             name = Primitive::fromDouble(k).toString(scope.engine);
             r12 = instance->get(name);
             CHECK_EXCEPTION();
 
             if (!r12->isNullOrUndefined())
-                R += r12->toQString();
+                R.append(*r12);
         }
     }
 
-    return Encode(scope.engine->newString(R));
+    return Encode(R.toString(scope.engine));
 }
 
 ReturnedValue ArrayPrototype::method_pop(const FunctionObject *b, const Value *thisObject, const Value *, int)
@@ -717,6 +825,16 @@ ReturnedValue ArrayPrototype::method_indexOf(const FunctionObject *b, const Valu
         Heap::SimpleArrayData *sa = instance->d()->arrayData.cast<Heap::SimpleArrayData>();
         if (len > sa->values.size)
             len = sa->values.size;
+        if (searchValue->isNumber() && hasOnlyNumbers(instance)) {
+            const NumberMatcher matches(sa, searchValue->asDouble());
+            if (!matches.canMatch())
+                return Encode(-1);
+            for (uint i = fromIndex; i < len; ++i) {
+                if (matches(sa->data(i)))
+                    return Encode(i);
+            }
+            return Encode(-1);
+        }
         uint idx = fromIndex;
         while (idx < len) {
             value = sa->data(idx);
@@ -761,6 +879,19 @@ ReturnedValue ArrayPrototype::method_lastIndexOf(const FunctionObject *b, const
         fromIndex = (uint) f + 1;
     }
 
+    if (searchValue->isNumber() && hasOnlyNumbers(instance)) {
+        const Heap::SimpleArrayData *sa = instance->d()->arrayData.cast<Heap::SimpleArrayData>();
+        const NumberMatcher matches(sa, searchValue->asDouble());
+        if (!matches.canMatch())
+            return Encode(-1);
+        for (uint k = qMin(fromIndex, sa->values.size); k > 0;) {
+            --k;
+            if (matches(sa->data(k)))
+                return Encode(k);
+        }
+        return Encode(-1);
+    }
+
     ScopedValue v(scope);
     for (uint k = fromIndex; k > 0;) {
         --k;
@@ -793,7 +924,7 @@ ReturnedValue ArrayPrototype::method_every(const FunctionObject *b, const Value
     bool ok = true;
     for (uint k = 0; ok && k < len; ++k) {
         bool exists;
-        arguments[0] = instance->getIndexed(k, &exists);
+        arguments[0] = getArrayElement(instance, k, &exists);
         if (!exists)
             continue;
 
@@ -824,7 +955,7 @@ ReturnedValue ArrayPrototype::method_some(const FunctionObject *b, const Value *
 
     for (uint k = 0; k < len; ++k) {
         bool exists;
-        arguments[0] = instance->getIndexed(k, &exists);
+        arguments[0] = getArrayElement(instance, k, &exists);
         if (!exists)
             continue;
 
@@ -855,7 +986,7 @@ ReturnedValue ArrayPrototype::method_forEach(const FunctionObject *b, const Valu
 
     for (uint k = 0; k < len; ++k) {
         bool exists;
-        arguments[0] = instance->getIndexed(k, &exists);
+        arguments[0] = getArrayElement(instance, k, &exists);
         if (!exists)
             continue;
 
@@ -890,7 +1021,7 @@ ReturnedValue ArrayPrototype::method_map(const FunctionObject *b, const Value *t
 
     for (uint k = 0; k < len; ++k) {
         bool exists;
-        arguments[0] = instance->getIndexed(k, &exists);
+        arguments[0] = getArrayElement(instance, k, &exists);
         if (!exists)
             continue;
 
@@ -925,7 +1056,7 @@ ReturnedValue ArrayPrototype::method_filter(const FunctionObject *b, const Value
     uint to = 0;
     for (uint k = 0; k < len; ++k) {
         bool exists;
-        arguments[0] = instance->getIndexed(k, &exists);
+        arguments[0] = getArrayElement(instance, k, &exists);
         if (!exists)
             continue;
 
@@ -962,7 +1093,7 @@ ReturnedValue ArrayPrototype::method_reduce(const FunctionObject *b, const Value
     } else {
         bool kPresent = false;
         while (k < len && !kPresent) {
-            v = instance->getIndexed(k, &kPresent);
+            v = getArrayElement(instance, k, &kPresent);
             if (kPresent)
                 acc = v;
             ++k;
@@ -975,7 +1106,7 @@ ReturnedValue ArrayPrototype::method_reduce(const FunctionObject *b, const Value
 
     while (k < len) {
         bool kPresent;
-        v = instance->getIndexed(k, &kPresent);
+        v = getArrayElement(instance, k, &kPresent);
         if (kPresent) {
             arguments[0] = acc;
             arguments[1] = v;
@@ -1015,7 +1146,7 @@ ReturnedValue ArrayPrototype::method_reduceRight(const FunctionObject *b, const
     } else {
         bool kPresent = false;
         while (k > 0 && !kPresent) {
-            v = instance->getIndexed(k - 1, &kPresent);
+            v = getArrayElement(instance, k - 1, &kPresent);
             if (kPresent)
                 acc = v;
             --k;
@@ -1028,7 +1159,7 @@ ReturnedValue ArrayPrototype::method_reduceRight(const FunctionObject *b, const
 
     while (k > 0) {
         bool kPresent;
-        v = instance->getIndexed(k - 1, &kPresent);
+        v = getArrayElement(instance, k - 1, &kPresent);
         if (kPresent) {
             arguments[0] = acc;
             arguments[1] = v;
@@ -82,6 +82,7 @@ struct ArrayPrototype: ArrayObject
     static ReturnedValue method_toString(const FunctionObject *, const Value *thisObject, const Value *argv, int argc);
     static ReturnedValue method_toLocaleString(const FunctionObject *, const Value *thisObject, const Value *argv, int argc);
     static ReturnedValue method_concat(const FunctionObject *, const Value *thisObject, const Value *argv, int argc);
+    static ReturnedValue method_fill(const FunctionObject *, const Value *thisObject, const Value *argv, int argc);
     static ReturnedValue method_find(const FunctionObject *, const Value *thisObject, const Value *argv, int argc);
     static ReturnedValue method_findIndex(const FunctionObject *, const Value *thisObject, const Value *argv, int argc);
     static ReturnedValue method_join(const FunctionObject *, const Value *thisObject, const Value *argv, int argc);
@@ -134,6 +134,7 @@ ExecutionEngine::ExecutionEngine()
     , m_engineId(engineSerial.fetchAndAddOrdered(1))
     , regExpCache(nullptr)
     , m_multiplyWrappedQObjects(nullptr)
+    , overloadResolutionCache(nullptr)
 #if defined(V4_ENABLE_JIT) && !defined(V4_BOOTSTRAP)
     , m_canAllocateExecutableMemory(OSAllocator::canAllocateExecutableMemory())
 #endif
@@ -178,6 +179,28 @@ ExecutionEngine::ExecutionEngine()
             jitCallCountThreshold = 3;
         if (qEnvironmentVariableIsSet("QV4_FORCE_INTERPRETER"))
             jitCallCountThreshold = std::numeric_limits<int>::max();
+
+        jitOptimizeCallCountThreshold = qEnvironmentVariableIntValue("QV4_JIT_OPTIMIZE_THRESHOLD", &ok);
+        if (!ok)
+            jitOptimizeCallCountThreshold = 100;
+        if (jitOptimizeCallCountThreshold < 0)
+            jitOptimizeCallCountThreshold = std::numeric_limits<int>::max();
+
+        jitLoopIterationThreshold = qEnvironmentVariableIntValue("QV4_JIT_LOOP_THRESHOLD", &ok);
+        if (!ok)
+            jitLoopIterationThreshold = 1000;
+        if (jitCallCountThreshold == std::numeric_limits<int>::max())
+            jitLoopIterationThreshold = -1; // negative values disable entering JIT code from loops
+
+        m_jitCachesStackSlots = !qEnvironmentVariableIsSet("QV4_JIT_NO_REGISTER_CACHE");
+        // Installing machine code from a file means trusting that file like a library, so this
+        // has to be asked for.
+        m_jitUsesDiskCache = qEnvironmentVariableIsSet("QV4_JIT_DISK_CACHE")
+                && jitCallCountThreshold != std::numeric_limits<int>::max();
+        // only the optimizing tier reads the feedback
+        m_jitRecordsTypeFeedback = !qEnvironmentVariableIsSet("QV4_JIT_NO_TYPE_FEEDBACK")
+                && jitCallCountThreshold != std::numeric_limits<int>::max()
+                && jitOptimizeCallCountThreshold != std::numeric_limits<int>::max();
     }
 
     exceptionValue = jsAlloca(1);
@@ -481,11 +504,14 @@ ExecutionEngine::~ExecutionEngine()
 {
     delete m_multiplyWrappedQObjects;
     m_multiplyWrappedQObjects = nullptr;
+    delete overloadResolutionCache;
+    overloadResolutionCache = nullptr;
     delete identifierTable;
     delete memoryManager;
 
     while (!compilationUnits.isEmpty())
         (*compilationUnits.begin())->unlink();
+    flushJitCodeCache();
 
     internalClasses[Class_Empty]->destroy();
     delete classPool;
@@ -500,6 +526,19 @@ ExecutionEngine::~ExecutionEngine()
     delete [] argumentsAccessors;
 }
 
+// Writes the cache files of released compilation units and of the linked ones that got new
+// baseline JIT code since the last flush, so that the code survives an engine that is never
+// destroyed.
+void ExecutionEngine::flushJitCodeCache()
+{
+    for (auto it = compilationUnits.begin(), end = compilationUnits.end(); it != end; ++it)
+        (*it)->handOverJitCodeForDiskCache();
+    if (jitCodeCacheFiles.isEmpty())
+        return;
+    CompiledData::CompilationUnit::writeJitCodeCacheFiles(jitCodeCacheFiles);
+    jitCodeCacheFiles.clear();
+}
+
 #if QT_CONFIG(qml_debug)
 void ExecutionEngine::setDebugger(Debugging::Debugger *debugger)
 {
@@ -599,6 +638,8 @@ Heap::ArrayObject *ExecutionEngine::newArrayObject(const Value *values, int leng
         // this doesn't require a write barrier, things will be ok, when the new array data gets inserted into
         // the parent object
         memcpy(&d->values.values, values, length*sizeof(Value));
+        for (int i = 0; i < length; ++i)
+            d->updateElementKind(values[i]);
         a->d()->arrayData.set(this, d);
         a->setArrayLengthUnchecked(length);
     }
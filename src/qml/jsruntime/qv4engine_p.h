@@ -54,6 +54,7 @@
 #include "qv4managed_p.h"
 #include "qv4context_p.h"
 #include <private/qintrusivelist_p.h>
+#include <QtCore/qhash.h>
 #include "qv4enginebase_p.h"
 
 
@@ -344,6 +345,10 @@ public:
 
 #ifndef V4_BOOTSTRAP
     QIntrusiveList<CompiledData::CompilationUnit, &CompiledData::CompilationUnit::nextCompilationUnit> compilationUnits;
+    // contents of the cache files that got new baseline JIT code, by file name, written
+    // by flushJitCodeCache()
+    QHash<QString, QByteArray> jitCodeCacheFiles;
+    void flushJitCodeCache();
 #endif
 
     quint32 m_engineId;
@@ -368,6 +373,8 @@ public:
     // but any time a QObject is wrapped a second time in another engine, we have to do
     // bookkeeping.
     MultiplyWrappedQObjectMap *m_multiplyWrappedQObjects;
+    // The overloads that calls of overloaded C++ methods from this engine resolved to
+    OverloadResolutionCache *overloadResolutionCache;
 #if defined(V4_ENABLE_JIT) && !defined(V4_BOOTSTRAP)
     const bool m_canAllocateExecutableMemory;
 #endif
@@ -500,6 +507,38 @@ public:
 #endif
     }
 
+    bool canOptimize(Function *f)
+    {
+#if defined(V4_ENABLE_JIT) && !defined(V4_BOOTSTRAP)
+        return f->baselineCallCount >= jitOptimizeCallCountThreshold;
+#else
+        Q_UNUSED(f);
+        return false;
+#endif
+    }
+
+    // Counts a backward jump taken by the interpreter in f. Returns true once the loops have run
+    // long enough for the current call to continue in JIT code.
+    bool canJITLoop(Function *f)
+    {
+#if defined(V4_ENABLE_JIT) && !defined(V4_BOOTSTRAP)
+        if (!m_canAllocateExecutableMemory || jitLoopIterationThreshold < 0)
+            return false;
+        if (f->loopIterationCount < jitLoopIterationThreshold) {
+            ++f->loopIterationCount;
+            return false;
+        }
+        return true;
+#else
+        Q_UNUSED(f);
+        return false;
+#endif
+    }
+
+    bool jitCachesStackSlots() const { return m_jitCachesStackSlots; }
+    bool jitUsesDiskCache() const { return m_jitUsesDiskCache; }
+    bool jitRecordsTypeFeedback() const { return m_jitRecordsTypeFeedback; }
+
     QV4::ReturnedValue global();
 
 private:
@@ -508,6 +547,11 @@ private:
     QScopedPointer<QV4::Profiling::Profiler> m_profiler;
 #endif
     int jitCallCountThreshold;
+    int jitOptimizeCallCountThreshold;
+    int jitLoopIterationThreshold;
+    bool m_jitCachesStackSlots;
+    bool m_jitUsesDiskCache;
+    bool m_jitRecordsTypeFeedback;
 };
 
 // This is a trick to tell the code generators that functions taking a NoThrowContext won't
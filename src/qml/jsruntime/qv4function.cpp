@@ -59,6 +59,7 @@ Function::Function(ExecutionEngine *engine, CompiledData::CompilationUnit *unit,
         , codeData(function->code())
         , jittedCode(nullptr)
         , codeRef(nullptr)
+        , baselineCodeRef(nullptr)
         , hasQmlDependencies(function->hasQmlDependencies())
 {
     Q_UNUSED(engine);
@@ -80,6 +81,8 @@ Function::Function(ExecutionEngine *engine, CompiledData::CompilationUnit *unit,
 Function::~Function()
 {
     delete codeRef;
+    delete baselineCodeRef;
+    delete[] typeFeedback;
 }
 
 void Function::updateInternalClass(ExecutionEngine *engine, const QList<QByteArray> &parameters)
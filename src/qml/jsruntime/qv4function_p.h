@@ -79,11 +79,29 @@ struct Q_QML_EXPORT Function {
     typedef ReturnedValue (*JittedCode)(CppStackFrame *, ExecutionEngine *);
     JittedCode jittedCode;
     JSC::MacroAssemblerCodeRef *codeRef;
+    // baseline code replaced by the optimizing tier, still running in frames further up the stack
+    JSC::MacroAssemblerCodeRef *baselineCodeRef;
 
     // first nArguments names in internalClass are the actual arguments
     InternalClass *internalClass;
     uint nFormals;
     int interpreterCallCount = 0;
+    int baselineCallCount = 0;
+    int loopIterationCount = 0;
+    // interpreted calls that continued in JIT code at a loop header
+    int loopEntryCount = 0;
+    bool isOptimized = false;
+
+    // Operand types the interpreter has seen for arithmetic and relational instructions, one
+    // byte per byte of bytecode, indexed by the offset of the last byte of the instruction.
+    // Allocated for the last interpreted call before the baseline JIT, read by the optimizing JIT.
+    enum TypeFeedback : quint8 {
+        NoTypeFeedback = 0,
+        SawInt = 1,
+        SawDouble = 2,
+        SawOther = 4
+    };
+    quint8 *typeFeedback = nullptr;
     bool hasQmlDependencies;
 
     Function(ExecutionEngine *engine, CompiledData::CompilationUnit *unit, const CompiledData::Function *function, Code codePtr);
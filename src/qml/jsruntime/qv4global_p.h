@@ -248,6 +248,7 @@ class WeakValue;
 struct IdentifierTable;
 class RegExpCache;
 class MultiplyWrappedQObjectMap;
+class OverloadResolutionCache;
 
 enum PropertyFlag {
     Attr_Data = 0,
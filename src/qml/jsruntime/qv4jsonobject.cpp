@@ -45,14 +45,22 @@
 #include <qv4scopedvalue_p.h>
 #include <qv4runtime_p.h>
 #include <qv4variantobject_p.h>
+#include <qv4internalclass_p.h>
 #include "qv4string_p.h"
 #include "qv4jscall_p.h"
+#include "private/qlocale_tools_p.h"
 
+#include <private/qsimd_p.h>
+
+#include <qalgorithms.h>
 #include <qstack.h>
+#include <qvarlengtharray.h>
 #include <qstringlist.h>
 
 #include <wtf/MathExtras.h>
 
+#include <algorithm>
+
 using namespace QV4;
 
 //#define PARSER_DEBUG
@@ -75,8 +83,10 @@ static const int nestingLimit = 1024;
 
 JsonParser::JsonParser(ExecutionEngine *engine, const QChar *json, int length)
     : engine(engine), head(json), json(json), nestingLevel(0), lastError(QJsonParseError::NoError)
+    , objectClass(nullptr)
 {
     end = json + length;
+    std::fill(lastObjectClass, lastObjectClass + MaxShapeNestingLevel, nullptr);
 }
 
 
@@ -212,11 +222,22 @@ ReturnedValue JsonParser::parseObject()
     BEGIN << "parseObject pos=" << json;
     Scope scope(engine);
 
-    ScopedObject o(scope, engine->newObject());
+    ObjectShape shape = { nullptr, 0 };
+    if (nestingLevel < MaxShapeNestingLevel)
+        shape.predicted = lastObjectClass[nestingLevel];
+
+    // Allocating the object with the predicted class sizes its members up front.
+    ScopedObject o(scope);
+    if (shape.predicted) {
+        o = engine->newObject(shape.predicted, engine->objectPrototype());
+    } else {
+        o = engine->newObject();
+        objectClass = o->internalClass();
+    }
 
     QChar token = nextToken();
     while (token == Quote) {
-        if (!parseMember(o))
+        if (!parseMember(o, &shape))
             return Encode::undefined();
         token = nextToken();
         if (token != ValueSeparator)
@@ -234,6 +255,11 @@ ReturnedValue JsonParser::parseObject()
         return Encode::undefined();
     }
 
+    if (shape.predicted)
+        leaveShape(o, &shape);
+    if (nestingLevel < MaxShapeNestingLevel)
+        lastObjectClass[nestingLevel] = o->internalClass();
+
     END;
 
     --nestingLevel;
@@ -243,14 +269,39 @@ ReturnedValue JsonParser::parseObject()
 /*
     member = string name-separator value
 */
-bool JsonParser::parseMember(Object *o)
+bool JsonParser::parseMember(Object *o, ObjectShape *shape)
 {
     BEGIN << "parseMember";
     Scope scope(engine);
 
+    const QChar *keyEnd = scanPlainString();
+    if (shape->predicted) {
+        const Identifier *predictedKey = shape->matched < shape->predicted->size
+                ? shape->predicted->nameMap.at(shape->matched) : nullptr;
+        if (keyEnd && predictedKey && predictedKey->string.length() == keyEnd - json
+                && !memcmp(predictedKey->string.constData(), json, (keyEnd - json) * sizeof(QChar))) {
+            json = keyEnd + 1;
+            if (nextToken() != NameSeparator) {
+                lastError = QJsonParseError::MissingNameSeparator;
+                return false;
+            }
+            ScopedValue val(scope);
+            if (!parseValue(val))
+                return false;
+            o->setProperty(shape->matched++, val);
+            END;
+            return true;
+        }
+        leaveShape(o, shape);
+    }
+
     QString key;
-    if (!parseString(&key))
+    if (keyEnd) {
+        key = QString(json, keyEnd - json);
+        json = keyEnd + 1;
+    } else if (!parseString(&key)) {
         return false;
+    }
     QChar token = nextToken();
     if (token != NameSeparator) {
         lastError = QJsonParseError::MissingNameSeparator;
@@ -272,6 +323,23 @@ bool JsonParser::parseMember(Object *o)
     return true;
 }
 
+/*
+    Gives up on the predicted class of \a o. The members that matched the prediction so far
+    are kept, everything else is added one by one from now on.
+*/
+void JsonParser::leaveShape(Object *o, ObjectShape *shape)
+{
+    InternalClass *predicted = shape->predicted;
+    shape->predicted = nullptr;
+    if (shape->matched == predicted->size)
+        return;
+
+    InternalClass *ic = objectClass;
+    for (uint i = 0; i < shape->matched; ++i)
+        ic = ic->addMember(predicted->nameMap.at(i), Attr_Data);
+    o->setInternalClass(ic);
+}
+
 /*
     array = begin-array [ value *( value-separator value ) ] end-array
 */
@@ -470,24 +538,38 @@ bool JsonParser::parseNumber(Value *val)
             ++json;
     }
 
-    QString number(start, json - start);
-    DEBUG << "numberstring" << number;
+    const int length = json - start;
+    DEBUG << "numberstring" << QString(start, length);
 
     if (isInt) {
-        bool ok;
-        int n = number.toInt(&ok);
-        if (ok && n < (1<<25) && n > -(1<<25)) {
-            *val = Primitive::fromInt32(n);
-            END;
-            return true;
+        // At most 9 digits always fit into an int. -0 has to be a double.
+        const QChar *digit = start;
+        const bool negative = (*digit == '-');
+        if (negative)
+            ++digit;
+        if (digit < json && json - digit <= 9) {
+            int n = 0;
+            for (; digit < json; ++digit)
+                n = n * 10 + (digit->unicode() - '0');
+            if (n || !negative) {
+                *val = Primitive::fromInt32(negative ? -n : n);
+                END;
+                return true;
+            }
         }
     }
 
+    // The grammar above only let ASCII characters through.
+    QVarLengthArray<char, 64> number(length + 1);
+    for (int i = 0; i < length; ++i)
+        number[i] = char(start[i].unicode());
+    number[length] = '\0';
+
     bool ok;
-    double d;
-    d = number.toDouble(&ok);
+    const char *processed = nullptr;
+    double d = qstrtod(number.constData(), &processed, &ok);
 
-    if (!ok) {
+    if (!ok || !length || processed - number.constData() != length) {
         lastError = QJsonParseError::IllegalNumber;
         return false;
     }
@@ -578,14 +660,40 @@ static inline bool scanEscapeSequence(const QChar *&json, const QChar *end, uint
 }
 
 
+/*
+    Returns the position of the quote that ends the string at the current position, or nullptr
+    if the string contains escape sequences or is invalid.
+*/
+const QChar *JsonParser::scanPlainString() const
+{
+    for (const QChar *c = json; c < end; ++c) {
+        const ushort ch = c->unicode();
+        if (ch == Quote)
+            return c;
+        if (ch == '\\' || ch <= 0x1f)
+            return nullptr;
+    }
+    return nullptr;
+}
+
 bool JsonParser::parseString(QString *string)
 {
     BEGIN << "parse string stringPos=" << json;
 
+    if (const QChar *stringEnd = scanPlainString()) {
+        string->append(json, stringEnd - json);
+        json = stringEnd + 1;
+        END;
+        return true;
+    }
+
+    // Copy the text between escape sequences in one go.
+    const QChar *run = json;
     while (json < end) {
         if (*json == '"')
             break;
         else if (*json == '\\') {
+            string->append(run, json - run);
             uint ch = 0;
             if (!scanEscapeSequence(json, end, &ch)) {
                 lastError = QJsonParseError::IllegalEscapeSequence;
@@ -596,15 +704,16 @@ bool JsonParser::parseString(QString *string)
             } else {
                 *string += QChar(ch);
             }
+            run = json;
         } else {
             if (json->unicode() <= 0x1f) {
                 lastError = QJsonParseError::IllegalEscapeSequence;
                 return false;
             }
-            *string += *json;
             ++json;
         }
     }
+    string->append(run, json - run);
     ++json;
 
     if (json > end) {
@@ -619,13 +728,26 @@ bool JsonParser::parseString(QString *string)
 
 struct Stringify
 {
+    // The key of the value being serialized. Array elements only format their index when
+    // toJSON() or the replacer function needs it.
+    struct Key {
+        Key(const QString &name) : name(&name), index(0) {}
+        Key(uint index) : name(nullptr), index(index) {}
+        QString toQString() const { return name ? *name : QString::number(index); }
+
+        const QString *name;
+        uint index;
+    };
+
     ExecutionEngine *v4;
     FunctionObject *replacerFunction;
     QV4::String *propertyList;
     int propertyListSize;
+    QV4::String *toJSON;
     QString gap;
     QString indent;
     QStack<Object *> stack;
+    StringBuilder result;
 
     bool stackContains(Object *o) {
         for (int i = 0; i < stack.size(); ++i)
@@ -634,73 +756,121 @@ struct Stringify
         return false;
     }
 
-    Stringify(ExecutionEngine *e) : v4(e), replacerFunction(nullptr), propertyList(nullptr), propertyListSize(0) {}
+    Stringify(ExecutionEngine *e, QV4::String *toJSON)
+        : v4(e), replacerFunction(nullptr), propertyList(nullptr), propertyListSize(0), toJSON(toJSON) {}
 
-    QString Str(const QString &key, const Value &v);
-    QString JA(Object *a);
-    QString JO(Object *o);
+    // Each of these appends to result, and returns false if the value is not serialized at all.
+    bool Str(const Key &key, const Value &v);
+    bool JA(Object *a);
+    bool JO(Object *o);
+    bool JOPlain(Object *o, int *count);
 
-    QString makeMember(const QString &key, const Value &v);
+    bool makeMember(const QString &key, const Value &v, int *count);
+    void beginPartial(int count);
+    void quote(const QString &str);
 };
 
-static QString quote(const QString &str)
+/*
+    Returns the index of the first character at or after \a from that has to be escaped in a
+    JSON string, or \a length if there is none.
+*/
+static int findEscapedCharacter(const ushort *s, int from, int length)
+{
+    int i = from;
+#if defined(__SSE2__)
+    const __m128i controlBits = _mm_set1_epi16(short(0xffe0));
+    const __m128i quote = _mm_set1_epi16('"');
+    const __m128i backslash = _mm_set1_epi16('\\');
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= length; i += 8) {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        const __m128i escaped = _mm_or_si128(_mm_cmpeq_epi16(_mm_and_si128(data, controlBits), zero),
+                                             _mm_or_si128(_mm_cmpeq_epi16(data, quote),
+                                                          _mm_cmpeq_epi16(data, backslash)));
+        const uint mask = uint(_mm_movemask_epi8(escaped));
+        if (mask)
+            return i + qCountTrailingZeroBits(mask) / 2;
+    }
+#elif defined(__ARM_NEON__) && defined(Q_PROCESSOR_ARM_64)
+    const uint16x8_t controlLimit = vdupq_n_u16(0x20);
+    const uint16x8_t quote = vdupq_n_u16('"');
+    const uint16x8_t backslash = vdupq_n_u16('\\');
+    for (; i + 8 <= length; i += 8) {
+        const uint16x8_t data = vld1q_u16(s + i);
+        const uint16x8_t escaped = vorrq_u16(vcltq_u16(data, controlLimit),
+                                             vorrq_u16(vceqq_u16(data, quote), vceqq_u16(data, backslash)));
+        if (vmaxvq_u16(escaped))
+            break; // the scalar loop finds the exact position
+    }
+#endif
+    for (; i < length; ++i) {
+        const ushort c = s[i];
+        if (c < 0x20 || c == '"' || c == '\\')
+            return i;
+    }
+    return length;
+}
+
+void Stringify::quote(const QString &str)
 {
-    QString product;
+    const ushort *s = reinterpret_cast<const ushort *>(str.constData());
     const int length = str.length();
-    product.reserve(length + 2);
-    product += QLatin1Char('"');
-    for (int i = 0; i < length; ++i) {
-        QChar c = str.at(i);
-        switch (c.unicode()) {
+
+    result.append(QLatin1Char('"'));
+    int run = 0;
+    while (true) {
+        // Copy everything up to the next character that needs escaping in one go.
+        const int i = findEscapedCharacter(s, run, length);
+        result.append(str.constData() + run, i - run);
+        if (i == length)
+            break;
+
+        const ushort c = s[i];
+        switch (c) {
         case '"':
-            product += QLatin1String("\\\"");
+            result.append(QLatin1String("\\\""));
             break;
         case '\\':
-            product += QLatin1String("\\\\");
+            result.append(QLatin1String("\\\\"));
             break;
         case '\b':
-            product += QLatin1String("\\b");
+            result.append(QLatin1String("\\b"));
             break;
         case '\f':
-            product += QLatin1String("\\f");
+            result.append(QLatin1String("\\f"));
             break;
         case '\n':
-            product += QLatin1String("\\n");
+            result.append(QLatin1String("\\n"));
             break;
         case '\r':
-            product += QLatin1String("\\r");
+            result.append(QLatin1String("\\r"));
             break;
         case '\t':
-            product += QLatin1String("\\t");
+            result.append(QLatin1String("\\t"));
             break;
         default:
-            if (c.unicode() <= 0x1f) {
-                product += QLatin1String("\\u00");
-                product += (c.unicode() > 0xf ? QLatin1Char('1') : QLatin1Char('0')) +
-                        QLatin1Char("0123456789abcdef"[c.unicode() & 0xf]);
-            } else {
-                product += c;
-            }
+            result.append(QLatin1String("\\u00"));
+            result.append(c > 0xf ? QLatin1Char('1') : QLatin1Char('0'));
+            result.append(QLatin1Char("0123456789abcdef"[c & 0xf]));
         }
+        run = i + 1;
     }
-    product += QLatin1Char('"');
-    return product;
+    result.append(QLatin1Char('"'));
 }
 
-QString Stringify::Str(const QString &key, const Value &v)
+bool Stringify::Str(const Key &key, const Value &v)
 {
     Scope scope(v4);
 
     ScopedValue value(scope, v);
     ScopedObject o(scope, value);
     if (o) {
-        ScopedString s(scope, v4->newString(QStringLiteral("toJSON")));
-        ScopedFunctionObject toJSON(scope, o->get(s));
-        if (!!toJSON) {
+        ScopedFunctionObject toJSONFunction(scope, o->get(toJSON));
+        if (!!toJSONFunction) {
             JSCallData jsCallData(scope, 1);
             *jsCallData->thisObject = value;
-            jsCallData->args[0] = v4->newString(key);
-            value = toJSON->call(jsCallData);
+            jsCallData->args[0] = v4->newString(key.toQString());
+            value = toJSONFunction->call(jsCallData);
         }
     }
 
@@ -708,7 +878,7 @@ QString Stringify::Str(const QString &key, const Value &v)
         ScopedObject holder(scope, v4->newObject());
         holder->put(scope.engine->id_empty(), value);
         JSCallData jsCallData(scope, 2);
-        jsCallData->args[0] = v4->newString(key);
+        jsCallData->args[0] = v4->newString(key.toQString());
         jsCallData->args[1] = value;
         *jsCallData->thisObject = holder;
         value = replacerFunction->call(jsCallData);
@@ -724,20 +894,31 @@ QString Stringify::Str(const QString &key, const Value &v)
             value = Encode(b->value());
     }
 
-    if (value->isNull())
-        return QStringLiteral("null");
-    if (value->isBoolean())
-        return value->booleanValue() ? QStringLiteral("true") : QStringLiteral("false");
-    if (value->isString())
-        return quote(value->stringValue()->toQString());
+    if (value->isNull()) {
+        result.append(QLatin1String("null"));
+        return true;
+    }
+    if (value->isBoolean()) {
+        result.append(value->booleanValue() ? QLatin1String("true") : QLatin1String("false"));
+        return true;
+    }
+    if (value->isString()) {
+        quote(value->stringValue()->toQString());
+        return true;
+    }
 
     if (value->isNumber()) {
-        double d = value->toNumber();
-        return std::isfinite(d) ? value->toQString() : QStringLiteral("null");
+        if (value->isInteger() || std::isfinite(value->doubleValue()))
+            result.append(*value);
+        else
+            result.append(QLatin1String("null"));
+        return true;
     }
 
     if (const QV4::VariantObject *v = value->as<QV4::VariantObject>()) {
-        return v->d()->data().toString();
+        const QString string = v->d()->data().toString();
+        result.append(string);
+        return !string.isEmpty();
     }
 
     o = value->asReturnedValue();
@@ -751,54 +932,106 @@ QString Stringify::Str(const QString &key, const Value &v)
         }
     }
 
-    return QString();
+    return false;
 }
 
-QString Stringify::makeMember(const QString &key, const Value &v)
+// Starts the next member of an object or array, after the opening bracket or another member.
+void Stringify::beginPartial(int count)
 {
-    QString strP = Str(key, v);
-    if (!strP.isEmpty()) {
-        QString member = quote(key) + QLatin1Char(':');
-        if (!gap.isEmpty())
-            member += QLatin1Char(' ');
-        member += strP;
-        return member;
+    if (count)
+        result.append(QLatin1Char(','));
+    if (!gap.isEmpty()) {
+        result.append(QLatin1Char('\n'));
+        result.append(indent);
+    }
+}
+
+bool Stringify::makeMember(const QString &key, const Value &v, int *count)
+{
+    // The key is written before the value is known, and dropped again if there is none.
+    const int start = result.length();
+    beginPartial(*count);
+    quote(key);
+    result.append(QLatin1Char(':'));
+    if (!gap.isEmpty())
+        result.append(QLatin1Char(' '));
+    if (!Str(key, v)) {
+        result.truncate(start);
+        return false;
+    }
+    ++*count;
+    return true;
+}
+
+/*
+    Serializes the members of a plain object with data properties only straight from its
+    internal class, without iterating it. Returns false, without appending anything, if
+    the object is not that simple.
+*/
+bool Stringify::JOPlain(Object *o, int *count)
+{
+    if (o->d()->vtable() != QV4::Object::staticVTable() || o->arrayData())
+        return false;
+
+    InternalClass *ic = o->internalClass();
+    for (uint i = 0; i < ic->size; ++i) {
+        if (ic->propertyData.at(i).isAccessor())
+            return false;
     }
-    return QString();
+
+    // The keys are taken up front. toJSON() or the replacer could change the object while
+    // it is serialized, then the values are looked up by name.
+    Scope scope(v4);
+    ScopedString name(scope);
+    ScopedValue value(scope);
+    for (uint i = 0; i < ic->size; ++i) {
+        Identifier *id = ic->nameMap.at(i);
+        if (!id || !ic->propertyData.at(i).isEnumerable())
+            continue;
+        if (o->internalClass() == ic) {
+            value = *o->propertyData(i);
+        } else {
+            name = v4->newIdentifier(id->string);
+            value = o->get(name);
+        }
+        makeMember(id->string, value, count);
+        if (v4->hasException)
+            break;
+    }
+    return true;
 }
 
-QString Stringify::JO(Object *o)
+bool Stringify::JO(Object *o)
 {
     if (stackContains(o)) {
         v4->throwTypeError();
-        return QString();
+        return false;
     }
 
     Scope scope(v4);
 
-    QString result;
+    result.append(QLatin1Char('{'));
+    int count = 0;
     stack.push(o);
     QString stepback = indent;
     indent += gap;
 
-    QStringList partial;
     if (!propertyListSize) {
-        ObjectIterator it(scope, o, ObjectIterator::EnumerableOnly);
-        ScopedValue name(scope);
+        if (!JOPlain(o, &count)) {
+            ObjectIterator it(scope, o, ObjectIterator::EnumerableOnly);
+            ScopedValue name(scope);
 
-        ScopedValue val(scope);
-        while (1) {
-            name = it.nextPropertyNameAsString(val);
-            if (name->isNull())
-                break;
-            QString key = name->toQString();
-            QString member = makeMember(key, val);
-            if (!member.isEmpty())
-                partial += member;
+            ScopedValue val(scope);
+            while (!v4->hasException) {
+                name = it.nextPropertyNameAsString(val);
+                if (name->isNull())
+                    break;
+                makeMember(name->toQString(), val, &count);
+            }
         }
     } else {
         ScopedValue v(scope);
-        for (int i = 0; i < propertyListSize; ++i) {
+        for (int i = 0; i < propertyListSize && !v4->hasException; ++i) {
             bool exists;
             String *s = propertyList + i;
             if (!s)
@@ -806,70 +1039,55 @@ QString Stringify::JO(Object *o)
             v = o->get(s, &exists);
             if (!exists)
                 continue;
-            QString member = makeMember(s->toQString(), v);
-            if (!member.isEmpty())
-                partial += member;
+            makeMember(s->toQString(), v, &count);
         }
     }
 
-    if (partial.isEmpty()) {
-        result = QStringLiteral("{}");
-    } else if (gap.isEmpty()) {
-        result = QLatin1Char('{') + partial.join(QLatin1Char(',')) + QLatin1Char('}');
-    } else {
-        QString separator = QLatin1String(",\n") + indent;
-        result = QLatin1String("{\n") + indent + partial.join(separator) + QLatin1Char('\n')
-                 + stepback + QLatin1Char('}');
+    if (count && !gap.isEmpty()) {
+        result.append(QLatin1Char('\n'));
+        result.append(stepback);
     }
+    result.append(QLatin1Char('}'));
 
     indent = stepback;
     stack.pop();
-    return result;
+    return true;
 }
 
-QString Stringify::JA(Object *a)
+bool Stringify::JA(Object *a)
 {
     if (stackContains(a)) {
         v4->throwTypeError();
-        return QString();
+        return false;
     }
 
     Scope scope(a->engine());
 
-    QString result;
+    result.append(QLatin1Char('['));
+    int count = 0;
     stack.push(a);
     QString stepback = indent;
     indent += gap;
 
-    QStringList partial;
     uint len = a->getLength();
     ScopedValue v(scope);
-    for (uint i = 0; i < len; ++i) {
+    for (uint i = 0; i < len && !v4->hasException; ++i) {
+        beginPartial(count++);
         bool exists;
         v = a->getIndexed(i, &exists);
-        if (!exists) {
-            partial += QStringLiteral("null");
-            continue;
-        }
-        QString strP = Str(QString::number(i), v);
-        if (!strP.isEmpty())
-            partial += strP;
-        else
-            partial += QStringLiteral("null");
+        if (!exists || !Str(i, v))
+            result.append(QLatin1String("null"));
     }
 
-    if (partial.isEmpty()) {
-        result = QStringLiteral("[]");
-    } else if (gap.isEmpty()) {
-        result = QLatin1Char('[') + partial.join(QLatin1Char(',')) + QLatin1Char(']');
-    } else {
-        QString separator = QLatin1String(",\n") + indent;
-        result = QLatin1String("[\n") + indent + partial.join(separator) + QLatin1Char('\n') + stepback + QLatin1Char(']');
+    if (count && !gap.isEmpty()) {
+        result.append(QLatin1Char('\n'));
+        result.append(stepback);
     }
+    result.append(QLatin1Char(']'));
 
     indent = stepback;
     stack.pop();
-    return result;
+    return true;
 }
 
 
@@ -906,7 +1124,8 @@ ReturnedValue JsonObject::method_parse(const FunctionObject *b, const Value *, c
 ReturnedValue JsonObject::method_stringify(const FunctionObject *b, const Value *, const Value *argv, int argc)
 {
     Scope scope(b);
-    Stringify stringify(scope.engine);
+    ScopedString toJSON(scope, scope.engine->newIdentifier(QStringLiteral("toJSON")));
+    Stringify stringify(scope.engine, toJSON);
 
     ScopedObject o(scope, argc > 1 ? argv[1] : Primitive::undefinedValue());
     if (o) {
@@ -947,10 +1166,9 @@ ReturnedValue JsonObject::method_stringify(const FunctionObject *b, const Value
 
 
     ScopedValue arg0(scope, argc ? argv[0] : Primitive::undefinedValue());
-    QString result = stringify.Str(QString(), arg0);
-    if (result.isEmpty() || scope.engine->hasException)
+    if (!stringify.Str(QString(), arg0) || scope.engine->hasException)
         RETURN_UNDEFINED();
-    return Encode(scope.engine->newString(result));
+    return Encode(stringify.result.toString(scope.engine));
 }
 
 
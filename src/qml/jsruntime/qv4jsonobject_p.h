@@ -120,13 +120,21 @@ private:
     inline bool eatSpace();
     inline QChar nextToken();
 
+    struct ObjectShape {
+        InternalClass *predicted;
+        uint matched;
+    };
+
     ReturnedValue parseObject();
     ReturnedValue parseArray();
-    bool parseMember(Object *o);
+    bool parseMember(Object *o, ObjectShape *shape);
     bool parseString(QString *string);
     bool parseValue(Value *val);
     bool parseNumber(Value *val);
 
+    const QChar *scanPlainString() const;
+    void leaveShape(Object *o, ObjectShape *shape);
+
     ExecutionEngine *engine;
     const QChar *head;
     const QChar *json;
@@ -134,6 +142,13 @@ private:
 
     int nestingLevel;
     QJsonParseError::ParseError lastError;
+
+    // The class of the last object parsed at each nesting level. Records in an array
+    // usually have the same keys in the same order, so the next object is predicted to
+    // end up with that class as well.
+    enum { MaxShapeNestingLevel = 16 };
+    InternalClass *objectClass;
+    InternalClass *lastObjectClass[MaxShapeNestingLevel];
 };
 
 }
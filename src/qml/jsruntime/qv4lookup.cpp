@@ -40,12 +40,55 @@
 #include "qv4functionobject_p.h"
 #include "qv4jscall_p.h"
 #include "qv4string_p.h"
+#include "qv4qobjectwrapper_p.h"
 #include <private/qv4identifiertable_p.h>
 
 QT_BEGIN_NAMESPACE
 
 using namespace QV4;
 
+static Lookup::PolymorphicCache *newPolymorphicCache()
+{
+    Lookup::PolymorphicCache *cache = new Lookup::PolymorphicCache;
+    memset(cache, 0, sizeof(Lookup::PolymorphicCache));
+    return cache;
+}
+
+static void addPolymorphicEntry(Lookup::PolymorphicCache *cache, Lookup::PolymorphicCache::EntryType type,
+                                InternalClass *ic, int offset, const Value *data = nullptr,
+                                int icIdentifier = 0)
+{
+    Q_ASSERT(cache->nEntries < Lookup::PolymorphicCache::Size);
+    Lookup::PolymorphicCache::Entry &e = cache->entries[cache->nEntries++];
+    e.type = type;
+    e.ic = ic;
+    e.offset = offset;
+    e.data = data;
+    e.icIdentifier = icIdentifier;
+}
+
+Lookup::PolymorphicCache *Lookup::polymorphicCache() const
+{
+    if (getter == getterPolymorphic || setter == setterPolymorphic)
+        return polymorphicLookup.cache;
+    return nullptr;
+}
+
+void Lookup::releasePolymorphicCache()
+{
+    delete polymorphicCache();
+    polymorphicLookup.cache = nullptr;
+}
+
+void Lookup::releasePropertyCache()
+{
+    if (getter != QObjectWrapper::lookupGetter)
+        return;
+    if (qobjectLookup.propertyCache)
+        qobjectLookup.propertyCache->release();
+    qobjectLookup.propertyCache = nullptr;
+}
+
 
 void Lookup::resolveProtoGetter(Identifier *name, const Heap::Object *proto)
 {
@@ -158,8 +201,11 @@ ReturnedValue Lookup::resolveGlobalGetter(ExecutionEngine *engine)
 
 ReturnedValue Lookup::getterGeneric(Lookup *l, ExecutionEngine *engine, const Value &object)
 {
-    if (const Object *o = object.as<Object>())
+    if (const Object *o = object.as<Object>()) {
+        if (const QObjectWrapper *wrapper = o->as<QObjectWrapper>())
+            return QObjectWrapper::resolveLookupGetter(wrapper, engine, l);
         return l->resolveGetter(engine, o);
+    }
     return l->resolvePrimitiveGetter(engine, object);
 }
 
@@ -267,8 +313,12 @@ ReturnedValue Lookup::getter0Inlinegetter0Inline(Lookup *l, ExecutionEngine *eng
         if (l->objectLookupTwoClasses.ic2 == o->internalClass)
             return o->inlinePropertyDataWithOffset(l->objectLookupTwoClasses.offset2)->asReturnedValue();
     }
-    l->getter = getterFallback;
-    return getterFallback(l, engine, object);
+    PolymorphicCache *cache = newPolymorphicCache();
+    addPolymorphicEntry(cache, PolymorphicCache::InlineProperty, l->objectLookupTwoClasses.ic, l->objectLookupTwoClasses.offset);
+    addPolymorphicEntry(cache, PolymorphicCache::InlineProperty, l->objectLookupTwoClasses.ic2, l->objectLookupTwoClasses.offset2);
+    l->polymorphicLookup.cache = cache;
+    l->getter = getterPolymorphic;
+    return getterPolymorphic(l, engine, object);
 }
 
 ReturnedValue Lookup::getter0Inlinegetter0MemberData(Lookup *l, ExecutionEngine *engine, const Value &object)
@@ -282,8 +332,12 @@ ReturnedValue Lookup::getter0Inlinegetter0MemberData(Lookup *l, ExecutionEngine
         if (l->objectLookupTwoClasses.ic2 == o->internalClass)
             return o->memberData->values.data()[l->objectLookupTwoClasses.offset2].asReturnedValue();
     }
-    l->getter = getterFallback;
-    return getterFallback(l, engine, object);
+    PolymorphicCache *cache = newPolymorphicCache();
+    addPolymorphicEntry(cache, PolymorphicCache::InlineProperty, l->objectLookupTwoClasses.ic, l->objectLookupTwoClasses.offset);
+    addPolymorphicEntry(cache, PolymorphicCache::MemberDataProperty, l->objectLookupTwoClasses.ic2, l->objectLookupTwoClasses.offset2);
+    l->polymorphicLookup.cache = cache;
+    l->getter = getterPolymorphic;
+    return getterPolymorphic(l, engine, object);
 }
 
 ReturnedValue Lookup::getter0MemberDatagetter0MemberData(Lookup *l, ExecutionEngine *engine, const Value &object)
@@ -297,8 +351,12 @@ ReturnedValue Lookup::getter0MemberDatagetter0MemberData(Lookup *l, ExecutionEng
         if (l->objectLookupTwoClasses.ic2 == o->internalClass)
             return o->memberData->values.data()[l->objectLookupTwoClasses.offset2].asReturnedValue();
     }
-    l->getter = getterFallback;
-    return getterFallback(l, engine, object);
+    PolymorphicCache *cache = newPolymorphicCache();
+    addPolymorphicEntry(cache, PolymorphicCache::MemberDataProperty, l->objectLookupTwoClasses.ic, l->objectLookupTwoClasses.offset);
+    addPolymorphicEntry(cache, PolymorphicCache::MemberDataProperty, l->objectLookupTwoClasses.ic2, l->objectLookupTwoClasses.offset2);
+    l->polymorphicLookup.cache = cache;
+    l->getter = getterPolymorphic;
+    return getterPolymorphic(l, engine, object);
 }
 
 ReturnedValue Lookup::getterProtoTwoClasses(Lookup *l, ExecutionEngine *engine, const Value &object)
@@ -311,10 +369,72 @@ ReturnedValue Lookup::getterProtoTwoClasses(Lookup *l, ExecutionEngine *engine,
             return l->protoLookupTwoClasses.data->asReturnedValue();
         if (l->protoLookupTwoClasses.icIdentifier2 == o->internalClass->id)
             return l->protoLookupTwoClasses.data2->asReturnedValue();
+    }
+    PolymorphicCache *cache = newPolymorphicCache();
+    addPolymorphicEntry(cache, PolymorphicCache::ProtoProperty, nullptr, 0, l->protoLookupTwoClasses.data, l->protoLookupTwoClasses.icIdentifier);
+    addPolymorphicEntry(cache, PolymorphicCache::ProtoProperty, nullptr, 0, l->protoLookupTwoClasses.data2, l->protoLookupTwoClasses.icIdentifier2);
+    l->polymorphicLookup.cache = cache;
+    l->getter = getterPolymorphic;
+    return getterPolymorphic(l, engine, object);
+}
+
+ReturnedValue Lookup::getterPolymorphic(Lookup *l, ExecutionEngine *engine, const Value &object)
+{
+    PolymorphicCache *cache = l->polymorphicLookup.cache;
+    // we can safely cast to a QV4::Object here. If object is actually a string,
+    // the internal class won't match
+    Heap::Object *o = static_cast<Heap::Object *>(object.heapObject());
+    if (o) {
+        for (uint i = 0; i < cache->nEntries; ++i) {
+            const PolymorphicCache::Entry &e = cache->entries[i];
+            switch (e.type) {
+            case PolymorphicCache::InlineProperty:
+                if (e.ic == o->internalClass) {
+                    ++cache->hits;
+                    return o->inlinePropertyDataWithOffset(e.offset)->asReturnedValue();
+                }
+                break;
+            case PolymorphicCache::MemberDataProperty:
+                if (e.ic == o->internalClass) {
+                    ++cache->hits;
+                    return o->memberData->values.data()[e.offset].asReturnedValue();
+                }
+                break;
+            case PolymorphicCache::ProtoProperty:
+                if (e.icIdentifier == o->internalClass->id) {
+                    ++cache->hits;
+                    return e.data->asReturnedValue();
+                }
+                break;
+            default:
+                Q_UNREACHABLE();
+            }
+        }
+    }
+
+    ++cache->misses;
+    const Object *obj = object.as<Object>();
+    if (!obj)
+        return getterFallback(l, engine, object);
+
+    if (cache->nEntries == PolymorphicCache::Size) {
+        // megamorphic, give up on the cache once it misses more often than it hits
+        if (cache->misses > cache->hits) {
+            l->releasePolymorphicCache();
+            l->getter = getterFallback;
+        }
         return getterFallback(l, engine, object);
     }
-    l->getter = getterFallback;
-    return getterFallback(l, engine, object);
+
+    Lookup resolved = *l;
+    ReturnedValue result = resolved.resolveGetter(engine, obj);
+    if (resolved.getter == getter0Inline)
+        addPolymorphicEntry(cache, PolymorphicCache::InlineProperty, resolved.objectLookup.ic, resolved.objectLookup.offset);
+    else if (resolved.getter == getter0MemberData)
+        addPolymorphicEntry(cache, PolymorphicCache::MemberDataProperty, resolved.objectLookup.ic, resolved.objectLookup.offset);
+    else if (resolved.getter == getterProto)
+        addPolymorphicEntry(cache, PolymorphicCache::ProtoProperty, nullptr, 0, resolved.protoLookup.data, resolved.protoLookup.icIdentifier);
+    return result;
 }
 
 ReturnedValue Lookup::getterAccessor(Lookup *l, ExecutionEngine *engine, const Value &object)
@@ -501,12 +621,12 @@ bool Lookup::setterTwoClasses(Lookup *l, ExecutionEngine *engine, Value &object,
     Lookup second = *l;
 
     if (object.isObject()) {
-        if (!l->resolveSetter(engine, static_cast<Object *>(&object), value)) {
+        if (!second.resolveSetter(engine, static_cast<Object *>(&object), value)) {
             l->setter = setterFallback;
             return false;
         }
 
-        if (l->setter == Lookup::setter0 || l->setter == Lookup::setter0Inline) {
+        if (second.setter == Lookup::setter0 || second.setter == Lookup::setter0Inline) {
             l->objectLookupTwoClasses.ic = first.objectLookup.ic;
             l->objectLookupTwoClasses.ic2 = second.objectLookup.ic;
             l->objectLookupTwoClasses.offset = first.objectLookup.offset;
@@ -514,6 +634,10 @@ bool Lookup::setterTwoClasses(Lookup *l, ExecutionEngine *engine, Value &object,
             l->setter = setter0setter0;
             return true;
         }
+
+        // the value has been stored while resolving
+        l->setter = setterFallback;
+        return true;
     }
 
     l->setter = setterFallback;
@@ -567,8 +691,49 @@ bool Lookup::setter0setter0(Lookup *l, ExecutionEngine *engine, Value &object, c
         }
     }
 
-    l->setter = setterFallback;
-    return setterFallback(l, engine, object, value);
+    PolymorphicCache *cache = newPolymorphicCache();
+    addPolymorphicEntry(cache, PolymorphicCache::WritableProperty, l->objectLookupTwoClasses.ic, l->objectLookupTwoClasses.offset);
+    addPolymorphicEntry(cache, PolymorphicCache::WritableProperty, l->objectLookupTwoClasses.ic2, l->objectLookupTwoClasses.offset2);
+    l->polymorphicLookup.cache = cache;
+    l->setter = setterPolymorphic;
+    return setterPolymorphic(l, engine, object, value);
+}
+
+bool Lookup::setterPolymorphic(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value)
+{
+    PolymorphicCache *cache = l->polymorphicLookup.cache;
+    Heap::Object *o = static_cast<Heap::Object *>(object.heapObject());
+    if (o) {
+        for (uint i = 0; i < cache->nEntries; ++i) {
+            const PolymorphicCache::Entry &e = cache->entries[i];
+            Q_ASSERT(e.type == PolymorphicCache::WritableProperty);
+            if (e.ic == o->internalClass) {
+                ++cache->hits;
+                o->setProperty(engine, e.offset, value);
+                return true;
+            }
+        }
+    }
+
+    ++cache->misses;
+    if (!object.isObject())
+        return setterFallback(l, engine, object, value);
+
+    if (cache->nEntries == PolymorphicCache::Size) {
+        // megamorphic, give up on the cache once it misses more often than it hits
+        if (cache->misses > cache->hits) {
+            l->releasePolymorphicCache();
+            l->setter = setterFallback;
+        }
+        return setterFallback(l, engine, object, value);
+    }
+
+    Lookup resolved = *l;
+    if (!resolved.resolveSetter(engine, static_cast<Object *>(&object), value))
+        return false;
+    if (resolved.setter == setter0 || resolved.setter == setter0Inline)
+        addPolymorphicEntry(cache, PolymorphicCache::WritableProperty, resolved.objectLookup.ic, resolved.objectLookup.offset);
+    return true;
 }
 
 bool Lookup::setterInsert(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value)
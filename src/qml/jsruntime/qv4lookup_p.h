@@ -62,10 +62,36 @@
 
 QT_BEGIN_NAMESPACE
 
+class QQmlPropertyCache;
+class QQmlPropertyData;
+
 namespace QV4 {
 
 struct Lookup {
     enum { Size = 4 };
+
+    // Out of line cache for access sites that have seen more than two internal classes.
+    struct PolymorphicCache {
+        enum { Size = 8 };
+        enum EntryType {
+            InlineProperty,
+            MemberDataProperty,
+            ProtoProperty,
+            WritableProperty
+        };
+        struct Entry {
+            InternalClass *ic;
+            const Value *data;
+            int icIdentifier;
+            int offset;
+            EntryType type;
+        };
+        Entry entries[Size];
+        uint nEntries;
+        uint hits;
+        uint misses;
+    };
+
     union {
         ReturnedValue (*getter)(Lookup *l, ExecutionEngine *engine, const Value &object);
         ReturnedValue (*globalGetter)(Lookup *l, ExecutionEngine *engine);
@@ -104,8 +130,23 @@ struct Lookup {
             int icIdentifier;
             int offset;
         } insertionLookup;
+        struct {
+            PolymorphicCache *cache;
+        } polymorphicLookup;
+        struct {
+            // The property cache is referenced, so the property data stays valid.
+            InternalClass *ic;
+            QQmlPropertyCache *propertyCache;
+            QQmlPropertyData *propertyData;
+        } qobjectLookup;
     };
     uint nameIndex;
+    // how often a QObject property lookup had to be resolved again, see QObjectWrapper::lookupGetter()
+    uint propertyCacheMisses;
+
+    PolymorphicCache *polymorphicCache() const;
+    void releasePolymorphicCache();
+    void releasePropertyCache();
 
     ReturnedValue resolveGetter(ExecutionEngine *engine, const Object *object);
     ReturnedValue resolvePrimitiveGetter(ExecutionEngine *engine, const Value &object);
@@ -115,6 +156,7 @@ struct Lookup {
     static ReturnedValue getterGeneric(Lookup *l, ExecutionEngine *engine, const Value &object);
     static ReturnedValue getterTwoClasses(Lookup *l, ExecutionEngine *engine, const Value &object);
     static ReturnedValue getterFallback(Lookup *l, ExecutionEngine *engine, const Value &object);
+    static ReturnedValue getterPolymorphic(Lookup *l, ExecutionEngine *engine, const Value &object);
 
     static ReturnedValue getter0MemberData(Lookup *l, ExecutionEngine *engine, const Value &object);
     static ReturnedValue getter0Inline(Lookup *l, ExecutionEngine *engine, const Value &object);
@@ -139,6 +181,7 @@ struct Lookup {
     static bool setterGeneric(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value);
     static bool setterTwoClasses(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value);
     static bool setterFallback(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value);
+    static bool setterPolymorphic(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value);
     static bool setter0(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value);
     static bool setter0Inline(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value);
     static bool setter0setter0(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value);
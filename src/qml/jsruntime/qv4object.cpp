@@ -1024,8 +1024,8 @@ void Object::copyArrayData(Object *other)
             dd->values.size = other->d()->arrayData->values.size;
             dd->offset = other->d()->arrayData->offset;
         }
-        // ### need a write barrier
-        memcpy(d()->arrayData->values.values, other->d()->arrayData->values.values, other->d()->arrayData->values.alloc*sizeof(Value));
+        d()->arrayData->elementKind = other->d()->arrayData->elementKind;
+        d()->arrayData->values.copyData(engine(), 0, other->d()->arrayData->values.values, other->d()->arrayData->values.alloc);
     }
     setArrayLengthUnchecked(other->getLength());
 }
@@ -69,6 +69,7 @@ Profiler::Profiler(QV4::ExecutionEngine *engine) : featuresEnabled(0), m_engine(
     static const int metatypes[] = {
         qRegisterMetaType<QVector<QV4::Profiling::FunctionCallProperties> >(),
         qRegisterMetaType<QVector<QV4::Profiling::MemoryAllocationProperties> >(),
+        qRegisterMetaType<QVector<QV4::Profiling::GarbageCollectionProperties> >(),
         qRegisterMetaType<FunctionLocationHash>()
     };
     Q_UNUSED(metatypes);
@@ -109,9 +110,10 @@ void Profiler::reportData(bool trackLocations)
         }
     }
 
-    emit dataReady(locations, properties, m_memory_data);
+    emit dataReady(locations, properties, m_memory_data, m_gc_data);
     m_data.clear();
     m_memory_data.clear();
+    m_gc_data.clear();
 }
 
 void Profiler::startProfiling(quint64 features)
@@ -54,6 +54,7 @@
 #include "qv4global_p.h"
 #include "qv4engine_p.h"
 #include "qv4function_p.h"
+#include <private/qv4mmdefs_p.h>
 
 #include <QElapsedTimer>
 
@@ -61,6 +62,8 @@
 
 #define Q_V4_PROFILE_ALLOC(engine, size, type) (!engine)
 #define Q_V4_PROFILE_DEALLOC(engine, size, type) (!engine)
+#define Q_V4_PROFILE_GC_ENABLED(engine) (!engine)
+#define Q_V4_PROFILE_GC(engine, record) (!engine)
 
 QT_BEGIN_NAMESPACE
 
@@ -88,6 +91,13 @@ QT_END_NAMESPACE
             (engine->profiler()->featuresEnabled & (1 << Profiling::FeatureMemoryAllocation)) ?\
         engine->profiler()->trackDealloc(size, type) : false)
 
+#define Q_V4_PROFILE_GC_ENABLED(engine) \
+    (engine->profiler() &&\
+            (engine->profiler()->featuresEnabled & (1 << Profiling::FeatureMemoryAllocation)))
+
+#define Q_V4_PROFILE_GC(engine, record) \
+    (Q_V4_PROFILE_GC_ENABLED(engine) ? engine->profiler()->trackGarbageCollection(record) : false)
+
 QT_BEGIN_NAMESPACE
 
 namespace QV4 {
@@ -136,6 +146,19 @@ struct MemoryAllocationProperties {
     MemoryType type;
 };
 
+struct GarbageCollectionProperties {
+    qint64 timestamp; // when the collection finished
+    qint64 markTime;
+    qint64 sweepTime;
+    qint64 freedBytes;
+    qint64 usedBytes; // small and huge items that survived
+    qint32 hugeItems;
+    GCRecord::Type type;
+    QVector<qint64> chunkOccupancy; // see GCRecord::chunkOccupancy
+    QString freedClasses; // comma separated, in the order of freedBytesPerClass
+    QVector<qint64> freedBytesPerClass;
+};
+
 class FunctionCall {
 public:
 
@@ -247,6 +270,27 @@ public:
         }
     }
 
+    bool trackGarbageCollection(const GCRecord &record)
+    {
+        GarbageCollectionProperties collection = {
+            m_timer.nsecsElapsed(), record.markTime, record.sweepTime, qint64(record.freedBytes()),
+            qint64(record.usedAfter + record.largeItemsAfter), qint32(record.hugeItemsAfter),
+            record.type, QVector<qint64>(), QString(), QVector<qint64>()
+        };
+        collection.chunkOccupancy.reserve(GCRecord::OccupancyBuckets);
+        for (uint chunks : record.chunkOccupancy)
+            collection.chunkOccupancy.append(chunks);
+        collection.freedBytesPerClass.reserve(int(record.freedBytesPerClass.size()));
+        for (const GCRecord::FreedClass &freed : record.freedBytesPerClass) {
+            if (!collection.freedClasses.isEmpty())
+                collection.freedClasses += QLatin1Char(',');
+            collection.freedClasses += QLatin1String(freed.first);
+            collection.freedBytesPerClass.append(qint64(freed.second));
+        }
+        m_gc_data.append(collection);
+        return true;
+    }
+
     quint64 featuresEnabled;
 
     void stopProfiling();
@@ -257,13 +301,15 @@ public:
 signals:
     void dataReady(const QV4::Profiling::FunctionLocationHash &,
                    const QVector<QV4::Profiling::FunctionCallProperties> &,
-                   const QVector<QV4::Profiling::MemoryAllocationProperties> &);
+                   const QVector<QV4::Profiling::MemoryAllocationProperties> &,
+                   const QVector<QV4::Profiling::GarbageCollectionProperties> &);
 
 private:
     QV4::ExecutionEngine *m_engine;
     QElapsedTimer m_timer;
     QVector<FunctionCall> m_data;
     QVector<MemoryAllocationProperties> m_memory_data;
+    QVector<GarbageCollectionProperties> m_gc_data;
     QHash<quintptr, SentMarker> m_sentLocations;
 
     friend class FunctionCallProfiler;
@@ -302,6 +348,7 @@ public:
 } // namespace QV4
 
 Q_DECLARE_TYPEINFO(QV4::Profiling::MemoryAllocationProperties, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(QV4::Profiling::GarbageCollectionProperties, Q_MOVABLE_TYPE);
 Q_DECLARE_TYPEINFO(QV4::Profiling::FunctionCallProperties, Q_MOVABLE_TYPE);
 Q_DECLARE_TYPEINFO(QV4::Profiling::FunctionCall, Q_MOVABLE_TYPE);
 Q_DECLARE_TYPEINFO(QV4::Profiling::FunctionLocation, Q_MOVABLE_TYPE);
@@ -311,6 +358,7 @@ QT_END_NAMESPACE
 Q_DECLARE_METATYPE(QV4::Profiling::FunctionLocationHash)
 Q_DECLARE_METATYPE(QVector<QV4::Profiling::FunctionCallProperties>)
 Q_DECLARE_METATYPE(QVector<QV4::Profiling::MemoryAllocationProperties>)
+Q_DECLARE_METATYPE(QVector<QV4::Profiling::GarbageCollectionProperties>)
 
 #endif // QT_CONFIG(qml_debug)
 
@@ -63,6 +63,7 @@
 #include <private/qv4dateobject_p.h>
 #include <private/qv4scopedvalue_p.h>
 #include <private/qv4jscall_p.h>
+#include <private/qv4lookup_p.h>
 #include <private/qv4mm_p.h>
 #include <private/qqmlscriptstring_p.h>
 #include <private/qv4compileddata_p.h>
@@ -694,6 +695,62 @@ QV4::ReturnedValue QObjectWrapper::get(const Managed *m, String *name, bool *has
     return that->getQmlProperty(qmlContext, name, IgnoreRevision, hasProperty, /*includeImports*/ true);
 }
 
+ReturnedValue QObjectWrapper::resolveLookupGetter(const QObjectWrapper *object, ExecutionEngine *engine, Lookup *lookup)
+{
+    // Keep this in sync with getQmlProperty(). Only properties from the property cache are
+    // cached, methods that aren't in it, attached properties and JS properties are not.
+    if (object->vtable()->get != QObjectWrapper::get)
+        return lookup->resolveGetter(engine, object);
+
+    QObject *qobj = object->d()->object();
+    QQmlData *ddata = QQmlData::get(qobj, false);
+    if (QQmlData::wasDeleted(qobj) || !ddata || !ddata->propertyCache)
+        return Lookup::getterFallback(lookup, engine, *object);
+
+    Scope scope(engine);
+    ScopedString name(scope, engine->currentStackFrame->v4Function->compilationUnit->runtimeStrings[lookup->nameIndex]);
+    QQmlPropertyData *property = nullptr;
+    if (!name->equals(engine->id_destroy()) && !name->equals(engine->id_toString()))
+        property = ddata->propertyCache->property(name.getPointer(), qobj, engine->callingQmlContext());
+    if (!property) {
+        lookup->getter = Lookup::getterFallback;
+        return lookup->getter(lookup, engine, *object);
+    }
+
+    lookup->qobjectLookup.ic = object->internalClass();
+    lookup->qobjectLookup.propertyCache = ddata->propertyCache;
+    lookup->qobjectLookup.propertyCache->addref();
+    lookup->qobjectLookup.propertyData = property;
+    lookup->getter = lookupGetter;
+    return lookupGetter(lookup, engine, *object);
+}
+
+ReturnedValue QObjectWrapper::lookupGetter(Lookup *lookup, ExecutionEngine *engine, const Value &object)
+{
+    // we can safely cast to a QObjectWrapper here. If object is something else,
+    // the internal class won't match
+    Heap::Object *o = static_cast<Heap::Object *>(object.heapObject());
+    if (o && o->internalClass == lookup->qobjectLookup.ic) {
+        QObject *qobj = static_cast<Heap::QObjectWrapper *>(o)->object();
+        if (QQmlData::wasDeleted(qobj))
+            return QV4::Encode::undefined();
+        QQmlData *ddata = QQmlData::get(qobj, false);
+        if (ddata && ddata->propertyCache == lookup->qobjectLookup.propertyCache)
+            return getProperty(engine, qobj, lookup->qobjectLookup.propertyData);
+    }
+
+    lookup->releasePropertyCache();
+    // A site that sees objects of different types would resolve the property again and again,
+    // plain get() calls are cheaper then.
+    enum { MaxMisses = 4 };
+    if (++lookup->propertyCacheMisses >= MaxMisses) {
+        lookup->getter = Lookup::getterFallback;
+        return Lookup::getterFallback(lookup, engine, object);
+    }
+    lookup->getter = Lookup::getterGeneric;
+    return Lookup::getterGeneric(lookup, engine, object);
+}
+
 bool QObjectWrapper::put(Managed *m, String *name, const Value &value)
 {
     QObjectWrapper *that = static_cast<QObjectWrapper*>(m);
@@ -1340,6 +1397,91 @@ static int MatchScore(const QV4::Value &actual, int conversionType)
     }
 }
 
+/*
+    Returns the kind of \a actual as far as MatchScore() can tell, or 0 if the score also
+    depends on the value itself. Keep this in sync with MatchScore().
+*/
+static quint32 MatchKind(const QV4::Value &actual)
+{
+    enum { VariableKind, NumberKind, StringKind, BooleanKind, DateKind, RegExpKind,
+           ArrayBufferKind, ArrayKind, NullKind, QObjectKind, ObjectKind, OtherKind };
+
+    if (actual.isNumber())
+        return NumberKind;
+    if (actual.isString())
+        return StringKind;
+    if (actual.isBoolean())
+        return BooleanKind;
+    if (actual.as<DateObject>())
+        return DateKind;
+    if (actual.as<QV4::RegExpObject>())
+        return RegExpKind;
+    if (actual.as<ArrayBuffer>())
+        return ArrayBufferKind;
+    if (actual.as<ArrayObject>())
+        return ArrayKind;
+    if (actual.isNull())
+        return NullKind;
+    if (const QV4::Object *obj = actual.as<QV4::Object>()) {
+        if (obj->as<QV4::VariantObject>() || obj->as<QV4::QQmlValueTypeWrapper>())
+            return VariableKind;
+        if (obj->as<QObjectWrapper>())
+            return QObjectKind;
+        return ObjectKind;
+    }
+    return OtherKind;
+}
+
+/*
+    Packs the match kinds of all arguments into \a kinds, four bits each. Returns false if
+    there are too many arguments, or if the overload chosen for them can differ between
+    calls with the same kinds.
+*/
+static bool MatchKinds(QV4::CallData *callArgs, quint32 *kinds)
+{
+    const int argc = callArgs->argc();
+    if (argc > 8)
+        return false;
+
+    *kinds = 0;
+    for (int ii = 0; ii < argc; ++ii) {
+        quint32 kind = MatchKind(callArgs->args[ii]);
+        if (!kind)
+            return false;
+        *kinds |= kind << (ii * 4);
+    }
+    return true;
+}
+
+uint OverloadResolutionCache::slot(const QQmlPropertyCache *propertyCache, int methodIndex, int argc, quint32 argumentKinds)
+{
+    return (qHash(propertyCache) ^ qHash(argumentKinds) ^ uint(methodIndex * 31 + argc)) % Size;
+}
+
+/*
+    Returns the index of the overload that a call to method \a methodIndex of \a propertyCache
+    with \a argc arguments of \a argumentKinds resolved to, or -1 if that call hasn't been seen
+    or its entry got replaced by a different one.
+*/
+int OverloadResolutionCache::overload(const QQmlPropertyCache *propertyCache, int methodIndex, int argc, quint32 argumentKinds) const
+{
+    const Entry &e = entries[slot(propertyCache, methodIndex, argc, argumentKinds)];
+    if (e.propertyCache.data() == propertyCache && e.methodIndex == methodIndex && e.argc == argc
+            && e.argumentKinds == argumentKinds)
+        return e.overloadIndex;
+    return -1;
+}
+
+void OverloadResolutionCache::setOverload(const QQmlPropertyCache *propertyCache, int methodIndex, int argc, quint32 argumentKinds, int overloadIndex)
+{
+    Entry &e = entries[slot(propertyCache, methodIndex, argc, argumentKinds)];
+    e.propertyCache = const_cast<QQmlPropertyCache *>(propertyCache);
+    e.methodIndex = methodIndex;
+    e.argc = argc;
+    e.argumentKinds = argumentKinds;
+    e.overloadIndex = overloadIndex;
+}
+
 static inline int QMetaObject_methods(const QMetaObject *metaObject)
 {
     struct Private
@@ -1462,6 +1604,19 @@ static QV4::ReturnedValue CallOverloaded(const QQmlObjectOrGadget &object, const
 {
     int argumentCount = callArgs->argc();
 
+    // Look the resolution up in the engine's overload cache, which has 64 direct-mapped
+    // slots keyed by method, number of arguments and argument kinds. A colliding entry is
+    // simply replaced.
+    quint32 argumentKinds = 0;
+    const bool cacheable = propertyCache && MatchKinds(callArgs, &argumentKinds);
+    if (cacheable && engine->overloadResolutionCache) {
+        const int cached = engine->overloadResolutionCache->overload(propertyCache, data.coreIndex(), argumentCount, argumentKinds);
+        if (cached != -1) {
+            if (const QQmlPropertyData *method = propertyCache->method(cached))
+                return CallPrecise(object, *method, engine, callArgs, callType);
+        }
+    }
+
     QQmlPropertyData best;
     int bestParameterScore = INT_MAX;
     int bestMatchScore = INT_MAX;
@@ -1508,6 +1663,11 @@ static QV4::ReturnedValue CallOverloaded(const QQmlObjectOrGadget &object, const
     } while ((attempt = RelatedMethod(object, attempt, dummy, propertyCache)) != nullptr);
 
     if (best.isValid()) {
+        if (cacheable) {
+            if (!engine->overloadResolutionCache)
+                engine->overloadResolutionCache = new OverloadResolutionCache;
+            engine->overloadResolutionCache->setOverload(propertyCache, data.coreIndex(), argumentCount, argumentKinds, best.coreIndex());
+        }
         return CallPrecise(object, best, engine, callArgs, callType);
     } else {
         QString error = QLatin1String("Unable to determine callable overload.  Candidates are:");
@@ -1535,6 +1695,19 @@ CallArgument::~CallArgument()
 
 void CallArgument::cleanup()
 {
+    switch (type) {
+    case QMetaType::UnknownType:
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Bool:
+    case QMetaType::Double:
+    case QMetaType::Float:
+    case QMetaType::QObjectStar:
+        return;
+    default:
+        break;
+    }
+
     if (type == QMetaType::QString) {
         qstringPtr->~QString();
     } else if (type == QMetaType::QByteArray) {
@@ -1556,6 +1729,21 @@ void CallArgument::cleanup()
 
 void *CallArgument::dataPtr()
 {
+    switch (type) {
+    case QMetaType::UnknownType:
+        return nullptr;
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Bool:
+    case QMetaType::Double:
+    case QMetaType::Float:
+    case QMetaType::QObjectStar:
+    case QMetaType::QString:
+        return (void *)&allocData;
+    default:
+        break;
+    }
+
     if (type == -1)
         return qvariantPtr->data();
     else if (type == qMetaTypeId<std::vector<int>>())
@@ -1639,33 +1827,45 @@ void CallArgument::fromValue(int callType, QV4::ExecutionEngine *engine, const Q
         type = 0;
     }
 
-    QV4::Scope scope(engine);
-
-    bool queryEngine = false;
-    if (callType == qMetaTypeId<QJSValue>()) {
-        qjsValuePtr = new (&allocData) QJSValue(scope.engine, value.asReturnedValue());
-        type = qMetaTypeId<QJSValue>();
-    } else if (callType == QMetaType::Int) {
+    // The common argument types convert directly, without looking at any registered types.
+    switch (callType) {
+    case QMetaType::Int:
         intValue = quint32(value.toInt32());
         type = callType;
-    } else if (callType == QMetaType::UInt) {
+        return;
+    case QMetaType::UInt:
         intValue = quint32(value.toUInt32());
         type = callType;
-    } else if (callType == QMetaType::Bool) {
+        return;
+    case QMetaType::Bool:
         boolValue = value.toBoolean();
         type = callType;
-    } else if (callType == QMetaType::Double) {
+        return;
+    case QMetaType::Double:
         doubleValue = double(value.toNumber());
         type = callType;
-    } else if (callType == QMetaType::Float) {
+        return;
+    case QMetaType::Float:
         floatValue = float(value.toNumber());
         type = callType;
-    } else if (callType == QMetaType::QString) {
+        return;
+    case QMetaType::QString:
         if (value.isNull() || value.isUndefined())
             qstringPtr = new (&allocData) QString();
         else
             qstringPtr = new (&allocData) QString(value.toQStringNoThrow());
         type = callType;
+        return;
+    default:
+        break;
+    }
+
+    QV4::Scope scope(engine);
+
+    bool queryEngine = false;
+    if (callType == qMetaTypeId<QJSValue>()) {
+        qjsValuePtr = new (&allocData) QJSValue(scope.engine, value.asReturnedValue());
+        type = qMetaTypeId<QJSValue>();
     } else if (callType == QMetaType::QObjectStar) {
         qobjectPtr = nullptr;
         if (const QV4::QObjectWrapper *qobjectWrapper = value.as<QV4::QObjectWrapper>())
@@ -1774,22 +1974,27 @@ void CallArgument::fromValue(int callType, QV4::ExecutionEngine *engine, const Q
 
 QV4::ReturnedValue CallArgument::toValue(QV4::ExecutionEngine *engine)
 {
-    QV4::Scope scope(engine);
-
-    if (type == qMetaTypeId<QJSValue>()) {
-        return QJSValuePrivate::convertedToValue(scope.engine, *qjsValuePtr);
-    } else if (type == QMetaType::Int) {
+    switch (type) {
+    case QMetaType::Int:
         return QV4::Encode(int(intValue));
-    } else if (type == QMetaType::UInt) {
+    case QMetaType::UInt:
         return QV4::Encode((uint)intValue);
-    } else if (type == QMetaType::Bool) {
+    case QMetaType::Bool:
         return QV4::Encode(boolValue);
-    } else if (type == QMetaType::Double) {
+    case QMetaType::Double:
         return QV4::Encode(doubleValue);
-    } else if (type == QMetaType::Float) {
+    case QMetaType::Float:
         return QV4::Encode(floatValue);
-    } else if (type == QMetaType::QString) {
+    case QMetaType::QString:
         return QV4::Encode(engine->newString(*qstringPtr));
+    default:
+        break;
+    }
+
+    QV4::Scope scope(engine);
+
+    if (type == qMetaTypeId<QJSValue>()) {
+        return QJSValuePrivate::convertedToValue(scope.engine, *qjsValuePtr);
     } else if (type == QMetaType::QByteArray) {
         return QV4::Encode(engine->newArrayBuffer(*qbyteArrayPtr));
     } else if (type == QMetaType::QObjectStar) {
@@ -72,6 +72,7 @@ class QQmlPropertyData;
 
 namespace QV4 {
 struct QObjectSlotDispatcher;
+struct Lookup;
 
 namespace Heap {
 
@@ -182,6 +183,9 @@ struct Q_QML_EXPORT QObjectWrapper : public Object
 
     void destroyObject(bool lastCall);
 
+    static ReturnedValue resolveLookupGetter(const QObjectWrapper *object, ExecutionEngine *engine, Lookup *lookup);
+    static ReturnedValue lookupGetter(Lookup *lookup, ExecutionEngine *engine, const Value &object);
+
 protected:
     static bool isEqualTo(Managed *that, Managed *o);
 
@@ -299,6 +303,31 @@ private Q_SLOTS:
     void removeDestroyedObject(QObject*);
 };
 
+// Remembers which overload calls of an overloaded method with the same number and kinds of
+// arguments resolved to, in a direct-mapped table of 64 slots. Each engine has its own, as property caches are shared between
+// engines on different threads. The entries hold a reference to their property cache, so
+// that its address can't be reused while the entry is around.
+class OverloadResolutionCache
+{
+public:
+    int overload(const QQmlPropertyCache *propertyCache, int methodIndex, int argc, quint32 argumentKinds) const;
+    void setOverload(const QQmlPropertyCache *propertyCache, int methodIndex, int argc, quint32 argumentKinds, int overloadIndex);
+
+private:
+    enum { Size = 64 };
+    struct Entry {
+        QQmlRefPointer<QQmlPropertyCache> propertyCache;
+        int methodIndex = -1;
+        int argc = -1;
+        quint32 argumentKinds = 0;
+        int overloadIndex = -1;
+    };
+
+    static uint slot(const QQmlPropertyCache *propertyCache, int methodIndex, int argc, quint32 argumentKinds);
+
+    Entry entries[Size];
+};
+
 }
 
 QT_END_NAMESPACE
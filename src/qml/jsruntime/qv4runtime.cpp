@@ -317,6 +317,15 @@ ReturnedValue Runtime::method_closure(ExecutionEngine *engine, int functionId)
     return FunctionObject::createScriptFunction(current, clos)->asReturnedValue();
 }
 
+ReturnedValue Runtime::method_isClosureOf(ExecutionEngine *engine, const Value &func, int functionId)
+{
+    const FunctionObject *f = func.as<FunctionObject>();
+    if (!f)
+        return Encode(false);
+    QV4::Function *clos = static_cast<CompiledData::CompilationUnit*>(engine->currentStackFrame->v4Function->compilationUnit)->runtimeFunctions[functionId];
+    return Encode(f->function() == clos);
+}
+
 bool Runtime::method_deleteElement(ExecutionEngine *engine, const Value &base, const Value &index)
 {
     Scope scope(engine);
@@ -129,6 +129,7 @@ struct ExceptionCheck<void (*)(QV4::NoThrowEngine *, A, B, C)> {
     \
     /* closures */ \
     F(ReturnedValue, closure, (ExecutionEngine *engine, int functionId)) \
+    F(ReturnedValue, isClosureOf, (ExecutionEngine *engine, const Value &func, int functionId)) \
     \
     /* function header */ \
     F(void, declareVar, (ExecutionEngine *engine, bool deletable, int nameIndex)) \
@@ -40,6 +40,7 @@
 #include "qv4string_p.h"
 #include "qv4value_p.h"
 #ifndef V4_BOOTSTRAP
+#include "qv4engine_p.h"
 #include "qv4identifiertable_p.h"
 #include "qv4runtime_p.h"
 #include "qv4objectproto_p.h"
@@ -102,11 +103,12 @@ void Heap::ComplexString::init(String *l, String *r)
     left = l;
     right = r;
     len = left->length() + right->length();
-    if (left->subtype >= StringType_Complex)
+    // substrings keep their offset where added strings keep largestSubLength
+    if (left->subtype == StringType_AddedString)
         largestSubLength = static_cast<ComplexString *>(left)->largestSubLength;
     else
         largestSubLength = left->length();
-    if (right->subtype >= StringType_Complex)
+    if (right->subtype == StringType_AddedString)
         largestSubLength = qMax(largestSubLength, static_cast<ComplexString *>(right)->largestSubLength);
     else
         largestSubLength = qMax(largestSubLength, right->length());
@@ -227,6 +229,49 @@ void Heap::String::append(const String *data, QChar *ch)
     }
 }
 
+Heap::String *StringBuilder::toString(ExecutionEngine *engine) const
+{
+    return engine->newString(m_text);
+}
+
+// Makes room for size more characters at the end and returns a pointer to them.
+QChar *StringBuilder::grow(int size)
+{
+    const int oldLength = m_text.length();
+    const int newLength = oldLength + size;
+    // QString::resize() allocates just enough, which would copy the text for every piece
+    if (newLength > m_text.capacity())
+        m_text.reserve(qMax(newLength, 2 * m_text.capacity()));
+    m_text.resize(newLength);
+    return m_text.data() + oldLength;
+}
+
+void StringBuilder::append(const Heap::String *str)
+{
+    if (str->subtype < Heap::String::StringType_Complex) {
+        m_text.append(reinterpret_cast<const QChar *>(str->text->data()), str->text->size);
+        return;
+    }
+    const int size = str->length();
+    if (size)
+        Heap::String::append(str, grow(size));
+}
+
+void StringBuilder::append(const Value &value)
+{
+    if (const String *s = value.stringValue()) {
+        append(s->d());
+    } else if (value.isInteger()) {
+        const int i = value.int_32();
+        if (i >= 0 && i < 10)
+            m_text.append(QLatin1Char(char('0' + i)));
+        else
+            m_text.append(QString::number(i));
+    } else {
+        m_text.append(value.toQString());
+    }
+}
+
 void Heap::String::createHashValue() const
 {
     if (!text)
@@ -114,12 +114,13 @@ struct Q_QML_PRIVATE_EXPORT String : Base {
 
     bool startsWithUpper() const;
 
+    // Copies the characters of data to ch, without flattening it if it's complex.
+    static void append(const String *data, QChar *ch);
+
     mutable QStringData *text;
     mutable Identifier *identifier;
     mutable uint subtype;
     mutable uint stringHash;
-private:
-    static void append(const String *data, QChar *ch);
 #endif
 };
 Q_STATIC_ASSERT(std::is_trivial< String >::value);
@@ -280,6 +281,37 @@ struct ComplexString : String {
     }
 };
 
+// Collects a string that is built from many pieces, as in Array.prototype.join(). Complex
+// strings are copied without flattening them first, and the buffer grows geometrically.
+class Q_QML_PRIVATE_EXPORT StringBuilder
+{
+public:
+    StringBuilder() = default;
+
+    void reserve(int size) { m_text.reserve(size); }
+    int length() const { return m_text.length(); }
+    bool isEmpty() const { return m_text.isEmpty(); }
+
+    void append(QChar c) { m_text.append(c); }
+    void append(QLatin1String str) { m_text.append(str); }
+    void append(const QString &str) { m_text.append(str); }
+    void append(const QChar *str, int size) { m_text.append(str, size); }
+    void append(const Heap::String *str);
+    // converts value to a string, which may run JS code for objects
+    void append(const Value &value);
+
+    // drops everything after the first length characters, keeping the allocated buffer
+    void truncate(int length) { m_text.truncate(length); }
+
+    const QString &toQString() const { return m_text; }
+    Heap::String *toString(ExecutionEngine *engine) const;
+
+private:
+    QChar *grow(int size);
+
+    QString m_text;
+};
+
 template<>
 inline const String *Value::as() const {
     return isManaged() && m()->vtable()->isString ? static_cast<const String *>(this) : nullptr;
@@ -49,6 +49,8 @@
 #include <QtCore/QDateTime>
 #include <QtCore/QDebug>
 #include <QtCore/QStringList>
+#include <QtCore/qalgorithms.h>
+#include <private/qsimd_p.h>
 
 #include <cassert>
 
@@ -209,6 +211,254 @@ static Heap::String *thisAsString(ExecutionEngine *v4, const QV4::Value *thisObj
     return thisObject->toString(v4);
 }
 
+// Searching and case mapping of UTF-16 text. The vector paths handle the bulk of the string,
+// the remainder is done one character at a time.
+
+static inline int firstSetBit(uint mask)
+{
+    return qCountTrailingZeroBits(mask);
+}
+
+// Returns the index of the first occurrence of \a ch in [from, length), or -1.
+static int findChar(const ushort *s, int length, int from, ushort ch)
+{
+    int i = from;
+#if defined(__AVX2__)
+    const __m256i pattern = _mm256_set1_epi16(short(ch));
+    for (; i + 16 <= length; i += 16) {
+        const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+        const uint mask = uint(_mm256_movemask_epi8(_mm256_cmpeq_epi16(data, pattern)));
+        if (mask)
+            return i + firstSetBit(mask) / 2;
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i pattern128 = _mm_set1_epi16(short(ch));
+    for (; i + 8 <= length; i += 8) {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        const uint mask = uint(_mm_movemask_epi8(_mm_cmpeq_epi16(data, pattern128)));
+        if (mask)
+            return i + firstSetBit(mask) / 2;
+    }
+#elif defined(__ARM_NEON__) && defined(Q_PROCESSOR_ARM_64)
+    const uint16x8_t pattern = vdupq_n_u16(ch);
+    for (; i + 8 <= length; i += 8) {
+        const uint16x8_t data = vld1q_u16(s + i);
+        if (vmaxvq_u16(vceqq_u16(data, pattern)))
+            break; // the scalar loop finds the exact position
+    }
+#endif
+    for (; i < length; ++i) {
+        if (s[i] == ch)
+            return i;
+    }
+    return -1;
+}
+
+/*
+    Returns the index of the first occurrence of \a needle in \a haystack at or after \a from,
+    or -1. The vector paths compare the first and the last character of the needle against
+    a block of positions at once, and only compare the rest of the needle where both match.
+*/
+static int findString(const ushort *haystack, int haystackLength, int from,
+                      const ushort *needle, int needleLength)
+{
+    if (from < 0 || from > haystackLength)
+        return -1;
+    if (needleLength == 0)
+        return from;
+    if (needleLength == 1)
+        return findChar(haystack, haystackLength, from, needle[0]);
+
+    const int last = haystackLength - needleLength; // the last possible match position
+    const ushort first = needle[0];
+    const ushort tail = needle[needleLength - 1];
+    const size_t middleBytes = size_t(needleLength - 2) * sizeof(ushort);
+    int i = from;
+
+#if defined(__AVX2__)
+    {
+        const __m256i firstPattern = _mm256_set1_epi16(short(first));
+        const __m256i tailPattern = _mm256_set1_epi16(short(tail));
+        for (; i + 16 <= last + 1; i += 16) {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(haystack + i));
+            const __m256i b = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i *>(haystack + i + needleLength - 1));
+            uint mask = uint(_mm256_movemask_epi8(_mm256_and_si256(
+                                                      _mm256_cmpeq_epi16(a, firstPattern),
+                                                      _mm256_cmpeq_epi16(b, tailPattern))));
+            while (mask) {
+                const int candidate = i + firstSetBit(mask) / 2;
+                if (!memcmp(haystack + candidate + 1, needle + 1, middleBytes))
+                    return candidate;
+                mask &= ~(3u << (firstSetBit(mask) & ~1));
+            }
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        const __m128i firstPattern = _mm_set1_epi16(short(first));
+        const __m128i tailPattern = _mm_set1_epi16(short(tail));
+        for (; i + 8 <= last + 1; i += 8) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(haystack + i));
+            const __m128i b = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i *>(haystack + i + needleLength - 1));
+            uint mask = uint(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(a, firstPattern),
+                                                             _mm_cmpeq_epi16(b, tailPattern))));
+            while (mask) {
+                const int candidate = i + firstSetBit(mask) / 2;
+                if (!memcmp(haystack + candidate + 1, needle + 1, middleBytes))
+                    return candidate;
+                mask &= ~(3u << (firstSetBit(mask) & ~1));
+            }
+        }
+    }
+#elif defined(__ARM_NEON__) && defined(Q_PROCESSOR_ARM_64)
+    {
+        const uint16x8_t firstPattern = vdupq_n_u16(first);
+        const uint16x8_t tailPattern = vdupq_n_u16(tail);
+        for (; i + 8 <= last + 1; i += 8) {
+            const uint16x8_t match = vandq_u16(vceqq_u16(vld1q_u16(haystack + i), firstPattern),
+                                               vceqq_u16(vld1q_u16(haystack + i + needleLength - 1),
+                                                         tailPattern));
+            if (!vmaxvq_u16(match))
+                continue;
+            for (int j = i; j < i + 8; ++j) {
+                if (haystack[j] == first && haystack[j + needleLength - 1] == tail
+                        && !memcmp(haystack + j + 1, needle + 1, middleBytes)) {
+                    return j;
+                }
+            }
+        }
+    }
+#endif
+
+    for (; i <= last; ++i) {
+        if (haystack[i] == first && haystack[i + needleLength - 1] == tail
+                && !memcmp(haystack + i + 1, needle + 1, middleBytes)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+    Maps the ASCII letters between \a lower and \a lower + 25 in [from, length) of \a s to
+    \a d, adding \a delta, and copies all other characters. Returns false, leaving \a d
+    partially written, if the text contains anything outside of ASCII.
+*/
+static bool mapAsciiCase(const ushort *s, ushort *d, int from, int length, ushort lower, short delta)
+{
+    int i = from;
+#if defined(__SSE2__)
+    // SSE2 only has signed 16 bit comparisons, so move the range to the bottom of that.
+    const __m128i bias = _mm_set1_epi16(short(0x8000 - lower));
+    const __m128i limit = _mm_set1_epi16(short(0x8000 + 26));
+    const __m128i nonAsciiBits = _mm_set1_epi16(short(0xff80));
+    const __m128i deltaVector = _mm_set1_epi16(delta);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= length; i += 8) {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(data, nonAsciiBits), zero)) != 0xffff)
+            return false;
+        const __m128i inRange = _mm_cmplt_epi16(_mm_add_epi16(data, bias), limit);
+        const __m128i mapped = _mm_add_epi16(data, _mm_and_si128(inRange, deltaVector));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(d + i), mapped);
+    }
+#elif defined(__ARM_NEON__) && defined(Q_PROCESSOR_ARM_64)
+    const uint16x8_t lowerVector = vdupq_n_u16(lower);
+    const uint16x8_t limit = vdupq_n_u16(26);
+    const uint16x8_t asciiLimit = vdupq_n_u16(0x80);
+    const uint16x8_t deltaVector = vdupq_n_u16(ushort(delta));
+    for (; i + 8 <= length; i += 8) {
+        const uint16x8_t data = vld1q_u16(s + i);
+        if (vmaxvq_u16(vcgeq_u16(data, asciiLimit)))
+            return false;
+        const uint16x8_t inRange = vcltq_u16(vsubq_u16(data, lowerVector), limit);
+        vst1q_u16(d + i, vaddq_u16(data, vandq_u16(inRange, deltaVector)));
+    }
+#endif
+    for (; i < length; ++i) {
+        const ushort c = s[i];
+        if (c >= 0x80)
+            return false;
+        d[i] = ushort(c - lower) < 26 ? ushort(c + delta) : c;
+    }
+    return true;
+}
+
+/*
+    Returns the index of the first character in \a s that is an ASCII letter between
+    \a lower and \a lower + 25, or that is outside of ASCII. Returns \a length if there is none.
+*/
+static int findAsciiCaseChange(const ushort *s, int length, ushort lower)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i bias = _mm_set1_epi16(short(0x8000 - lower));
+    const __m128i limit = _mm_set1_epi16(short(0x8000 + 26));
+    const __m128i nonAsciiBits = _mm_set1_epi16(short(0xff80));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= length; i += 8) {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        const __m128i nonAscii = _mm_xor_si128(_mm_cmpeq_epi16(_mm_and_si128(data, nonAsciiBits), zero),
+                                               _mm_set1_epi16(-1));
+        const __m128i inRange = _mm_cmplt_epi16(_mm_add_epi16(data, bias), limit);
+        const uint mask = uint(_mm_movemask_epi8(_mm_or_si128(nonAscii, inRange)));
+        if (mask)
+            return i + firstSetBit(mask) / 2;
+    }
+#elif defined(__ARM_NEON__) && defined(Q_PROCESSOR_ARM_64)
+    const uint16x8_t lowerVector = vdupq_n_u16(lower);
+    const uint16x8_t limit = vdupq_n_u16(26);
+    const uint16x8_t asciiLimit = vdupq_n_u16(0x80);
+    for (; i + 8 <= length; i += 8) {
+        const uint16x8_t data = vld1q_u16(s + i);
+        if (vmaxvq_u16(vorrq_u16(vcgeq_u16(data, asciiLimit),
+                                 vcltq_u16(vsubq_u16(data, lowerVector), limit)))) {
+            break; // the scalar loop finds the exact position
+        }
+    }
+#endif
+    for (; i < length; ++i) {
+        const ushort c = s[i];
+        if (c >= 0x80 || ushort(c - lower) < 26)
+            return i;
+    }
+    return length;
+}
+
+/*
+    Maps ASCII text to lower case if \a toUpper is false and to upper case otherwise, and leaves
+    everything else to QString. Returns \a str itself if there's nothing to change.
+*/
+static QString convertCase(const QString &str, bool toUpper)
+{
+    const ushort lower = toUpper ? 'a' : 'A';
+    const short delta = toUpper ? -0x20 : 0x20;
+    const ushort *s = reinterpret_cast<const ushort *>(str.constData());
+    const int length = str.length();
+
+    const int start = findAsciiCaseChange(s, length, lower);
+    if (start == length)
+        return str;
+    if (s[start] < 0x80) {
+        QString result(length, Qt::Uninitialized);
+        ushort *d = reinterpret_cast<ushort *>(result.data());
+        memcpy(d, s, start * sizeof(ushort));
+        if (mapAsciiCase(s, d, start, length, lower, delta))
+            return result;
+    }
+    return toUpper ? str.toUpper() : str.toLower();
+}
+
+static int indexOf(const QString &haystack, const QString &needle, int from = 0)
+{
+    return findString(reinterpret_cast<const ushort *>(haystack.constData()), haystack.length(), from,
+                      reinterpret_cast<const ushort *>(needle.constData()), needle.length());
+}
+
 static QString getThisString(ExecutionEngine *v4, const QV4::Value *thisObject)
 {
     if (String *s = thisObject->stringValue())
@@ -273,11 +523,15 @@ ReturnedValue StringPrototype::method_charCodeAt(const FunctionObject *b, const
 ReturnedValue StringPrototype::method_concat(const FunctionObject *b, const Value *thisObject, const Value *argv, int argc)
 {
     ExecutionEngine *v4 = b->engine();
-    QString value = getThisString(v4, thisObject);
+    if (thisObject->isUndefined() || thisObject->isNull())
+        return v4->throwTypeError();
+
+    Scope scope(v4);
+    ScopedString value(scope, thisAsString(v4, thisObject));
     if (v4->hasException)
         return QV4::Encode::undefined();
 
-    Scope scope(v4);
+    // Like the + operator, so that concatenating in a loop doesn't copy the string every time.
     ScopedString s(scope);
     for (int i = 0; i < argc; ++i) {
         s = argv[i].toString(scope.engine);
@@ -285,10 +539,15 @@ ReturnedValue StringPrototype::method_concat(const FunctionObject *b, const Valu
             return QV4::Encode::undefined();
 
         Q_ASSERT(s->isString());
-        value += s->toQString();
+        if (!s->d()->length())
+            continue;
+        if (!value->d()->length())
+            value = s;
+        else
+            value = v4->memoryManager->alloc<ComplexString>(value->d(), s->d());
     }
 
-    return Encode(v4->newString(value));
+    return value->asReturnedValue();
 }
 
 ReturnedValue StringPrototype::method_endsWith(const FunctionObject *b, const Value *thisObject, const Value *argv, int argc)
@@ -333,7 +592,7 @@ ReturnedValue StringPrototype::method_indexOf(const FunctionObject *b, const Val
 
     int index = -1;
     if (! value.isEmpty())
-        index = value.indexOf(searchString, qMin(qMax(pos, 0), value.length()));
+        index = indexOf(value, searchString, qMin(qMax(pos, 0), value.length()));
 
     return Encode(index);
 }
@@ -360,11 +619,7 @@ ReturnedValue StringPrototype::method_includes(const FunctionObject *b, const Va
             pos = value.length();
     }
 
-    if (pos == 0)
-        RETURN_RESULT(Encode(value.contains(searchString)));
-
-    QStringRef stringToSearch = value.midRef(pos);
-    return Encode(stringToSearch.contains(searchString));
+    return Encode(indexOf(value, searchString, qMin(qMax(pos, 0), value.length())) != -1);
 }
 
 ReturnedValue StringPrototype::method_lastIndexOf(const FunctionObject *b, const Value *thisObject, const Value *argv, int argc)
@@ -566,7 +821,7 @@ ReturnedValue StringPrototype::method_replace(const FunctionObject *b, const Val
     } else {
         numCaptures = 1;
         QString searchString = searchValue->toQString();
-        int idx = string.indexOf(searchString);
+        int idx = indexOf(string, searchString);
         if (idx != -1) {
             numStringMatches = 1;
             matchOffsets[0] = idx;
@@ -758,7 +1013,7 @@ ReturnedValue StringPrototype::method_split(const FunctionObject *b, const Value
 
         int start = 0;
         int end;
-        while ((end = text.indexOf(separator, start)) != -1) {
+        while ((end = indexOf(text, separator, start)) != -1) {
             array->push_back((s = scope.engine->newString(text.mid(start, end - start))));
             start = end + separator.size();
             if (array->getLength() >= limit)
@@ -869,7 +1124,10 @@ ReturnedValue StringPrototype::method_toLowerCase(const FunctionObject *b, const
     if (v4->hasException)
         return QV4::Encode::undefined();
 
-    return Encode(v4->newString(value.toLower()));
+    const QString result = convertCase(value, /*toUpper*/ false);
+    if (thisObject->isString() && result.isSharedWith(value))
+        return thisObject->asReturnedValue();
+    return Encode(v4->newString(result));
 }
 
 ReturnedValue StringPrototype::method_toLocaleLowerCase(const FunctionObject *b, const Value *thisObject, const Value *argv, int argc)
@@ -884,7 +1142,10 @@ ReturnedValue StringPrototype::method_toUpperCase(const FunctionObject *b, const
     if (v4->hasException)
         return QV4::Encode::undefined();
 
-    return Encode(v4->newString(value.toUpper()));
+    const QString result = convertCase(value, /*toUpper*/ true);
+    if (thisObject->isString() && result.isSharedWith(value))
+        return thisObject->asReturnedValue();
+    return Encode(v4->newString(result));
 }
 
 ReturnedValue StringPrototype::method_toLocaleUpperCase(const FunctionObject *b, const Value *thisObject, const Value *argv, int argc)
@@ -903,6 +1164,14 @@ ReturnedValue StringPrototype::method_fromCharCode(const FunctionObject *b, cons
     return Encode(b->engine()->newString(str));
 }
 
+static inline bool isTrimmedSpace(QChar c)
+{
+    // Printable ASCII is by far the most common, and never white space.
+    if (c.unicode() > 0x20 && c.unicode() < 0x7f)
+        return false;
+    return c.isSpace() || c.unicode() == 0xfeff;
+}
+
 ReturnedValue StringPrototype::method_trim(const FunctionObject *b, const Value *thisObject, const Value *, int)
 {
     ExecutionEngine *v4 = b->engine();
@@ -913,13 +1182,15 @@ ReturnedValue StringPrototype::method_trim(const FunctionObject *b, const Value
     const QChar *chars = s.constData();
     int start, end;
     for (start = 0; start < s.length(); ++start) {
-        if (!chars[start].isSpace() && chars[start].unicode() != 0xfeff)
+        if (!isTrimmedSpace(chars[start]))
             break;
     }
     for (end = s.length() - 1; end >= start; --end) {
-        if (!chars[end].isSpace() && chars[end].unicode() != 0xfeff)
+        if (!isTrimmedSpace(chars[end]))
             break;
     }
 
+    if (thisObject->isString() && start == 0 && end == s.length() - 1)
+        return thisObject->asReturnedValue();
     return Encode(v4->newString(QString(chars + start, end - start + 1)));
 }
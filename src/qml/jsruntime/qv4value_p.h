@@ -833,6 +833,15 @@ struct ValueArray {
     void set(EngineBase *e, uint index, Heap::Base *b) {
         WriteBarrier::write(e, base(), values[index].data_ptr(), b->asReturnedValue());
     }
+    // Copies n values to index. Only while a barrier is active does every value go through it.
+    void copyData(EngineBase *e, uint index, const Value *from, uint n) {
+        if (Q_UNLIKELY(e->writeBarrierActive)) {
+            for (uint i = 0; i < n; ++i)
+                set(e, index + i, from[i]);
+        } else {
+            memcpy(values + index, from, n*sizeof(Value));
+        }
+    }
     inline const Value &operator[] (uint index) const {
         Q_ASSERT(index < alloc);
         return values[index];
@@ -337,6 +337,11 @@ static struct InstrCount {
 
 #define STACK_VALUE(temp) stack[temp]
 
+// code points past the instruction being executed, see Function::typeFeedback
+#define RECORD_TYPE_FEEDBACK(kind) \
+    if (function->typeFeedback) \
+        function->typeFeedback[code - codeStart - 1] |= Function::kind
+
 // qv4scopedvalue_p.h also defines a CHECK_EXCEPTION macro
 #ifdef CHECK_EXCEPTION
 #undef CHECK_EXCEPTION
@@ -481,6 +486,17 @@ static bool compareEqualInt(QV4::Value &accumulator, QV4::Value lhs, int rhs)
 
 #define STORE_IP() frame.instructionPointer = int(code - codeStart);
 #define STORE_ACC() accumulator = acc;
+
+// After a backward jump, a call that keeps looping continues in JIT code at the loop header. The
+// JIT code picks up the frame as is, only the exception handler can't be carried over.
+#ifdef V4_ENABLE_JIT
+#define CHECK_LOOP_JIT_ENTRY() \
+    if (offset < 0 && !exceptionHandler && debugger == nullptr \
+            && (function->jittedCode != nullptr || engine->canJITLoop(function))) \
+        goto enterJitAtLoopHeader;
+#else
+#define CHECK_LOOP_JIT_ENTRY()
+#endif
 #define ACC Primitive::fromReturnedValue(acc)
 #define VALUE_TO_INT(i, val) \
     int i; \
@@ -560,10 +576,25 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
 
 #ifdef V4_ENABLE_JIT
     if (function->jittedCode == nullptr && debugger == nullptr) {
-        if (engine->canJIT(function))
+        if (engine->canJIT(function)) {
             QV4::JIT::BaselineJIT(function).generate();
-        else
+        } else {
             ++function->interpreterCallCount;
+            // Only the last interpreted call before the baseline JIT takes over records type
+            // feedback, functions that are called just a few times don't get the buffer at all.
+            if (!function->typeFeedback && engine->jitRecordsTypeFeedback() && engine->canJIT(function))
+                function->typeFeedback = new quint8[function->compiledFunction->codeSize]();
+        }
+    } else if (!function->isOptimized && debugger == nullptr) {
+        if (engine->canOptimize(function)) {
+            QV4::JIT::OptimizingJIT(function).generate();
+            function->isOptimized = true;
+            // interpreter frames further up the stack check for null before recording
+            delete[] function->typeFeedback;
+            function->typeFeedback = nullptr;
+        } else {
+            ++function->baselineCallCount;
+        }
     }
 #endif // V4_ENABLE_JIT
 
@@ -1001,25 +1032,22 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
 
     MOTH_BEGIN_INSTR(Jump)
         code += offset;
+        CHECK_LOOP_JIT_ENTRY();
     MOTH_END_INSTR(Jump)
 
     MOTH_BEGIN_INSTR(JumpTrue)
-        if (Q_LIKELY(ACC.integerCompatible())) {
-            if (ACC.int_32())
-                code += offset;
-        } else {
-            if (ACC.toBoolean())
-                code += offset;
+        const bool taken = Q_LIKELY(ACC.integerCompatible()) ? ACC.int_32() != 0 : ACC.toBoolean();
+        if (taken) {
+            code += offset;
+            CHECK_LOOP_JIT_ENTRY();
         }
     MOTH_END_INSTR(JumpTrue)
 
     MOTH_BEGIN_INSTR(JumpFalse)
-        if (Q_LIKELY(ACC.integerCompatible())) {
-            if (!ACC.int_32())
-                code += offset;
-        } else {
-            if (!ACC.toBoolean())
-                code += offset;
+        const bool taken = Q_LIKELY(ACC.integerCompatible()) ? ACC.int_32() == 0 : !ACC.toBoolean();
+        if (taken) {
+            code += offset;
+            CHECK_LOOP_JIT_ENTRY();
         }
     MOTH_END_INSTR(JumpFalse)
 
@@ -1078,10 +1106,13 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
     MOTH_BEGIN_INSTR(CmpGt)
         const Value left = STACK_VALUE(lhs);
         if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            RECORD_TYPE_FEEDBACK(SawInt);
             acc = Encode(left.int_32() > ACC.int_32());
         } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
             acc = Encode(left.asDouble() > ACC.asDouble());
         } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
             STORE_ACC();
             acc = Encode(bool(Runtime::method_compareGreaterThan(left, accumulator)));
             CHECK_EXCEPTION;
@@ -1091,10 +1122,13 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
     MOTH_BEGIN_INSTR(CmpGe)
         const Value left = STACK_VALUE(lhs);
         if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            RECORD_TYPE_FEEDBACK(SawInt);
             acc = Encode(left.int_32() >= ACC.int_32());
         } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
             acc = Encode(left.asDouble() >= ACC.asDouble());
         } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
             STORE_ACC();
             acc = Encode(bool(Runtime::method_compareGreaterEqual(left, accumulator)));
             CHECK_EXCEPTION;
@@ -1104,10 +1138,13 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
     MOTH_BEGIN_INSTR(CmpLt)
         const Value left = STACK_VALUE(lhs);
         if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            RECORD_TYPE_FEEDBACK(SawInt);
             acc = Encode(left.int_32() < ACC.int_32());
         } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
             acc = Encode(left.asDouble() < ACC.asDouble());
         } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
             STORE_ACC();
             acc = Encode(bool(Runtime::method_compareLessThan(left, accumulator)));
             CHECK_EXCEPTION;
@@ -1117,10 +1154,13 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
     MOTH_BEGIN_INSTR(CmpLe)
         const Value left = STACK_VALUE(lhs);
         if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            RECORD_TYPE_FEEDBACK(SawInt);
             acc = Encode(left.int_32() <= ACC.int_32());
         } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
             acc = Encode(left.asDouble() <= ACC.asDouble());
         } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
             STORE_ACC();
             acc = Encode(bool(Runtime::method_compareLessEqual(left, accumulator)));
             CHECK_EXCEPTION;
@@ -1165,6 +1205,10 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
         CHECK_EXCEPTION;
     MOTH_END_INSTR(CmpInstanceOf)
 
+    MOTH_BEGIN_INSTR(TestClosure)
+        acc = Runtime::method_isClosureOf(engine, Primitive::fromReturnedValue(acc), value);
+    MOTH_END_INSTR(TestClosure)
+
     MOTH_BEGIN_INSTR(JumpStrictNotEqualStackSlotInt)
         if (STACK_VALUE(lhs).int_32() != rhs || STACK_VALUE(lhs).isUndefined())
             code += offset;
@@ -1236,10 +1280,13 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
     MOTH_BEGIN_INSTR(Add)
         const Value left = STACK_VALUE(lhs);
         if (Q_LIKELY(Value::integerCompatible(left, ACC))) {
+            RECORD_TYPE_FEEDBACK(SawInt);
             acc = add_int32(left.int_32(), ACC.int_32());
         } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
             acc = Encode(left.asDouble() + ACC.asDouble());
         } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
             STORE_ACC();
             acc = Runtime::method_add(engine, left, accumulator);
             CHECK_EXCEPTION;
@@ -1249,10 +1296,13 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
     MOTH_BEGIN_INSTR(Sub)
         const Value left = STACK_VALUE(lhs);
         if (Q_LIKELY(Value::integerCompatible(left, ACC))) {
+            RECORD_TYPE_FEEDBACK(SawInt);
             acc = sub_int32(left.int_32(), ACC.int_32());
         } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
             acc = Encode(left.asDouble() - ACC.asDouble());
         } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
             STORE_ACC();
             acc = Runtime::method_sub(left, accumulator);
             CHECK_EXCEPTION;
@@ -1262,10 +1312,13 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
     MOTH_BEGIN_INSTR(Mul)
         const Value left = STACK_VALUE(lhs);
         if (Q_LIKELY(Value::integerCompatible(left, ACC))) {
+            RECORD_TYPE_FEEDBACK(SawInt);
             acc = mul_int32(left.int_32(), ACC.int_32());
         } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
             acc = Encode(left.asDouble() * ACC.asDouble());
         } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
             STORE_ACC();
             acc = Runtime::method_mul(left, accumulator);
             CHECK_EXCEPTION;
@@ -1369,6 +1422,228 @@ QV4::ReturnedValue VME::exec(const FunctionObject *fo, const QV4::Value *thisObj
         STACK_VALUE(result) = Runtime::method_loadQmlImportedScripts(static_cast<QV4::NoThrowEngine*>(engine));
     MOTH_END_INSTR(LoadQmlImportedScripts)
 
+    MOTH_BEGIN_INSTR(CmpEqJumpFalse)
+        const Value left = STACK_VALUE(lhs);
+        bool result;
+        if (Q_LIKELY(left.asReturnedValue() == ACC.asReturnedValue())) {
+            result = !ACC.isNaN();
+        } else if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            result = left.int_32() == ACC.int_32();
+        } else {
+            STORE_ACC();
+            result = compareEqual(left, accumulator);
+            CHECK_EXCEPTION;
+        }
+        acc = Encode(result);
+        if (!result)
+            code += offset;
+    MOTH_END_INSTR(CmpEqJumpFalse)
+
+    MOTH_BEGIN_INSTR(CmpNeJumpFalse)
+        const Value left = STACK_VALUE(lhs);
+        bool result;
+        if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            result = left.int_32() != ACC.int_32();
+        } else {
+            STORE_ACC();
+            result = !compareEqual(left, accumulator);
+            CHECK_EXCEPTION;
+        }
+        acc = Encode(result);
+        if (!result)
+            code += offset;
+    MOTH_END_INSTR(CmpNeJumpFalse)
+
+    MOTH_BEGIN_INSTR(CmpGtJumpFalse)
+        const Value left = STACK_VALUE(lhs);
+        bool result;
+        if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            RECORD_TYPE_FEEDBACK(SawInt);
+            result = left.int_32() > ACC.int_32();
+        } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
+            result = left.asDouble() > ACC.asDouble();
+        } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
+            STORE_ACC();
+            result = Runtime::method_compareGreaterThan(left, accumulator);
+            CHECK_EXCEPTION;
+        }
+        acc = Encode(result);
+        if (!result)
+            code += offset;
+    MOTH_END_INSTR(CmpGtJumpFalse)
+
+    MOTH_BEGIN_INSTR(CmpGeJumpFalse)
+        const Value left = STACK_VALUE(lhs);
+        bool result;
+        if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            RECORD_TYPE_FEEDBACK(SawInt);
+            result = left.int_32() >= ACC.int_32();
+        } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
+            result = left.asDouble() >= ACC.asDouble();
+        } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
+            STORE_ACC();
+            result = Runtime::method_compareGreaterEqual(left, accumulator);
+            CHECK_EXCEPTION;
+        }
+        acc = Encode(result);
+        if (!result)
+            code += offset;
+    MOTH_END_INSTR(CmpGeJumpFalse)
+
+    MOTH_BEGIN_INSTR(CmpLtJumpFalse)
+        const Value left = STACK_VALUE(lhs);
+        bool result;
+        if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            RECORD_TYPE_FEEDBACK(SawInt);
+            result = left.int_32() < ACC.int_32();
+        } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
+            result = left.asDouble() < ACC.asDouble();
+        } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
+            STORE_ACC();
+            result = Runtime::method_compareLessThan(left, accumulator);
+            CHECK_EXCEPTION;
+        }
+        acc = Encode(result);
+        if (!result)
+            code += offset;
+    MOTH_END_INSTR(CmpLtJumpFalse)
+
+    MOTH_BEGIN_INSTR(CmpLeJumpFalse)
+        const Value left = STACK_VALUE(lhs);
+        bool result;
+        if (Q_LIKELY(left.isInteger() && ACC.isInteger())) {
+            RECORD_TYPE_FEEDBACK(SawInt);
+            result = left.int_32() <= ACC.int_32();
+        } else if (left.isNumber() && ACC.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
+            result = left.asDouble() <= ACC.asDouble();
+        } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
+            STORE_ACC();
+            result = Runtime::method_compareLessEqual(left, accumulator);
+            CHECK_EXCEPTION;
+        }
+        acc = Encode(result);
+        if (!result)
+            code += offset;
+    MOTH_END_INSTR(CmpLeJumpFalse)
+
+    MOTH_BEGIN_INSTR(CmpStrictEqualJumpFalse)
+        bool result;
+        if (STACK_VALUE(lhs).rawValue() == ACC.rawValue() && !ACC.isNaN()) {
+            result = true;
+        } else {
+            STORE_ACC();
+            result = RuntimeHelpers::strictEqual(STACK_VALUE(lhs), accumulator);
+            CHECK_EXCEPTION;
+        }
+        acc = Encode(result);
+        if (!result)
+            code += offset;
+    MOTH_END_INSTR(CmpStrictEqualJumpFalse)
+
+    MOTH_BEGIN_INSTR(CmpStrictNotEqualJumpFalse)
+        bool result;
+        if (STACK_VALUE(lhs).rawValue() != ACC.rawValue() || ACC.isNaN()) {
+            STORE_ACC();
+            result = !RuntimeHelpers::strictEqual(STACK_VALUE(lhs), accumulator);
+            CHECK_EXCEPTION;
+        } else {
+            result = false;
+        }
+        acc = Encode(result);
+        if (!result)
+            code += offset;
+    MOTH_END_INSTR(CmpStrictNotEqualJumpFalse)
+
+    MOTH_BEGIN_INSTR(LoadRegAdd)
+        const Value left = STACK_VALUE(lhs);
+        const Value right = STACK_VALUE(reg);
+        if (Q_LIKELY(Value::integerCompatible(left, right))) {
+            RECORD_TYPE_FEEDBACK(SawInt);
+            acc = add_int32(left.int_32(), right.int_32());
+        } else if (left.isNumber() && right.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
+            acc = Encode(left.asDouble() + right.asDouble());
+        } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
+            accumulator = right;
+            acc = Runtime::method_add(engine, left, accumulator);
+            CHECK_EXCEPTION;
+        }
+    MOTH_END_INSTR(LoadRegAdd)
+
+    MOTH_BEGIN_INSTR(LoadRegSub)
+        const Value left = STACK_VALUE(lhs);
+        const Value right = STACK_VALUE(reg);
+        if (Q_LIKELY(Value::integerCompatible(left, right))) {
+            RECORD_TYPE_FEEDBACK(SawInt);
+            acc = sub_int32(left.int_32(), right.int_32());
+        } else if (left.isNumber() && right.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
+            acc = Encode(left.asDouble() - right.asDouble());
+        } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
+            accumulator = right;
+            acc = Runtime::method_sub(left, accumulator);
+            CHECK_EXCEPTION;
+        }
+    MOTH_END_INSTR(LoadRegSub)
+
+    MOTH_BEGIN_INSTR(LoadRegMul)
+        const Value left = STACK_VALUE(lhs);
+        const Value right = STACK_VALUE(reg);
+        if (Q_LIKELY(Value::integerCompatible(left, right))) {
+            RECORD_TYPE_FEEDBACK(SawInt);
+            acc = mul_int32(left.int_32(), right.int_32());
+        } else if (left.isNumber() && right.isNumber()) {
+            RECORD_TYPE_FEEDBACK(SawDouble);
+            acc = Encode(left.asDouble() * right.asDouble());
+        } else {
+            RECORD_TYPE_FEEDBACK(SawOther);
+            accumulator = right;
+            acc = Runtime::method_mul(left, accumulator);
+            CHECK_EXCEPTION;
+        }
+    MOTH_END_INSTR(LoadRegMul)
+
+    MOTH_BEGIN_INSTR(IncrementStoreReg)
+        if (Q_LIKELY(ACC.integerCompatible())) {
+            acc = add_int32(ACC.int_32(), 1);
+        } else if (ACC.isDouble()) {
+            acc = QV4::Encode(ACC.doubleValue() + 1.);
+        } else {
+            acc = Encode(ACC.toNumberImpl() + 1.);
+            CHECK_EXCEPTION;
+        }
+        STACK_VALUE(reg) = acc;
+    MOTH_END_INSTR(IncrementStoreReg)
+
+    MOTH_BEGIN_INSTR(GetLookupStoreReg)
+        STORE_IP();
+        QV4::Lookup *l = function->compilationUnit->runtimeLookups + index;
+        acc = l->getter(l, engine, STACK_VALUE(base));
+        CHECK_EXCEPTION;
+        STACK_VALUE(reg) = acc;
+    MOTH_END_INSTR(GetLookupStoreReg)
+
+#ifdef V4_ENABLE_JIT
+    enterJitAtLoopHeader:
+        if (function->jittedCode == nullptr)
+            QV4::JIT::BaselineJIT(function).generate();
+        ++function->loopEntryCount;
+        STORE_IP();
+        STORE_ACC();
+        acc = function->jittedCode(&frame, engine);
+        goto functionExit;
+#endif
+
     catchException:
         Q_ASSERT(engine->hasException);
         if (!exceptionHandler) {
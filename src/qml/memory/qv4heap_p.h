@@ -117,6 +117,12 @@ struct Q_QML_EXPORT Base {
         Q_ASSERT(!Chunk::testBit(c->extendsBitmap, h - c->realBase()));
         return Chunk::setBit(c->grayBitmap, h - c->realBase());
     }
+    inline void setDestroyBit() {
+        const HeapItem *h = reinterpret_cast<const HeapItem *>(this);
+        Chunk *c = h->chunk();
+        Q_ASSERT(!Chunk::testBit(c->extendsBitmap, h - c->realBase()));
+        return Chunk::setBit(c->destroyBitmap, h - c->realBase());
+    }
 
     inline bool inUse() const {
         const HeapItem *h = reinterpret_cast<const HeapItem *>(this);
@@ -191,7 +197,13 @@ void Heap::Base::mark(QV4::MarkStack *markStack)
     quintptr *bitmap = c->blackBitmap + Chunk::bitmapIndex(index);
     quintptr bit = Chunk::bitForIndex(index);
     if (!(*bitmap & bit)) {
-        *bitmap |= bit;
+        if (Q_UNLIKELY(markStack->parallel)) {
+            // another thread might have marked us, or something next to us, in the meantime
+            if (Chunk::testAndSetBitAtomic(bitmap, bit))
+                return;
+        } else {
+            *bitmap |= bit;
+        }
         markStack->push(this);
     }
 }
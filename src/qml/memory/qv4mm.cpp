@@ -53,11 +53,17 @@
 
 #include <QElapsedTimer>
 #include <QMap>
+#include <QMutex>
+#include <QRunnable>
 #include <QScopedValueRollback>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 #include <iostream>
 #include <cstdlib>
 #include <algorithm>
+#include <memory>
 #include "qv4alloca_p.h"
 #include "qv4profiling_p.h"
 
@@ -91,6 +97,7 @@
 #endif
 
 #define MIN_UNMANAGED_HEAPSIZE_GC_LIMIT std::size_t(128 * 1024)
+#define DEFAULT_GC_SLICE_TIME 2 // ms
 
 Q_LOGGING_CATEGORY(lcGcStats, "qt.qml.gc.statistics")
 Q_DECLARE_LOGGING_CATEGORY(lcGcStats)
@@ -105,7 +112,10 @@ namespace QV4 {
 
 enum {
     MinSlotsGCLimit = QV4::Chunk::AvailableSlots*16,
-    GCOverallocation = 200 /* Max overallocation by the GC in % */
+    GCOverallocation = 200, /* Max overallocation by the GC in % */
+    HighSurvivalRate = 75, /* in %, above this the heap is allowed to grow twice as much */
+    IdleGCLookahead = 1000, /* ms, collections due within this time get moved into idle time */
+    DefaultHugeItemCacheSegments = 2 /* cached segments of huge items, in standard segment sizes */
 };
 
 struct MemorySegment {
@@ -114,6 +124,7 @@ struct MemorySegment {
         SegmentSize = NumChunks*Chunk::ChunkSize,
     };
 
+    MemorySegment() {}
     MemorySegment(size_t size)
     {
         size += Chunk::ChunkSize; // make sure we can get enough 64k aligment memory
@@ -131,13 +142,49 @@ struct MemorySegment {
         qSwap(pageReservation, other.pageReservation);
         qSwap(base, other.base);
         qSwap(allocatedMap, other.allocatedMap);
+        qSwap(committedMap, other.committedMap);
+        qSwap(hugeItemCommitted, other.hugeItemCommitted);
         qSwap(availableBytes, other.availableBytes);
         qSwap(nChunks, other.nChunks);
+        qSwap(recycle, other.recycle);
+    }
+    MemorySegment &operator=(MemorySegment &&other) {
+        qSwap(pageReservation, other.pageReservation);
+        qSwap(base, other.base);
+        qSwap(allocatedMap, other.allocatedMap);
+        qSwap(committedMap, other.committedMap);
+        qSwap(hugeItemCommitted, other.hugeItemCommitted);
+        qSwap(availableBytes, other.availableBytes);
+        qSwap(nChunks, other.nChunks);
+        qSwap(recycle, other.recycle);
+        return *this;
     }
 
     ~MemorySegment() {
-        if (base)
+        if (base) {
+            decommitRetainedChunks(~static_cast<quint64>(0));
+            if (hugeItemCommitted)
+                pageReservation.decommit(base, hugeItemCommitted);
             pageReservation.deallocate();
+        }
+    }
+
+    static quint64 chunkMask(size_t index, size_t n) {
+        return (n >= NumChunks ? ~static_cast<quint64>(0) : (static_cast<quint64>(1) << n) - 1) << index;
+    }
+
+    bool hasStandardSize() const {
+        return pageReservation.size() == SegmentSize + Chunk::ChunkSize;
+    }
+
+    void decommitRetainedChunks(quint64 mask) {
+        mask &= committedMap;
+        committedMap &= ~mask;
+        while (mask) {
+            uint index = qCountTrailingZeroBits(mask);
+            mask ^= (static_cast<quint64>(1) << index);
+            pageReservation.decommit(base + index, Chunk::ChunkSize);
+        }
     }
 
     void setBit(size_t index) {
@@ -171,6 +218,18 @@ struct MemorySegment {
 
         size_t pageSize = WTF::pageSize();
         size = (size + pageSize - 1) & ~(pageSize - 1);
+
+        if (recycle) {
+            // The segment goes to the segment pool once its engine is gone. Zeroing out the
+            // whole chunks is cheaper for the next engine than faulting their pages in again.
+            const size_t retainedChunks = size/Chunk::ChunkSize;
+            memset(chunk, 0, retainedChunks*Chunk::ChunkSize);
+            committedMap |= chunkMask(static_cast<size_t>(chunk - base), retainedChunks);
+            chunk += retainedChunks;
+            size -= retainedChunks*Chunk::ChunkSize;
+            if (!size)
+                return;
+        }
 #if !defined(Q_OS_LINUX) && !defined(Q_OS_WIN)
         // Linux and Windows zero out pages that have been decommitted and get committed again.
         // unfortunately that's not true on other OSes (e.g. BSD based ones), so zero out the
@@ -185,11 +244,27 @@ struct MemorySegment {
         return c >= base && c < base + nChunks;
     }
 
+    // For segments holding a single huge item, that get cached by the HugeItemAllocator once the
+    // item is dead. Unless decommitting, the item's pages stay committed for the next one.
+    void freeHugeItem(size_t size, bool decommit) {
+        Q_ASSERT(!hugeItemCommitted);
+        if (decommit) {
+            free(base, size);
+        } else {
+            allocatedMap = 0;
+            hugeItemCommitted = size;
+        }
+    }
+    Chunk *reuseForHugeItem(size_t size);
+
     PageReservation pageReservation;
     Chunk *base = nullptr;
     quint64 allocatedMap = 0;
+    quint64 committedMap = 0; // free chunks that are still committed, and zeroed out
+    size_t hugeItemCommitted = 0; // bytes still committed after freeHugeItem()
     size_t availableBytes = 0;
     uint nChunks = 0;
+    bool recycle = false; // keep freed chunks committed, see ChunkAllocator::prepareForRecycling()
 };
 
 Chunk *MemorySegment::allocate(size_t size)
@@ -197,6 +272,7 @@ Chunk *MemorySegment::allocate(size_t size)
     if (!allocatedMap && size >= SegmentSize) {
         // chunk allocated for one huge allocation
         Q_ASSERT(availableBytes >= size);
+        decommitRetainedChunks(~static_cast<quint64>(0));
         pageReservation.commit(base, size);
         allocatedMap = ~static_cast<quintptr>(0);
         return base;
@@ -214,7 +290,13 @@ Chunk *MemorySegment::allocate(size_t size)
             sequence = 0;
         }
         if (sequence == requiredChunks) {
-            pageReservation.commit(candidate, size);
+            const quint64 mask = chunkMask(static_cast<size_t>(candidate - base), requiredChunks);
+            if ((committedMap & mask) == mask && size == requiredChunks*Chunk::ChunkSize) {
+                committedMap &= ~mask; // committed and zeroed out already
+            } else {
+                decommitRetainedChunks(mask);
+                pageReservation.commit(candidate, size);
+            }
             for (uint i = 0; i < requiredChunks; ++i)
                 setBit(candidate - base + i);
             DEBUG << "allocated chunk " << candidate << hex << size;
@@ -224,8 +306,88 @@ Chunk *MemorySegment::allocate(size_t size)
     return nullptr;
 }
 
+/*
+ * Keeps empty memory segments of destroyed engines, so that engines created later can take
+ * them over instead of reserving and committing fresh memory. This makes short lived engines,
+ * like the ones of worker scripts, much cheaper. The segments keep their chunks committed,
+ * so the pool holds on to real memory. It is therefore limited to a few segments, configured
+ * with QV4_MM_SEGMENT_POOL_SIZE or MemoryManager::setSegmentPoolCapacity().
+ */
+struct SegmentPool {
+    SegmentPool()
+        : capacity(uint(qMax(0, qEnvironmentVariableIntValue(QV4_MM_SEGMENT_POOL_SIZE))))
+    {}
+
+    uint freeCapacity() {
+        QMutexLocker locker(&mutex);
+        return capacity > segments.size() ? capacity - uint(segments.size()) : 0;
+    }
+
+    void setCapacity(uint c) {
+        std::vector<MemorySegment> dropped;
+        {
+            QMutexLocker locker(&mutex);
+            capacity = c;
+            while (segments.size() > capacity) {
+                dropped.push_back(std::move(segments.back()));
+                segments.pop_back();
+            }
+        }
+        // releasing the memory happens outside of the lock
+    }
+
+    void give(MemorySegment &segment) {
+        Q_ASSERT(!segment.allocatedMap);
+        segment.recycle = false;
+        QMutexLocker locker(&mutex);
+        if (segments.size() < capacity)
+            segments.push_back(std::move(segment));
+    }
+
+    // takes the segment with the most committed chunks
+    bool take(MemorySegment *segment) {
+        QMutexLocker locker(&mutex);
+        if (segments.empty())
+            return false;
+        auto best = std::max_element(segments.begin(), segments.end(),
+                                     [](const MemorySegment &a, const MemorySegment &b) {
+            return qPopulationCount(a.committedMap) < qPopulationCount(b.committedMap);
+        });
+        *segment = std::move(*best);
+        segments.erase(best);
+        return true;
+    }
+
+    QMutex mutex;
+    std::vector<MemorySegment> segments;
+    uint capacity;
+};
+
+Q_GLOBAL_STATIC(SegmentPool, segmentPool)
+
+Chunk *MemorySegment::reuseForHugeItem(size_t size)
+{
+    Q_ASSERT(!allocatedMap && size <= availableBytes);
+    char *start = reinterpret_cast<char *>(base);
+    if (size < hugeItemCommitted) {
+#if !defined(Q_OS_LINUX) && !defined(Q_OS_WIN)
+        // see free()
+        memset(start + size, 0, hugeItemCommitted - size);
+#endif
+        pageReservation.decommit(start + size, hugeItemCommitted - size);
+    } else if (size > hugeItemCommitted) {
+        pageReservation.commit(start + hugeItemCommitted, size - hugeItemCommitted);
+    }
+    // pages committed just now are zeroed out already
+    memset(base, 0, qMin(size, hugeItemCommitted));
+    hugeItemCommitted = 0;
+    allocatedMap = chunkMask(0, (size - 1)/Chunk::ChunkSize + 1);
+    return base;
+}
+
 struct ChunkAllocator {
     ChunkAllocator() {}
+    ~ChunkAllocator();
 
     size_t requiredChunkSize(size_t size) {
         size += Chunk::HeaderSize; // space required for the Chunk header
@@ -238,6 +400,8 @@ struct ChunkAllocator {
 
     Chunk *allocate(size_t size = 0);
     void free(Chunk *chunk, size_t size = 0);
+    size_t releaseEmptySegments();
+    void prepareForRecycling();
 
     std::vector<MemorySegment> memorySegments;
 };
@@ -253,6 +417,15 @@ Chunk *ChunkAllocator::allocate(size_t size)
         }
     }
 
+    if (size < MemorySegment::SegmentSize) {
+        MemorySegment pooled;
+        if (segmentPool.exists() && segmentPool->take(&pooled)) {
+            memorySegments.push_back(std::move(pooled));
+            if (Chunk *c = memorySegments.back().allocate(size))
+                return c;
+        }
+    }
+
     // allocate a new segment
     memorySegments.push_back(MemorySegment(size));
     Chunk *c = memorySegments.back().allocate(size);
@@ -260,6 +433,32 @@ Chunk *ChunkAllocator::allocate(size_t size)
     return c;
 }
 
+ChunkAllocator::~ChunkAllocator()
+{
+    if (!segmentPool.exists())
+        return;
+    for (MemorySegment &m : memorySegments) {
+        if (m.recycle && !m.allocatedMap)
+            segmentPool->give(m);
+    }
+}
+
+// Called before everything gets freed on engine destruction. Marks as many segments as the pool
+// can take, their chunks stay committed when freed.
+void ChunkAllocator::prepareForRecycling()
+{
+    SegmentPool *pool = segmentPool();
+    uint n = pool ? pool->freeCapacity() : 0;
+    for (MemorySegment &m : memorySegments) {
+        if (!n)
+            break;
+        if (m.hasStandardSize()) {
+            m.recycle = true;
+            --n;
+        }
+    }
+}
+
 void ChunkAllocator::free(Chunk *chunk, size_t size)
 {
     size = requiredChunkSize(size);
@@ -272,6 +471,17 @@ void ChunkAllocator::free(Chunk *chunk, size_t size)
     Q_ASSERT(false);
 }
 
+// Gives the address space of segments without any allocated chunk back to the OS. The pages
+// got decommitted when their chunks were freed already. Returns the number of released segments.
+size_t ChunkAllocator::releaseEmptySegments()
+{
+    auto isEmpty = [](const MemorySegment &m) { return !m.allocatedMap; };
+    auto newEnd = std::remove_if(memorySegments.begin(), memorySegments.end(), isEmpty);
+    const size_t released = memorySegments.end() - newEnd;
+    memorySegments.erase(newEnd, memorySegments.end());
+    return released;
+}
+
 #ifdef DUMP_SWEEP
 QString binary(quintptr n) {
     QString s = QString::number(n, 2);
@@ -296,8 +506,30 @@ static void increaseFreedCountForClass(const char *className)
     (*freedObjectStatsGlobal())[className]++;
 }
 
+void Chunk::destroyUnmarkedItems()
+{
+    HeapItem *o = realBase();
+    for (uint i = 0; i < Chunk::EntriesInBitmap; ++i) {
+        quintptr toDestroy = (objectBitmap[i] ^ blackBitmap[i]) & destroyBitmap[i];
+        while (toDestroy) {
+            uint index = qCountTrailingZeroBits(toDestroy);
+            toDestroy ^= (static_cast<quintptr>(1) << index);
+
+            Heap::Base *b = *(o + index);
+            const VTable *v = b->vtable();
+            Q_ASSERT(v->destroy);
+            v->destroy(b);
+            b->_checkIsDestroyed();
+        }
+        // Dead items leave the remembered set. This has to happen on the engine's thread, where
+        // the write barrier sets gray bits, the chunk might get swept on another one.
+        grayBitmap[i] &= blackBitmap[i];
+        o += Chunk::Bits;
+    }
+}
+
 //bool Chunk::sweep(ClassDestroyStatsCallback classCountPtr)
-bool Chunk::sweep(ExecutionEngine *engine)
+bool Chunk::sweep(ExecutionEngine *engine, bool keepMarks)
 {
     bool hasUsedSlots = false;
     SDUMP() << "sweeping chunk" << this;
@@ -333,25 +565,25 @@ bool Chunk::sweep(ExecutionEngine *engine)
             result |= mask; // ensure we don't clear stuff to the right of the current object
             e &= result;
 
-            HeapItem *itemToFree = o + index;
-            Heap::Base *b = *itemToFree;
-            const VTable *v = b->vtable();
-//            if (Q_UNLIKELY(classCountPtr))
-//                classCountPtr(v->className);
-            if (v->destroy) {
-                v->destroy(b);
-                b->_checkIsDestroyed();
-            }
+            // destroy() has been called by destroyUnmarkedItems() already
 #ifdef V4_USE_HEAPTRACK
-            heaptrack_report_free(itemToFree);
+            heaptrack_report_free(o + index);
 #endif
         }
-        Q_V4_PROFILE_DEALLOC(engine, qPopulationCount((objectBitmap[i] | extendsBitmap[i])
-                                                      - (blackBitmap[i] | e)) * Chunk::SlotSize,
-                             Profiling::SmallItem);
+        if (engine) {
+            Q_V4_PROFILE_DEALLOC(engine, qPopulationCount((objectBitmap[i] | extendsBitmap[i])
+                                                          - (blackBitmap[i] | e)) * Chunk::SlotSize,
+                                 Profiling::SmallItem);
+        }
         objectBitmap[i] = blackBitmap[i];
-        grayBitmap[i] = 0;
-        hasUsedSlots |= (blackBitmap[i] != 0);
+        destroyBitmap[i] &= blackBitmap[i];
+        // When keeping the marks, the gray bits are the remembered set. The write barrier might
+        // set them on the engine's thread while we sweep, so they must not be touched here.
+        if (!keepMarks) {
+            blackBitmap[i] = 0;
+            grayBitmap[i] = 0;
+        }
+        hasUsedSlots |= (objectBitmap[i] != 0);
         extendsBitmap[i] = e;
         lastSlotFree = !((objectBitmap[i]|extendsBitmap[i]) >> (sizeof(quintptr)*8 - 1));
         SDUMP() << "        new extends =" << binary(e);
@@ -401,6 +633,7 @@ void Chunk::freeAll(ExecutionEngine *engine)
                              - qPopulationCount(e)) * Chunk::SlotSize, Profiling::SmallItem);
         objectBitmap[i] = 0;
         grayBitmap[i] = 0;
+        destroyBitmap[i] = 0;
         extendsBitmap[i] = e;
         o += Chunk::Bits;
     }
@@ -412,6 +645,11 @@ void Chunk::resetBlackBits()
     memset(blackBitmap, 0, sizeof(blackBitmap));
 }
 
+void Chunk::resetGrayBits()
+{
+    memset(grayBitmap, 0, sizeof(grayBitmap));
+}
+
 #ifdef MM_STATS
 static uint nGrayItems = 0;
 #endif
@@ -438,6 +676,8 @@ void Chunk::collectGrayItems(MarkStack *markStack)
             Heap::Base *b = *itemToFree;
             Q_ASSERT(b->inUse());
             markStack->push(b);
+            if (markStack->top >= markStack->limit)
+                markStack->drain();
 #ifdef MM_STATS
             ++nGrayItems;
 //            qDebug() << "adding gray item" << b << "to mark stack";
@@ -454,21 +694,17 @@ void Chunk::sortIntoBins(HeapItem **bins, uint nBins)
 {
 //    qDebug() << "sortIntoBins:";
     HeapItem *base = realBase();
-#if QT_POINTER_SIZE == 8
-    const int start = 0;
-#else
-    const int start = 1;
-#endif
+    // the header occupies the first slots, skip all bitmap entries that only cover the header
+    const uint headerSlots = HeaderSize/SlotSize;
+    const int start = headerSlots/Bits;
 #ifdef MM_STATS
     uint freeSlots = 0;
     uint allocatedSlots = 0;
 #endif
     for (int i = start; i < EntriesInBitmap; ++i) {
         quintptr usedSlots = (objectBitmap[i]|extendsBitmap[i]);
-#if QT_POINTER_SIZE == 8
-        if (!i)
-            usedSlots |= (static_cast<quintptr>(1) << (HeaderSize/SlotSize)) - 1;
-#endif
+        if (i == start)
+            usedSlots |= (static_cast<quintptr>(1) << (headerSlots % Bits)) - 1;
 #ifdef MM_STATS
         allocatedSlots += qPopulationCount(usedSlots);
 //        qDebug() << hex << "   i=" << i << "used=" << usedSlots;
@@ -523,88 +759,95 @@ HeapItem *BlockAllocator::allocate(size_t size, bool forceAllocation) {
     HeapItem **last;
 
     HeapItem *m;
+    Chunk *newChunk;
 
-    if (slotsRequired < NumBins - 1) {
-        m = freeBins[slotsRequired];
-        if (m) {
-            freeBins[slotsRequired] = m->freeData.next;
-            goto done;
+    // The chunks that are still being swept will have free memory, so wait for them one
+    // batch after the other before allocating a new chunk.
+    while (true) {
+        if (slotsRequired < NumBins - 1) {
+            m = freeBins[slotsRequired];
+            if (m) {
+                freeBins[slotsRequired] = m->freeData.next;
+                goto done;
+            }
         }
-    }
 
-    if (nFree >= slotsRequired) {
-        // use bump allocation
-        Q_ASSERT(nextFree);
-        m = nextFree;
-        nextFree += slotsRequired;
-        nFree -= slotsRequired;
-        goto done;
-    }
+        if (nFree >= slotsRequired) {
+            // use bump allocation
+            Q_ASSERT(nextFree);
+            m = nextFree;
+            nextFree += slotsRequired;
+            nFree -= slotsRequired;
+            goto done;
+        }
 
-    //        DEBUG << "No matching bin found for item" << size << bin;
-    // search last bin for a large enough item
-    last = &freeBins[NumBins - 1];
-    while ((m = *last)) {
-        if (m->freeData.availableSlots >= slotsRequired) {
-            *last = m->freeData.next; // take it out of the list
+        //        DEBUG << "No matching bin found for item" << size << bin;
+        // search last bin for a large enough item
+        last = &freeBins[NumBins - 1];
+        while ((m = *last)) {
+            if (m->freeData.availableSlots >= slotsRequired) {
+                *last = m->freeData.next; // take it out of the list
 
-            size_t remainingSlots = m->freeData.availableSlots - slotsRequired;
-            //                DEBUG << "found large free slots of size" << m->freeData.availableSlots << m << "remaining" << remainingSlots;
-            if (remainingSlots == 0)
-                goto done;
+                size_t remainingSlots = m->freeData.availableSlots - slotsRequired;
+                //                DEBUG << "found large free slots of size" << m->freeData.availableSlots << m << "remaining" << remainingSlots;
+                if (remainingSlots == 0)
+                    goto done;
 
-            HeapItem *remainder = m + slotsRequired;
-            if (remainingSlots > nFree) {
-                if (nFree) {
-                    size_t bin = binForSlots(nFree);
-                    nextFree->freeData.next = freeBins[bin];
-                    nextFree->freeData.availableSlots = nFree;
-                    freeBins[bin] = nextFree;
+                HeapItem *remainder = m + slotsRequired;
+                if (remainingSlots > nFree) {
+                    if (nFree) {
+                        size_t bin = binForSlots(nFree);
+                        nextFree->freeData.next = freeBins[bin];
+                        nextFree->freeData.availableSlots = nFree;
+                        freeBins[bin] = nextFree;
+                    }
+                    nextFree = remainder;
+                    nFree = remainingSlots;
+                } else {
+                    remainder->freeData.availableSlots = remainingSlots;
+                    size_t binForRemainder = binForSlots(remainingSlots);
+                    remainder->freeData.next = freeBins[binForRemainder];
+                    freeBins[binForRemainder] = remainder;
                 }
-                nextFree = remainder;
-                nFree = remainingSlots;
-            } else {
-                remainder->freeData.availableSlots = remainingSlots;
-                size_t binForRemainder = binForSlots(remainingSlots);
-                remainder->freeData.next = freeBins[binForRemainder];
-                freeBins[binForRemainder] = remainder;
+                goto done;
             }
-            goto done;
+            last = &m->freeData.next;
         }
-        last = &m->freeData.next;
-    }
 
-    if (slotsRequired < NumBins - 1) {
-        // check if we can split up another slot
-        for (size_t i = slotsRequired + 1; i < NumBins - 1; ++i) {
-            m = freeBins[i];
-            if (m) {
-                freeBins[i] = m->freeData.next; // take it out of the list
+        if (slotsRequired < NumBins - 1) {
+            // check if we can split up another slot
+            for (size_t i = slotsRequired + 1; i < NumBins - 1; ++i) {
+                m = freeBins[i];
+                if (m) {
+                    freeBins[i] = m->freeData.next; // take it out of the list
 //                qDebug() << "got item" << slotsRequired << "from slot" << i;
-                size_t remainingSlots = i - slotsRequired;
-                Q_ASSERT(remainingSlots < NumBins - 1);
-                HeapItem *remainder = m + slotsRequired;
-                remainder->freeData.availableSlots = remainingSlots;
-                remainder->freeData.next = freeBins[remainingSlots];
-                freeBins[remainingSlots] = remainder;
-                goto done;
+                    size_t remainingSlots = i - slotsRequired;
+                    Q_ASSERT(remainingSlots < NumBins - 1);
+                    HeapItem *remainder = m + slotsRequired;
+                    remainder->freeData.availableSlots = remainingSlots;
+                    remainder->freeData.next = freeBins[remainingSlots];
+                    freeBins[remainingSlots] = remainder;
+                    goto done;
+                }
             }
         }
-    }
 
-    if (!m) {
-        if (!forceAllocation)
-            return nullptr;
-        Chunk *newChunk = chunkAllocator->allocate();
-        Q_V4_PROFILE_ALLOC(engine, Chunk::DataSize, Profiling::HeapPage);
-        chunks.push_back(newChunk);
-        nextFree = newChunk->first();
-        nFree = Chunk::AvailableSlots;
-        m = nextFree;
-        nextFree += slotsRequired;
-        nFree -= slotsRequired;
+        if (Q_LIKELY(!sweeper))
+            break;
+        adoptSweptChunks();
     }
 
+    if (!forceAllocation)
+        return nullptr;
+    newChunk = chunkAllocator->allocate();
+    Q_V4_PROFILE_ALLOC(engine, Chunk::DataSize, Profiling::HeapPage);
+    chunks.push_back(newChunk);
+    nextFree = newChunk->first();
+    nFree = Chunk::AvailableSlots;
+    m = nextFree;
+    nextFree += slotsRequired;
+    nFree -= slotsRequired;
+
 done:
     m->setAllocatedSlots(slotsRequired);
     Q_V4_PROFILE_ALLOC(engine, slotsRequired * Chunk::SlotSize, Profiling::SmallItem);
@@ -615,8 +858,51 @@ done:
     return m;
 }
 
-void BlockAllocator::sweep()
+/*
+ * Sweeps chunks on a worker thread. The destructors have been run on the engine's thread
+ * before, so all that is left is updating the chunk bitmaps. The allocator adopts the chunks
+ * in order once they have been swept.
+ */
+struct ConcurrentSweeper
 {
+    void sweepChunks()
+    {
+        {
+            QMutexLocker locker(&mutex);
+            started = true;
+        }
+        for (Chunk *c : chunks) {
+            c->sweep(nullptr, keepMarks);
+            QMutexLocker locker(&mutex);
+            ++nSwept;
+            chunkSwept.wakeAll();
+        }
+    }
+
+    std::vector<Chunk *> chunks; // not modified while sweeping
+    bool keepMarks = false;
+    QRunnable *task = nullptr;
+    QMutex mutex;
+    QWaitCondition chunkSwept;
+    size_t nSwept = 0; // protected by mutex
+    bool started = false; // protected by mutex
+    size_t nAdopted = 0; // only used from the engine's thread
+};
+
+namespace {
+struct ConcurrentSweepTask : QRunnable
+{
+    ConcurrentSweepTask(const QSharedPointer<ConcurrentSweeper> &sweeper) : sweeper(sweeper) {}
+    void run() override { sweeper->sweepChunks(); }
+
+    QSharedPointer<ConcurrentSweeper> sweeper;
+};
+}
+
+void BlockAllocator::sweep(bool concurrently, bool keepMarks)
+{
+    Q_ASSERT(!sweeper);
+
     nextFree = nullptr;
     nFree = 0;
     memset(freeBins, 0, sizeof(freeBins));
@@ -624,21 +910,92 @@ void BlockAllocator::sweep()
 //    qDebug() << "BlockAlloc: sweep";
     usedSlotsAfterLastSweep = 0;
 
-    auto isFree = [this] (Chunk *c) {
-        bool isUsed = c->sweep(engine);
+    std::vector<Chunk *> chunksToSweep;
+    chunksToSweep.swap(chunks);
+
+    if (defragment) {
+        // Objects can't be moved, but the allocator can stay away from sparse chunks. Allocation
+        // takes the free slots of the chunk sorted into the bins last first, so the densest
+        // chunks get refilled while the sparse ones are left alone and get freed once their
+        // remaining objects die.
+        std::vector<std::pair<uint, Chunk *>> byLiveItems;
+        byLiveItems.reserve(chunksToSweep.size());
+        for (Chunk *c : chunksToSweep) {
+            uint liveItems = 0;
+            for (uint i = 0; i < Chunk::EntriesInBitmap; ++i)
+                liveItems += qPopulationCount(c->blackBitmap[i]);
+            byLiveItems.push_back(std::make_pair(liveItems, c));
+        }
+        std::sort(byLiveItems.begin(), byLiveItems.end());
+        for (size_t i = 0; i < byLiveItems.size(); ++i)
+            chunksToSweep[i] = byLiveItems[i].second;
+    }
 
-        if (isUsed) {
-            c->sortIntoBins(freeBins, NumBins);
-            usedSlotsAfterLastSweep += c->nUsedSlots();
-        } else {
-            Q_V4_PROFILE_DEALLOC(engine, Chunk::DataSize, Profiling::HeapPage);
-            chunkAllocator->free(c);
+    if (!concurrently || !sweeperThread || chunksToSweep.empty()) {
+        for (Chunk *c : chunksToSweep) {
+            c->destroyUnmarkedItems();
+            c->sweep(engine, keepMarks);
+            adoptSweptChunk(c);
         }
-        return !isUsed;
-    };
+        return;
+    }
 
-    auto newEnd = std::remove_if(chunks.begin(), chunks.end(), isFree);
-    chunks.erase(newEnd, chunks.end());
+    // destructors might touch anything, they need to run on our thread
+    for (Chunk *c : chunksToSweep)
+        c->destroyUnmarkedItems();
+
+    sweeper.reset(new ConcurrentSweeper);
+    sweeper->chunks.swap(chunksToSweep);
+    sweeper->keepMarks = keepMarks;
+    sweeper->task = new ConcurrentSweepTask(sweeper);
+    sweeperThread->start(sweeper->task);
+}
+
+void BlockAllocator::finishSweep()
+{
+    while (sweeper)
+        adoptSweptChunks();
+}
+
+void BlockAllocator::adoptSweptChunks()
+{
+    Q_ASSERT(sweeper);
+    ConcurrentSweeper *s = sweeper.data();
+
+    size_t nSwept;
+    {
+        QMutexLocker locker(&s->mutex);
+        if (s->nSwept == s->nAdopted && !s->started) {
+            // the thread didn't pick it up yet, don't wait for it and sweep here instead
+            locker.unlock();
+            if (sweeperThread->tryTake(s->task)) {
+                delete s->task;
+                s->sweepChunks();
+            }
+            locker.relock();
+        }
+        while (s->nSwept == s->nAdopted)
+            s->chunkSwept.wait(&s->mutex);
+        nSwept = s->nSwept;
+    }
+
+    for (; s->nAdopted < nSwept; ++s->nAdopted)
+        adoptSweptChunk(s->chunks.at(s->nAdopted));
+
+    if (s->nAdopted == s->chunks.size())
+        sweeper.reset();
+}
+
+void BlockAllocator::adoptSweptChunk(Chunk *c)
+{
+    if (Chunk::hasNonZeroBit(c->objectBitmap)) {
+        c->sortIntoBins(freeBins, NumBins);
+        usedSlotsAfterLastSweep += c->nUsedSlots();
+        chunks.push_back(c);
+    } else {
+        Q_V4_PROFILE_DEALLOC(engine, Chunk::DataSize, Profiling::HeapPage);
+        chunkAllocator->free(c);
+    }
 }
 
 void BlockAllocator::freeAll()
@@ -652,32 +1009,56 @@ void BlockAllocator::freeAll()
 
 void BlockAllocator::resetBlackBits()
 {
+    finishSweep();
     for (auto c : chunks)
         c->resetBlackBits();
 }
 
+void BlockAllocator::resetGrayBits()
+{
+    finishSweep();
+    for (auto c : chunks)
+        c->resetGrayBits();
+}
+
 void BlockAllocator::collectGrayItems(MarkStack *markStack)
 {
+    finishSweep();
     for (auto c : chunks)
         c->collectGrayItems(markStack);
 
 }
 
+// Segments of their own get reserved in size classes, a quarter of a power of two apart, so
+// that a cached segment fits items of a similar size.
+static size_t hugeSegmentSize(size_t size)
+{
+    const size_t step = (static_cast<size_t>(1) << (63 - qCountLeadingZeroBits(quint64(size))))/4;
+    return (size + step - 1) & ~(step - 1);
+}
+
 HeapItem *HugeItemAllocator::allocate(size_t size) {
     MemorySegment *m = nullptr;
     Chunk *c = nullptr;
     if (size >= MemorySegment::SegmentSize/2) {
         // too large to handle through the ChunkAllocator, let's get our own memory segement
-        size_t segmentSize = size + Chunk::HeaderSize; // space required for the Chunk header
+        size += Chunk::HeaderSize; // space required for the Chunk header
         size_t pageSize = WTF::pageSize();
-        segmentSize = (segmentSize + pageSize - 1) & ~(pageSize - 1); // align to page sizes
-        m = new MemorySegment(segmentSize);
         size = (size + pageSize - 1) & ~(pageSize - 1); // align to page sizes
-        c = m->allocate(size);
+        m = takeCachedSegment(size);
+        if (m) {
+            ++counters.segmentsReused;
+            c = m->reuseForHugeItem(size);
+        } else {
+            ++counters.segmentsMapped;
+            m = new MemorySegment(hugeSegmentSize(size));
+            c = m->allocate(size);
+        }
     } else {
         c = chunkAllocator->allocate(size);
     }
     Q_ASSERT(c);
+    ++counters.allocations;
     chunks.push_back(HugeChunk{m, c, size});
     Chunk::setBit(c->objectBitmap, c->first() - c->realBase());
     Q_V4_PROFILE_ALLOC(engine, size, Profiling::LargeItem);
@@ -687,7 +1068,34 @@ HeapItem *HugeItemAllocator::allocate(size_t size) {
     return c->first();
 }
 
-static void freeHugeChunk(ChunkAllocator *chunkAllocator, const HugeItemAllocator::HugeChunk &c, ClassDestroyStatsCallback classCountPtr)
+// takes the smallest cached segment the item fits into
+MemorySegment *HugeItemAllocator::takeCachedSegment(size_t size)
+{
+    auto best = cachedSegments.end();
+    for (auto it = cachedSegments.begin(); it != cachedSegments.end(); ++it) {
+        const MemorySegment *m = *it;
+        if (m->availableBytes < size
+                || (size < MemorySegment::SegmentSize && (size - 1)/Chunk::ChunkSize >= m->nChunks)) {
+            continue;
+        }
+        if (best == cachedSegments.end() || m->availableBytes < (*best)->availableBytes)
+            best = it;
+    }
+    if (best == cachedSegments.end())
+        return nullptr;
+    MemorySegment *m = *best;
+    cachedSegments.erase(best);
+    cachedBytes -= m->availableBytes;
+    return m;
+}
+
+void HugeItemAllocator::releaseSegment(MemorySegment *segment)
+{
+    ++counters.segmentsUnmapped;
+    delete segment;
+}
+
+void HugeItemAllocator::freeHugeChunk(const HugeChunk &c, ClassDestroyStatsCallback classCountPtr)
 {
     HeapItem *itemToFree = c.chunk->first();
     Heap::Base *b = *itemToFree;
@@ -701,8 +1109,16 @@ static void freeHugeChunk(ChunkAllocator *chunkAllocator, const HugeItemAllocato
     }
     if (c.segment) {
         // own memory segment
-        c.segment->free(c.chunk, c.size);
-        delete c.segment;
+        if (c.segment->availableBytes <= cacheLimit) {
+            // the segments that died last are the most likely to fit the next huge items
+            trimCachedSegments(cacheLimit - c.segment->availableBytes);
+            c.segment->freeHugeItem(c.size, decommitCachedSegments);
+            cachedSegments.push_back(c.segment);
+            cachedBytes += c.segment->availableBytes;
+        } else {
+            c.segment->free(c.chunk, c.size);
+            releaseSegment(c.segment);
+        }
     } else {
         chunkAllocator->free(c.chunk, c.size);
     }
@@ -711,14 +1127,16 @@ static void freeHugeChunk(ChunkAllocator *chunkAllocator, const HugeItemAllocato
 #endif
 }
 
-void HugeItemAllocator::sweep(ClassDestroyStatsCallback classCountPtr)
+void HugeItemAllocator::sweep(ClassDestroyStatsCallback classCountPtr, bool keepMarks)
 {
-    auto isBlack = [this, classCountPtr] (const HugeChunk &c) {
+    auto isBlack = [this, classCountPtr, keepMarks] (const HugeChunk &c) {
         bool b = c.chunk->first()->isBlack();
-        Chunk::clearBit(c.chunk->blackBitmap, c.chunk->first() - c.chunk->realBase());
+        if (!keepMarks)
+            Chunk::clearBit(c.chunk->blackBitmap, c.chunk->first() - c.chunk->realBase());
+        Chunk::clearBit(c.chunk->grayBitmap, c.chunk->first() - c.chunk->realBase());
         if (!b) {
             Q_V4_PROFILE_DEALLOC(engine, c.size, Profiling::LargeItem);
-            freeHugeChunk(chunkAllocator, c, classCountPtr);
+            freeHugeChunk(c, classCountPtr);
         }
         return !b;
     };
@@ -735,22 +1153,40 @@ void HugeItemAllocator::resetBlackBits()
 
 void HugeItemAllocator::collectGrayItems(MarkStack *markStack)
 {
-    for (auto c : chunks)
+    for (auto c : chunks) {
+        const size_t index = c.chunk->first() - c.chunk->realBase();
         // Correct for a Steele type barrier
-        if (Chunk::testBit(c.chunk->blackBitmap, c.chunk->first() - c.chunk->realBase()) &&
-            Chunk::testBit(c.chunk->grayBitmap, c.chunk->first() - c.chunk->realBase())) {
+        if (Chunk::testBit(c.chunk->blackBitmap, index) && Chunk::testBit(c.chunk->grayBitmap, index)) {
             HeapItem *i = c.chunk->first();
             Heap::Base *b = *i;
-            b->mark(markStack);
+            // the item is black already, so mark() would ignore it
+            markStack->push(b);
+            if (markStack->top >= markStack->limit)
+                markStack->drain();
         }
+        Chunk::clearBit(c.chunk->grayBitmap, index);
+    }
 }
 
 void HugeItemAllocator::freeAll()
 {
     for (auto &c : chunks) {
         Q_V4_PROFILE_DEALLOC(engine, c.size, Profiling::LargeItem);
-        freeHugeChunk(chunkAllocator, c, nullptr);
+        freeHugeChunk(c, nullptr);
     }
+    chunks.clear();
+    releaseCachedSegments();
+}
+
+void HugeItemAllocator::trimCachedSegments(size_t limit)
+{
+    // the oldest ones go first
+    auto it = cachedSegments.begin();
+    for (; it != cachedSegments.end() && cachedBytes > limit; ++it) {
+        cachedBytes -= (*it)->availableBytes;
+        releaseSegment(*it);
+    }
+    cachedSegments.erase(cachedSegments.begin(), it);
 }
 
 
@@ -765,6 +1201,10 @@ MemoryManager::MemoryManager(ExecutionEngine *engine)
     , aggressiveGC(!qEnvironmentVariableIsEmpty("QV4_MM_AGGRESSIVE_GC"))
     , gcStats(lcGcStats().isDebugEnabled())
     , gcCollectorStats(lcGcAllocatorStats().isDebugEnabled())
+    , incrementalGC(!qEnvironmentVariableIsEmpty(QV4_MM_INCREMENTAL_GC))
+    , concurrentSweep(!qEnvironmentVariableIsEmpty(QV4_MM_CONCURRENT_SWEEP))
+    // both need the write barrier, incremental marking takes precedence
+    , generationalGC(!incrementalGC && !qEnvironmentVariableIsEmpty(QV4_MM_GENERATIONAL_GC))
 {
 #ifdef V4_USE_VALGRIND
     VALGRIND_CREATE_MEMPOOL(this, 0, true);
@@ -772,6 +1212,36 @@ MemoryManager::MemoryManager(ExecutionEngine *engine)
     memset(statistics.allocations, 0, sizeof(statistics.allocations));
     if (gcStats)
         blockAllocator.allocationStats = statistics.allocations;
+    blockAllocator.defragment = !qEnvironmentVariableIsEmpty(QV4_MM_DEFRAGMENT);
+    hugeItemAllocator.decommitCachedSegments = !qEnvironmentVariableIsEmpty(QV4_MM_HUGE_ITEM_DECOMMIT);
+    setHeapGrowth(qEnvironmentVariableIntValue(QV4_MM_HEAP_GROWTH));
+
+    bool ok = false;
+    const int hugeItemCache = qEnvironmentVariableIntValue(QV4_MM_HUGE_ITEM_CACHE, &ok);
+    // kept small, every engine (including those of worker scripts) has a cache of its own
+    hugeItemAllocator.cacheLimit = ok ? size_t(qMax(hugeItemCache, 0))
+                                      : size_t(DefaultHugeItemCacheSegments*MemorySegment::SegmentSize);
+
+    gcSliceTime = qEnvironmentVariableIntValue(QV4_MM_GC_SLICE_TIME, &ok);
+    if (!ok || gcSliceTime <= 0)
+        gcSliceTime = DEFAULT_GC_SLICE_TIME;
+
+    if (generationalGC)
+        engine->writeBarrierActive = WriteBarrier::RememberingBarrier;
+
+    if (!qEnvironmentVariableIsEmpty(QV4_MM_PARALLEL_MARK)) {
+        markingThreads = qEnvironmentVariableIntValue(QV4_MM_PARALLEL_MARK, &ok);
+        if (!ok || markingThreads <= 0)
+            markingThreads = QThread::idealThreadCount();
+        // the engine's thread is marking as well
+        markingThreads = qMin(markingThreads, QThreadPool::globalInstance()->maxThreadCount() + 1);
+    }
+
+    if (concurrentSweep || incrementalGC) {
+        sweeperThreadPool = new QThreadPool;
+        sweeperThreadPool->setMaxThreadCount(1);
+        blockAllocator.sweeperThread = sweeperThreadPool;
+    }
 }
 
 #ifdef MM_STATS
@@ -786,6 +1256,7 @@ Heap::Base *MemoryManager::allocString(std::size_t unmanagedSize)
     lastAllocRequestedSlots = stringSize >> Chunk::SlotSizeShift;
     ++allocationCount;
 #endif
+    bytesAllocatedSinceLastGC += stringSize;
 
     bool didGCRun = false;
     if (aggressiveGC) {
@@ -796,9 +1267,12 @@ Heap::Base *MemoryManager::allocString(std::size_t unmanagedSize)
     unmanagedHeapSize += unmanagedSize;
     if (unmanagedHeapSize > unmanagedHeapSizeGCLimit) {
         if (!didGCRun)
-            runGC();
+            triggerGC();
 
-        if (3*unmanagedHeapSizeGCLimit <= 4*unmanagedHeapSize)
+        if (gcState == IncrementalMark)
+            // memory only gets freed once marking is done, do the next step after some more allocations
+            unmanagedHeapSizeGCLimit = unmanagedHeapSize + MIN_UNMANAGED_HEAPSIZE_GC_LIMIT;
+        else if (3*unmanagedHeapSizeGCLimit <= 4*unmanagedHeapSize)
             // more than 75% full, raise limit
             unmanagedHeapSizeGCLimit = std::max(unmanagedHeapSizeGCLimit, unmanagedHeapSize) * 2;
         else if (unmanagedHeapSize * 4 <= unmanagedHeapSizeGCLimit)
@@ -810,12 +1284,14 @@ Heap::Base *MemoryManager::allocString(std::size_t unmanagedSize)
     HeapItem *m = blockAllocator.allocate(stringSize);
     if (!m) {
         if (!didGCRun && shouldRunGC())
-            runGC();
+            triggerGC();
         m = blockAllocator.allocate(stringSize, true);
     }
 
 //    qDebug() << "allocated string" << m;
     memset(m, 0, stringSize);
+    if (Q_UNLIKELY(gcState == IncrementalMark))
+        markAllocatedDuringIncrementalMark(m);
     return *m;
 }
 
@@ -825,6 +1301,7 @@ Heap::Base *MemoryManager::allocData(std::size_t size)
     lastAllocRequestedSlots = size >> Chunk::SlotSizeShift;
     ++allocationCount;
 #endif
+    bytesAllocatedSinceLastGC += size;
 
     bool didRunGC = false;
     if (aggressiveGC) {
@@ -840,18 +1317,22 @@ Heap::Base *MemoryManager::allocData(std::size_t size)
     if (size > Chunk::DataSize) {
         HeapItem *h = hugeItemAllocator.allocate(size);
 //        qDebug() << "allocating huge item" << h;
+        if (Q_UNLIKELY(gcState == IncrementalMark))
+            markAllocatedDuringIncrementalMark(h);
         return *h;
     }
 
     HeapItem *m = blockAllocator.allocate(size);
     if (!m) {
         if (!didRunGC && shouldRunGC())
-            runGC();
+            triggerGC();
         m = blockAllocator.allocate(size, true);
     }
 
     memset(m, 0, size);
 //    qDebug() << "allocating data" << m;
+    if (Q_UNLIKELY(gcState == IncrementalMark))
+        markAllocatedDuringIncrementalMark(m);
     return *m;
 }
 
@@ -871,7 +1352,10 @@ Heap::Object *MemoryManager::allocObjectWithMemberData(const QV4::VTable *vtable
         Heap::MemberData *m;
         if (totalSize > Chunk::DataSize) {
             o = static_cast<Heap::Object *>(allocData(size));
-            m = hugeItemAllocator.allocate(memberSize)->as<Heap::MemberData>();
+            HeapItem *mh = hugeItemAllocator.allocate(memberSize);
+            if (Q_UNLIKELY(gcState == IncrementalMark))
+                markAllocatedDuringIncrementalMark(mh);
+            m = mh->as<Heap::MemberData>();
         } else {
             HeapItem *mh = reinterpret_cast<HeapItem *>(allocData(totalSize));
             Heap::Base *b = *mh;
@@ -882,6 +1366,8 @@ Heap::Object *MemoryManager::allocObjectWithMemberData(const QV4::VTable *vtable
             size_t index = mh - c->realBase();
             Chunk::setBit(c->objectBitmap, index);
             Chunk::clearBit(c->extendsBitmap, index);
+            if (Q_UNLIKELY(gcState == IncrementalMark))
+                markAllocatedDuringIncrementalMark(mh);
         }
         o->memberData.set(engine, m);
         m->internalClass = engine->internalClasses[EngineBase::Class_MemberData];
@@ -895,7 +1381,114 @@ Heap::Object *MemoryManager::allocObjectWithMemberData(const QV4::VTable *vtable
     return o;
 }
 
-static uint markStackSize = 0;
+/*
+ * Drains mark stacks on several threads at once. Every thread marks from its own stack. As
+ * soon as some thread runs out of work, the others hand over the older half of their stacks
+ * through a shared pool. A worker whose stack gets full hands over half of it right away.
+ * Marking is done once all threads are idle and the pool is empty.
+ *
+ * Marking the children of a QObject wrapper looks at the QObject, its QQmlData and its
+ * children, which may only happen on the engine's thread. Workers pass these items on to it.
+ */
+struct ParallelMarker
+{
+    enum {
+        MinItemsToShare = 256,
+        StackSize = ExecutionEngine::GCStackLimit/sizeof(Heap::Base *)
+    };
+
+    void markFrom(MarkStack *stack)
+    {
+        while (true) {
+            while (stack->top > stack->base) {
+                Heap::Base *h = stack->pop();
+                if (stack->worker && handOverToEngineThread(h))
+                    continue;
+                ++stack->markedItems;
+                Q_ASSERT(h);
+                h->markChildren(stack);
+                if ((stack->worker && stack->top >= stack->limit)
+                        || (idleThreads.load() && stack->top - stack->base >= MinItemsToShare)) {
+                    shareWork(stack);
+                }
+            }
+            if (!takeWork(stack))
+                break;
+        }
+    }
+
+    static bool needsEngineThread(Heap::Base *h)
+    {
+        for (const VTable *vt = h->vtable(); vt; vt = vt->parent) {
+            if (vt == QObjectWrapper::staticVTable())
+                return true;
+        }
+        return false;
+    }
+
+    bool handOverToEngineThread(Heap::Base *h)
+    {
+        if (!needsEngineThread(h))
+            return false;
+        QMutexLocker locker(&mutex);
+        engineThreadWork.push_back(h);
+        workAvailable.wakeAll();
+        return true;
+    }
+
+    void shareWork(MarkStack *stack)
+    {
+        const size_t n = (stack->top - stack->base)/2;
+        std::vector<Heap::Base *> work(stack->base, stack->base + n);
+        memmove(stack->base, stack->base + n, (stack->top - stack->base - n)*sizeof(Heap::Base *));
+        stack->top -= n;
+
+        QMutexLocker locker(&mutex);
+        pool.push_back(std::move(work));
+        workAvailable.wakeOne();
+    }
+
+    bool takeWork(MarkStack *stack)
+    {
+        const bool engineThread = !stack->worker;
+        QMutexLocker locker(&mutex);
+        idleThreads.ref();
+        while (pool.empty() && !(engineThread && !engineThreadWork.empty()) && !done) {
+            if (idleThreads.load() == activeThreads && engineThreadWork.empty()) {
+                done = true;
+                workAvailable.wakeAll();
+                break;
+            }
+            workAvailable.wait(&mutex);
+        }
+        if (done)
+            return false;
+
+        idleThreads.deref();
+        std::vector<Heap::Base *> &work = (engineThread && !engineThreadWork.empty())
+                ? engineThreadWork : pool.back();
+        // leave room for the children of what we take
+        const size_t n = qMin(work.size(), size_t(stack->limit - stack->base)/2);
+        memcpy(stack->top, work.data() + work.size() - n, n*sizeof(Heap::Base *));
+        stack->top += n;
+        work.resize(work.size() - n);
+        if (pool.size() && pool.back().empty())
+            pool.pop_back();
+        return true;
+    }
+
+    QMutex mutex;
+    QWaitCondition workAvailable;
+    QWaitCondition workerFinished;
+    std::vector<std::vector<Heap::Base *>> pool; // protected by mutex
+    std::vector<Heap::Base *> engineThreadWork; // protected by mutex
+    QAtomicInt idleThreads; // only modified with the mutex locked
+    int activeThreads = 1; // protected by mutex, the engine's thread is always marking
+    std::vector<bool> workerStarted; // protected by mutex
+    int pendingWorkers = 0; // protected by mutex
+    bool done = false; // protected by mutex
+    uint itemsMarked = 0; // by the workers, protected by mutex
+};
 
 MarkStack::MarkStack(ExecutionEngine *engine)
     : engine(engine)
@@ -905,16 +1498,84 @@ MarkStack::MarkStack(ExecutionEngine *engine)
     limit = base + ExecutionEngine::GCStackLimit/sizeof(Heap::Base)*3/4;
 }
 
+MarkStack::MarkStack(ExecutionEngine *engine, Heap::Base **stack, size_t size)
+    : engine(engine)
+{
+    base = stack;
+    top = base;
+    limit = base + size*3/4;
+}
+
 void MarkStack::drain()
 {
     while (top > base) {
         Heap::Base *h = pop();
-        ++markStackSize;
+        if (Q_UNLIKELY(worker) && worker->handOverToEngineThread(h))
+            continue;
+        ++markedItems;
         Q_ASSERT(h); // at this point we should only have Heap::Base objects in this area on the stack. If not, weird things might happen.
         h->markChildren(this);
     }
 }
 
+bool MarkStack::drain(QDeadlineTimer deadline)
+{
+    enum { ItemsBetweenDeadlineChecks = 64 };
+    while (top > base) {
+        // reading the clock is comparatively expensive, so only do it every couple of items
+        for (int i = 0; i < ItemsBetweenDeadlineChecks && top > base; ++i) {
+            Heap::Base *h = pop();
+            ++markedItems;
+            Q_ASSERT(h);
+            h->markChildren(this);
+        }
+        if (deadline.hasExpired())
+            return top == base;
+    }
+    return true;
+}
+
+namespace {
+
+struct ParallelMarkTask : QRunnable
+{
+    ParallelMarkTask(ParallelMarker *marker, ExecutionEngine *engine, int index)
+        : marker(marker), engine(engine), index(index)
+    {}
+
+    void run() override
+    {
+        {
+            QMutexLocker locker(&marker->mutex);
+            marker->workerStarted[index] = true;
+            if (marker->done) {
+                // started too late to be of any help
+                --marker->pendingWorkers;
+                marker->workerFinished.wakeAll();
+                return;
+            }
+            ++marker->activeThreads;
+        }
+
+        std::unique_ptr<Heap::Base *[]> stackData(new Heap::Base *[ParallelMarker::StackSize]);
+        MarkStack stack(engine, stackData.get(), ParallelMarker::StackSize);
+        stack.parallel = true;
+        stack.worker = marker;
+        marker->markFrom(&stack);
+
+        QMutexLocker locker(&marker->mutex);
+        marker->itemsMarked += stack.markedItems;
+        --marker->pendingWorkers;
+        marker->workerFinished.wakeAll();
+    }
+
+    ParallelMarker *marker;
+    ExecutionEngine *engine;
+    int index;
+};
+
+}
+
 void MemoryManager::collectRoots(MarkStack *markStack)
 {
     engine->markObjects(markStack);
@@ -962,12 +1623,49 @@ void MemoryManager::collectRoots(MarkStack *markStack)
 
 void MemoryManager::mark()
 {
-    markStackSize = 0;
-
     MarkStack markStack(engine);
     collectRoots(&markStack);
 
-    markStack.drain();
+    drainMarkStack(&markStack);
+    markedItems = markStack.markedItems;
+}
+
+void MemoryManager::drainMarkStack(MarkStack *markStack)
+{
+    if (markingThreads <= 1 || markStack->top == markStack->base) {
+        markStack->drain();
+        return;
+    }
+
+    // The engine's thread keeps marking as well, the workers take over parts of its stack
+    ParallelMarker marker;
+    QThreadPool *threadPool = QThreadPool::globalInstance();
+    const int nWorkers = markingThreads - 1;
+    std::vector<ParallelMarkTask *> tasks;
+    tasks.reserve(nWorkers);
+    marker.workerStarted.resize(nWorkers, false);
+    marker.pendingWorkers = nWorkers;
+    for (int i = 0; i < nWorkers; ++i) {
+        tasks.push_back(new ParallelMarkTask(&marker, engine, i));
+        threadPool->start(tasks.back());
+    }
+
+    markStack->parallel = true;
+    marker.markFrom(markStack);
+    markStack->parallel = false;
+
+    QMutexLocker locker(&marker.mutex);
+    // don't wait for workers the pool didn't get around to starting
+    for (int i = 0; i < nWorkers; ++i) {
+        if (!marker.workerStarted[i] && threadPool->tryTake(tasks[i])) {
+            delete tasks[i];
+            --marker.pendingWorkers;
+        }
+    }
+    while (marker.pendingWorkers)
+        marker.workerFinished.wait(&marker.mutex);
+
+    markStack->markedItems += marker.itemsMarked;
 }
 
 void MemoryManager::sweep(bool lastSweep, ClassDestroyStatsCallback classCountPtr)
@@ -1017,18 +1715,103 @@ void MemoryManager::sweep(bool lastSweep, ClassDestroyStatsCallback classCountPt
         }
     }
 
-    blockAllocator.sweep();
-    hugeItemAllocator.sweep(classCountPtr);
+    // the statistics and the profiler want to know about every freed item right away
+    // the incremental collector can't afford sweeping in its final pause
+    const bool sweepConcurrently = (concurrentSweep || incrementalGC) && !lastSweep && !gcStats && !gcCollectorStats
+            && !aggressiveGC && !engine->profiler() && !gcRecordCallback;
+    // survivors of a generational collection stay black, that's what makes them old
+    const bool keepMarks = generationalGC && !lastSweep;
+    blockAllocator.sweep(sweepConcurrently, keepMarks);
+    hugeItemAllocator.sweep(classCountPtr, keepMarks);
 }
 
-bool MemoryManager::shouldRunGC() const
+uint MemoryManager::currentHeapGrowth() const
 {
+    // Collecting a heap where almost everything survives (e.g. while the application creates
+    // its objects at startup) is wasted effort, so let it grow further before the next run.
+    return survivalRate > HighSurvivalRate ? 2*heapGrowth : heapGrowth;
+}
+
+bool MemoryManager::shouldRunGC()
+{
+    // the chunks still being swept are neither in the total nor in the used slots
+    blockAllocator.finishSweep();
     size_t total = blockAllocator.totalSlots();
-    if (total > MinSlotsGCLimit && usedSlotsAfterLastFullSweep * GCOverallocation < total * 100)
+    if (total > MinSlotsGCLimit && blockAllocator.usedSlotsAfterLastSweep * currentHeapGrowth() < total * 100)
         return true;
     return false;
 }
 
+bool MemoryManager::isGCDue()
+{
+    blockAllocator.finishSweep();
+
+    if (4*unmanagedHeapSize > 3*unmanagedHeapSizeGCLimit)
+        return true;
+
+    // roughly what can be allocated until shouldRunGC() asks for a collection
+    const size_t liveBytes = blockAllocator.usedSlotsAfterLastSweep*Chunk::SlotSize;
+    const size_t budget = qMax<size_t>(MinSlotsGCLimit*Chunk::SlotSize,
+                                       liveBytes*(currentHeapGrowth() - 100)/100);
+    if (2*bytesAllocatedSinceLastGC >= budget)
+        return true;
+
+    // at the current allocation rate, the collection will happen soon anyway
+    const size_t remaining = budget - bytesAllocatedSinceLastGC;
+    return remaining < allocationRate*IdleGCLookahead/1000;
+}
+
+void MemoryManager::updatePacing()
+{
+    // whatever the last collection left alive, sweeping has to be finished for this
+    Q_ASSERT(!blockAllocator.isSweeping());
+    const size_t liveBytes = blockAllocator.usedSlotsAfterLastSweep*Chunk::SlotSize;
+    if (liveBytesBeforeLastGC)
+        survivalRate = uint(qMin<size_t>(100, liveBytes*100/liveBytesBeforeLastGC));
+
+    const qint64 elapsed = timeSinceLastGC.isValid() ? timeSinceLastGC.elapsed() : 0;
+    if (elapsed > 0)
+        allocationRate = bytesAllocatedSinceLastGC*1000/size_t(elapsed);
+
+    liveBytesBeforeLastGC = liveBytes + bytesAllocatedSinceLastGC;
+    bytesAllocatedSinceLastGC = 0;
+}
+
+bool MemoryManager::collectInIdleTime(int msecs)
+{
+    if (gcBlocked || msecs <= 0)
+        return false;
+
+    // nothing is going to reuse the cached memory while the application is idle
+    hugeItemAllocator.releaseCachedSegments();
+
+    QDeadlineTimer deadline(msecs, Qt::PreciseTimer);
+
+    if (incrementalGC) {
+        if (gcState == NoGC && !isGCDue())
+            return false;
+        // a step takes about gcSliceTime, the last one also runs the destructors of dead items
+        do {
+            runIncrementalGCStep();
+        } while (gcState == IncrementalMark && deadline.remainingTime() > gcSliceTime);
+        return true;
+    }
+
+    if (!isGCDue())
+        return false;
+
+    const bool minor = generationalGC && !shouldRunFullGC();
+    const qint64 expectedPause = minor ? minorGCPause : fullGCPause;
+    if (expectedPause > deadline.remainingTimeNSecs())
+        return false;
+
+    if (minor)
+        runMinorGC();
+    else
+        runGC();
+    return true;
+}
+
 size_t dumpBins(BlockAllocator *b, bool printOutput = true)
 {
     const QLoggingCategory &stats = lcGcAllocatorStats();
@@ -1068,14 +1851,49 @@ void MemoryManager::runGC()
     QScopedValueRollback<bool> gcBlocker(gcBlocked, true);
 //    qDebug() << "runGC";
 
+    if (gcState == IncrementalMark) {
+        // A full collection got explicitly requested. Objects that died since the incremental
+        // collection started would survive it, so start over from scratch instead.
+        abortIncrementalMark();
+    }
+
+    QElapsedTimer pause;
+    pause.start();
+
+    // marking needs all chunks to be swept
+    blockAllocator.finishSweep();
+    updatePacing();
+
+    if (generationalGC) {
+        // a full collection needs to look at the old generation as well, and rebuilds the
+        // remembered set from scratch
+        blockAllocator.resetBlackBits();
+        blockAllocator.resetGrayBits();
+        hugeItemAllocator.resetBlackBits();
+        minorCollections = 0;
+    }
+
     if (gcStats) {
         statistics.maxReservedMem = qMax(statistics.maxReservedMem, getAllocatedMem());
         statistics.maxAllocatedMem = qMax(statistics.maxAllocatedMem, getUsedMem() + getLargeItemsMem());
     }
 
+    const bool recording = isRecordingGC();
+    GCRecord record;
+    if (recording)
+        startGCRecord(&record, GCRecord::FullCollection);
+
     if (!gcCollectorStats) {
+        QElapsedTimer t;
+        t.start();
         mark();
+        const qint64 markTime = t.nsecsElapsed();
+        if (recording)
+            recordFreedItems(&record);
+        t.restart();
         sweep();
+        if (recording)
+            finishGCRecord(&record, markTime, t.nsecsElapsed());
     } else {
         bool triggeredByUnmanagedHeap = (unmanagedHeapSize > unmanagedHeapSizeGCLimit);
         size_t oldUnmanagedSize = unmanagedHeapSize;
@@ -1103,12 +1921,18 @@ void MemoryManager::runGC()
         QElapsedTimer t;
         t.start();
         mark();
-        qint64 markTime = t.nsecsElapsed()/1000;
+        const qint64 markNSecs = t.nsecsElapsed();
+        qint64 markTime = markNSecs/1000;
+        if (recording)
+            recordFreedItems(&record);
         t.restart();
         sweep(false, increaseFreedCountForClass);
         const size_t usedAfter = getUsedMem();
         const size_t largeItemsAfter = getLargeItemsMem();
-        qint64 sweepTime = t.nsecsElapsed()/1000;
+        const qint64 sweepNSecs = t.nsecsElapsed();
+        qint64 sweepTime = sweepNSecs/1000;
+        if (recording)
+            finishGCRecord(&record, markNSecs, sweepNSecs);
 
         if (triggeredByUnmanagedHeap) {
             qDebug(stats) << "triggered by unmanaged heap:";
@@ -1118,7 +1942,7 @@ void MemoryManager::runGC()
         }
         size_t memInBins = dumpBins(&blockAllocator);
         qDebug(stats) << "Marked object in" << markTime << "us.";
-        qDebug(stats) << "   " << markStackSize << "objects marked";
+        qDebug(stats) << "   " << markedItems << "objects marked";
         qDebug(stats) << "Sweeped object in" << sweepTime << "us.";
 
         // sort our object types by number of freed instances
@@ -1154,6 +1978,205 @@ void MemoryManager::runGC()
         qDebug(stats) << "======== End GC ========";
     }
 
+    if (generationalGC)
+        updateOldGeneration(true);
+
+    fullGCPause = pause.nsecsElapsed();
+    finishGC();
+}
+
+void MemoryManager::runMinorGC()
+{
+    Q_ASSERT(generationalGC);
+    Q_ASSERT(gcState == NoGC);
+
+    if (gcBlocked)
+        return;
+
+    QScopedValueRollback<bool> gcBlocker(gcBlocked, true);
+
+    QElapsedTimer pause;
+    pause.start();
+
+    blockAllocator.finishSweep();
+    updatePacing();
+
+    if (gcStats) {
+        statistics.maxReservedMem = qMax(statistics.maxReservedMem, getAllocatedMem());
+        statistics.maxAllocatedMem = qMax(statistics.maxAllocatedMem, getUsedMem() + getLargeItemsMem());
+    }
+
+    const bool recording = isRecordingGC();
+    GCRecord record;
+    if (recording)
+        startGCRecord(&record, GCRecord::MinorCollection);
+
+    QElapsedTimer t;
+    t.start();
+    const size_t usedBefore = gcCollectorStats ? getUsedMem() : 0;
+
+    ++minorCollections;
+
+    // Old objects are still black from the previous collection, so marking stops as soon as
+    // it reaches one of them. The only old objects that need to be scanned are the gray ones:
+    // they got nursery objects stored into them since then.
+    MarkStack markStack(engine);
+    blockAllocator.collectGrayItems(&markStack);
+    hugeItemAllocator.collectGrayItems(&markStack);
+    collectRoots(&markStack);
+    drainMarkStack(&markStack);
+    markedItems = markStack.markedItems;
+
+    const qint64 markTime = t.nsecsElapsed();
+    if (recording)
+        recordFreedItems(&record);
+
+    sweep();
+
+    const qint64 sweepTime = t.nsecsElapsed() - markTime;
+    if (recording)
+        finishGCRecord(&record, markTime, sweepTime);
+
+    if (gcCollectorStats) {
+        const QLoggingCategory &stats = lcGcAllocatorStats();
+        qDebug(stats) << "========== Minor GC ==========";
+        qDebug(stats) << "Minor collection" << minorCollections << "since the last full collection";
+        qDebug(stats) << "Marked object in" << markTime/1000 << "us.";
+        qDebug(stats) << "   " << markedItems << "objects marked";
+        qDebug(stats) << "Sweeped object in" << sweepTime/1000 << "us.";
+        qDebug(stats) << "Freed up bytes      :" << (usedBefore - getUsedMem());
+        qDebug(stats) << "Old generation slots:" << blockAllocator.usedSlotsAfterLastSweep
+                      << "limit:" << oldGenerationSlotsLimit;
+        qDebug(stats) << "======== End Minor GC ========";
+    }
+
+    updateOldGeneration(false);
+
+    minorGCPause = pause.nsecsElapsed();
+    finishGC();
+}
+
+void MemoryManager::setHeapGrowth(int percent)
+{
+    // growing by less than 10% would mean collecting all the time
+    heapGrowth = percent > 0 ? uint(qMax(percent, 110)) : uint(GCOverallocation);
+}
+
+void MemoryManager::setSegmentPoolCapacity(int segments)
+{
+    if (SegmentPool *pool = segmentPool())
+        pool->setCapacity(uint(qMax(segments, 0)));
+}
+
+int MemoryManager::pooledSegments()
+{
+    SegmentPool *pool = segmentPool();
+    if (!pool)
+        return 0;
+    QMutexLocker locker(&pool->mutex);
+    return int(pool->segments.size());
+}
+
+size_t MemoryManager::oldGenerationSlots()
+{
+    blockAllocator.finishSweep();
+    // whatever survived the last collection is the old generation
+    return blockAllocator.usedSlotsAfterLastSweep + hugeItemAllocator.usedMem()/Chunk::SlotSize;
+}
+
+void MemoryManager::updateOldGeneration(bool fullCollection)
+{
+    // the survivors are only counted once all chunks are swept
+    blockAllocator.finishSweep();
+    if (fullCollection) {
+        // allow the old generation to grow from here until the next full collection
+        oldGenerationSlotsLimit = qMax<size_t>(MinSlotsGCLimit, oldGenerationSlots()*heapGrowth/100);
+    }
+}
+
+bool MemoryManager::shouldRunFullGC()
+{
+    // before the first full collection there is no limit yet
+    return oldGenerationSlotsLimit && oldGenerationSlots() > oldGenerationSlotsLimit;
+}
+
+bool MemoryManager::isRecordingGC() const
+{
+    return gcRecordCallback || Q_V4_PROFILE_GC_ENABLED(engine);
+}
+
+void MemoryManager::startGCRecord(GCRecord *record, GCRecord::Type type)
+{
+    record->type = type;
+    record->usedBefore = getUsedMem();
+    record->largeItemsBefore = getLargeItemsMem();
+    record->hugeItemsBefore = uint(hugeItemAllocator.chunks.size());
+}
+
+static size_t itemSize(Chunk *c, uint index)
+{
+    size_t slots = 1;
+    while (++index < Chunk::NumSlots && Chunk::testBit(c->extendsBitmap, index))
+        ++slots;
+    return slots*Chunk::SlotSize;
+}
+
+// Needs to run between marking and sweeping, when the dead items are the white ones.
+void MemoryManager::recordFreedItems(GCRecord *record)
+{
+    blockAllocator.finishSweep();
+    QHash<const char *, size_t> freedBytes;
+    for (Chunk *c : blockAllocator.chunks) {
+        HeapItem *o = c->realBase();
+        for (uint i = 0; i < Chunk::EntriesInBitmap; ++i) {
+            quintptr toFree = c->objectBitmap[i] ^ c->blackBitmap[i];
+            while (toFree) {
+                uint index = qCountTrailingZeroBits(toFree);
+                toFree ^= (static_cast<quintptr>(1) << index);
+
+                Heap::Base *b = *(o + index);
+                freedBytes[b->vtable()->className] += itemSize(c, i*Chunk::Bits + index);
+            }
+            o += Chunk::Bits;
+        }
+    }
+    for (const auto &c : hugeItemAllocator.chunks) {
+        HeapItem *item = c.chunk->first();
+        if (!item->isBlack()) {
+            Heap::Base *b = *item;
+            freedBytes[b->vtable()->className] += c.size;
+        }
+    }
+
+    record->freedBytesPerClass.reserve(freedBytes.size());
+    for (auto it = freedBytes.constBegin(); it != freedBytes.constEnd(); ++it)
+        record->freedBytesPerClass.push_back(std::make_pair(it.key(), it.value()));
+    std::sort(record->freedBytesPerClass.begin(), record->freedBytesPerClass.end(),
+              [](const GCRecord::FreedClass &a, const GCRecord::FreedClass &b) {
+        return a.second > b.second;
+    });
+}
+
+void MemoryManager::finishGCRecord(GCRecord *record, qint64 markTime, qint64 sweepTime)
+{
+    record->markTime = markTime;
+    record->sweepTime = sweepTime;
+    record->markedItems = markedItems;
+    record->usedAfter = getUsedMem();
+    record->largeItemsAfter = getLargeItemsMem();
+    record->hugeItemsAfter = uint(hugeItemAllocator.chunks.size());
+    for (Chunk *c : blockAllocator.chunks) {
+        const uint bucket = c->nUsedSlots()*GCRecord::OccupancyBuckets/Chunk::AvailableSlots;
+        ++record->chunkOccupancy[qMin<uint>(bucket, GCRecord::OccupancyBuckets - 1)];
+    }
+
+    if (gcRecordCallback)
+        gcRecordCallback(*record);
+    Q_V4_PROFILE_GC(engine, *record);
+}
+
+void MemoryManager::finishGC()
+{
     if (gcStats)
         statistics.maxUsedMem = qMax(statistics.maxUsedMem, getUsedMem() + getLargeItemsMem());
 
@@ -1162,20 +2185,235 @@ void MemoryManager::runGC()
         Q_ASSERT(blockAllocator.allocatedMem() == getUsedMem() + dumpBins(&blockAllocator, false));
     }
 
-    usedSlotsAfterLastFullSweep = blockAllocator.usedSlotsAfterLastSweep;
+    timeSinceLastGC.start();
+
+    if (blockAllocator.defragment) {
+        const size_t releasedSegments = chunkAllocator->releaseEmptySegments();
+        if (gcCollectorStats && releasedSegments)
+            qDebug(lcGcAllocatorStats()) << "Released" << releasedSegments << "empty memory segments";
+    }
+
+    // sweeping already reset the black bits, unless the survivors got promoted
+}
+
+void MemoryManager::triggerGC()
+{
+    if (incrementalGC) {
+        runIncrementalGCStep();
+    } else if (generationalGC && !gcBlocked && !shouldRunFullGC()) {
+        runMinorGC();
+    } else {
+        runGC();
+    }
+}
+
+void MemoryManager::runIncrementalGCStep()
+{
+    if (gcBlocked)
+        return;
+
+    QScopedValueRollback<bool> gcBlocker(gcBlocked, true);
+
+    if (gcState == NoGC) {
+        startIncrementalMark();
+        return;
+    }
+
+    const QDeadlineTimer deadline(gcSliceTime, Qt::PreciseTimer);
+    if (incrementalMarkSlice(deadline) && remark(deadline))
+        finishIncrementalGC();
+}
+
+void MemoryManager::startIncrementalMark()
+{
+    Q_ASSERT(gcState == NoGC);
+    Q_ASSERT(!m_markStack);
+
+    blockAllocator.finishSweep();
+    updatePacing();
 
-    // reset all black bits
+    if (gcStats) {
+        statistics.maxReservedMem = qMax(statistics.maxReservedMem, getAllocatedMem());
+        statistics.maxAllocatedMem = qMax(statistics.maxAllocatedMem, getUsedMem() + getLargeItemsMem());
+    }
+
+    QElapsedTimer t;
+    t.start();
+
+    incrementalSlices = 0;
+    remarkAttempts = 0;
+    allocatedScanned = 0;
+    allocatedScanLimit = 0;
+    m_markStack = new MarkStack(engine);
+    gcState = IncrementalMark;
+    engine->writeBarrierActive = WriteBarrier::MarkingBarrier;
+
+    collectRoots(m_markStack);
+    incrementalMarkTime = t.nsecsElapsed();
+}
+
+bool MemoryManager::incrementalMarkSlice(QDeadlineTimer deadline)
+{
+    Q_ASSERT(gcState == IncrementalMark);
+    ++incrementalSlices;
+    QElapsedTimer t;
+    t.start();
+    // Items get scanned in the slice after the one they were allocated in, by then whoever
+    // allocated them has usually finished initializing them.
+    const bool done = scanAllocatedDuringIncrementalMark(allocatedScanLimit, deadline)
+            && drainIncrementalMarkStack(deadline);
+    allocatedScanLimit = m_allocatedDuringIncrementalMark.size();
+    incrementalMarkTime += t.nsecsElapsed();
+    return done;
+}
+
+// Marks the children of the items allocated while marking, up to end.
+bool MemoryManager::scanAllocatedDuringIncrementalMark(size_t end, QDeadlineTimer deadline)
+{
+    enum { ItemsBetweenDeadlineChecks = 64 };
+    while (allocatedScanned < end) {
+        Heap::Base *b = *m_allocatedDuringIncrementalMark.at(allocatedScanned);
+        b->markChildren(m_markStack);
+        if (m_markStack->top >= m_markStack->limit)
+            spillMarkStack();
+        if (++allocatedScanned % ItemsBetweenDeadlineChecks == 0 && deadline.hasExpired())
+            return allocatedScanned == end;
+    }
+    return true;
+}
+
+// Drains the mark stack, including what got spilled from it, until done or the deadline expired.
+bool MemoryManager::drainIncrementalMarkStack(QDeadlineTimer deadline)
+{
+    while (true) {
+        if (deadline.isForever())
+            drainMarkStack(m_markStack);
+        else if (!m_markStack->drain(deadline))
+            return false;
+        if (m_markStackOverflow.empty())
+            return true;
+        const size_t n = qMin(m_markStackOverflow.size(),
+                              size_t(m_markStack->limit - m_markStack->base)/2);
+        for (size_t i = 0; i < n; ++i) {
+            m_markStack->push(m_markStackOverflow.back());
+            m_markStackOverflow.pop_back();
+        }
+    }
+}
+
+void MemoryManager::spillMarkStack()
+{
+    MarkStack *markStack = m_markStack;
+    Q_ASSERT(markStack);
+    const size_t size = markStack->top - markStack->base;
+    const size_t n = size/2;
+    m_markStackOverflow.insert(m_markStackOverflow.end(), markStack->base, markStack->base + n);
+    memmove(markStack->base, markStack->base + n, (size - n)*sizeof(Heap::Base *));
+    markStack->top -= n;
+}
+
+/*
+ * Nothing guards the roots with a write barrier, so once the heap is marked, they need to be
+ * scanned again, together with the items allocated since the last slice. This and all the
+ * marking it leads to has to happen in one pause. Usually that's little work, as most of the
+ * heap is black by now. If it doesn't fit into what's left of the step, the application gets
+ * to run again and a later step tries once more, with even more of the heap marked. Only the
+ * last attempt is allowed to take as long as it needs, so that the collection finishes.
+ */
+bool MemoryManager::remark(QDeadlineTimer deadline)
+{
+    enum { MaxRemarkAttempts = 8 };
+
+    QElapsedTimer t;
+    t.start();
+    if (++remarkAttempts >= MaxRemarkAttempts)
+        deadline = QDeadlineTimer(QDeadlineTimer::Forever);
+
+    collectRoots(m_markStack);
+    const bool done = scanAllocatedDuringIncrementalMark(m_allocatedDuringIncrementalMark.size(), deadline)
+            && drainIncrementalMarkStack(deadline);
+    allocatedScanLimit = m_allocatedDuringIncrementalMark.size();
+
+    remarkTime = t.nsecsElapsed();
+    incrementalMarkTime += remarkTime;
+    return done;
+}
+
+void MemoryManager::finishIncrementalGC()
+{
+    Q_ASSERT(gcState == IncrementalMark);
+    Q_ASSERT(m_markStack->top == m_markStack->base && m_markStackOverflow.empty());
+
+    const bool recording = isRecordingGC();
+    GCRecord record;
+    if (recording)
+        startGCRecord(&record, GCRecord::IncrementalCollection);
+
+    engine->writeBarrierActive = WriteBarrier::NoActiveBarrier;
+    markedItems = m_markStack->markedItems;
+    const size_t allocatedDuringMark = m_allocatedDuringIncrementalMark.size();
+    m_allocatedDuringIncrementalMark.clear();
+    delete m_markStack;
+    m_markStack = nullptr;
+    gcState = NoGC;
+
+    if (recording)
+        recordFreedItems(&record);
+
+    // The chunks get swept on the sweeper thread, only the destructors run in this pause.
+    QElapsedTimer t;
+    t.start();
+    sweep();
+
+    const qint64 sweepTime = t.nsecsElapsed();
+    if (recording)
+        finishGCRecord(&record, incrementalMarkTime, sweepTime);
+
+    if (gcCollectorStats) {
+        const QLoggingCategory &stats = lcGcAllocatorStats();
+        qDebug(stats) << "========== Incremental GC ==========";
+        qDebug(stats) << "Marked in" << incrementalSlices << "slices of at most" << gcSliceTime << "ms";
+        qDebug(stats) << "   " << markedItems << "objects marked";
+        qDebug(stats) << "   " << allocatedDuringMark << "objects allocated while marking";
+        qDebug(stats) << "Final marking pause" << remarkTime/1000 << "us, after" << remarkAttempts << "attempts.";
+        qDebug(stats) << "Sweeped object in" << sweepTime/1000 << "us.";
+        qDebug(stats) << "======== End Incremental GC ========";
+    }
+
+    finishGC();
+}
+
+void MemoryManager::abortIncrementalMark()
+{
+    Q_ASSERT(gcState == IncrementalMark);
+    engine->writeBarrierActive = WriteBarrier::NoActiveBarrier;
+    delete m_markStack;
+    m_markStack = nullptr;
+    m_allocatedDuringIncrementalMark.clear();
+    m_markStackOverflow.clear();
+    gcState = NoGC;
     blockAllocator.resetBlackBits();
     hugeItemAllocator.resetBlackBits();
 }
 
-size_t MemoryManager::getUsedMem() const
+void MemoryManager::markAllocatedDuringIncrementalMark(HeapItem *m)
+{
+    // Items allocated during marking are alive for the running collection. Their children
+    // get scanned by the following slices and the remark.
+    Chunk *c = m->chunk();
+    Chunk::setBit(c->blackBitmap, m - c->realBase());
+    m_allocatedDuringIncrementalMark.push_back(m);
+}
+
+size_t MemoryManager::getUsedMem()
 {
+    blockAllocator.finishSweep();
     return blockAllocator.usedMem();
 }
 
-size_t MemoryManager::getAllocatedMem() const
+size_t MemoryManager::getAllocatedMem()
 {
+    blockAllocator.finishSweep();
     return blockAllocator.allocatedMem() + hugeItemAllocator.usedMem();
 }
 
@@ -1186,10 +2424,24 @@ size_t MemoryManager::getLargeItemsMem() const
 
 MemoryManager::~MemoryManager()
 {
+    blockAllocator.finishSweep();
+    blockAllocator.sweeperThread = nullptr;
+    delete sweeperThreadPool;
+    if (gcState == IncrementalMark)
+        abortIncrementalMark();
+    if (generationalGC) {
+        // the last sweep must not treat the old generation as alive
+        engine->writeBarrierActive = WriteBarrier::NoActiveBarrier;
+        blockAllocator.resetBlackBits();
+        hugeItemAllocator.resetBlackBits();
+    }
+
     delete m_persistentValues;
 
     dumpStats();
 
+    // everything is about to be freed, let the segment pool have some of the memory
+    chunkAllocator->prepareForRecycling();
     sweep(/*lastSweep*/true);
     blockAllocator.freeAll();
     hugeItemAllocator.freeAll();
@@ -1216,6 +2468,10 @@ void MemoryManager::dumpStats() const
     for (int i = 1; i < BlockAllocator::NumBins - 1; ++i)
         qDebug(stats) << "     <" << (i << Chunk::SlotSizeShift) << " bytes: " << statistics.allocations[i];
     qDebug(stats) << "     >=" << ((BlockAllocator::NumBins - 1) << Chunk::SlotSizeShift) << " bytes: " << statistics.allocations[BlockAllocator::NumBins - 1];
+    qDebug(stats) << "Huge items allocated:" << hugeItemAllocator.counters.allocations;
+    qDebug(stats) << "   memory segments mapped:" << hugeItemAllocator.counters.segmentsMapped;
+    qDebug(stats) << "   memory segments reused:" << hugeItemAllocator.counters.segmentsReused;
+    qDebug(stats) << "   memory segments unmapped:" << hugeItemAllocator.counters.segmentsUnmapped;
 }
 
 void MemoryManager::collectFromJSStack(MarkStack *markStack) const
@@ -1233,6 +2489,40 @@ void MemoryManager::collectFromJSStack(MarkStack *markStack) const
     }
 }
 
+namespace WriteBarrier {
+
+void markBarrier(EngineBase *engine, Heap::Base *value)
+{
+    if (!value)
+        return;
+    MarkStack *markStack = engine->memoryManager->markStack();
+    Q_ASSERT(markStack);
+    value->mark(markStack);
+    // draining here could take as long as marking the rest of the heap
+    if (markStack->top >= markStack->limit)
+        engine->memoryManager->spillMarkStack();
+}
+
+void markBarrier(EngineBase *engine, ReturnedValue value)
+{
+    markBarrier(engine, Value::fromReturnedValue(value).heapObject());
+}
+
+void rememberBarrier(Heap::Base *base, Heap::Base *value)
+{
+    // only pointers from the old generation into the nursery need to be remembered
+    if (!value || !base->isMarked() || value->isMarked())
+        return;
+    base->setGrayBit();
+}
+
+void rememberBarrier(Heap::Base *base, ReturnedValue value)
+{
+    rememberBarrier(base, Value::fromReturnedValue(value).heapObject());
+}
+
+} // namespace WriteBarrier
+
 } // namespace QV4
 
 QT_END_NAMESPACE
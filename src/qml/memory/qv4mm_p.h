@@ -57,19 +57,34 @@
 #include <private/qv4object_p.h>
 #include <private/qv4mmdefs_p.h>
 #include <QVector>
+#include <QSharedPointer>
+#include <QElapsedTimer>
 
 #define QV4_MM_MAXBLOCK_SHIFT "QV4_MM_MAXBLOCK_SHIFT"
 #define QV4_MM_MAX_CHUNK_SIZE "QV4_MM_MAX_CHUNK_SIZE"
 #define QV4_MM_STATS "QV4_MM_STATS"
+#define QV4_MM_INCREMENTAL_GC "QV4_MM_INCREMENTAL_GC"
+#define QV4_MM_GC_SLICE_TIME "QV4_MM_GC_SLICE_TIME"
+#define QV4_MM_CONCURRENT_SWEEP "QV4_MM_CONCURRENT_SWEEP"
+#define QV4_MM_GENERATIONAL_GC "QV4_MM_GENERATIONAL_GC"
+#define QV4_MM_PARALLEL_MARK "QV4_MM_PARALLEL_MARK"
+#define QV4_MM_DEFRAGMENT "QV4_MM_DEFRAGMENT"
+#define QV4_MM_HEAP_GROWTH "QV4_MM_HEAP_GROWTH"
+#define QV4_MM_SEGMENT_POOL_SIZE "QV4_MM_SEGMENT_POOL_SIZE"
+#define QV4_MM_HUGE_ITEM_CACHE "QV4_MM_HUGE_ITEM_CACHE"
+#define QV4_MM_HUGE_ITEM_DECOMMIT "QV4_MM_HUGE_ITEM_DECOMMIT"
 
 #define MM_DEBUG 0
 
 QT_BEGIN_NAMESPACE
 
+class QThreadPool;
+
 namespace QV4 {
 
 struct ChunkAllocator;
 struct MemorySegment;
+struct ConcurrentSweeper;
 
 struct BlockAllocator {
     BlockAllocator(ChunkAllocator *chunkAllocator, ExecutionEngine *engine)
@@ -100,11 +115,20 @@ struct BlockAllocator {
         return used;
     }
 
-    void sweep();
+    // keepMarks leaves the black bits of the surviving items set, promoting them to the old generation
+    void sweep(bool concurrently = false, bool keepMarks = false);
+    void finishSweep();
+    bool isSweeping() const { return !sweeper.isNull(); }
     void freeAll();
     void resetBlackBits();
+    void resetGrayBits();
     void collectGrayItems(MarkStack *markStack);
 
+private:
+    void adoptSweptChunks();
+    void adoptSweptChunk(Chunk *c);
+
+public:
     // bump allocations
     HeapItem *nextFree = nullptr;
     size_t nFree = 0;
@@ -114,6 +138,10 @@ struct BlockAllocator {
     ExecutionEngine *engine;
     std::vector<Chunk *> chunks;
     uint *allocationStats = nullptr;
+    bool defragment = false; // prefer dense chunks when allocating, so that sparse ones can be freed
+    // chunks that still get swept by a worker thread, they are not in chunks until adopted
+    QSharedPointer<ConcurrentSweeper> sweeper;
+    QThreadPool *sweeperThread = nullptr; // owned by the MemoryManager, sweeps synchronously if null
 };
 
 struct HugeItemAllocator {
@@ -122,8 +150,11 @@ struct HugeItemAllocator {
     {}
 
     HeapItem *allocate(size_t size);
-    void sweep(ClassDestroyStatsCallback classCountPtr);
+    void sweep(ClassDestroyStatsCallback classCountPtr, bool keepMarks = false);
     void freeAll();
+    // releases the oldest cached segments until at most limit bytes are left
+    void trimCachedSegments(size_t limit);
+    void releaseCachedSegments() { trimCachedSegments(0); }
     void resetBlackBits();
     void collectGrayItems(MarkStack *markStack);
 
@@ -143,6 +174,28 @@ struct HugeItemAllocator {
     };
 
     std::vector<HugeChunk> chunks;
+
+    // Items too big for the ChunkAllocator get a memory segment of their own. If cacheLimit
+    // allows, their segments are kept here once they die, for the next huge item, instead of
+    // being unmapped. The pages stay committed, unless decommitCachedSegments is set. When the
+    // cache is full, the segments cached the longest ago make room for newly freed ones. The
+    // whole cache is released once the application is idle.
+    std::vector<MemorySegment *> cachedSegments;
+    size_t cachedBytes = 0;
+    size_t cacheLimit = 0;
+    bool decommitCachedSegments = false;
+
+    struct {
+        uint allocations = 0;
+        uint segmentsMapped = 0;   // segments of their own reserved from the OS
+        uint segmentsReused = 0;   // segments of their own taken from the cache
+        uint segmentsUnmapped = 0; // segments of their own given back to the OS
+    } counters;
+
+private:
+    MemorySegment *takeCachedSegment(size_t size);
+    void freeHugeChunk(const HugeChunk &c, ClassDestroyStatsCallback classCountPtr);
+    void releaseSegment(MemorySegment *segment);
 };
 
 
@@ -169,6 +222,8 @@ public:
         ic = ic->changeVTable(ManagedType::staticVTable());
         o->internalClass = ic;
         Q_ASSERT(o->internalClass && o->internalClass->vtable);
+        if (ic->vtable->destroy)
+            o->setDestroyBit();
         return static_cast<typename ManagedType::Data *>(o);
     }
 
@@ -181,6 +236,8 @@ public:
         o->internalClass = ic;
         Q_ASSERT(o->internalClass && o->internalClass->vtable);
         Q_ASSERT(ic->vtable == ManagedType::staticVTable());
+        if (ic->vtable->destroy)
+            o->setDestroyBit();
         return static_cast<typename ManagedType::Data *>(o);
     }
 
@@ -191,6 +248,8 @@ public:
         o->internalClass = ic;
         Q_ASSERT(o->internalClass && o->internalClass->vtable);
         Q_ASSERT(ic->vtable == ObjectType::staticVTable());
+        if (ic->vtable->destroy)
+            o->setDestroyBit();
         return static_cast<typename ObjectType::Data *>(o);
     }
 
@@ -204,6 +263,8 @@ public:
         o->internalClass = ic;
         Q_ASSERT(o->internalClass && o->internalClass->vtable);
         Q_ASSERT(o->internalClass->prototype == ObjectType::defaultPrototype(engine)->d());
+        if (ic->vtable->destroy)
+            o->setDestroyBit();
         return static_cast<typename ObjectType::Data *>(o);
     }
 
@@ -213,6 +274,8 @@ public:
         typename ManagedType::Data *o = reinterpret_cast<typename ManagedType::Data *>(allocString(unmanagedSize));
         o->internalClass = ManagedType::defaultInternalClass(engine);
         Q_ASSERT(o->internalClass && o->internalClass->vtable);
+        if (o->internalClass->vtable->destroy)
+            o->setDestroyBit();
         o->init(arg1);
         return o;
     }
@@ -383,10 +446,46 @@ public:
 
     void runGC();
 
+    // Collects the nursery only: everything allocated since the last collection that is
+    // reachable neither from the roots nor from the remembered set. Survivors get promoted
+    // to the old generation.
+    void runMinorGC();
+
+    // Performs one time-bounded step of an incremental collection, starting a new one if
+    // none is running. The collection is finished (and the heap swept) by the step whose
+    // final remark of the roots fits into the time budget.
+    void runIncrementalGCStep();
+    bool isIncrementalGCRunning() const { return gcState != NoGC; }
+    MarkStack *markStack() const { return m_markStack; }
+    // Makes room on the incremental mark stack by moving its older half aside.
+    void spillMarkStack();
+
+    // Tells the collector that the application is idle for the next msecs milliseconds. A
+    // collection that would be due soon is run now, if it is expected to fit into that time.
+    // Returns whether any collection work was done.
+    bool collectInIdleTime(int msecs);
+
+    // How much the heap may grow relative to the memory that survived the last collection
+    // before collecting again, in percent. Values <= 0 restore the default.
+    void setHeapGrowth(int percent);
+    int heapGrowthPercentage() const { return int(heapGrowth); }
+
+    // Destroyed engines leave some of their memory segments in a process-wide pool, where
+    // engines created later pick them up. Sets how many segments the pool keeps at most,
+    // releasing the ones beyond that. 0 disables the pool.
+    static void setSegmentPoolCapacity(int segments);
+    static int pooledSegments();
+
+    // Installs a callback that gets a GCRecord after every collection, or removes it when
+    // passed an empty one. Recording looks at every dead item before it is freed, and keeps
+    // the heap from being swept concurrently, so collections get somewhat slower.
+    void setGCRecordCallback(const GCRecordCallback &callback) { gcRecordCallback = callback; }
+
     void dumpStats() const;
 
-    size_t getUsedMem() const;
-    size_t getAllocatedMem() const;
+    // These wait for a concurrent sweep to finish, the chunks it still sweeps aren't counted before.
+    size_t getUsedMem();
+    size_t getAllocatedMem();
     size_t getLargeItemsMem() const;
 
     // called when a JS object grows itself. Specifically: Heap::String::append
@@ -402,8 +501,29 @@ private:
     void collectFromJSStack(MarkStack *markStack) const;
     void mark();
     void sweep(bool lastSweep = false, ClassDestroyStatsCallback classCountPtr = nullptr);
-    bool shouldRunGC() const;
+    bool shouldRunGC();
+    uint currentHeapGrowth() const;
+    bool isGCDue();
+    void updatePacing();
     void collectRoots(MarkStack *markStack);
+    void drainMarkStack(MarkStack *markStack);
+    void triggerGC();
+    void startIncrementalMark();
+    bool incrementalMarkSlice(QDeadlineTimer deadline);
+    bool scanAllocatedDuringIncrementalMark(size_t end, QDeadlineTimer deadline);
+    bool drainIncrementalMarkStack(QDeadlineTimer deadline);
+    bool remark(QDeadlineTimer deadline);
+    void finishIncrementalGC();
+    void abortIncrementalMark();
+    void finishGC();
+    void markAllocatedDuringIncrementalMark(HeapItem *m);
+    size_t oldGenerationSlots();
+    void updateOldGeneration(bool fullCollection);
+    bool shouldRunFullGC();
+    bool isRecordingGC() const;
+    void startGCRecord(GCRecord *record, GCRecord::Type type);
+    void recordFreedItems(GCRecord *record);
+    void finishGCRecord(GCRecord *record, qint64 markTime, qint64 sweepTime);
 
 public:
     QV4::ExecutionEngine *engine;
@@ -416,13 +536,49 @@ public:
 
     std::size_t unmanagedHeapSize = 0; // the amount of bytes of heap that is not managed by the memory manager, but which is held onto by managed items.
     std::size_t unmanagedHeapSizeGCLimit;
-    std::size_t usedSlotsAfterLastFullSweep = 0;
 
     bool gcBlocked = false;
     bool aggressiveGC = false;
     bool gcStats = false;
     bool gcCollectorStats = false;
 
+    enum GCState {
+        NoGC,
+        IncrementalMark
+    };
+    GCState gcState = NoGC;
+    bool incrementalGC = false;
+    bool concurrentSweep = false;
+    bool generationalGC = false;
+    // a thread of its own, a busy global pool would keep the engine waiting for the sweep
+    QThreadPool *sweeperThreadPool = nullptr;
+    int markingThreads = 1; // including the engine's thread
+    int gcSliceTime; // in milliseconds, the time budget for one incremental marking step
+    MarkStack *m_markStack = nullptr;
+    std::vector<HeapItem *> m_allocatedDuringIncrementalMark;
+    size_t allocatedScanned = 0; // the items before this had their children marked
+    size_t allocatedScanLimit = 0; // the items before this were allocated before the last slice
+    std::vector<Heap::Base *> m_markStackOverflow; // marked, but their children still need to be
+    uint markedItems = 0; // by the running or the last collection
+    uint incrementalSlices = 0;
+    uint remarkAttempts = 0;
+    qint64 incrementalMarkTime = 0; // in ns, spent in the slices of the running collection
+    qint64 remarkTime = 0; // in ns, spent in the last, successful remark
+    std::size_t oldGenerationSlotsLimit = 0; // a full collection is due when the old generation grows beyond this
+    uint minorCollections = 0;
+
+    // pacing, updated when a collection starts
+    uint heapGrowth; // in %
+    uint survivalRate = 0; // in % of what was alive or allocated before the last collection
+    std::size_t allocationRate = 0; // bytes per second between the last two collections
+    std::size_t bytesAllocatedSinceLastGC = 0;
+    std::size_t liveBytesBeforeLastGC = 0;
+    QElapsedTimer timeSinceLastGC;
+    qint64 fullGCPause = 0; // in ns
+    qint64 minorGCPause = 0; // in ns
+
+    GCRecordCallback gcRecordCallback;
+
     struct {
         size_t maxReservedMem = 0;
         size_t maxAllocatedMem = 0;
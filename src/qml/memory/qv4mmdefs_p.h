@@ -53,27 +53,77 @@
 #include <private/qv4global_p.h>
 #include <private/qv4runtimeapi_p.h>
 #include <QtCore/qalgorithms.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qdeadlinetimer.h>
 #include <qdebug.h>
 
+#include <functional>
+#include <vector>
+
 QT_BEGIN_NAMESPACE
 
 namespace QV4 {
 
 struct MarkStack;
+struct ParallelMarker;
 
 typedef void(*ClassDestroyStatsCallback)(const char *);
 
+/*
+ * Describes one garbage collection. The memory manager fills one in after every collection
+ * if someone is interested, see MemoryManager::setGCRecordCallback() and the memory profiler.
+ *
+ * All times are in nanoseconds, all sizes in bytes. Small items live in the chunks of the
+ * block allocator, huge items get a chunk of their own.
+ */
+struct GCRecord {
+    enum Type {
+        FullCollection,
+        MinorCollection,
+        IncrementalCollection
+    };
+    enum {
+        OccupancyBuckets = 10
+    };
+    // name of the vtable's class, and the bytes freed for items of that class
+    typedef std::pair<const char *, size_t> FreedClass;
+
+    Type type = FullCollection;
+    qint64 markTime = 0; // the time spent in incremental slices is included
+    qint64 sweepTime = 0;
+    size_t markedItems = 0;
+    size_t usedBefore = 0;
+    size_t usedAfter = 0;
+    size_t largeItemsBefore = 0;
+    size_t largeItemsAfter = 0;
+    uint hugeItemsBefore = 0;
+    uint hugeItemsAfter = 0;
+    // Chunks by occupancy after sweeping: bucket n counts the chunks that have between n and
+    // n + 1 tenths of their slots in use. Completely filled chunks are counted in the last one.
+    uint chunkOccupancy[OccupancyBuckets] = {};
+    std::vector<FreedClass> freedBytesPerClass; // sorted by size, largest first
+
+    qint64 pauseTime() const { return markTime + sweepTime; }
+    size_t freedBytes() const
+    { return usedBefore + largeItemsBefore - usedAfter - largeItemsAfter; }
+};
+
+typedef std::function<void(const GCRecord &)> GCRecordCallback;
+
 /*
  * Chunks are the basic structure containing GC managed objects.
  *
  * Chunks are 64k aligned in memory, so that retrieving the Chunk pointer from a Heap object
- * is a simple masking operation. Each Chunk has 4 bitmaps for managing purposes,
+ * is a simple masking operation. Each Chunk has 5 bitmaps for managing purposes,
  * and 32byte wide slots for the objects following afterwards.
  *
- * The gray and black bitmaps are used for mark/sweep.
+ * The gray and black bitmaps are used for mark/sweep. When collecting generationally, the black
+ * bits of old objects stay set between collections, and the gray bitmap holds the remembered set.
  * The object bitmap has a bit set if this location represents the start of a Heap object.
  * The extends bitmap denotes the extend of an object. It has a cleared bit at the start of the object
  * and a set bit for all following slots used by the object.
+ * The destroy bitmap has a bit set for objects whose vtable has a destroy method, so that sweeping
+ * only needs to look at those objects, and can otherwise work on the bitmaps alone.
  *
  * Free memory has both used and extends bits set to 0.
  *
@@ -95,7 +145,7 @@ struct Chunk {
         SlotSizeShift = 5,
         NumSlots = ChunkSize/SlotSize,
         BitmapSize = NumSlots/8,
-        HeaderSize = 4*BitmapSize,
+        HeaderSize = 5*BitmapSize,
         DataSize = ChunkSize - HeaderSize,
         AvailableSlots = DataSize/SlotSize,
 #if QT_POINTER_SIZE == 8
@@ -111,6 +161,7 @@ struct Chunk {
     quintptr blackBitmap[BitmapSize/sizeof(quintptr)];
     quintptr objectBitmap[BitmapSize/sizeof(quintptr)];
     quintptr extendsBitmap[BitmapSize/sizeof(quintptr)];
+    quintptr destroyBitmap[BitmapSize/sizeof(quintptr)];
     char data[ChunkSize - HeaderSize];
 
     HeapItem *realBase();
@@ -135,6 +186,11 @@ struct Chunk {
         quintptr bit = bitForIndex(index);
         *bitmap &= ~bit;
     }
+    // sets bit in *entry, which other threads might modify at the same time. Returns whether
+    // the bit was set already.
+    static bool testAndSetBitAtomic(quintptr *entry, quintptr bit) {
+        return reinterpret_cast<QBasicAtomicInteger<quintptr> *>(entry)->fetchAndOrRelaxed(bit) & bit;
+    }
     static bool testBit(quintptr *bitmap, size_t index) {
 //        Q_ASSERT(index >= HeaderSize/SlotSize && index < ChunkSize/SlotSize);
         bitmap += bitmapIndex(index);
@@ -188,8 +244,11 @@ struct Chunk {
 
     bool sweep(ClassDestroyStatsCallback classCountPtr);
     void resetBlackBits();
+    void resetGrayBits();
     void collectGrayItems(QV4::MarkStack *markStack);
-    bool sweep(ExecutionEngine *engine);
+    void destroyUnmarkedItems();
+    // only touches the bitmaps, engine may be null when sweeping outside of the engine's thread
+    bool sweep(ExecutionEngine *engine, bool keepMarks = false);
     void freeAll(ExecutionEngine *engine);
 
     void sortIntoBins(HeapItem **bins, uint nBins);
@@ -272,10 +331,17 @@ Q_STATIC_ASSERT((1 << Chunk::BitShift) == Chunk::Bits);
 
 struct MarkStack {
     MarkStack(ExecutionEngine *engine);
+    // uses the given memory instead of the engine's GC stack, for marking on other threads
+    MarkStack(ExecutionEngine *engine, Heap::Base **stack, size_t size);
     Heap::Base **top = nullptr;
     Heap::Base **base = nullptr;
     Heap::Base **limit = nullptr;
     ExecutionEngine *engine;
+    // set while several threads mark at the same time, mark bits then need to be set atomically
+    bool parallel = false;
+    // set on the stacks of the worker threads of a parallel marker
+    ParallelMarker *worker = nullptr;
+    uint markedItems = 0; // the items that got their children marked from this stack
     void push(Heap::Base *m) {
         *top = m;
         ++top;
@@ -285,7 +351,8 @@ struct MarkStack {
         return *top;
     }
     void drain();
-
+    // drains until the stack is empty or the deadline expired, returns true if the stack is empty
+    bool drain(QDeadlineTimer deadline);
 };
 
 // Some helper to automate the generation of our
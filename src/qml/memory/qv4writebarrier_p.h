@@ -55,7 +55,14 @@
 
 QT_BEGIN_NAMESPACE
 
+#ifdef V4_BOOTSTRAP
+// the bootstrapped tools never run the garbage collector
 #define WRITEBARRIER_none 1
+#define WRITEBARRIER_incremental 2
+#else
+#define WRITEBARRIER_none 2
+#define WRITEBARRIER_incremental 1
+#endif
 
 #define WRITEBARRIER(x) (1/WRITEBARRIER_##x == 1)
 
@@ -98,6 +105,64 @@ inline void write(EngineBase *engine, Heap::Base *base, Heap::Base **slot, Heap:
     *slot = value;
 }
 
+#elif WRITEBARRIER(incremental)
+
+/*
+ * EngineBase::writeBarrierActive holds one of the ActiveBarrier values.
+ *
+ * The marking barrier is active while the memory manager is marking incrementally
+ * (see MemoryManager::runIncrementalGCStep()). It then shades both the value being
+ * overwritten (Yuasa deletion barrier) and the value being stored (Dijkstra
+ * insertion barrier), so that no reachable object can hide from the collector
+ * behind an already scanned (black) object.
+ *
+ * The remembering barrier is active all the time when collecting generationally
+ * (see MemoryManager::runMinorGC()). Objects of the old generation keep their black
+ * bit between collections. When a nursery object gets stored into one of them, the
+ * old object is marked gray, so that the next minor collection scans it again.
+ */
+enum ActiveBarrier {
+    NoActiveBarrier = 0,
+    MarkingBarrier = 1,
+    RememberingBarrier = 2
+};
+
+Q_QML_EXPORT void markBarrier(EngineBase *engine, ReturnedValue value);
+Q_QML_EXPORT void markBarrier(EngineBase *engine, Heap::Base *value);
+Q_QML_EXPORT void rememberBarrier(Heap::Base *base, ReturnedValue value);
+Q_QML_EXPORT void rememberBarrier(Heap::Base *base, Heap::Base *value);
+
+template <NewValueType type>
+static Q_CONSTEXPR inline bool isRequired() {
+    return type != Primitive;
+}
+
+inline void write(EngineBase *engine, Heap::Base *base, ReturnedValue *slot, ReturnedValue value)
+{
+    if (Q_UNLIKELY(engine->writeBarrierActive)) {
+        if (engine->writeBarrierActive == MarkingBarrier) {
+            markBarrier(engine, *slot);
+            markBarrier(engine, value);
+        } else {
+            rememberBarrier(base, value);
+        }
+    }
+    *slot = value;
+}
+
+inline void write(EngineBase *engine, Heap::Base *base, Heap::Base **slot, Heap::Base *value)
+{
+    if (Q_UNLIKELY(engine->writeBarrierActive)) {
+        if (engine->writeBarrierActive == MarkingBarrier) {
+            markBarrier(engine, *slot);
+            markBarrier(engine, value);
+        } else {
+            rememberBarrier(base, value);
+        }
+    }
+    *slot = value;
+}
+
 #endif
 
 }
@@ -1992,6 +1992,7 @@ void QQmlTypeLoader::clearCache()
     m_importDirCache.clear();
     m_importQmlDirCache.clear();
     QQmlMetaType::freeUnusedTypesAndCaches();
+    engine()->handle()->flushJitCodeCache();
 }
 
 void QQmlTypeLoader::updateTypeCacheTrimThreshold()
@@ -2035,6 +2036,9 @@ void QQmlTypeLoader::trimCache()
 
     QQmlMetaType::freeUnusedTypesAndCaches();
 
+    // Units released above handed their new JIT code to the engine.
+    engine()->handle()->flushJitCodeCache();
+
     // TODO: release any scripts which are no longer referenced by any types
 }
 
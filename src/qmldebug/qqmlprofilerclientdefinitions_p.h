@@ -67,7 +67,11 @@ enum Message {
     MemoryAllocation,
     DebugMessage,
 
-    MaximumMessage
+    MaximumMessage,
+
+    // Added later. Kept out of the range above, so that MaximumMessage keeps its value and
+    // older clients skip it as an unknown message.
+    GarbageCollection = MaximumMessage + 1
 };
 
 enum EventType {
@@ -126,6 +130,14 @@ enum MemoryType {
     SmallItem
 };
 
+enum GarbageCollectionType {
+    FullCollection,
+    MinorCollection,
+    IncrementalCollection,
+
+    MaximumGarbageCollectionType
+};
+
 enum ProfileFeature {
     ProfileJavaScript,
     ProfileMemory,
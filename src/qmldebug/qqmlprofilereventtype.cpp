@@ -81,6 +81,7 @@ ProfileFeature QQmlProfilerEventType::feature() const
     case SceneGraphFrame:
         return ProfileSceneGraph;
     case MemoryAllocation:
+    case GarbageCollection:
         return ProfileMemory;
     case DebugMessage:
         return ProfileDebugMessages;
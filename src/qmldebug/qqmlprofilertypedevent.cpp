@@ -52,7 +52,7 @@ QDataStream &operator>>(QDataStream &stream, QQmlProfilerTypedEvent &event)
 
     stream >> time >> messageType;
 
-    if (messageType < 0 || messageType > MaximumMessage)
+    if ((messageType < 0 || messageType > MaximumMessage) && messageType != GarbageCollection)
         messageType = MaximumMessage;
 
     RangeType rangeType = MaximumRangeType;
@@ -136,6 +136,24 @@ QDataStream &operator>>(QDataStream &stream, QQmlProfilerTypedEvent &event)
         event.event.setNumbers<QVarLengthArray<qint64>, qint64>(params);
         break;
     }
+    case GarbageCollection: {
+        // the names of the classes that had items freed, their freed bytes follow the numbers
+        QString freedClasses;
+        stream >> freedClasses;
+
+        QVarLengthArray<qint64> params;
+        qint64 param;
+        while (!stream.atEnd()) {
+            stream >> param;
+            params.push_back(param);
+        }
+
+        event.type = QQmlProfilerEventType(
+                    static_cast<Message>(messageType),
+                    MaximumRangeType, subtype, QQmlProfilerEventLocation(), freedClasses);
+        event.event.setNumbers<QVarLengthArray<qint64>, qint64>(params);
+        break;
+    }
     case PixmapCacheEvent: {
         qint32 width = 0, height = 0, refcount = 0;
         QString filename;
@@ -9,8 +9,10 @@ Timer {
         console.log(x.t[i]);
         if (i < 3)
             recurse(i + 1);
-        else
+        else {
+            gc();
             Qt.quit();
+        }
     }
 
     onTriggered: recurse(0)
@@ -62,6 +62,7 @@ public:
     QVector<QQmlProfilerEvent> qmlMessages;
     QVector<QQmlProfilerEvent> javascriptMessages;
     QVector<QQmlProfilerEvent> jsHeapMessages;
+    QVector<QQmlProfilerEvent> gcMessages;
     QVector<QQmlProfilerEvent> asynchronousMessages;
     QVector<QQmlProfilerEvent> pixmapMessages;
 
@@ -142,6 +143,9 @@ void QQmlProfilerTestClient::addEvent(const QQmlProfilerEvent &event)
     case MemoryAllocation:
         jsHeapMessages.append(event);
         break;
+    case GarbageCollection:
+        gcMessages.append(event);
+        break;
     case DebugMessage:
         // Unhandled
         break;
@@ -741,6 +745,30 @@ void tst_QQmlProfilerService::memory()
     }
 
     QVERIFY(smallItems > 5);
+
+    // memory.qml collects garbage explicitly
+    QVERIFY(m_client->gcMessages.count() > 0);
+    for (const QQmlProfilerEvent &message : qAsConst(m_client->gcMessages)) {
+        const QQmlProfilerEventType &type = m_client->types[message.typeIndex()];
+        QVERIFY(type.detailType() >= 0 && type.detailType() < MaximumGarbageCollectionType);
+        QVERIFY(message.number<qint64>(0) >= 0); // mark time
+        QVERIFY(message.number<qint64>(1) >= 0); // sweep time
+        QVERIFY(message.number<qint64>(2) >= 0); // freed bytes
+        QVERIFY(message.number<qint64>(3) > 0);  // used bytes
+
+        // the chunk occupancy histogram, then the freed bytes of each class named in the type
+        const QVector<qint64> numbers = message.numbers<QVector<qint64>>();
+        const int buckets = int(message.number<qint64>(5));
+        QVERIFY(buckets > 0);
+        qint64 chunks = 0;
+        for (int i = 6; i < 6 + buckets; ++i)
+            chunks += numbers.at(i);
+        QVERIFY(chunks > 0);
+        const QStringList freedClasses = type.data().split(QLatin1Char(','), QString::SkipEmptyParts);
+        QCOMPARE(numbers.length(), 6 + buckets + freedClasses.length());
+        for (int i = 6 + buckets; i < numbers.length(); ++i)
+            QVERIFY(numbers.at(i) > 0);
+    }
 }
 
 static bool hasCompileEvents(const QVector<QQmlProfilerEventType> &types)
@@ -39,6 +39,11 @@
 #include <qqmlcomponent.h>
 #include <stdlib.h>
 #include <private/qv4alloca_p.h>
+#include <private/qjsvalue_p.h>
+#include <private/qv4functionobject_p.h>
+#include <private/qv4instr_moth_p.h>
+#include <private/qv4lookup_p.h>
+#include <private/qv4qobjectwrapper_p.h>
 
 #ifdef Q_CC_MSVC
 #define NO_INLINE __declspec(noinline)
@@ -94,6 +99,9 @@ private slots:
     void valueConversion_regExp();
     void castWithMultipleInheritance();
     void collectGarbage();
+    void collectGarbageInIdleTime();
+    void garbageCollectionHeapGrowth();
+    void garbageCollectionRecording();
     void gcWithNestedDataStructure();
     void stacktrace();
     void numberParsing_data();
@@ -111,6 +119,15 @@ private slots:
     void with_constant();
     void stringObjects();
     void jsStringPrototypeReplaceBugs();
+    void stringConcat_data();
+    void stringConcat();
+    void stringConcatBuildsRope();
+    void arrayJoin_data();
+    void arrayJoin();
+    void stringSearchAndCase_data();
+    void stringSearchAndCase();
+    void stringSearchConcatenated_data();
+    void stringSearchConcatenated();
     void getterSetterThisObject_global();
     void getterSetterThisObject_plain();
     void getterSetterThisObject_prototypeChain();
@@ -126,7 +143,22 @@ private slots:
     void reentrancy_objectCreation();
     void jsIncDecNonObjectProperty();
     void JSONparse();
+    void JSONparseRecords_data();
+    void JSONparseRecords();
+    void JSONparsePredictedShapes();
+    void JSONstringifyOutput_data();
+    void JSONstringifyOutput();
+    void JSONstringifyEscaping();
     void arraySort();
+    void arraySortOrder_data();
+    void arraySortOrder();
+    void arraySortCollectingGarbage();
+    void numericArrays_data();
+    void numericArrays();
+    void numericArraysAfterFill_data();
+    void numericArraysAfterFill();
+    void qobjectPropertyLookup();
+    void qobjectPropertyLookupAlternatingTypes();
     void lookupOnDisappearingProperty();
     void arrayConcat();
     void recursiveBoundFunctions();
@@ -208,6 +240,14 @@ private slots:
 
     void protoChanges_QTBUG68369();
 
+    void polymorphicLookups();
+    void superinstructions_data();
+    void superinstructions();
+    void superinstructionsInBytecode();
+    void inlinedCalls_data();
+    void inlinedCalls();
+    void inlinedCallsInBytecode();
+
 signals:
     void testSignal();
 };
@@ -220,6 +260,66 @@ tst_QJSEngine::~tst_QJSEngine()
 {
 }
 
+// For data-driven tests with "code" and "expected" columns: evaluates the code of the current row
+// in a fresh engine and compares the result, converted to a string, with the expected one.
+static void evaluateAndCompare()
+{
+    QFETCH(QString, code);
+    QFETCH(QString, expected);
+
+    QJSEngine engine;
+    QJSValue result = engine.evaluate(code);
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), expected);
+}
+
+// For data-driven tests with "code" and "expected" columns: evaluates the code of the current row
+// once in the interpreter and once with every function compiled by the JIT on its first call, and
+// compares both results, converted to strings, with the expected one.
+static void evaluateAndCompareInterpretedAndJitted()
+{
+    static const char *const variables[] = { "QV4_FORCE_INTERPRETER", "QV4_JIT_CALL_THRESHOLD" };
+    static const char *const values[] = { "1", "0" };
+
+    QFETCH(QString, code);
+    QFETCH(QString, expected);
+
+    for (int i = 0; i < 2; ++i) {
+        qputenv(variables[i], values[i]);
+        QJSEngine engine;
+        qunsetenv(variables[i]);
+        QJSValue result = engine.evaluate(code);
+        QVERIFY2(!result.isError(), qPrintable(QString::fromLatin1(variables[i]) + QLatin1String(": ")
+                                               + result.toString()));
+        QCOMPARE(result.toString(), expected);
+    }
+}
+
+// Counts the instructions of the given type in the bytecode of a function.
+static int instructionCount(const QJSValue &function, QV4::Moth::Instr::Type type)
+{
+    static const int argumentCount[] = { FOR_EACH_MOTH_INSTR(MOTH_COLLECT_NARGS) };
+
+    QJSValue value = function;
+    const QV4::Function *f = QJSValuePrivate::getValue(&value)->as<QV4::FunctionObject>()->function();
+    const uchar *code = f->codeData;
+    const uchar *end = code + f->compiledFunction->codeSize;
+    int count = 0;
+    while (code < end) {
+        // wide instructions follow the regular ones and have 32 bit arguments
+        int instr = *code;
+        int argumentSize = sizeof(qint8);
+        if (instr >= MOTH_NUM_INSTRUCTIONS()) {
+            instr -= MOTH_NUM_INSTRUCTIONS();
+            argumentSize = sizeof(qint32);
+        }
+        if (instr == static_cast<int>(type))
+            ++count;
+        code += 1 + argumentCount[instr] * argumentSize;
+    }
+    return count;
+}
+
 Q_DECLARE_METATYPE(Qt::KeyboardModifier)
 Q_DECLARE_METATYPE(Qt::KeyboardModifiers)
 
@@ -1050,6 +1150,7 @@ void tst_QJSEngine::builtinFunctionNames_data()
     QTest::newRow("Array.prototype.toString") << QString("Array.prototype.toString") << QString("toString");
     QTest::newRow("Array.prototype.toLocaleString") << QString("Array.prototype.toLocaleString") << QString("toLocaleString");
     QTest::newRow("Array.prototype.concat") << QString("Array.prototype.concat") << QString("concat");
+    QTest::newRow("Array.prototype.fill") << QString("Array.prototype.fill") << QString("fill");
     QTest::newRow("Array.prototype.find") << QString("Array.prototype.find") << QString("find");
     QTest::newRow("Array.prototype.findIndex") << QString("Array.prototype.findIndex") << QString("findIndex");
     QTest::newRow("Array.prototype.join") << QString("Array.prototype.join") << QString("join");
@@ -1611,6 +1712,63 @@ void tst_QJSEngine::collectGarbage()
     QVERIFY(ptr.isNull());
 }
 
+void tst_QJSEngine::collectGarbageInIdleTime()
+{
+    QJSEngine eng;
+    eng.collectGarbage();
+    // nothing has been allocated since, so no collection is due
+    QVERIFY(!eng.collectGarbageInIdleTime(100));
+    QVERIFY(!eng.collectGarbageInIdleTime(0));
+
+    // With this much heap growth allowed, no collection interrupts the allocations below. Back
+    // at the default, the several megabytes allocated since the last collection use up more
+    // than half of the budget, so a collection is due no matter how fast they were allocated.
+    eng.setGarbageCollectionHeapGrowth(100000);
+    eng.evaluate("var garbage = []; for (var i = 0; i < 100000; ++i) garbage.push({ index: i }); garbage = null;");
+    eng.setGarbageCollectionHeapGrowth(0);
+    QVERIFY(eng.collectGarbageInIdleTime(10000));
+}
+
+void tst_QJSEngine::garbageCollectionHeapGrowth()
+{
+    QJSEngine eng;
+    QCOMPARE(eng.garbageCollectionHeapGrowth(), 200);
+    eng.setGarbageCollectionHeapGrowth(400);
+    QCOMPARE(eng.garbageCollectionHeapGrowth(), 400);
+    eng.setGarbageCollectionHeapGrowth(50);
+    QCOMPARE(eng.garbageCollectionHeapGrowth(), 110);
+    eng.setGarbageCollectionHeapGrowth(0);
+    QCOMPARE(eng.garbageCollectionHeapGrowth(), 200);
+}
+
+void tst_QJSEngine::garbageCollectionRecording()
+{
+    QJSEngine eng;
+    QVERIFY(!eng.isGarbageCollectionRecordingEnabled());
+    QSignalSpy spy(&eng, &QJSEngine::garbageCollected);
+
+    eng.setGarbageCollectionRecordingEnabled(true);
+    QVERIFY(eng.isGarbageCollectionRecordingEnabled());
+    eng.evaluate("var garbage = []; for (var i = 0; i < 1000; ++i) garbage.push({ index: i }); garbage = null;");
+    eng.collectGarbage();
+    // delivered through the event loop
+    QCOMPARE(spy.count(), 0);
+    QTRY_VERIFY(spy.count() > 0);
+
+    const QVariantMap record = spy.last().at(0).toMap();
+    QCOMPARE(record.value("type").toString(), QString("full"));
+    QVERIFY(record.value("usedBefore").toULongLong() > record.value("usedAfter").toULongLong());
+    QCOMPARE(record.value("chunkOccupancy").toList().length(), 10);
+    QVERIFY(record.value("freedBytesPerClass").toMap().value("Object").toULongLong() >= 1000*32);
+
+    eng.setGarbageCollectionRecordingEnabled(false);
+    QVERIFY(!eng.isGarbageCollectionRecordingEnabled());
+    spy.clear();
+    eng.collectGarbage();
+    QCoreApplication::processEvents();
+    QCOMPARE(spy.count(), 0);
+}
+
 void tst_QJSEngine::gcWithNestedDataStructure()
 {
     // The GC must be able to traverse deeply nested objects, otherwise this
@@ -2454,6 +2612,195 @@ void tst_QJSEngine::jsStringPrototypeReplaceBugs()
     }
 }
 
+void tst_QJSEngine::stringConcat_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("arguments") << QString::fromLatin1(
+        "'a'.concat(1, null, undefined, true, { toString: function() { return 'o'; } })")
+        << QString::fromLatin1("a1nullundefinedtrueo");
+    QTest::newRow("empty strings") << QString::fromLatin1(
+        "[''.concat(), ''.concat('', 'x', ''), 'y'.concat(''), ''.concat('')].join('|')")
+        << QString::fromLatin1("|x|y|");
+    QTest::newRow("loop") << QString::fromLatin1(
+        "var s = ''; for (var i = 0; i < 1000; ++i) s = s.concat(i % 10, '-');"
+        "[s.length, s.slice(0, 6), s.slice(-6), s.indexOf('9-0-')].join()")
+        << QString::fromLatin1("2000,0-1-2-,7-8-9-,18");
+    QTest::newRow("number this") << QString::fromLatin1(
+        "String.prototype.concat.call(12, 3, 4)")
+        << QString::fromLatin1("1234");
+    QTest::newRow("null this") << QString::fromLatin1(
+        "try { String.prototype.concat.call(null, 'a'); 'no error' } catch (e) { e instanceof TypeError }")
+        << QString::fromLatin1("true");
+    QTest::newRow("undefined this") << QString::fromLatin1(
+        "try { String.prototype.concat.call(undefined, 'a'); 'no error' } catch (e) { e instanceof TypeError }")
+        << QString::fromLatin1("true");
+    QTest::newRow("throwing argument") << QString::fromLatin1(
+        "try { 'a'.concat('b', { toString: function() { throw 'thrown'; } }); 'no error' } catch (e) { e }")
+        << QString::fromLatin1("thrown");
+}
+
+void tst_QJSEngine::stringConcat()
+{
+    evaluateAndCompare();
+}
+
+void tst_QJSEngine::stringConcatBuildsRope()
+{
+    QJSEngine engine;
+
+    // concat() adds strings like the + operator does, without copying them. Converting the
+    // result to a QString flattens it, so that is checked last.
+    QJSValue concatenated = engine.evaluate("'abc'.concat('def', 'ghi')");
+    const QV4::String *rope = QJSValuePrivate::getValue(&concatenated)->as<QV4::String>();
+    QVERIFY(rope);
+    QCOMPARE(rope->d()->subtype, uint(QV4::Heap::String::StringType_AddedString));
+    QCOMPARE(concatenated.toString(), QString::fromLatin1("abcdefghi"));
+
+    // a substring in a rope counts with its length, not with its offset into the original string
+    QJSValue withSubstring = engine.evaluate(
+        "var text = ''; for (var i = 0; i < 100; ++i) text += 'abcdefghij';"
+        "text.slice(600, 610) + 'klm'");
+    rope = QJSValuePrivate::getValue(&withSubstring)->as<QV4::String>();
+    QVERIFY(rope);
+    QCOMPARE(rope->d()->subtype, uint(QV4::Heap::String::StringType_AddedString));
+    QCOMPARE(static_cast<const QV4::Heap::ComplexString *>(rope->d())->largestSubLength, 10);
+    QCOMPARE(withSubstring.toString(), QString::fromLatin1("abcdefghijklm"));
+}
+
+void tst_QJSEngine::arrayJoin_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("element types") << QString::fromLatin1(
+        "[1, 'a', null, undefined, 2.5, -7, [3, 4], { toString: function() { return 'o'; } }].join('-')")
+        << QString::fromLatin1("1-a---2.5--7-3,4-o");
+    QTest::newRow("separators") << QString::fromLatin1(
+        "[[1, 2, 3].join(), [1, 2, 3].join(''), [1, 2, 3].join(undefined), [1, 2].join(0), [].join('x'),"
+        " [, ].join('x')].join('|')")
+        << QString::fromLatin1("1,2,3|123|1,2,3|102||");
+    QTest::newRow("ropes") << QString::fromLatin1(
+        "var parts = []; for (var i = 0; i < 100; ++i) { var p = ''; for (var j = 0; j < 20; ++j) p += j % 10;"
+        "  parts.push(p); }"
+        "var joined = parts.join(', '); [joined.length, joined.slice(0, 24), joined.slice(-22)].join('|')")
+        << QString::fromLatin1("2198|01234567890123456789, 01|, 01234567890123456789");
+    QTest::newRow("array-like") << QString::fromLatin1(
+        "Array.prototype.join.call({ length: 3, 0: 'x', 2: 'z' }, '+')")
+        << QString::fromLatin1("x++z");
+    QTest::newRow("throwing element") << QString::fromLatin1(
+        "try { ['a', { toString: function() { throw 'thrown'; } }].join(); 'no error' } catch (e) { e }")
+        << QString::fromLatin1("thrown");
+}
+
+void tst_QJSEngine::arrayJoin()
+{
+    evaluateAndCompare();
+}
+
+void tst_QJSEngine::stringSearchAndCase_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+
+    // The strings are long enough to go through the vectorized loops and their remainders.
+    const QString longText = QString::fromLatin1(
+        "var text = ''; for (var i = 0; i < 100; ++i) text += 'abcdefghij';");
+
+    QTest::newRow("indexOf") << longText + QString::fromLatin1(
+        "[text.indexOf('j'), text.indexOf('jab'), text.indexOf('ja', 500), text.indexOf('ja', 990),"
+        " text.indexOf('jk'), text.indexOf('abcdefghija', 990), text.indexOf('', 7),"
+        " text.indexOf('a', -5), (text + '\\u00e9x\\u00e9').indexOf('\\u00e9x')].join()")
+        << QString::fromLatin1("9,9,509,-1,-1,-1,7,0,1000");
+    QTest::newRow("includes") << longText + QString::fromLatin1(
+        "[text.includes('hija'), text.includes('hija', 998), text.includes('', 5000),"
+        " text.includes('ab', -3), text.includes('aa')].join()")
+        << QString::fromLatin1("true,false,true,true,false");
+    QTest::newRow("split") << longText + QString::fromLatin1(
+        "var parts = text.split('ja'); [parts.length, parts[0], parts[1], parts[99]].join()")
+        << QString::fromLatin1("100,abcdefghi,bcdefghi,bcdefghij");
+    QTest::newRow("replace") << longText + QString::fromLatin1(
+        "text.replace('hij', '-').substr(5, 10)")
+        << QString::fromLatin1("fg-abcdefg");
+    QTest::newRow("toUpperCase") << QString::fromLatin1(
+        "['Hello, World! 0123456789 [`{@', 'abcdefghijklmnopqrstuvwxyz', 'ALREADY UPPER CASE TEXT 123']"
+        ".map(function(s) { return s.toUpperCase(); }).join('|') + '|'"
+        " + ('abcdefghij \\u00e9t\\u00e9'.toUpperCase() === 'ABCDEFGHIJ \\u00c9T\\u00c9')")
+        << QString::fromLatin1("HELLO, WORLD! 0123456789 [`{@|ABCDEFGHIJKLMNOPQRSTUVWXYZ|"
+                               "ALREADY UPPER CASE TEXT 123|true");
+    QTest::newRow("toLowerCase") << QString::fromLatin1(
+        "['Hello, World! 0123456789 [`{@', 'ABCDEFGHIJKLMNOPQRSTUVWXYZ', 'already lower case text 123']"
+        ".map(function(s) { return s.toLowerCase(); }).join('|') + '|'"
+        " + ('ABCDEFGHIJ \\u00c9T\\u00c9'.toLowerCase() === 'abcdefghij \\u00e9t\\u00e9')")
+        << QString::fromLatin1("hello, world! 0123456789 [`{@|abcdefghijklmnopqrstuvwxyz|"
+                               "already lower case text 123|true");
+    QTest::newRow("trim") << QString::fromLatin1(
+        "['  a b  ', '\\t\\n \\ufeffx\\u00a0', 'untouched', '   ']"
+        ".map(function(s) { return '[' + s.trim() + ']'; }).join()")
+        << QString::fromLatin1("[a b],[x],[untouched],[]");
+}
+
+void tst_QJSEngine::stringSearchAndCase()
+{
+    evaluateAndCompare();
+}
+
+void tst_QJSEngine::stringSearchConcatenated_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+    QTest::addColumn<bool>("returnsText");
+
+    // short enough for the concatenations to stay unflattened until something reads them
+    const QString mixed = QString::fromLatin1(
+        "var a = 'abcdefghij', b = 'ABCDEFGHIJ'; var text = a + b + a;");
+    const QString upper = QString::fromLatin1(
+        "var a = 'ABCDEFGHIJ', b = 'KLMNOPQRST', c = ' 0123456789'; var text = a + b + c;");
+
+    QTest::newRow("indexOf") << mixed << QString::fromLatin1("String(text.indexOf('jA'))")
+        << QString::fromLatin1("9") << false;
+    QTest::newRow("includes") << mixed << QString::fromLatin1("String(text.includes('Jab'))")
+        << QString::fromLatin1("true") << false;
+    QTest::newRow("split") << mixed << QString::fromLatin1("text.split('J').join('|')")
+        << QString::fromLatin1("abcdefghijABCDEFGHI|abcdefghij") << false;
+    QTest::newRow("replace") << mixed << QString::fromLatin1("text.replace('jA', '-')")
+        << QString::fromLatin1("abcdefghi-BCDEFGHIJabcdefghij") << false;
+    QTest::newRow("toUpperCase unchanged") << upper << QString::fromLatin1("text.toUpperCase()")
+        << QString::fromLatin1("ABCDEFGHIJKLMNOPQRST 0123456789") << true;
+    QTest::newRow("toLowerCase") << upper << QString::fromLatin1("text.toLowerCase()")
+        << QString::fromLatin1("abcdefghijklmnopqrst 0123456789") << false;
+}
+
+void tst_QJSEngine::stringSearchConcatenated()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, code);
+    QFETCH(QString, expected);
+    QFETCH(bool, returnsText);
+
+    QJSEngine engine;
+    QJSValue result = engine.evaluate(text + QLatin1String(" text"));
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    const QV4::Heap::String *string = QJSValuePrivate::getValue(&result)->stringValue()->d();
+    QCOMPARE(string->subtype, uint(QV4::Heap::String::StringType_AddedString));
+
+    result = engine.evaluate(code);
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), expected);
+
+    // The search flattened the text in place, so later searches don't concatenate it again.
+    QVERIFY(string->subtype < QV4::Heap::String::StringType_Complex);
+    QVERIFY(string->text);
+    QCOMPARE(string->text->size, engine.evaluate(QStringLiteral("text.length")).toInt());
+    QVERIFY(!static_cast<const QV4::Heap::ComplexString *>(string)->left);
+
+    // case mapping returns the string itself when nothing changes
+    if (returnsText)
+        QVERIFY(QJSValuePrivate::getValue(&result)->heapObject() == string);
+}
+
 void tst_QJSEngine::getterSetterThisObject_global()
 {
     {
@@ -2979,6 +3326,189 @@ void tst_QJSEngine::JSONparse()
     QVERIFY(ret.isObject());
 }
 
+void tst_QJSEngine::JSONparseRecords_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+
+    // Objects at the same nesting level are parsed with the class of the previous one.
+    QTest::newRow("same shape") << QString::fromLatin1(
+        "var a = JSON.parse('[{\"id\":1,\"name\":\"a\"},{\"id\":2,\"name\":\"b\"},{\"id\":3,\"name\":\"c\"}]');"
+        "a.map(function(o) { return Object.keys(o).join('+') + '=' + o.id + o.name; }).join()")
+        << QString::fromLatin1("id+name=1a,id+name=2b,id+name=3c");
+    QTest::newRow("changing shapes") << QString::fromLatin1(
+        "var a = JSON.parse('[{\"x\":1,\"y\":2,\"z\":3},{\"x\":4,\"z\":5},{\"x\":6,\"y\":7},"
+        "{\"x\":8,\"y\":9,\"z\":10,\"w\":11},{},{\"x\":12,\"x\":13,\"y\":14},{\"0\":15,\"x\":16}]');"
+        "a.map(function(o) { return Object.keys(o).map(function(k) { return k + o[k]; }).join('+'); }).join()")
+        << QString::fromLatin1("x1+y2+z3,x4+z5,x6+y7,x8+y9+z10+w11,,x13+y14,015+x16");
+    QTest::newRow("nested") << QString::fromLatin1(
+        "JSON.stringify(JSON.parse('[{\"a\":{\"b\":[1,{\"c\":2}]}},{\"a\":{\"b\":[3,{\"c\":4}],\"d\":5}},"
+        "{\"a\":{\"e\":6}}]'))")
+        << QString::fromLatin1("[{\"a\":{\"b\":[1,{\"c\":2}]}},{\"a\":{\"b\":[3,{\"c\":4}],\"d\":5}},"
+                               "{\"a\":{\"e\":6}}]");
+    QTest::newRow("escaped keys") << QString::fromLatin1(
+        "var a = JSON.parse('[{\"k\\\\u0065y\":1},{\"key\":2},{\"k\\\\u0065y\":3}]');"
+        "[a[0].key, a[1].key, a[2].key].join()")
+        << QString::fromLatin1("1,2,3");
+    QTest::newRow("numbers") << QString::fromLatin1(
+        "var a = JSON.parse('[0, -0, 7, -123456789, 1234567890, -2147483649, 1.5, -2.5e3, 1E2, 12345678901234567890]');"
+        "a.map(function(n) { return (n === 0 && 1 / n < 0) ? '-0' : String(n); }).join()")
+        << QString::fromLatin1("0,-0,7,-123456789,1234567890,-2147483649,1.5,-2500,100,12345678901234567000");
+    QTest::newRow("strings") << QString::fromLatin1(
+        "JSON.parse('[\"plain\", \"\", \"a\\\\\"b\", \"\\\\\\\\\", \"x\\\\ty\\\\n\", \"\\\\u0041\\\\ud83d\\\\ude00z\"]')"
+        ".map(function(s) { return s.length + ':' + escape(s); }).join()")
+        << QString::fromLatin1("5:plain,0:,3:a%22b,1:%5C,4:x%09y%0A,4:A%uD83D%uDE00z");
+    QTest::newRow("invalid numbers") << QString::fromLatin1(
+        "['-', '1.5.2', '--1', '1e', '[1,-]'].map(function(t) {"
+        "  try { JSON.parse(t); return 'parsed'; } catch (e) { return e.name; } }).join()")
+        << QString::fromLatin1("SyntaxError,SyntaxError,SyntaxError,SyntaxError,SyntaxError");
+}
+
+void tst_QJSEngine::JSONparseRecords()
+{
+    evaluateAndCompare();
+}
+
+void tst_QJSEngine::JSONparsePredictedShapes()
+{
+    QJSEngine engine;
+    QJSValue records = engine.evaluate(QString::fromLatin1(
+        "JSON.parse('[{\"id\":1,\"name\":\"a\"},{\"id\":2,\"name\":\"b\"},{\"id\":3},"
+        "{\"id\":4,\"name\":\"d\",\"more\":true}]')"));
+    QVERIFY2(records.isArray(), qPrintable(records.toString()));
+
+    QVector<QV4::InternalClass *> classes;
+    for (int i = 0; i < 4; ++i) {
+        QJSValue record = records.property(i);
+        classes.append(QJSValuePrivate::getValue(&record)->as<QV4::Object>()->internalClass());
+    }
+
+    // The second record was allocated with the class of the first one, the others left it.
+    QCOMPARE(classes.at(1), classes.at(0));
+    QCOMPARE(classes.at(0)->size, 2u);
+    QCOMPARE(classes.at(2)->size, 1u);
+    QCOMPARE(classes.at(3)->size, 3u);
+    QCOMPARE(records.property(1).property("id").toInt(), 2);
+    QCOMPARE(records.property(1).property("name").toString(), QString::fromLatin1("b"));
+    QCOMPARE(records.property(2).property("id").toInt(), 3);
+    QVERIFY(!records.property(2).hasOwnProperty(QStringLiteral("name")));
+    QCOMPARE(records.property(3).property("more").toBool(), true);
+
+    // Adding to a record with the predicted class doesn't change the one it was predicted from.
+    records.property(1).setProperty(QStringLiteral("extra"), 5);
+    QJSValue first = records.property(0);
+    QCOMPARE(QJSValuePrivate::getValue(&first)->as<QV4::Object>()->internalClass(), classes.at(0));
+    QVERIFY(!first.hasOwnProperty(QStringLiteral("extra")));
+    QCOMPARE(records.property(1).property("extra").toInt(), 5);
+    QCOMPARE(records.property(1).property("name").toString(), QString::fromLatin1("b"));
+}
+
+void tst_QJSEngine::JSONstringifyOutput_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("escapes") << QString::fromLatin1(
+        "JSON.stringify('a\"b\\\\c\\t\\n' + String.fromCharCode(1, 0x1f, 8, 12, 13) + '01234567890123456789\"')")
+        << QString::fromLatin1("\"a\\\"b\\\\c\\t\\n\\u0001\\u001f\\b\\f\\r01234567890123456789\\\"\"");
+    QTest::newRow("skipped members") << QString::fromLatin1(
+        "JSON.stringify({a: 1, b: undefined, c: function() {}, d: 'x', e: [undefined, function() {}, 2]})")
+        << QString::fromLatin1("{\"a\":1,\"d\":\"x\",\"e\":[null,null,2]}");
+    QTest::newRow("primitives") << QString::fromLatin1(
+        "JSON.stringify([0, -5, 1.5, 1e21, NaN, Infinity, new Number(3), true, new Boolean(false), null])")
+        << QString::fromLatin1("[0,-5,1.5,1e+21,null,null,3,true,false,null]");
+    QTest::newRow("toJSON") << QString::fromLatin1(
+        "JSON.stringify({d: {toJSON: function(k) { return 'key:' + k; }},"
+        " l: [{toJSON: function(k) { return typeof k + k; }}]})")
+        << QString::fromLatin1("{\"d\":\"key:d\",\"l\":[\"string0\"]}");
+    QTest::newRow("replacer function") << QString::fromLatin1(
+        "JSON.stringify({a: 1, b: 2, c: [3, 4]}, function(k, v) {"
+        "  return k === 'b' ? undefined : typeof v === 'number' ? v * 10 : v; })")
+        << QString::fromLatin1("{\"a\":10,\"c\":[30,40]}");
+    QTest::newRow("replacer array") << QString::fromLatin1(
+        "JSON.stringify({a: 1, b: 2, c: 3, 1: 4}, ['c', 'a', 1, 'x'])")
+        << QString::fromLatin1("{\"c\":3,\"a\":1,\"1\":4}");
+    QTest::newRow("gap") << QString::fromLatin1(
+        "JSON.stringify({a: [1, {}], b: {c: []}, d: undefined}, null, 2)")
+        << QString::fromLatin1("{\n  \"a\": [\n    1,\n    {}\n  ],\n  \"b\": {\n    \"c\": []\n  }\n}");
+    QTest::newRow("accessors and index keys") << QString::fromLatin1(
+        "var o = {2: 'two', x: 1};"
+        "Object.defineProperty(o, 'g', {get: function() { return 'got'; }, enumerable: true});"
+        "Object.defineProperty(o, 'h', {value: 'hidden'});"
+        "JSON.stringify(o)")
+        << QString::fromLatin1("{\"2\":\"two\",\"x\":1,\"g\":\"got\"}");
+    // The keys are collected before the values are serialized.
+    QTest::newRow("modified while serialized") << QString::fromLatin1(
+        "var o = {a: {toJSON: function() { delete o.b; o.c = 3; return 1; }}, b: 2};"
+        "JSON.stringify(o)")
+        << QString::fromLatin1("{\"a\":1}");
+    QTest::newRow("no output") << QString::fromLatin1(
+        "[JSON.stringify(undefined), JSON.stringify(function() {}), JSON.stringify({toJSON: function() {}})]"
+        ".map(String).join()")
+        << QString::fromLatin1("undefined,undefined,undefined");
+    QTest::newRow("cycle") << QString::fromLatin1(
+        "try { var o = {}; o.o = [o]; JSON.stringify(o); 'no exception'; } catch (e) { e.name; }")
+        << QString::fromLatin1("TypeError");
+}
+
+void tst_QJSEngine::JSONstringifyOutput()
+{
+    evaluateAndCompare();
+}
+
+// The escaping that JSON.stringify has to do, one character at a time.
+static QString quotedForJson(const QString &text)
+{
+    QString quoted = QLatin1String("\"");
+    for (const QChar c : text) {
+        switch (c.unicode()) {
+        case '"': quoted += QLatin1String("\\\""); break;
+        case '\\': quoted += QLatin1String("\\\\"); break;
+        case '\b': quoted += QLatin1String("\\b"); break;
+        case '\f': quoted += QLatin1String("\\f"); break;
+        case '\n': quoted += QLatin1String("\\n"); break;
+        case '\r': quoted += QLatin1String("\\r"); break;
+        case '\t': quoted += QLatin1String("\\t"); break;
+        default:
+            if (c.unicode() < 0x20)
+                quoted += QString::asprintf("\\u%04x", c.unicode());
+            else
+                quoted += c;
+        }
+    }
+    return quoted + QLatin1Char('"');
+}
+
+void tst_QJSEngine::JSONstringifyEscaping()
+{
+    QJSEngine engine;
+    QJSValue stringify = engine.globalObject().property("JSON").property("stringify");
+    QVERIFY(stringify.isCallable());
+
+    // Every ASCII character and a few others, at each place within and around the blocks
+    // of characters that are checked for escaping at once.
+    QVector<ushort> characters;
+    for (ushort c = 0; c < 0x80; ++c)
+        characters.append(c);
+    characters << 0xe9 << 0x2028 << 0xd800 << 0xdc00 << 0xfffe;
+
+    for (ushort c : qAsConst(characters)) {
+        for (int pos : { 0, 1, 7, 8, 9, 15, 16, 23 }) {
+            QString text(24, QLatin1Char('x'));
+            text[pos] = QChar(c);
+            QJSValue result = stringify.call(QJSValueList() << text);
+            QVERIFY2(result.isString(), qPrintable(result.toString()));
+            QCOMPARE(result.toString(), quotedForJson(text));
+        }
+    }
+
+    // keys go through the same escaping
+    QJSValue object = engine.newObject();
+    object.setProperty(QString::fromLatin1("k\"\n") + QChar(0x1f), 1);
+    QCOMPARE(stringify.call(QJSValueList() << object).toString(),
+             QString::fromLatin1("{\"k\\\"\\n\\u001f\":1}"));
+}
+
 void tst_QJSEngine::arraySort()
 {
     // tests that calling Array.sort with a bad sort function doesn't cause issues
@@ -2997,6 +3527,283 @@ void tst_QJSEngine::arraySort()
                  "crashMe();");
 }
 
+void tst_QJSEngine::arraySortOrder_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("integers as strings") << QString::fromLatin1(
+        "[10, 9, -1, 100, 0, -10, 2147483647, -2147483648, 1, 11].sort().join()")
+        << QString::fromLatin1("-1,-10,-2147483648,0,1,10,100,11,2147483647,9");
+    QTest::newRow("primitives") << QString::fromLatin1(
+        "[true, 'b', 1.5, null, 'a', 10, undefined, 'A', 2].sort().join('|')")
+        << QString::fromLatin1("1.5|10|2|A|a|b|null|true|");
+    QTest::newRow("objects") << QString::fromLatin1(
+        "var o = { toString: function() { return 'm'; } };"
+        "['z', o, 3, 'a'].sort().join()")
+        << QString::fromLatin1("3,a,m,z");
+    QTest::newRow("holes and undefined") << QString::fromLatin1(
+        "var a = [3, , undefined, 1, , 2]; a.sort();"
+        "[a.length, a[0], a[1], a[2], a[3], 4 in a, 5 in a].join()")
+        << QString::fromLatin1("6,1,2,3,,false,false");
+    QTest::newRow("stable") << QString::fromLatin1(
+        "var a = []; for (var i = 0; i < 1000; ++i) a.push({ k: (i * 7919) % 13, i: i });"
+        "a.sort(function(x, y) { return x.k - y.k; });"
+        "var ok = true; for (var i = 1; i < a.length; ++i)"
+        "  ok = ok && (a[i - 1].k < a[i].k || (a[i - 1].k === a[i].k && a[i - 1].i < a[i].i));"
+        "ok")
+        << QString::fromLatin1("true");
+    QTest::newRow("stable with little stack left") << QString::fromLatin1(
+        "var big = []; for (var i = 0; i < 10000; ++i) big.push(i);"
+        "function deep() {"
+        "    var up;"
+        "    try { up = deep.apply(null, big); } catch (e) { up = 2; }"
+        "    if (typeof up !== 'number') return up;"
+        "    if (up > 0) return up - 1;"
+        "    var a = []; for (var i = 0; i < 30000; ++i) a.push({ k: (i * 7919) % 13, i: i });"
+        "    a.sort(function(x, y) { return x.k - y.k; });"
+        "    var ok = true; for (var i = 1; i < a.length; ++i)"
+        "      ok = ok && (a[i - 1].k < a[i].k || (a[i - 1].k === a[i].k && a[i - 1].i < a[i].i));"
+        "    return String(ok);"
+        "}"
+        "deep()")
+        << QString::fromLatin1("true");
+    QTest::newRow("runs") << QString::fromLatin1(
+        "var a = []; for (var i = 0; i < 500; ++i) a.push(i); for (var i = 500; i > 0; --i) a.push(i * 2);"
+        "a.sort(function(x, y) { return x - y; });"
+        "var ok = a.length === 1000; for (var i = 1; i < a.length; ++i) ok = ok && a[i - 1] <= a[i];"
+        "ok")
+        << QString::fromLatin1("true");
+    QTest::newRow("sparse") << QString::fromLatin1(
+        "var a = []; a[100000] = 'c'; a[5] = 'a'; a[70] = 'b'; a.sort();"
+        "[a[0], a[1], a[2], a.length].join()")
+        << QString::fromLatin1("a,b,c,100001");
+    QTest::newRow("throwing comparison") << QString::fromLatin1(
+        "var a = [5, 4, 3, 2, 1], calls = 0;"
+        "try { a.sort(function(x, y) { if (++calls == 3) throw 'stop'; return x - y; }); } catch (e) {}"
+        "[calls, a.slice().sort().join()].join(';')")
+        << QString::fromLatin1("3;1,2,3,4,5");
+}
+
+void tst_QJSEngine::arraySortOrder()
+{
+    evaluateAndCompare();
+}
+
+void tst_QJSEngine::arraySortCollectingGarbage()
+{
+    // While the comparison function allocates and collects garbage, the elements are only held
+    // by the merge buffer or have been written back into the array.
+    QJSEngine eng;
+    eng.installExtensions(QJSEngine::GarbageCollectionExtension);
+    QJSValue result = eng.evaluate(
+        "var a = []; for (var i = 0; i < 2000; ++i) a.push({ k: (i * 7919) % 101, s: 'item' + i });"
+        "var calls = 0, garbage = [];"
+        "a.sort(function(x, y) {"
+        "    garbage.push({ x: x, y: y, s: x.s + y.s });"
+        "    if (++calls % 500 == 0) { garbage = []; gc(); }"
+        "    return x.k - y.k;"
+        "});"
+        "garbage = []; gc();"
+        "var ok = a.length === 2000, seen = {};"
+        "for (var i = 0; i < a.length; ++i) {"
+        "    ok = ok && a[i].s.substr(0, 4) === 'item' && !seen[a[i].s];"
+        "    seen[a[i].s] = true;"
+        "    if (i > 0) ok = ok && a[i - 1].k <= a[i].k;"
+        "}"
+        "ok");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString::fromLatin1("true"));
+}
+
+void tst_QJSEngine::numericArrays_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("indexOf integers") << QString::fromLatin1(
+        "var a = [1, 2, 3, 2, 1];"
+        "[a.indexOf(2), a.indexOf(2.0), a.indexOf(2.5), a.indexOf(-0), a.indexOf('2'), a.lastIndexOf(2), a.lastIndexOf(1, -2)].join()")
+        << QString::fromLatin1("1,1,-1,-1,-1,3,0");
+    QTest::newRow("indexOf doubles") << QString::fromLatin1(
+        "var a = [0, 0.5, NaN, 1e300, -1];"
+        "[a.indexOf(0.5), a.indexOf(-0), a.indexOf(NaN), a.indexOf(1e300), a.indexOf(-1, 5), a.lastIndexOf(0.5, 0)].join()")
+        << QString::fromLatin1("1,0,-1,3,-1,-1");
+    QTest::newRow("becomes generic") << QString::fromLatin1(
+        "var a = [1, 2, 3]; a[1] = 'x'; a[1] = 2;"
+        "var b = [1, 2, 3]; b.push({}); b.pop();"
+        "[a.indexOf(2), a.indexOf('x'), b.indexOf(3), b.lastIndexOf(1)].join()")
+        << QString::fromLatin1("1,-1,2,0");
+    QTest::newRow("holes and prototype") << QString::fromLatin1(
+        "var a = [1, , 3]; var r = [a.indexOf(undefined), a.lastIndexOf(undefined)];"
+        "Array.prototype[1] = 2; r.push(a.indexOf(2), a.lastIndexOf(2)); delete Array.prototype[1];"
+        "r.join()")
+        << QString::fromLatin1("-1,-1,1,1");
+    QTest::newRow("fill") << QString::fromLatin1(
+        "var a = new Array(5).fill(7); var b = [1, 2, 3, 4].fill(0.5, 1, -1);"
+        "var c = [1, 2, 3].fill('x', -1); var d = [1, 2].fill(9, 5);"
+        "[a.join(), b.join(), c.join(), d.join(), a.indexOf(7), b.indexOf(0.5), c.indexOf(3)].join(';')")
+        << QString::fromLatin1("7,7,7,7,7;1,0.5,0.5,4;1,2,x;1,2;0;1;-1");
+    QTest::newRow("fill generic") << QString::fromLatin1(
+        "var o = { length: 3 }; Array.prototype.fill.call(o, 1);"
+        "var f = Object.freeze([1, 2]); var threw = false;"
+        "try { 'use strict'; f.fill(0); } catch (e) { threw = true; }"
+        "[o[0], o[2], o.length, threw, f.join()].join()")
+        << QString::fromLatin1("1,1,3,true,1,2");
+    QTest::newRow("fill element attributes") << QString::fromLatin1(
+        "var a = [1, 2, 3]; Object.defineProperty(a, 1, { writable: false }); var threw = false;"
+        "try { a.fill(0); } catch (e) { threw = e instanceof TypeError; }"
+        "var b = [1, 2], seen = [];"
+        "Object.defineProperty(b, 0, { get: function() { return 5; }, set: function(v) { seen.push(v); } });"
+        "b.fill(7);"
+        "[threw, a.join(), b.join(), seen.join()].join(';')")
+        << QString::fromLatin1("true;0,2,3;5,7;7");
+    QTest::newRow("map and reduce") << QString::fromLatin1(
+        "var a = []; for (var i = 0; i < 1000; ++i) a.push(i * 0.5);"
+        "var m = a.map(function(x) { return x * 2; });"
+        "var sum = m.reduce(function(s, x) { return s + x; }, 0);"
+        "var right = m.reduceRight(function(s, x) { return s + x; });"
+        "var b = [1, 2, 3, 4]; var seen = [];"
+        "b.forEach(function(x, i) { seen.push(x); if (i == 0) b.length = 2; });"
+        "var c = [1, , 3]; var filtered = c.filter(function() { return true; });"
+        "[sum, right, m[999], seen.join(' '), filtered.length].join()")
+        << QString::fromLatin1("499500,499500,999,1 2,2");
+}
+
+void tst_QJSEngine::numericArrays()
+{
+    evaluateAndCompare();
+}
+
+void tst_QJSEngine::numericArraysAfterFill_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+    QTest::addColumn<int>("elementKind");
+
+    QTest::newRow("integers") << QString::fromLatin1("new Array(5).fill(7)")
+        << QString::fromLatin1("7,7,7,7,7") << int(QV4::Heap::ArrayData::IntegerElements);
+    QTest::newRow("doubles") << QString::fromLatin1("[1, 2, 3, 4].fill(0.5, 1, -1)")
+        << QString::fromLatin1("1,0.5,0.5,4") << int(QV4::Heap::ArrayData::NumberElements);
+    QTest::newRow("integers into doubles") << QString::fromLatin1("[0.5, 1.5].fill(2)")
+        << QString::fromLatin1("2,2") << int(QV4::Heap::ArrayData::NumberElements);
+    QTest::newRow("string") << QString::fromLatin1("[1, 2, 3].fill('x', -1)")
+        << QString::fromLatin1("1,2,x") << int(QV4::Heap::ArrayData::GenericElements);
+    QTest::newRow("undefined") << QString::fromLatin1("[1, 2].fill(undefined, 1)")
+        << QString::fromLatin1("1,") << int(QV4::Heap::ArrayData::GenericElements);
+    QTest::newRow("past the end") << QString::fromLatin1("[1, 2].fill(0.5, 5)")
+        << QString::fromLatin1("1,2") << int(QV4::Heap::ArrayData::IntegerElements);
+}
+
+void tst_QJSEngine::numericArraysAfterFill()
+{
+    QFETCH(QString, code);
+    QFETCH(QString, expected);
+    QFETCH(int, elementKind);
+
+    QJSEngine engine;
+    QJSValue result = engine.evaluate(code);
+    QVERIFY2(result.isArray(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), expected);
+
+    // fill() writes dense arrays in place and widens their element kind only as far as needed
+    const QV4::Object *array = QJSValuePrivate::getValue(&result)->as<QV4::Object>();
+    QVERIFY(array && array->arrayData());
+    QCOMPARE(array->arrayType(), QV4::Heap::ArrayData::Simple);
+    QCOMPARE(int(array->arrayData()->elementKind), elementKind);
+}
+
+void tst_QJSEngine::qobjectPropertyLookup()
+{
+    QObject a;
+    a.setObjectName("a");
+    QObject b;
+    b.setObjectName("b");
+    QTimer t;
+    t.setObjectName("t");
+    t.setInterval(42);
+    QObject *deleted = new QObject;
+    deleted->setObjectName("deleted");
+
+    QJSEngine engine;
+    for (QObject *o : { &a, &b, static_cast<QObject *>(&t), deleted })
+        QQmlEngine::setObjectOwnership(o, QQmlEngine::CppOwnership);
+    engine.globalObject().setProperty("a", engine.newQObject(&a));
+    engine.globalObject().setProperty("b", engine.newQObject(&b));
+    engine.globalObject().setProperty("t", engine.newQObject(&t));
+    engine.globalObject().setProperty("d", engine.newQObject(deleted));
+
+    QJSValue result = engine.evaluate(
+        "function name(o) { return o.objectName; }"
+        "function interval(o) { return o.interval; }"
+        "function method(o) { return typeof o.toString + typeof o.deleteLater; }"
+        "var r = [];"
+        "var list = [a, a, b, t, { objectName: 'js' }, a, d, t];"
+        "for (var i = 0; i < list.length; ++i) r.push(name(list[i]));"
+        "r.push(interval(t), interval(t), interval(a), method(a), method(t));"
+        "r.join()");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("a,a,b,t,js,a,deleted,t,42,42,,functionfunction,functionfunction"));
+
+    a.setObjectName("changed");
+    t.setInterval(7);
+    delete deleted;
+    result = engine.evaluate("[name(a), interval(t), name(d)].join()");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("changed,7,"));
+}
+
+void tst_QJSEngine::qobjectPropertyLookupAlternatingTypes()
+{
+    QObject o;
+    o.setObjectName("o");
+    QTimer t;
+    t.setObjectName("t");
+
+    QJSEngine engine;
+    QQmlEngine::setObjectOwnership(&o, QQmlEngine::CppOwnership);
+    QQmlEngine::setObjectOwnership(&t, QQmlEngine::CppOwnership);
+    engine.globalObject().setProperty("o", engine.newQObject(&o));
+    engine.globalObject().setProperty("t", engine.newQObject(&t));
+
+    engine.evaluate("function name(obj) { return obj.objectName; }");
+    QJSValue name = engine.globalObject().property("name");
+    QVERIFY(name.isCallable());
+    QV4::Function *f = QJSValuePrivate::getValue(&name)->as<QV4::FunctionObject>()->function();
+    const QV4::Lookup *lookup = nullptr;
+    for (uint i = 0; i < f->compilationUnit->data->lookupTableSize; ++i) {
+        const QV4::Lookup *l = f->compilationUnit->runtimeLookups + i;
+        if (f->compilationUnit->runtimeStrings[l->nameIndex]->toQString() == QLatin1String("objectName"))
+            lookup = l;
+    }
+    QVERIFY(lookup);
+    const QJSValueList withO = QJSValueList() << engine.globalObject().property("o");
+    const QJSValueList withT = QJSValueList() << engine.globalObject().property("t");
+
+    // the first objects keep getting the property from their property cache
+    QCOMPARE(name.call(withO).toString(), QString("o"));
+    QCOMPARE(name.call(withO).toString(), QString("o"));
+    QVERIFY(lookup->getter == QV4::QObjectWrapper::lookupGetter);
+    QCOMPARE(lookup->propertyCacheMisses, 0u);
+
+    // alternating between two types gives up on the property cache after a few misses
+    QJSValue result = engine.evaluate(
+        "var r = [];"
+        "for (var i = 0; i < 20; ++i) r.push(name(i % 2 ? t : o));"
+        "r.join('')");
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QCOMPARE(result.toString(), QString("otototototototototot"));
+    QVERIFY(lookup->getter == QV4::Lookup::getterFallback);
+    const uint misses = lookup->propertyCacheMisses;
+    QVERIFY(misses < 20);
+
+    // and stays on the fallback path
+    QCOMPARE(name.call(withT).toString(), QString("t"));
+    QCOMPARE(name.call(withO).toString(), QString("o"));
+    QVERIFY(lookup->getter == QV4::Lookup::getterFallback);
+    QCOMPARE(lookup->propertyCacheMisses, misses);
+}
+
 void tst_QJSEngine::lookupOnDisappearingProperty()
 {
     QJSEngine eng;
@@ -4185,6 +4992,264 @@ void tst_QJSEngine::protoChanges_QTBUG68369()
     QVERIFY(ok.toBool() == true);
 }
 
+static const QV4::Lookup::PolymorphicCache *polymorphicCache(const QJSValue &function)
+{
+    QV4::Function *f = QJSValuePrivate::getValue(&function)->as<QV4::FunctionObject>()->function();
+    for (uint i = 0; i < f->compilationUnit->data->lookupTableSize; ++i) {
+        if (const QV4::Lookup::PolymorphicCache *cache = f->compilationUnit->runtimeLookups[i].polymorphicCache())
+            return cache;
+    }
+    return nullptr;
+}
+
+void tst_QJSEngine::polymorphicLookups()
+{
+    QJSEngine engine;
+    engine.evaluate(
+        "var shapes = [];"
+        "for (var i = 0; i < 6; ++i) {"
+        "    var o = {};"
+        "    for (var j = 0; j < i; ++j) o['pad' + j] = j;"
+        "    o.x = i;"
+        "    shapes.push(o);"
+        "}"
+        "var proto = { x: 'proto' };"
+        "var inherited = Object.create(proto);"
+        "shapes.push(inherited);");
+
+    QJSValue get = engine.evaluate("(function(o) { return o.x; })");
+    QJSValue set = engine.evaluate("(function(o, v) { o.x = v; })");
+    QVERIFY(get.isCallable());
+    QVERIFY(set.isCallable());
+
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 6; ++i) {
+            QJSValue o = engine.evaluate(QString::fromLatin1("shapes[%1]").arg(i));
+            QCOMPARE(get.call(QJSValueList() << o).toInt(), i);
+        }
+        QJSValue inherited = engine.evaluate("inherited");
+        QCOMPARE(get.call(QJSValueList() << inherited).toString(), QStringLiteral("proto"));
+    }
+
+    const QV4::Lookup::PolymorphicCache *cache = polymorphicCache(get);
+    QVERIFY(cache);
+    QCOMPARE(cache->nEntries, 7u);
+    QVERIFY(cache->hits > cache->misses);
+
+    // changing the prototype invalidates its entry
+    engine.evaluate("proto.x = 'changed'");
+    QCOMPARE(get.call(QJSValueList() << engine.evaluate("inherited")).toString(), QStringLiteral("changed"));
+    engine.evaluate("proto.y = 1; proto.x = 'reshaped'");
+    QCOMPARE(get.call(QJSValueList() << engine.evaluate("inherited")).toString(), QStringLiteral("reshaped"));
+
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 6; ++i) {
+            QJSValue o = engine.evaluate(QString::fromLatin1("shapes[%1]").arg(i));
+            set.call(QJSValueList() << o << (round * 10 + i));
+        }
+    }
+    for (int i = 0; i < 6; ++i)
+        QCOMPARE(engine.evaluate(QString::fromLatin1("shapes[%1].x").arg(i)).toInt(), 90 + i);
+
+    cache = polymorphicCache(set);
+    QVERIFY(cache);
+    QCOMPARE(cache->nEntries, 6u);
+    QVERIFY(cache->hits > cache->misses);
+
+    // too many shapes make the site megamorphic, which must not change results
+    QJSValue result = engine.evaluate(
+        "var sum = 0;"
+        "for (var i = 0; i < 50; ++i) {"
+        "    var o = {};"
+        "    o['unique' + i] = i;"
+        "    o.x = i;"
+        "    sum += o.x;"
+        "}"
+        "sum");
+    QCOMPARE(result.toInt(), 1225);
+}
+
+void tst_QJSEngine::superinstructions_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("compare and jump") << QString::fromLatin1(
+        "(function() {"
+        "    var r = [], one = 1, two = 2, five = 5, a = 'a', nan = NaN;"
+        "    for (var i = 0; i < 6; ++i) {"
+        "        if (i == one) r.push('eq'); if (i != two) r.push('ne');"
+        "        if (i > 3) r.push('gt'); if (i >= 4) r.push('ge');"
+        "        if (i <= 0) r.push('le'); if (i === five) r.push('seq');"
+        "        if (i !== five) r.push('sne');"
+        "    }"
+        "    if (a < 'b') r.push('str'); if (nan < 1) r.push('nan');"
+        "    return r.join();"
+        "})()")
+        << QString::fromLatin1("ne,le,sne,eq,ne,sne,sne,ne,sne,ne,gt,ge,sne,ne,gt,ge,seq,str");
+    QTest::newRow("load and arithmetic") << QString::fromLatin1(
+        "function f(a, b) { var x = a; var y = b; return [x + y, x - y, x * y].join(); }"
+        "[f(2, 3), f(0x7fffffff, 2), f(1.5, 2), f('a', 1), f({ valueOf: function() { return 4; } }, 2)].join(';')")
+        << QString::fromLatin1("5,-1,6;2147483649,2147483645,4294967294;3.5,-0.5,3;a1,NaN,NaN;6,2,8");
+    QTest::newRow("increment") << QString::fromLatin1(
+        "(function() {"
+        "    var s = 0; for (var i = 0.5; i < 5; ++i) s += i;"
+        "    var n = 0x7fffffff; ++n; var t = '1'; ++t;"
+        "    return [s, n, t].join();"
+        "})()")
+        << QString::fromLatin1("12.5,2147483648,2");
+    QTest::newRow("lookup and store") << QString::fromLatin1(
+        "function f(o) { var a = o.x; var b = o.y; return a + b; }"
+        "var threw = false; try { f(null); } catch (e) { threw = true; }"
+        "[f({ x: 1, y: 2 }), f({ y: 'b', x: 'a' }), threw].join()")
+        << QString::fromLatin1("3,ab,true");
+    QTest::newRow("jump target between pair") << QString::fromLatin1(
+        "function f(c, a, b) { return (c ? a : b) < 3; }"
+        "[f(true, 1, 5), f(false, 1, 5), f(false, 5, 1)].join()")
+        << QString::fromLatin1("true,false,true");
+}
+
+// The bytecode generator fuses frequent instruction pairs. Run the same code through the
+// interpreter and the JIT, which handle the fused instructions separately.
+void tst_QJSEngine::superinstructions()
+{
+    evaluateAndCompareInterpretedAndJitted();
+}
+
+void tst_QJSEngine::superinstructionsInBytecode()
+{
+    using Type = QV4::Moth::Instr::Type;
+
+    QJSEngine engine;
+    engine.evaluate("function compare(a, b) { var r = 0; if (a == b) ++r; if (a !== b) ++r; return r; }"
+                    "function add(a, b) { var x = a; var y = b; return x + y; }"
+                    "function lookup(o) { var a = o.x; return a; }");
+
+    const QJSValue compare = engine.globalObject().property("compare");
+    QVERIFY(compare.isCallable());
+    QCOMPARE(instructionCount(compare, Type::CmpEqJumpFalse), 1);
+    QCOMPARE(instructionCount(compare, Type::CmpStrictNotEqualJumpFalse), 1);
+    QCOMPARE(instructionCount(compare, Type::IncrementStoreReg), 2);
+    QCOMPARE(instructionCount(compare, Type::CmpEq), 0);
+    QCOMPARE(instructionCount(compare, Type::CmpStrictNotEqual), 0);
+    QCOMPARE(instructionCount(compare, Type::Increment), 0);
+
+    const QJSValue add = engine.globalObject().property("add");
+    QVERIFY(add.isCallable());
+    QCOMPARE(instructionCount(add, Type::LoadRegAdd), 1);
+    QCOMPARE(instructionCount(add, Type::Add), 0);
+
+    const QJSValue lookup = engine.globalObject().property("lookup");
+    QVERIFY(lookup.isCallable());
+    QCOMPARE(instructionCount(lookup, Type::GetLookupStoreReg), 1);
+    QCOMPARE(instructionCount(lookup, Type::GetLookup), 0);
+}
+
+void tst_QJSEngine::inlinedCalls_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("local") << QString::fromLatin1(
+        "(function() {"
+        "    function sq(x) { return x * x; }"
+        "    var s = 0; for (var i = 0; i < 5; ++i) s += sq(i);"
+        "    return s;"
+        "})()")
+        << QString::fromLatin1("30");
+    QTest::newRow("global") << QString::fromLatin1(
+        "function add(a, b) { return a + b; }"
+        "function run() { return [add(1, 2), add('a', 'b'), add(0x7fffffff, 1)].join(); }"
+        "run()")
+        << QString::fromLatin1("3,ab,2147483648");
+    QTest::newRow("missing and extra arguments") << QString::fromLatin1(
+        "(function() {"
+        "    var log = [];"
+        "    function pair(a, b) { return '' + a + ':' + b; }"
+        "    function note(v) { log.push(v); return v; }"
+        "    return [pair(1), pair(note(2), note(3), note(4)), log.join('')].join();"
+        "})()")
+        << QString::fromLatin1("1:undefined,2:3,234");
+    QTest::newRow("redefined") << QString::fromLatin1(
+        "(function() {"
+        "    function f(x) { return x + 1; }"
+        "    function call() { return f(10); }"
+        "    var r = [call()];"
+        "    f = function(x) { return x * 2; };"
+        "    r.push(call());"
+        "    f = 5;"
+        "    try { call(); } catch (e) { r.push(e instanceof TypeError); }"
+        "    return r.join();"
+        "})()")
+        << QString::fromLatin1("11,20,true");
+    QTest::newRow("free variables") << QString::fromLatin1(
+        "(function() {"
+        "    var k = 3;"
+        "    function scale(x) { return x * k; }"
+        "    function run(x) { var k = 100; return scale(x) + k; }"
+        "    var r = [run(2)];"
+        "    k = 4;"
+        "    r.push(run(2));"
+        "    return r.join();"
+        "})()")
+        << QString::fromLatin1("106,108");
+    QTest::newRow("duplicate formals") << QString::fromLatin1(
+        "(function() {"
+        "    function g(a, a) { return a; }"
+        "    return g(1, 2);"
+        "})()")
+        << QString::fromLatin1("2");
+    QTest::newRow("closure of another activation") << QString::fromLatin1(
+        "(function() {"
+        "    function make(k) {"
+        "        function get() { return k; }"
+        "        function use(o) { if (o) get = o; return get(); }"
+        "        return { get: get, use: use };"
+        "    }"
+        "    return [make(1).use(), make(1).use(make(2).get)].join();"
+        "})()")
+        << QString::fromLatin1("1,2");
+    QTest::newRow("exception") << QString::fromLatin1(
+        "(function() {"
+        "    function get(o) { return o.x; }"
+        "    try { get(null); } catch (e) { return e instanceof TypeError; }"
+        "})()")
+        << QString::fromLatin1("true");
+    QTest::newRow("exception location") << QString::fromLatin1(
+        "(function() {\n"
+        "    function get(o) {\n"
+        "        return o.x; }\n"
+        "    try { get(null); } catch (e) { return e.lineNumber; }\n"
+        "})()")
+        << QString::fromLatin1("3");
+}
+
+void tst_QJSEngine::inlinedCalls()
+{
+    evaluateAndCompareInterpretedAndJitted();
+}
+
+void tst_QJSEngine::inlinedCallsInBytecode()
+{
+    using Type = QV4::Moth::Instr::Type;
+
+    QJSEngine engine;
+    engine.evaluate("function sq(x) { return x * x; }"
+                    "function sumOfSquares(a, b) { return sq(a) + sq(b); }"
+                    "function self() { return this; }"
+                    "function callSelf() { return self(); }");
+
+    // each inlined call is guarded by a check of the callee, followed by the regular call
+    const QJSValue sumOfSquares = engine.globalObject().property("sumOfSquares");
+    QVERIFY(sumOfSquares.isCallable());
+    QCOMPARE(instructionCount(sumOfSquares, Type::TestClosure), 2);
+    QCOMPARE(sumOfSquares.call(QJSValueList() << 3 << 4).toInt(), 25);
+
+    const QJSValue callSelf = engine.globalObject().property("callSelf");
+    QVERIFY(callSelf.isCallable());
+    QCOMPARE(instructionCount(callSelf, Type::TestClosure), 0);
+}
+
 QTEST_MAIN(tst_QJSEngine)
 
 #include "tst_qjsengine.moc"
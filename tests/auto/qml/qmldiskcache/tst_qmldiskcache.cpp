@@ -33,6 +33,8 @@
 #include <private/qv8engine_p.h>
 #include <private/qv4engine_p.h>
 #include <private/qv4codegen_p.h>
+#include <private/qv4function_p.h>
+#include <private/qqmlcomponent_p.h>
 #include <QQmlComponent>
 #include <QQmlEngine>
 #include <QQmlFileSelector>
@@ -59,6 +61,7 @@ private slots:
     void stableOrderOfDependentCompositeTypes();
     void singletonDependency();
     void cppRegisteredSingletonDependency();
+    void jitCode();
 };
 
 // A wrapper around QQmlComponent to ensure the temporary reference counts
@@ -835,6 +838,88 @@ void tst_qmldiskcache::cppRegisteredSingletonDependency()
     }
 }
 
+void tst_qmldiskcache::jitCode()
+{
+#if !defined(V4_ENABLE_JIT)
+    QSKIP("This test requires the JIT");
+#else
+    QScopedPointer<QQmlEngine> engine(new QQmlEngine);
+    TestCompiler testCompiler(engine.data());
+    QVERIFY(testCompiler.tempDir.isValid());
+
+    const QByteArray contents = QByteArrayLiteral("import QtQml 2.0\n"
+                                                  "QtObject {\n"
+                                                  "    function sum(n) { var s = 0; for (var i = 0; i < n; ++i) s += i; return s; }\n"
+                                                  "    property int value: sum(10)\n"
+                                                  "}");
+
+    qputenv("QV4_JIT_DISK_CACHE", "1");
+    qputenv("QV4_JIT_CALL_THRESHOLD", "0");
+    QVERIFY2(testCompiler.compile(contents), qPrintable(testCompiler.lastErrorString));
+    {
+        CleanlyLoadingComponent component(engine.data(), testCompiler.testFilePath);
+        QScopedPointer<QObject> obj(component.create());
+        QVERIFY(!obj.isNull());
+        QCOMPARE(obj->property("value").toInt(), 45);
+    }
+    // The code is written to the cache file when the engine is destroyed.
+    engine.reset();
+
+    {
+        const QV4::CompiledData::Unit *unit = testCompiler.mapUnit();
+        QVERIFY2(unit, qPrintable(testCompiler.lastErrorString));
+        const quint32 sectionOffset = QV4::CompiledData::JitCodeSection::offsetAfter(unit);
+        QVERIFY(testCompiler.mappedFile.size() > qint64(sectionOffset + sizeof(QV4::CompiledData::JitCodeSection)));
+        const QV4::CompiledData::JitCodeSection *section
+                = reinterpret_cast<const QV4::CompiledData::JitCodeSection *>(testCompiler.currentMapping + sectionOffset);
+        QVERIFY(!strncmp(section->magic, QV4::CompiledData::jit_magic_str, sizeof(section->magic)));
+        QVERIFY(section->nFunctions > 0);
+        QCOMPARE(qint64(sectionOffset + section->sectionSize), testCompiler.mappedFile.size());
+        testCompiler.closeMapping();
+    }
+
+    // A high threshold means that any JIT code present must have come from the cache file.
+    qputenv("QV4_JIT_CALL_THRESHOLD", "1000000");
+    const auto loadAndCheckJittedCode = [&](bool expectJittedCode) {
+        engine.reset(new QQmlEngine);
+        testCompiler.engine = engine.data();
+        CleanlyLoadingComponent component(engine.data(), testCompiler.testFilePath);
+        QScopedPointer<QObject> obj(component.create());
+        QVERIFY(!obj.isNull());
+        QCOMPARE(obj->property("value").toInt(), 45);
+
+        QQmlComponentPrivate *componentPrivate = QQmlComponentPrivate::get(&component);
+        QVERIFY(componentPrivate->compilationUnit);
+        QVERIFY(!componentPrivate->compilationUnit->backingFile.isNull());
+        bool hasJittedCode = false;
+        for (QV4::Function *function : qAsConst(componentPrivate->compilationUnit->runtimeFunctions))
+            hasJittedCode |= function->jittedCode != nullptr;
+        QCOMPARE(hasJittedCode, expectJittedCode);
+    };
+
+    loadAndCheckJittedCode(true);
+    engine.reset();
+    if (QTest::currentTestFailed())
+        return;
+
+    // Code that doesn't match the content hash anymore is not installed.
+    {
+        QFile cacheFile(testCompiler.cacheFilePath);
+        QVERIFY(cacheFile.open(QIODevice::ReadWrite));
+        QVERIFY(cacheFile.seek(cacheFile.size() - 1));
+        char lastByte = 0;
+        QVERIFY(cacheFile.getChar(&lastByte));
+        QVERIFY(cacheFile.seek(cacheFile.size() - 1));
+        QVERIFY(cacheFile.putChar(char(lastByte ^ 0x1)));
+    }
+    loadAndCheckJittedCode(false);
+    engine.reset();
+
+    qunsetenv("QV4_JIT_CALL_THRESHOLD");
+    qunsetenv("QV4_JIT_DISK_CACHE");
+#endif
+}
+
 QTEST_MAIN(tst_qmldiskcache)
 
 #include "tst_qmldiskcache.moc"
@@ -29,6 +29,10 @@
 #include <QtTest/QtTest>
 #include <QtCore/qprocess.h>
 #include <QtCore/qtemporaryfile.h>
+#include <QtQml/qjsengine.h>
+#include <private/qjsvalue_p.h>
+#include <private/qv4function_p.h>
+#include <private/qv4functionobject_p.h>
 
 class tst_QV4Assembler : public QObject
 {
@@ -36,8 +40,43 @@ class tst_QV4Assembler : public QObject
 
 private slots:
     void perfMapFile();
+    void optimizingTier_data();
+    void optimizingTier();
+    void typeFeedback_data();
+    void typeFeedback();
+    void loopEntry_data();
+    void loopEntry();
 };
 
+// The JIT thresholds are read when an engine is created.
+class JitThresholds
+{
+public:
+    JitThresholds(const QHash<QByteArray, QByteArray> &variables)
+        : m_variables(variables)
+    {
+        for (auto it = m_variables.cbegin(), end = m_variables.cend(); it != end; ++it)
+            qputenv(it.key().constData(), it.value());
+    }
+
+    ~JitThresholds()
+    {
+        for (auto it = m_variables.cbegin(), end = m_variables.cend(); it != end; ++it)
+            qunsetenv(it.key().constData());
+    }
+
+private:
+    QHash<QByteArray, QByteArray> m_variables;
+};
+
+static QV4::Function *function(QJSEngine *engine, const QString &name)
+{
+    QJSValue value = engine->globalObject().property(name);
+    if (!value.isCallable())
+        return nullptr;
+    return QJSValuePrivate::getValue(&value)->as<QV4::FunctionObject>()->function();
+}
+
 void tst_QV4Assembler::perfMapFile()
 {
 #if !defined(Q_OS_LINUX)
@@ -85,6 +124,209 @@ void tst_QV4Assembler::perfMapFile()
 #endif
 }
 
+void tst_QV4Assembler::optimizingTier_data()
+{
+    QTest::addColumn<QByteArray>("script");
+
+    QTest::newRow("int arithmetic") << QByteArray(
+        "function f(a, b) { return (a + b) * 2 - b; }"
+        "for (var i = 0; i < 500; ++i) { if (f(i, 3) !== 2 * i + 3) throw new Error('int ' + i); }");
+    QTest::newRow("int overflow") << QByteArray(
+        "function f(a, b) { return a * b + a; }"
+        "for (var i = 0; i < 500; ++i) { if (f(0x7fffffff, i) !== 0x7fffffff * i + 0x7fffffff) throw new Error('overflow ' + i); }");
+    QTest::newRow("double arithmetic") << QByteArray(
+        "function f(a, b) { return (a - b) / (a * b + 0.5); }"
+        "for (var i = 0; i < 500; ++i) { var a = i + 0.25; var e = (a - 1.5) / (a * 1.5 + 0.5);"
+        "  if (f(a, 1.5) !== e) throw new Error('double ' + i); }");
+    QTest::newRow("mixed and nan") << QByteArray(
+        "function f(a, b) { return a / b + a; }"
+        "for (var i = 0; i < 500; ++i) { var r = f(i % 2 ? 0 : 1.5, 0);"
+        "  if (i % 2 ? r === r : r !== Infinity) throw new Error('nan ' + i); }"
+        "if (!isNaN(f(undefined, 1))) throw new Error('undefined');"
+        "if (f(3, '1') !== 6) throw new Error('string');");
+    QTest::newRow("monomorphic lookup") << QByteArray(
+        "function f(o) { return o.x + o.y; }"
+        "var p = { x: 1, y: 2 };"
+        "for (var i = 0; i < 500; ++i) { if (f(p) !== 3) throw new Error('mono ' + i); }"
+        "if (f({ y: 3, x: 4 }) !== 7) throw new Error('other shape');"
+        "if (!isNaN(f(42))) throw new Error('primitive');"
+        "var threw = false; try { f(null); } catch (e) { threw = true; }"
+        "if (!threw) throw new Error('null');");
+    QTest::newRow("member data lookup") << QByteArray(
+        "function f(o) { return o.p9; }"
+        "var o = {}; for (var j = 0; j < 10; ++j) o['p' + j] = j;"
+        "for (var i = 0; i < 500; ++i) { if (f(o) !== 9) throw new Error('member data ' + i); }"
+        "o.p9 = 'changed'; if (f(o) !== 'changed') throw new Error('changed');");
+    QTest::newRow("cached stack slots") << QByteArray(
+        "function f(n) { var a = 1, b = 2, c = 3;"
+        "  for (var i = 0; i < n; ++i) { var t = a; a = b; b = c; c = t + i; }"
+        "  var g = function() { a = 100; }; g();"
+        "  try { b = c; throw a; } catch (e) { c = e + b; }"
+        "  return a + b + c; }"
+        "function ref(n) { var a = 1, b = 2, c = 3;"
+        "  for (var i = 0; i < n; ++i) { var t = a; a = b; b = c; c = t + i; }"
+        "  return 100 + 2 * c + 100; }"
+        "for (var i = 0; i < 200; ++i) { if (f(i) !== ref(i)) throw new Error('slots ' + i); }");
+}
+
+void tst_QV4Assembler::optimizingTier()
+{
+#ifndef V4_ENABLE_JIT
+    QSKIP("the JIT is not enabled on this platform");
+#else
+    QFETCH(QByteArray, script);
+
+    JitThresholds thresholds({ { "QV4_JIT_CALL_THRESHOLD", "0" },
+                               { "QV4_JIT_OPTIMIZE_THRESHOLD", "10" } });
+    QJSEngine engine;
+    const QJSValue result = engine.evaluate(QString::fromUtf8(script));
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    const QV4::Function *f = function(&engine, QStringLiteral("f"));
+    QVERIFY(f);
+    QVERIFY(f->isOptimized);
+#endif
+}
+
+void tst_QV4Assembler::typeFeedback_data()
+{
+    // The training calls are interpreted, and the last of them records the operand types. The
+    // script then calls f until it runs code specialized for them, and passes it other types.
+    QTest::addColumn<QByteArray>("definition");
+    QTest::addColumn<QByteArray>("training");
+    QTest::addColumn<int>("seen");
+    QTest::addColumn<int>("notSeen");
+    QTest::addColumn<QByteArray>("script");
+
+    QTest::newRow("int then double") << QByteArray(
+        "function f(a, b) { var r = 0; for (var i = 0; i < 50; ++i) r = a * b + r - a; return r; }")
+        << QByteArray("f(1, 2); f(2, 2); f(3, 2);")
+        << int(QV4::Function::SawInt) << int(QV4::Function::SawDouble | QV4::Function::SawOther)
+        << QByteArray(
+        "for (var i = 0; i < 100; ++i) { if (f(i, 2) !== 50 * i) throw new Error('int ' + i); }"
+        "if (f(1.5, 2) !== 75) throw new Error('double');"
+        "if (f(0x7fffffff, 2) !== 50 * 0x7fffffff) throw new Error('overflow');"
+        "if (f('1', 2) !== 50) throw new Error('string');");
+    QTest::newRow("double then int") << QByteArray(
+        "function f(a, b) { var r = 0; for (var i = 0; i < 50; ++i) r = r + a * b - a; return r; }")
+        << QByteArray("f(0.5, 2); f(1.5, 2); f(2.5, 2);")
+        << int(QV4::Function::SawDouble) << int(QV4::Function::SawOther)
+        << QByteArray(
+        "for (var i = 0; i < 100; ++i) { if (f(i + 0.5, 2) !== 50 * (i + 0.5)) throw new Error('double ' + i); }"
+        "if (f(3, 2) !== 150) throw new Error('int');"
+        "if (!isNaN(f(undefined, 2))) throw new Error('undefined');"
+        "if (f(true, 2) !== 50) throw new Error('bool');");
+    QTest::newRow("compare") << QByteArray(
+        "function f(a, b) { var n = 0; for (var i = 0; i < 10; ++i) { if (a < b) ++n; if (a >= b) --n;"
+        "  if (a > b) n += 10; if (a <= b) n -= 10; } return n; }")
+        << QByteArray("f(0.25, 20); f(0.75, 20); f(1.25, 20);")
+        << int(QV4::Function::SawDouble) << int(QV4::Function::SawOther)
+        << QByteArray(
+        "for (var i = 0; i < 100; ++i) { if (f(i * 0.5 + 0.25, 20) !== (i * 0.5 < 20 ? -90 : 90)) throw new Error('double ' + i); }"
+        "if (f(1, 2) !== -90 || f(2, 1) !== 90) throw new Error('int');"
+        "if (f(NaN, 1) !== 0 || f(1, NaN) !== 0) throw new Error('nan');"
+        "if (f('a', 'b') !== -90 || f('10', 9) !== 90) throw new Error('string');");
+    QTest::newRow("other then number") << QByteArray(
+        "function f(a, b) { var r = ''; for (var i = 0; i < 5; ++i) r = a + b; return r; }")
+        << QByteArray("f('x', 0); f('x', 1); f('x', 2);")
+        << int(QV4::Function::SawOther) << int(QV4::Function::SawDouble)
+        << QByteArray(
+        "for (var i = 0; i < 100; ++i) { if (f('x', i) !== 'x' + i) throw new Error('string ' + i); }"
+        "if (f(1, 2) !== 3 || f(0.5, 0.25) !== 0.75) throw new Error('number');");
+}
+
+void tst_QV4Assembler::typeFeedback()
+{
+#ifndef V4_ENABLE_JIT
+    QSKIP("the JIT is not enabled on this platform");
+#else
+    QFETCH(QByteArray, definition);
+    QFETCH(QByteArray, training);
+    QFETCH(int, seen);
+    QFETCH(int, notSeen);
+    QFETCH(QByteArray, script);
+
+    JitThresholds thresholds({ { "QV4_JIT_CALL_THRESHOLD", "3" },
+                               { "QV4_JIT_OPTIMIZE_THRESHOLD", "10" } });
+    QJSEngine engine;
+    QJSValue result = engine.evaluate(QString::fromUtf8(definition + training));
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    const QV4::Function *f = function(&engine, QStringLiteral("f"));
+    QVERIFY(f);
+    QVERIFY(!f->jittedCode);
+    QVERIFY(f->typeFeedback);
+    int recorded = QV4::Function::NoTypeFeedback;
+    for (uint i = 0; i < f->compiledFunction->codeSize; ++i)
+        recorded |= f->typeFeedback[i];
+    QVERIFY(recorded & seen);
+    QVERIFY(!(recorded & notSeen));
+
+    result = engine.evaluate(QString::fromUtf8(script));
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+    QVERIFY(f->isOptimized);
+    QVERIFY(!f->typeFeedback);
+#endif
+}
+
+void tst_QV4Assembler::loopEntry_data()
+{
+    // f is called once or twice only, so it is compiled because of its loops and entered while
+    // it is running in the interpreter.
+    QTest::addColumn<QByteArray>("script");
+    QTest::addColumn<bool>("entered");
+
+    QTest::newRow("for") << QByteArray(
+        "function f(n) { var s = 0, t = 'x'; for (var i = 0; i < n; ++i) { s += i; if (i == 5000) t += s; }"
+        "  return t + s; }"
+        "if (f(10000) !== 'x12502500' + 49995000) throw new Error('for ' + f(10000));") << true;
+    QTest::newRow("nested") << QByteArray(
+        "function f() { var s = 0; for (var i = 0; i < 100; ++i) { var j = 0; while (j < i) { s += j; ++j; } } return s; }"
+        "if (f() !== 161700) throw new Error('nested ' + f());") << true;
+    QTest::newRow("do while") << QByteArray(
+        "function f() { var a = [], i = 0; do { a.push(i * 0.5); } while (++i < 3000); return a[2999] + a.length; }"
+        "if (f() !== 4499.5) throw new Error('do while ' + f());") << true;
+    QTest::newRow("closure") << QByteArray(
+        "function f() { var c = 0; var inc = function() { return ++c; }; for (var i = 0; i < 3000; ++i) inc(); return c; }"
+        "if (f() !== 3000) throw new Error('closure ' + f());") << true;
+    QTest::newRow("try around loop") << QByteArray(
+        "function f() { var s = 0; try { for (var i = 0; i < 3000; ++i) s += i; throw s; } catch (e) { return e + 1; } }"
+        "if (f() !== 4498501) throw new Error('try ' + f());") << false;
+    QTest::newRow("try in loop") << QByteArray(
+        "function f() { var s = 0; for (var i = 0; i < 3000; ++i) { try { if (i == 2999) throw i; } catch (e) { s += e; } } return s; }"
+        "if (f() !== 2999) throw new Error('try in loop ' + f());") << true;
+    QTest::newRow("throw out of loop") << QByteArray(
+        "function f(n) { for (var i = 0; ; ++i) { if (i == n) throw new Error('done ' + i); } }"
+        "var caught = null; try { f(5000); } catch (e) { caught = e.message; }"
+        "if (caught !== 'done 5000') throw new Error('throw ' + caught);") << true;
+    QTest::newRow("recursion") << QByteArray(
+        "function f(depth) { var s = 0; for (var i = 0; i < 1500; ++i) s += i; if (depth) s += f(depth - 1); return s; }"
+        "if (f(3) !== 4 * 1124250) throw new Error('recursion ' + f(3));") << true;
+}
+
+void tst_QV4Assembler::loopEntry()
+{
+#ifndef V4_ENABLE_JIT
+    QSKIP("the JIT is not enabled on this platform");
+#else
+    QFETCH(QByteArray, script);
+    QFETCH(bool, entered);
+
+    JitThresholds thresholds({ { "QV4_JIT_CALL_THRESHOLD", "1000" },
+                               { "QV4_JIT_LOOP_THRESHOLD", "100" } });
+    QJSEngine engine;
+    const QJSValue result = engine.evaluate(QString::fromUtf8(script));
+    QVERIFY2(!result.isError(), qPrintable(result.toString()));
+
+    const QV4::Function *f = function(&engine, QStringLiteral("f"));
+    QVERIFY(f);
+    if (entered)
+        QVERIFY(f->loopEntryCount > 0);
+    else
+        QCOMPARE(f->loopEntryCount, 0);
+#endif
+}
+
 QTEST_MAIN(tst_QV4Assembler)
 
 #include "tst_qv4assembler.moc"
@@ -28,6 +28,8 @@
 
 #include <qtest.h>
 #include <QQmlEngine>
+#include <QJSEngine>
+#include <private/qv4engine_p.h>
 #include <private/qv4mm_p.h>
 
 class tst_qv4mm : public QObject
@@ -37,6 +39,11 @@ class tst_qv4mm : public QObject
 private slots:
     void gcStats();
     void tweaks();
+    void defragment();
+    void gcRecord();
+    void segmentPool();
+    void hugeItemCache_data();
+    void hugeItemCache();
 };
 
 void tst_qv4mm::gcStats()
@@ -53,6 +60,222 @@ void tst_qv4mm::tweaks()
     QQmlEngine engine;
 }
 
+// Leaves chunks of medium density and newer, sparse chunks behind, fills part of the free
+// space with new objects and lets the sparse survivors die. Returns the number of chunks left.
+static size_t chunksAfterSparseSurvivorsDie(bool defragment)
+{
+    if (defragment)
+        qputenv(QV4_MM_DEFRAGMENT, "1");
+    QJSEngine engine;
+    qunsetenv(QV4_MM_DEFRAGMENT);
+    QV4::MemoryManager *mm = engine.handle()->memoryManager;
+    if (mm->blockAllocator.defragment != defragment)
+        return 0;
+
+    QJSValue result = engine.evaluate(QStringLiteral(
+        "var medium = [];"
+        "for (var i = 0; i < 40000; ++i) {"
+        "    var o = { index: i };"
+        "    if ((i / 50 | 0) % 2 == 0)"
+        "        medium.push(o);"
+        "}"
+        "var sparse = [];"
+        "for (var i = 0; i < 100000; ++i) {"
+        "    var o = { index: i };"
+        "    if (i % 1000 == 0)"
+        "        sparse.push(o);"
+        "}"));
+    if (result.isError())
+        return 0;
+    mm->runGC();
+
+    result = engine.evaluate(QStringLiteral(
+        "var fresh = [];"
+        "for (var i = 0; i < 10000; ++i)"
+        "    fresh.push({ index: i });"
+        "var ok = sparse.length == 100;"
+        "for (var i = 0; i < sparse.length; ++i)"
+        "    ok = ok && sparse[i].index == i * 1000;"
+        "sparse = null;"
+        "ok"));
+    if (!result.toBool())
+        return 0;
+    mm->runGC();
+
+    result = engine.evaluate(QStringLiteral(
+        "var ok = medium.length == 20000 && fresh.length == 10000;"
+        "for (var i = 0; i < fresh.length; ++i)"
+        "    ok = ok && fresh[i].index == i;"
+        "ok"));
+    if (!result.toBool())
+        return 0;
+    return mm->blockAllocator.chunks.size();
+}
+
+void tst_qv4mm::defragment()
+{
+    // Without defragmentation the new objects go into the most recently swept chunks, which
+    // are the sparse ones, and keep them alive. Defragmentation fills the denser chunks first.
+    const size_t fragmented = chunksAfterSparseSurvivorsDie(false);
+    const size_t defragmented = chunksAfterSparseSurvivorsDie(true);
+    QVERIFY(fragmented > 0);
+    QVERIFY(defragmented > 0);
+    QVERIFY2(defragmented < fragmented,
+             qPrintable(QString::fromLatin1("%1 chunks left, %2 without defragmentation")
+                        .arg(defragmented).arg(fragmented)));
+}
+
+void tst_qv4mm::gcRecord()
+{
+    QJSEngine engine;
+    QV4::MemoryManager *mm = engine.handle()->memoryManager;
+
+    QVector<QV4::GCRecord> records;
+    mm->setGCRecordCallback([&records](const QV4::GCRecord &record) {
+        records.append(record);
+    });
+
+    // the array's data is too big for a chunk, it becomes a huge item
+    QJSValue result = engine.evaluate(QStringLiteral(
+        "var garbage = [];"
+        "for (var i = 0; i < 10000; ++i)"
+        "    garbage.push({ index: i });"
+        "garbage = null;"));
+    QVERIFY(!result.isError());
+    // collections paced by the allocations above may have been recorded already
+    records.clear();
+    mm->runGC();
+
+    QVERIFY(!records.isEmpty());
+    const QV4::GCRecord &record = records.last();
+    QCOMPARE(record.type, QV4::GCRecord::FullCollection);
+    QVERIFY(record.markTime > 0);
+    QVERIFY(record.sweepTime > 0);
+    QVERIFY(record.markedItems > 0);
+    QVERIFY(record.usedAfter < record.usedBefore);
+    QVERIFY(record.largeItemsAfter < record.largeItemsBefore);
+    QVERIFY(record.hugeItemsAfter < record.hugeItemsBefore);
+    QCOMPARE(record.usedAfter, mm->getUsedMem());
+
+    uint chunks = 0;
+    for (uint n : record.chunkOccupancy)
+        chunks += n;
+    QCOMPARE(size_t(chunks), mm->blockAllocator.chunks.size());
+
+    // everything that got freed is accounted to some class
+    size_t freedBytes = 0;
+    bool seenObject = false;
+    for (const QV4::GCRecord::FreedClass &freed : record.freedBytesPerClass) {
+        freedBytes += freed.second;
+        seenObject |= (qstrcmp(freed.first, "Object") == 0);
+    }
+    QCOMPARE(freedBytes, record.freedBytes());
+    QVERIFY(seenObject);
+
+    const int recorded = records.size();
+    mm->setGCRecordCallback(QV4::GCRecordCallback());
+    mm->runGC();
+    QCOMPARE(records.size(), recorded);
+}
+
+void tst_qv4mm::segmentPool()
+{
+    QV4::MemoryManager::setSegmentPoolCapacity(2);
+    QCOMPARE(QV4::MemoryManager::pooledSegments(), 0);
+
+    const QString script = QStringLiteral(
+        "var objects = [];"
+        "for (var i = 0; i < 10000; ++i)"
+        "    objects.push({ index: i });"
+        "objects.length");
+    {
+        QJSEngine engine;
+        QCOMPARE(engine.evaluate(script).toInt(), 10000);
+    }
+    const int pooled = QV4::MemoryManager::pooledSegments();
+    QVERIFY(pooled > 0);
+    QVERIFY(pooled <= 2);
+
+    {
+        // the new engine takes the segments over, their chunks have to be zeroed out
+        QJSEngine engine;
+        QVERIFY(QV4::MemoryManager::pooledSegments() < pooled);
+        QCOMPARE(engine.evaluate(script).toInt(), 10000);
+        engine.collectGarbage();
+        QCOMPARE(engine.evaluate(QStringLiteral("objects[9999].index")).toInt(), 9999);
+    }
+    QVERIFY(QV4::MemoryManager::pooledSegments() > 0);
+
+    QV4::MemoryManager::setSegmentPoolCapacity(0);
+    QCOMPARE(QV4::MemoryManager::pooledSegments(), 0);
+}
+
+void tst_qv4mm::hugeItemCache_data()
+{
+    QTest::addColumn<QByteArray>("cacheSize");
+    QTest::addColumn<bool>("decommit");
+
+    const QByteArray sixteenMegabytes = QByteArray::number(16*1024*1024);
+    QTest::newRow("committed") << sixteenMegabytes << false;
+    QTest::newRow("decommitted") << sixteenMegabytes << true;
+    QTest::newRow("disabled") << QByteArray("0") << false;
+    QTest::newRow("default") << QByteArray() << false;
+}
+
+void tst_qv4mm::hugeItemCache()
+{
+    QFETCH(QByteArray, cacheSize);
+    QFETCH(bool, decommit);
+
+    if (!cacheSize.isEmpty())
+        qputenv(QV4_MM_HUGE_ITEM_CACHE, cacheSize);
+    if (decommit)
+        qputenv(QV4_MM_HUGE_ITEM_DECOMMIT, "1");
+    QJSEngine engine;
+    qunsetenv(QV4_MM_HUGE_ITEM_CACHE);
+    qunsetenv(QV4_MM_HUGE_ITEM_DECOMMIT);
+    QV4::MemoryManager *mm = engine.handle()->memoryManager;
+    QCOMPARE(mm->hugeItemAllocator.decommitCachedSegments, decommit);
+
+    // the array data outgrows half a memory segment, it gets segments of its own
+    for (int i = 0; i < 4; ++i) {
+        QJSValue result = engine.evaluate(QStringLiteral(
+            "var big = [];"
+            "for (var j = 0; j < 400000; ++j)"
+            "    big.push(j);"
+            "var sum = 0;"
+            "for (var j = 0; j < big.length; ++j)"
+            "    sum += big[j];"
+            "big = null;"
+            "sum"));
+        QCOMPARE(result.toNumber(), 399999.0*400000/2);
+        mm->runGC();
+    }
+
+    const auto &counters = mm->hugeItemAllocator.counters;
+    QVERIFY(counters.segmentsMapped > 0);
+    if (cacheSize == "0") {
+        QCOMPARE(mm->hugeItemAllocator.cacheLimit, size_t(0));
+        QCOMPARE(counters.segmentsReused, 0u);
+        QVERIFY(mm->hugeItemAllocator.cachedSegments.empty());
+        return;
+    }
+
+    QVERIFY(counters.segmentsReused > 0);
+    QVERIFY(!mm->hugeItemAllocator.cachedSegments.empty());
+    QVERIFY(mm->hugeItemAllocator.cachedBytes <= mm->hugeItemAllocator.cacheLimit);
+
+    // collections that free no huge items leave the cache alone
+    const size_t cachedBytes = mm->hugeItemAllocator.cachedBytes;
+    mm->runGC();
+    QCOMPARE(mm->hugeItemAllocator.cachedBytes, cachedBytes);
+
+    // nothing needs the cached segments while the application is idle
+    engine.collectGarbageInIdleTime(100);
+    QVERIFY(mm->hugeItemAllocator.cachedSegments.empty());
+    QCOMPARE(mm->hugeItemAllocator.cachedBytes, size_t(0));
+}
+
 QTEST_MAIN(tst_qv4mm)
 
 #include "tst_qv4mm.moc"
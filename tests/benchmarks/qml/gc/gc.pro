@@ -0,0 +1,7 @@
+CONFIG += benchmark
+TEMPLATE = app
+TARGET = tst_gc
+QT += qml-private testlib
+macx:CONFIG -= app_bundle
+
+SOURCES += tst_gc.cpp
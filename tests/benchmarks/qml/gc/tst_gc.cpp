@@ -0,0 +1,177 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <qtest.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtQml/qjsengine.h>
+#include <private/qv4engine_p.h>
+#include <private/qv4mm_p.h>
+
+class tst_gc : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fullCollection_data();
+    void fullCollection();
+    void incrementalCollection_data();
+    void incrementalCollection();
+    void minorCollection_data();
+    void minorCollection();
+    void parallelCollection_data();
+    void parallelCollection();
+
+private:
+    static void populateHeap(QJSEngine *engine, int delegateCount);
+};
+
+// Builds a heap shaped like a view with many delegates: a large retained object graph, plus
+// garbage that keeps being produced by bindings.
+void tst_gc::populateHeap(QJSEngine *engine, int delegateCount)
+{
+    QJSValue result = engine->evaluate(QString::fromLatin1(
+        "var delegates = [];"
+        "for (var i = 0; i < %1; ++i) {"
+        "    var d = { index: i, name: 'delegate' + i, properties: [] };"
+        "    for (var j = 0; j < 20; ++j)"
+        "        d.properties.push({ key: 'p' + j, value: j * i, next: d });"
+        "    delegates.push(d);"
+        "}"
+        "function churn() {"
+        "    var garbage = [];"
+        "    for (var i = 0; i < 1000; ++i)"
+        "        garbage.push({ text: 'row' + i, value: i });"
+        "    delegates[garbage.length % delegates.length].last = garbage[0];"
+        "}").arg(delegateCount));
+    QVERIFY(!result.isError());
+}
+
+void tst_gc::fullCollection_data()
+{
+    QTest::addColumn<int>("delegateCount");
+    QTest::newRow("500 delegates") << 500;
+    QTest::newRow("2000 delegates") << 2000;
+}
+
+void tst_gc::fullCollection()
+{
+    QFETCH(int, delegateCount);
+
+    QJSEngine engine;
+    populateHeap(&engine, delegateCount);
+    QV4::MemoryManager *mm = engine.handle()->memoryManager;
+
+    QBENCHMARK {
+        mm->runGC();
+    }
+}
+
+void tst_gc::incrementalCollection_data()
+{
+    fullCollection_data();
+}
+
+// Reports the longest single pause of a complete incremental collection, which is
+// what shows up as a frame hitch.
+void tst_gc::incrementalCollection()
+{
+    QFETCH(int, delegateCount);
+
+    QJSEngine engine;
+    QV4::MemoryManager *mm = engine.handle()->memoryManager;
+    mm->incrementalGC = true;
+    populateHeap(&engine, delegateCount);
+    QJSValue churn = engine.globalObject().property(QStringLiteral("churn"));
+
+    qint64 maxPause = 0;
+    QElapsedTimer timer;
+    do {
+        churn.call();
+        timer.start();
+        mm->runIncrementalGCStep();
+        maxPause = qMax(maxPause, timer.nsecsElapsed());
+    } while (mm->isIncrementalGCRunning());
+
+    QTest::setBenchmarkResult(maxPause / 1000000., QTest::WalltimeMilliseconds);
+}
+
+void tst_gc::minorCollection_data()
+{
+    fullCollection_data();
+}
+
+// Collects the garbage produced by one binding evaluation while the delegates sit in the
+// old generation. Compare with fullCollection.
+void tst_gc::minorCollection()
+{
+    QFETCH(int, delegateCount);
+
+    // the write barrier needs to be set up when the engine is created
+    qputenv(QV4_MM_GENERATIONAL_GC, "1");
+    QJSEngine engine;
+    qunsetenv(QV4_MM_GENERATIONAL_GC);
+    QV4::MemoryManager *mm = engine.handle()->memoryManager;
+    QVERIFY(mm->generationalGC);
+
+    populateHeap(&engine, delegateCount);
+    QJSValue churn = engine.globalObject().property(QStringLiteral("churn"));
+    // promote the delegates
+    mm->runGC();
+
+    QBENCHMARK {
+        churn.call();
+        mm->runMinorGC();
+    }
+}
+
+void tst_gc::parallelCollection_data()
+{
+    QTest::addColumn<int>("markingThreads");
+    QTest::newRow("1 thread") << 1;
+    QTest::newRow("2 threads") << 2;
+    QTest::newRow("4 threads") << 4;
+    QTest::newRow("8 threads") << 8;
+}
+
+void tst_gc::parallelCollection()
+{
+    QFETCH(int, markingThreads);
+
+    QJSEngine engine;
+    populateHeap(&engine, 10000);
+    QV4::MemoryManager *mm = engine.handle()->memoryManager;
+    mm->markingThreads = markingThreads;
+
+    QBENCHMARK {
+        mm->runGC();
+    }
+}
+
+QTEST_MAIN(tst_gc)
+
+#include "tst_gc.moc"
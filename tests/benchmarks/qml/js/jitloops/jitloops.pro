@@ -0,0 +1,8 @@
+CONFIG += benchmark
+TEMPLATE = app
+TARGET = tst_bench_jitloops
+
+SOURCES += tst_jitloops.cpp
+
+QT += qml testlib
+macos:CONFIG -= app_bundle
@@ -0,0 +1,102 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <qtest.h>
+#include <QtQml/qjsvalue.h>
+#include <QtQml/qjsengine.h>
+
+class tst_jitloops : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void loop_data();
+    void loop();
+};
+
+void tst_jitloops::loop_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<bool>("cacheStackSlots");
+
+    const struct {
+        const char *name;
+        const char *code;
+    } loops[] = {
+        { "int sum",
+          "(function(n) { var s = 0; for (var i = 0; i < n; ++i) s = s + i; return s; })" },
+        { "double accumulate",
+          "(function(n) { var s = 0.5; for (var i = 0; i < n; ++i) s = s * 1.0001 + i; return s; })" },
+        { "bitwise mix",
+          "(function(n) { var h = 17; for (var i = 0; i < n; ++i) h = ((h << 5) ^ (h >> 3) ^ i) & 0xffffff; return h; })" },
+        { "nested",
+          "(function(n) { var s = 0; for (var i = 0; i < n / 100; ++i) for (var j = 0; j < 100; ++j) s = s + i * j; return s; })" },
+        { "array walk",
+          "(function(n) { var a = []; for (var i = 0; i < 100; ++i) a.push(i); var s = 0;"
+          "  for (var k = 0; k < n / 100; ++k) for (var i = 0; i < a.length; ++i) s = s + a[i]; return s; })" },
+    };
+
+    for (const auto &l : loops) {
+        QTest::newRow(QByteArray(l.name).append(" (register cache)").constData())
+                << QString::fromLatin1(l.code) << true;
+        QTest::newRow(QByteArray(l.name).append(" (frame only)").constData())
+                << QString::fromLatin1(l.code) << false;
+    }
+}
+
+void tst_jitloops::loop()
+{
+    QFETCH(QString, code);
+    QFETCH(bool, cacheStackSlots);
+
+    // Both settings are read when the engine is created; compile on the first call.
+    qputenv("QV4_JIT_CALL_THRESHOLD", "0");
+    if (!cacheStackSlots)
+        qputenv("QV4_JIT_NO_REGISTER_CACHE", "1");
+    QJSEngine engine;
+    qunsetenv("QV4_JIT_NO_REGISTER_CACHE");
+    qunsetenv("QV4_JIT_CALL_THRESHOLD");
+
+    QJSValue function = engine.evaluate(code);
+    QVERIFY(function.isCallable());
+    const QJSValueList args = QJSValueList() << 100000;
+    const QJSValue expected = function.call(args);
+    QVERIFY(!expected.isError());
+
+    QBENCHMARK {
+        QJSValue result = function.call(args);
+        Q_UNUSED(result);
+    }
+
+    QCOMPARE(function.call(args).toNumber(), expected.toNumber());
+}
+
+QTEST_MAIN(tst_jitloops)
+
+#include "tst_jitloops.moc"
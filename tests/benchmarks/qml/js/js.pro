@@ -1,8 +1,10 @@
 TEMPLATE = subdirs
 SUBDIRS = \
+        jitloops \
         qjsengine \
         qjsvalue \
         qjsvalueiterator \
+        stringbuilding \
 
 TRUSTED_BENCHMARKS += \
     qjsvalue \
@@ -0,0 +1,8 @@
+CONFIG += benchmark
+TEMPLATE = app
+TARGET = tst_bench_stringbuilding
+
+SOURCES += tst_stringbuilding.cpp
+
+QT += qml testlib
+macos:CONFIG -= app_bundle
@@ -0,0 +1,113 @@
+/****************************************************************************
+**
+** Copyright (C) 2018 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the test suite of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include <qtest.h>
+#include <QtQml/qjsvalue.h>
+#include <QtQml/qjsengine.h>
+
+// Builds strings of up to 5M characters (10 MB) in different ways. The time should grow
+// linearly with the size for every pattern.
+class tst_stringbuilding : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void build_data();
+    void build();
+};
+
+void tst_stringbuilding::build_data()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<int>("size");
+
+    const struct {
+        const char *name;
+        const char *code;
+    } patterns[] = {
+        { "append character",
+          "(function(n) { var s = ''; for (var i = 0; i < n; ++i) s += 'x'; return s; })" },
+        { "append chunk",
+          "(function(n) { var c = '0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz';"
+          "  var s = ''; while (s.length < n) s += c; return s; })" },
+        { "prepend chunk",
+          "(function(n) { var c = '0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz';"
+          "  var s = ''; while (s.length < n) s = c + s; return s; })" },
+        { "append numbers",
+          "(function(n) { var s = ''; for (var i = 0; s.length < n; ++i) s += i + ','; return s; })" },
+        { "append captures",
+          "(function(n) { var re = /(\\w+)=(\\w+)/; var s = '';"
+          "  for (var i = 0; s.length < n; ++i) { var m = re.exec('key' + i + '=value' + i); s += m[1] + ':' + m[2] + ';'; }"
+          "  return s; })" },
+        { "String.prototype.concat",
+          "(function(n) { var s = ''; for (var i = 0; s.length < n; ++i) s = s.concat('item', i, ';'); return s; })" },
+        { "Array.prototype.join",
+          "(function(n) { var a = []; for (var i = 0; i < n / 10; ++i) a.push('row ' + (i % 10000));"
+          "  return a.join(','); })" },
+        { "Array.prototype.join of ropes",
+          "(function(n) { var a = []; for (var i = 0; i < n / 40; ++i) a.push('row ' + i + ': ' + 'abcdefghijklmnopqrstuvwxyz');"
+          "  return a.join('\\n'); })" },
+        { "JSON.stringify",
+          "(function(n) { var a = []; for (var i = 0; i < n / 40; ++i) a.push({ id: i, name: 'row' + i, ok: true });"
+          "  return JSON.stringify(a); })" },
+    };
+
+    const int sizes[] = { 1 << 20, 5 << 19, 5 << 20 };
+
+    for (const auto &p : patterns) {
+        for (int size : sizes) {
+            QTest::newRow(QByteArray(p.name).append(' ').append(QByteArray::number(size)).constData())
+                    << QString::fromLatin1(p.code) << size;
+        }
+    }
+}
+
+void tst_stringbuilding::build()
+{
+    QFETCH(QString, code);
+    QFETCH(int, size);
+
+    QJSEngine engine;
+    QJSValue function = engine.evaluate(code);
+    QVERIFY(function.isCallable());
+    const QJSValueList args = QJSValueList() << size;
+
+    QBENCHMARK {
+        QJSValue result = function.call(args);
+        Q_UNUSED(result);
+    }
+
+    const QJSValue result = function.call(args);
+    QVERIFY(!result.isError());
+    QVERIFY(result.toString().length() >= size / 2);
+}
+
+QTEST_MAIN(tst_stringbuilding)
+
+#include "tst_stringbuilding.moc"
@@ -11,6 +11,7 @@ SUBDIRS += \
            librarymetrics_performance \
            script \
            js \
-           creation
+           creation \
+           gc
 
 qtHaveModule(opengl): SUBDIRS += painting qquickwindow
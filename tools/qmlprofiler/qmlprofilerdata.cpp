@@ -121,6 +121,8 @@ QString QmlProfilerData::qmlRangeTypeAsString(RangeType type)
 
 QString QmlProfilerData::qmlMessageAsString(Message type)
 {
+    if (type == GarbageCollection)
+        return QLatin1String("GarbageCollection");
     if (type * sizeof(char *) < sizeof(MESSAGE_STRINGS))
         return QLatin1String(MESSAGE_STRINGS[type]);
     else
@@ -212,6 +214,9 @@ void QmlProfilerData::addEventType(const QQmlProfilerEventType &type)
     case DebugMessage:
         displayName = QString::fromLatin1("DebugMessage:%1").arg(type.detailType());
         break;
+    case GarbageCollection:
+        displayName = QString::fromLatin1("GarbageCollection:%1").arg(type.detailType());
+        break;
     case MaximumMessage: {
         const QQmlProfilerEventLocation eventLocation = type.location();
         // generate hash
@@ -363,6 +368,11 @@ struct StreamWriter {
         stream.writeAttribute(QLatin1String(name), QLatin1String(value));
     }
 
+    void writeAttribute(const char *name, const QString &value)
+    {
+        stream.writeAttribute(QLatin1String(name), value);
+    }
+
     void writeAttribute(const char *name, const QQmlProfilerEvent &event, int i, bool printZero = true)
     {
         const qint64 number = event.number<qint64>(i);
@@ -461,6 +471,8 @@ bool QmlProfilerData::save(const QString &filename)
             stream.writeTextElement("sgEventType", eventData.detailType());
         else if (eventData.message() == MemoryAllocation)
             stream.writeTextElement("memoryEventType", eventData.detailType());
+        else if (eventData.message() == GarbageCollection)
+            stream.writeTextElement("gcEventType", eventData.detailType());
         stream.writeEndElement();
     }
     stream.writeEndElement(); // eventData
@@ -503,6 +515,23 @@ bool QmlProfilerData::save(const QString &filename)
             stream.writeAttribute("timing5", event, 4, false);
         } else if (type.message() == MemoryAllocation) {
             stream.writeAttribute("amount", event, 0);
+        } else if (type.message() == GarbageCollection) {
+            stream.writeAttribute("markTime", event, 0);
+            stream.writeAttribute("sweepTime", event, 1);
+            stream.writeAttribute("freed", event, 2);
+            stream.writeAttribute("used", event, 3);
+            stream.writeAttribute("hugeItems", event, 4);
+            // the chunk occupancy histogram, then the freed bytes of the classes in the details
+            const QVector<qint64> numbers = event.numbers<QVector<qint64>>();
+            const int buckets = int(numbers.value(5));
+            QStringList occupancy;
+            for (int i = 6; i < 6 + buckets && i < numbers.length(); ++i)
+                occupancy.append(QString::number(numbers[i]));
+            stream.writeAttribute("chunkOccupancy", occupancy.join(QLatin1Char(',')));
+            QStringList freedPerClass;
+            for (int i = 6 + buckets; i < numbers.length(); ++i)
+                freedPerClass.append(QString::number(numbers[i]));
+            stream.writeAttribute("freedPerClass", freedPerClass.join(QLatin1Char(',')));
         }
         stream.writeEndElement();
     };